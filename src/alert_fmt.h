@@ -0,0 +1,269 @@
+/*
+ * alert_fmt.h - fixed-schema alert lines without printf.
+ *
+ * The settimeofday alerts always have the same fields in the same order,
+ * so the line is assembled from precomputed key prefixes (one table per
+ * style) and a hand-rolled integer conversion that writes its digits in
+ * place. Output goes straight to the caller's buffer, which must have
+ * AF_LINE_MAX bytes free; nothing is formatted on the stack first and
+ * nothing is allocated.
+ *
+ *   AF_KV    SETTIMEOFDAY cnt=1 new=... comm=date          (log_alert format)
+ *   AF_JSON  {"type":"SETTIMEOFDAY","cnt":1,...,"comm":"date"}   (JSON Lines)
+ *
+ * af_settime / af_summary produce the same bytes as the printf formats
+ * they replace in AF_KV style. A SETTIMEOFDAY from a known cgroup
+ * carries cgroup=... container=... after comm, and one with a captured
+ * caller stack (stack_sym.h) ends in ustack=... kstack=...
+ */
+#ifndef ALERT_FMT_H
+#define ALERT_FMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * keys + 10 numbers of <= 20 chars + comm, state and container escaped
+ * (x6) + stacks
+ */
+#define AF_STACK_MAX 384        /* SS_TEXT_MAX; never needs escaping */
+#define AF_NAME_MAX  64         /* container */
+#define AF_LINE_MAX (704 + 6 * AF_NAME_MAX + 2 * (AF_STACK_MAX + 16))
+#define AF_COMM_LEN 16
+
+enum af_style {
+    AF_KV,
+    AF_JSON,
+};
+
+struct af_key {
+    const char *s;
+    size_t n;
+};
+
+#define AF_KEYPAIR(kv, js) { { kv, sizeof(kv) - 1 }, { js, sizeof(js) - 1 } }
+
+static const char af_digits2[201] =
+    "00010203040506070809" "10111213141516171819"
+    "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+static inline char *af_put(char *p, const struct af_key *k)
+{
+    memcpy(p, k->s, k->n);
+    return p + k->n;
+}
+
+static inline int af_ndigits(uint64_t v)
+{
+    int n = 1;
+    for (;;) {
+        if (v < 10) return n;
+        if (v < 100) return n + 1;
+        if (v < 1000) return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+static inline char *af_u64(char *p, uint64_t v)
+{
+    int n = af_ndigits(v);
+    char *q = p + n;
+
+    while (v >= 100) {
+        unsigned d = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--q = af_digits2[d + 1];
+        *--q = af_digits2[d];
+    }
+    if (v >= 10) {
+        *--q = af_digits2[v * 2 + 1];
+        *--q = af_digits2[v * 2];
+    } else {
+        *--q = (char)('0' + v);
+    }
+    return p + n;
+}
+
+static inline char *af_i64(char *p, int64_t v)
+{
+    if (v < 0) {
+        *p++ = '-';
+        return af_u64(p, 0 - (uint64_t)v);
+    }
+    return af_u64(p, (uint64_t)v);
+}
+
+/*
+ * At most max bytes of s, up to its NUL (like %.16s). A comm is set by
+ * the process itself (prctl(PR_SET_NAME)), so it is never trusted to be
+ * clean: JSON escapes quotes, backslashes and control bytes, KV writes
+ * control bytes and backslashes as \xNN so no line (a forged #CHAIN,
+ * say) can be injected into the log.
+ */
+static inline char *af_str(char *p, const char *s, size_t max,
+                           enum af_style style)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < max && s[i]; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (style == AF_JSON && (c < 0x20 || c == '"' || c == '\\')) {
+            *p++ = '\\';
+            if (c == '"' || c == '\\') {
+                *p++ = (char)c;
+            } else {
+                memcpy(p, "u00", 3);
+                p[3] = hex[c >> 4];
+                p[4] = hex[c & 15];
+                p += 5;
+            }
+            continue;
+        }
+        if (style == AF_KV && (c < 0x20 || c == 0x7f || c == '\\')) {
+            p[0] = '\\';
+            p[1] = 'x';
+            p[2] = hex[c >> 4];
+            p[3] = hex[c & 15];
+            p += 4;
+            continue;
+        }
+        *p++ = (char)c;
+    }
+    return p;
+}
+
+/* ===== SETTIMEOFDAY (first event of a key) ===== */
+struct af_settime {
+    uint64_t cnt;
+    int64_t new_wall;
+    int64_t expected;
+    int64_t diff;
+    const char *state;
+    int64_t tz;
+    uint64_t ktime_ns;
+    int64_t boot_ns;
+    uint32_t pid;
+    const char *comm;
+    uint64_t cgroup;            /* 0: not known (trace, timerfd) */
+    const char *container;      /* NULL: "-" */
+    const char *ustack;         /* NULL: no stack captured */
+    size_t ustack_len;
+    const char *kstack;
+    size_t kstack_len;
+};
+
+static const struct af_key af_settime_keys[][2] = {
+    AF_KEYPAIR("SETTIMEOFDAY cnt=", "{\"type\":\"SETTIMEOFDAY\",\"cnt\":"),
+    AF_KEYPAIR(" new=",             ",\"new\":"),
+    AF_KEYPAIR(" expected=",        ",\"expected\":"),
+    AF_KEYPAIR(" diff=",            ",\"diff\":"),
+    AF_KEYPAIR(" state=",           ",\"state\":\""),
+    AF_KEYPAIR(" tz=",              "\",\"tz\":"),
+    AF_KEYPAIR(" ktime_ns=",        ",\"ktime_ns\":"),
+    AF_KEYPAIR(" boot_ns=",         ",\"boot_ns\":"),
+    AF_KEYPAIR(" pid=",             ",\"pid\":"),
+    AF_KEYPAIR(" comm=",            ",\"comm\":\""),
+    AF_KEYPAIR("\n",                "\"}\n"),
+    AF_KEYPAIR(" ustack=",          "\",\"ustack\":\""),
+    AF_KEYPAIR(" kstack=",          "\",\"kstack\":\""),
+    AF_KEYPAIR(" cgroup=",          "\",\"cgroup\":"),
+    AF_KEYPAIR(" container=",       ",\"container\":\""),
+};
+
+static inline char *af_settime(char *p, const struct af_settime *a,
+                               enum af_style style)
+{
+    const struct af_key (*k)[2] = af_settime_keys;
+
+    p = af_put(p, &k[0][style]);  p = af_u64(p, a->cnt);
+    p = af_put(p, &k[1][style]);  p = af_i64(p, a->new_wall);
+    p = af_put(p, &k[2][style]);  p = af_i64(p, a->expected);
+    p = af_put(p, &k[3][style]);  p = af_i64(p, a->diff);
+    p = af_put(p, &k[4][style]);  p = af_str(p, a->state, 16, style);
+    p = af_put(p, &k[5][style]);  p = af_i64(p, a->tz);
+    p = af_put(p, &k[6][style]);  p = af_u64(p, a->ktime_ns);
+    p = af_put(p, &k[7][style]);  p = af_i64(p, a->boot_ns);
+    p = af_put(p, &k[8][style]);  p = af_u64(p, a->pid);
+    p = af_put(p, &k[9][style]);  p = af_str(p, a->comm, AF_COMM_LEN, style);
+    if (a->cgroup) {
+        p = af_put(p, &k[13][style]);  p = af_u64(p, a->cgroup);
+        p = af_put(p, &k[14][style]);
+        p = af_str(p, a->container ? a->container : "-", AF_NAME_MAX, style);
+    }
+    if (a->ustack) {
+        size_t un = a->ustack_len < AF_STACK_MAX ? a->ustack_len : AF_STACK_MAX;
+        size_t kn = a->kstack_len < AF_STACK_MAX ? a->kstack_len : AF_STACK_MAX;
+        p = af_put(p, &k[11][style]);  memcpy(p, a->ustack, un);  p += un;
+        p = af_put(p, &k[12][style]);  memcpy(p, a->kstack, kn);  p += kn;
+    }
+    return af_put(p, &k[10][style]);
+}
+
+/* ===== SETTIMEOFDAY_SUMMARY (coalesced events of a key) ===== */
+struct af_summary {
+    uint32_t pid;
+    const char *comm;
+    const char *state;
+    uint64_t count;
+    int64_t min_diff;
+    int64_t max_diff;
+    int64_t first_ns;
+    int64_t last_ns;
+    uint64_t last_cnt;
+};
+
+static const struct af_key af_summary_keys[][2] = {
+    AF_KEYPAIR("SETTIMEOFDAY_SUMMARY pid=",
+               "{\"type\":\"SETTIMEOFDAY_SUMMARY\",\"pid\":"),
+    AF_KEYPAIR(" comm=",          ",\"comm\":\""),
+    AF_KEYPAIR(" state=",         "\",\"state\":\""),
+    AF_KEYPAIR(" count=",         "\",\"count\":"),
+    AF_KEYPAIR(" min_diff=",      ",\"min_diff\":"),
+    AF_KEYPAIR(" max_diff=",      ",\"max_diff\":"),
+    AF_KEYPAIR(" first_boot_ns=", ",\"first_boot_ns\":"),
+    AF_KEYPAIR(" last_boot_ns=",  ",\"last_boot_ns\":"),
+    AF_KEYPAIR(" last_cnt=",      ",\"last_cnt\":"),
+    AF_KEYPAIR("\n",              "}\n"),
+};
+
+static inline char *af_summary(char *p, const struct af_summary *a,
+                               enum af_style style)
+{
+    const struct af_key (*k)[2] = af_summary_keys;
+
+    p = af_put(p, &k[0][style]);  p = af_u64(p, a->pid);
+    p = af_put(p, &k[1][style]);  p = af_str(p, a->comm, AF_COMM_LEN, style);
+    p = af_put(p, &k[2][style]);  p = af_str(p, a->state, 16, style);
+    p = af_put(p, &k[3][style]);  p = af_u64(p, a->count);
+    p = af_put(p, &k[4][style]);  p = af_i64(p, a->min_diff);
+    p = af_put(p, &k[5][style]);  p = af_i64(p, a->max_diff);
+    p = af_put(p, &k[6][style]);  p = af_i64(p, a->first_ns);
+    p = af_put(p, &k[7][style]);  p = af_i64(p, a->last_ns);
+    p = af_put(p, &k[8][style]);  p = af_u64(p, a->last_cnt);
+    return af_put(p, &k[9][style]);
+}
+
+/*
+ * Any other log line as {"type":"LOG","msg":"..."}, so a JSON Lines log
+ * stays one object per line. len excludes a trailing newline; p needs
+ * 6 * len + 32 bytes.
+ */
+static const struct af_key af_log_keys[2] = {
+    { "{\"type\":\"LOG\",\"msg\":\"", sizeof("{\"type\":\"LOG\",\"msg\":\"") - 1 },
+    { "\"}\n", 3 },
+};
+
+static inline char *af_log_json(char *p, const char *msg, size_t len)
+{
+    p = af_put(p, &af_log_keys[0]);
+    p = af_str(p, msg, len, AF_JSON);
+    return af_put(p, &af_log_keys[1]);
+}
+
+#endif /* ALERT_FMT_H */
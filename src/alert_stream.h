@@ -0,0 +1,671 @@
+/*
+ * alert_stream.h - batched binary alert streams to a collector.
+ *
+ * An agent (perfbuffer_settimeofday -A) connects over TCP or a Unix
+ * socket, introduces itself once and then sends frames of trace.h
+ * records; the collector acks a frame once it is in a sealed segment,
+ * sealing early enough that no spool fills up waiting for its acks:
+ *
+ *   as_hello  agent -> collector   host, boot id, stream id, anchor
+ *   as_frame  agent -> collector   seq, n + n trace_rec (TRACE_ALERT)
+ *   as_ack    collector -> agent   every frame up to seq is on disk
+ *
+ * Records are batched per thread and a frame is cut when the batch
+ * reaches batch_bytes or its oldest record is batch_ms old. Frames go
+ * into the spool, a ring holding everything not acked yet; with a path
+ * it is a mapped file, so frames survive an agent restart and are sent
+ * then. A full spool drops its oldest frames and counts their records.
+ * After a reconnect the agent resends from the oldest unacked frame and
+ * the collector drops the seqs it already has for that stream: exactly
+ * once while the collector runs, at least once across its restarts.
+ *
+ * Integers are in host order (little-endian on every target).
+ */
+#ifndef ALERT_STREAM_H
+#define ALERT_STREAM_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "trace.h"
+
+#define AS_MAGIC        "TSSTRM1"
+#define AS_VERSION      1
+#define AS_HOST_LEN     64
+#define AS_BOOT_ID_LEN  40
+#define AS_FRAME_MAX    (64 * 1024)     /* records of one frame, bytes */
+
+/* connection preamble */
+struct as_hello {
+    char     magic[8];
+    uint32_t version;
+    uint32_t source;            /* enum trace_source */
+    uint64_t stream_id;         /* one per spool, kept across restarts */
+    char     host[AS_HOST_LEN];
+    char     boot_id[AS_BOOT_ID_LEN];
+    int64_t  anchor_wall;       /* as in struct trace_hdr */
+    int64_t  anchor_boot_ns;
+    int64_t  epsilon;
+    uint64_t spool_bytes;       /* acks must come before this fills */
+};
+
+/* followed by len bytes of trace_rec records */
+struct as_frame {
+    uint32_t len;
+    uint32_t n;                 /* records; 0 = spool padding, never sent */
+    uint64_t seq;               /* per stream, from 1 */
+};
+
+struct as_ack {
+    uint64_t seq;
+};
+
+/*
+ * TRACE_ALERT payload: one classified settimeofday event. Fixed-width
+ * fields, since a 32-bit Android agent and the collector do not agree
+ * on `long`.
+ */
+struct as_alert {
+    uint64_t cnt;
+    int64_t  new_wall;
+    int64_t  expected;
+    int64_t  diff;
+    int64_t  tz;
+    uint64_t ktime_ns;          /* CLOCK_BOOTTIME at the syscall */
+    int64_t  recv_boot_ns;
+    uint32_t pid;
+    uint32_t uid;
+    uint32_t state;             /* 0 CURRENT, 1 FUTURE, 2 PAST */
+    uint32_t _pad;
+    char     comm[16];
+    uint64_t cgroup_id;         /* 0: not known */
+};
+
+/* an alert from an agent that predates cgroup_id */
+#define AS_ALERT_SIZE_NOCG offsetof(struct as_alert, cgroup_id)
+
+static const char *const as_state_str[] = { "CURRENT", "FUTURE", "PAST" };
+
+static inline int64_t as_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * "unix:/path", "host:port", "[v6]:port" or a bare port (IPv4: any
+ * address when listening, loopback when connecting). Returns the family
+ * or -errno. Names are resolved here, once.
+ */
+static inline int as_addr_parse(const char *s, int passive,
+                                struct sockaddr_storage *ss, socklen_t *len)
+{
+    memset(ss, 0, sizeof(*ss));
+
+    if (strncmp(s, "unix:", 5) == 0) {
+        struct sockaddr_un *un = (struct sockaddr_un *)ss;
+        if (strlen(s + 5) >= sizeof(un->sun_path))
+            return -ENAMETOOLONG;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, s + 5);
+        *len = sizeof(*un);
+        return AF_UNIX;
+    }
+
+    char host[256] = "";
+    const char *port = strrchr(s, ':');
+    if (port) {
+        const char *h = s;
+        size_t n = port - s;
+        if (n >= 2 && h[0] == '[' && h[n - 1] == ']') {
+            h++;
+            n -= 2;
+        }
+        snprintf(host, sizeof(host), "%.*s", (int)n, h);
+        port++;
+    } else {
+        port = s;
+    }
+
+    struct addrinfo hints = {
+        .ai_family = host[0] ? AF_UNSPEC : AF_INET,
+        .ai_socktype = SOCK_STREAM,
+        .ai_flags = passive ? AI_PASSIVE : 0,
+    }, *ai;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &ai) != 0)
+        return -EINVAL;
+    memcpy(ss, ai->ai_addr, ai->ai_addrlen);
+    *len = ai->ai_addrlen;
+    int family = ai->ai_family;
+    freeaddrinfo(ai);
+    return family;
+}
+
+/* ===== spool =====
+ *
+ * A header page, then a ring of frames addressed by positions that only
+ * grow (offset = pos % cap). A frame never wraps: when it does not fit
+ * before the end, the rest is skipped, marked by a frame with n == 0 if
+ * there is room for one.
+ */
+#define AS_SPOOL_MAGIC  "TSSPOOL1"
+#define AS_SPOOL_HDR    4096
+
+struct as_spool_hdr {
+    char     magic[8];
+    uint64_t cap;               /* ring bytes */
+    uint64_t head;              /* oldest frame not acked */
+    uint64_t tail;              /* next write */
+    uint64_t next_seq;
+    uint64_t stream_id;
+    uint64_t dropped;           /* records dropped unsent for room, ever */
+};
+
+struct as_agent {
+    pthread_mutex_t lock;
+    struct as_spool_hdr *sp;    /* NULL: not streaming */
+    char *ring;
+    size_t map_len;
+    int file_backed;
+
+    size_t batch_bytes;
+    int64_t batch_ns;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int family;
+    struct as_hello hello;
+
+    int fd;
+    int connecting;
+    int shut;                   /* SHUT_WR sent (draining) */
+    uint64_t send_pos;          /* next byte to send */
+    uint64_t send_end;          /* end of the frame being sent, 0: none */
+    uint64_t acked;
+    unsigned char ack_buf[sizeof(struct as_ack)];
+    size_t ack_len;
+    int64_t retry_ns;
+    int64_t backoff_ns;
+    int err;                    /* why the last connection went down */
+
+    uint64_t frames, records, sent, connects;
+    uint64_t dropped, unacked;  /* as of as_agent_close() */
+};
+
+static struct as_agent as_ag = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .fd = -1,
+};
+
+enum as_event {
+    AS_EV_NONE,
+    AS_EV_UP,
+    AS_EV_DOWN,                 /* as_ag.err says why */
+};
+
+static __thread char as_batch[AS_FRAME_MAX];
+static __thread size_t as_batch_len;
+static __thread uint32_t as_batch_n;
+static __thread int64_t as_batch_t0;
+
+/* skip the tail of the ring a frame header does not fit in */
+static inline uint64_t as_spool_norm(const struct as_spool_hdr *sp, uint64_t pos)
+{
+    uint64_t room = sp->cap - pos % sp->cap;
+    return room < sizeof(struct as_frame) ? pos + room : pos;
+}
+
+static inline struct as_frame *as_spool_at(uint64_t pos)
+{
+    return (struct as_frame *)(as_ag.ring + pos % as_ag.sp->cap);
+}
+
+static inline uint64_t as_spool_end(uint64_t pos)
+{
+    return pos + sizeof(struct as_frame) + as_spool_at(pos)->len;
+}
+
+static inline int as_spool_map(const char *path, size_t cap)
+{
+    struct as_spool_hdr *sp;
+    size_t len = AS_SPOOL_HDR + cap;
+    int fresh = 1;
+
+    if (path) {
+        struct stat st;
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0)
+            return -errno;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size == len)
+            fresh = 0;
+        else if (ftruncate(fd, 0) < 0 || ftruncate(fd, len) < 0) {
+            int err = -errno;
+            close(fd);
+            return err;
+        }
+        sp = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        sp = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (sp == MAP_FAILED)
+        return -errno;
+
+    /* a spool from another size or a torn header starts over */
+    if (!fresh && (memcmp(sp->magic, AS_SPOOL_MAGIC, 8) != 0 ||
+                   sp->cap != cap || sp->head > sp->tail ||
+                   sp->tail - sp->head > cap || sp->next_seq == 0))
+        fresh = 1;
+    if (fresh) {
+        memset(sp, 0, sizeof(*sp));
+        sp->cap = cap;
+        sp->next_seq = 1;
+        int ufd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if (ufd < 0 || read(ufd, &sp->stream_id, 8) != 8)
+            sp->stream_id = (uint64_t)as_now() ^ ((uint64_t)getpid() << 32);
+        if (ufd >= 0)
+            close(ufd);
+        memcpy(sp->magic, AS_SPOOL_MAGIC, 8);
+    }
+
+    as_ag.sp = sp;
+    as_ag.ring = (char *)sp + AS_SPOOL_HDR;
+    as_ag.map_len = len;
+    as_ag.file_backed = path != NULL;
+    return 0;
+}
+
+static inline void as_disconnect(int err)
+{
+    if (as_ag.fd >= 0)
+        close(as_ag.fd);
+    as_ag.fd = -1;
+    as_ag.connecting = 0;
+    as_ag.shut = 0;
+    as_ag.send_end = 0;
+    as_ag.ack_len = 0;
+    as_ag.err = err;
+    as_ag.retry_ns = as_now() + as_ag.backoff_ns;
+    as_ag.backoff_ns = as_ag.backoff_ns < 16000000000LL ?
+                       as_ag.backoff_ns * 2 : 30000000000LL;
+}
+
+/*
+ * Release frames from the head: acked ones, or the oldest for room
+ * (force). A frame half-written to the socket cannot be released by an
+ * ack, and releasing it for room costs the connection.
+ */
+static inline int as_spool_release(int force)
+{
+    struct as_spool_hdr *sp = as_ag.sp;
+    int n = 0;
+
+    while (sp->head != sp->tail) {
+        uint64_t p = as_spool_norm(sp, sp->head);
+        const struct as_frame *f = as_spool_at(p);
+        uint64_t end = as_spool_end(p);
+        int partial = as_ag.send_end == end && as_ag.send_pos > p;
+
+        if (!force && f->n && f->seq > as_ag.acked)
+            break;
+        if (partial) {
+            if (!force)
+                break;
+            as_disconnect(-ENOBUFS);
+        }
+        /* sent but not acked yet: the collector still has it */
+        if (force && f->n && f->seq > as_ag.acked &&
+            (as_ag.fd < 0 || as_ag.send_pos <= p))
+            sp->dropped += f->n;
+        sp->head = end;
+        n++;
+        if (force)
+            break;
+    }
+    if (as_ag.send_pos < sp->head) {
+        as_ag.send_pos = sp->head;
+        as_ag.send_end = 0;
+    }
+    return n;
+}
+
+static inline void as_spool_put(const void *recs, uint32_t len, uint32_t n)
+{
+    struct as_spool_hdr *sp = as_ag.sp;
+    uint64_t need = sizeof(struct as_frame) + len;
+    uint64_t tail = as_spool_norm(sp, sp->tail);
+    uint64_t pad = sp->cap - tail % sp->cap < need ?
+                   sp->cap - tail % sp->cap : 0;
+
+    while (tail + pad + need - sp->head > sp->cap && as_spool_release(1))
+        ;
+    if (pad) {
+        struct as_frame *f = as_spool_at(tail);
+        *f = (struct as_frame){ .len = pad - sizeof(*f) };
+        tail += pad;
+    }
+
+    struct as_frame *f = as_spool_at(tail);
+    *f = (struct as_frame){ .len = len, .n = n, .seq = sp->next_seq++ };
+    memcpy(f + 1, recs, len);
+    sp->tail = tail + need;
+    as_ag.frames++;
+    as_ag.records += n;
+}
+
+/* ===== batching (any thread) ===== */
+
+/* cut this thread's batch into a frame */
+static inline void as_cut(void)
+{
+    if (!as_batch_n)
+        return;
+    pthread_mutex_lock(&as_ag.lock);
+    as_spool_put(as_batch, (uint32_t)as_batch_len, as_batch_n);
+    pthread_mutex_unlock(&as_ag.lock);
+    as_batch_len = 0;
+    as_batch_n = 0;
+}
+
+static inline void as_append(uint16_t type, int64_t boot_ns,
+                             const void *p, size_t len)
+{
+    size_t rl = (sizeof(struct trace_rec) + len + 7) & ~(size_t)7;
+
+    if (!as_ag.sp || rl > as_ag.batch_bytes)
+        return;
+    if (as_batch_len + rl > as_ag.batch_bytes)
+        as_cut();
+    if (!as_batch_n)
+        as_batch_t0 = as_now();
+
+    struct trace_rec *r = (struct trace_rec *)(as_batch + as_batch_len);
+    memset(r, 0, rl);
+    r->type = type;
+    r->len = (uint16_t)rl;
+    r->boot_ns = boot_ns;
+    memcpy(r + 1, p, len);
+    as_batch_len += rl;
+    as_batch_n++;
+}
+
+/* at the thread's flush points: cut a batch that is old enough */
+static inline void as_tick(void)
+{
+    if (as_batch_n && as_now() - as_batch_t0 >= as_ag.batch_ns)
+        as_cut();
+}
+
+/* ===== connection (one thread) ===== */
+static inline void as_connect(void)
+{
+    int fd = socket(as_ag.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    0);
+    if (fd < 0) {
+        as_disconnect(-errno);
+        return;
+    }
+    if (as_ag.family != AF_UNIX) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    as_ag.fd = fd;
+    if (connect(fd, (struct sockaddr *)&as_ag.addr, as_ag.addr_len) < 0) {
+        if (errno != EINPROGRESS) {
+            as_disconnect(-errno);
+            return;
+        }
+        as_ag.connecting = 1;
+    }
+}
+
+static inline int as_connected(void)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (as_ag.connecting) {
+        struct pollfd p = { .fd = as_ag.fd, .events = POLLOUT };
+        if (poll(&p, 1, 0) <= 0)
+            return 0;
+        getsockopt(as_ag.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) {
+            as_disconnect(-err);
+            return -1;
+        }
+        as_ag.connecting = 0;
+    }
+
+    /* a fresh socket buffer always takes the hello whole */
+    if (send(as_ag.fd, &as_ag.hello, sizeof(as_ag.hello), MSG_NOSIGNAL) !=
+        (ssize_t)sizeof(as_ag.hello)) {
+        as_disconnect(-errno);
+        return -1;
+    }
+    as_ag.send_pos = as_ag.sp->head;
+    as_ag.send_end = 0;
+    as_ag.backoff_ns = 1000000000LL;
+    as_ag.connects++;
+    return 1;
+}
+
+static inline int as_recv_acks(void)
+{
+    for (;;) {
+        ssize_t n = recv(as_ag.fd, as_ag.ack_buf + as_ag.ack_len,
+                         sizeof(as_ag.ack_buf) - as_ag.ack_len, MSG_DONTWAIT);
+        if (n == 0) {
+            as_disconnect(-ECONNRESET);
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+            as_disconnect(-errno);
+            return -1;
+        }
+        as_ag.ack_len += n;
+        if (as_ag.ack_len == sizeof(as_ag.ack_buf)) {
+            struct as_ack a;
+            memcpy(&a, as_ag.ack_buf, sizeof(a));
+            if (a.seq > as_ag.acked)
+                as_ag.acked = a.seq;
+            as_ag.ack_len = 0;
+            as_spool_release(0);
+        }
+    }
+}
+
+static inline int as_send(void)
+{
+    struct as_spool_hdr *sp = as_ag.sp;
+
+    while (as_ag.send_pos != sp->tail) {
+        if (!as_ag.send_end) {
+            uint64_t p = as_spool_norm(sp, as_ag.send_pos);
+            if (as_spool_at(p)->n == 0) {       /* padding */
+                as_ag.send_pos = as_spool_end(p);
+                continue;
+            }
+            as_ag.send_pos = p;
+            as_ag.send_end = as_spool_end(p);
+        }
+        ssize_t n = send(as_ag.fd, as_ag.ring + as_ag.send_pos % sp->cap,
+                         as_ag.send_end - as_ag.send_pos,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+            as_disconnect(-errno);
+            return -1;
+        }
+        as_ag.send_pos += n;
+        if (as_ag.send_pos == as_ag.send_end) {
+            as_ag.send_end = 0;
+            as_ag.sent++;
+        }
+    }
+    return 0;
+}
+
+static inline enum as_event as_poll_locked(void)
+{
+    int was_up = as_ag.fd >= 0 && !as_ag.connecting;
+
+    if (as_ag.fd < 0 && as_now() >= as_ag.retry_ns)
+        as_connect();
+    if (as_ag.fd >= 0 && !was_up)
+        as_connected();         /* sends the hello once connected */
+    if (as_ag.fd >= 0 && !as_ag.connecting && as_recv_acks() == 0)
+        as_send();
+
+    int up = as_ag.fd >= 0 && !as_ag.connecting;
+    return up == was_up ? AS_EV_NONE : up ? AS_EV_UP : AS_EV_DOWN;
+}
+
+/* connect / send / read acks without blocking; call often */
+static inline enum as_event as_agent_poll(void)
+{
+    if (!as_ag.sp)
+        return AS_EV_NONE;
+    pthread_mutex_lock(&as_ag.lock);
+    enum as_event ev = as_poll_locked();
+    pthread_mutex_unlock(&as_ag.lock);
+    return ev;
+}
+
+static inline int as_agent_open(const char *addr, const char *spool_path,
+                                size_t spool_bytes, size_t batch_bytes, int batch_ms,
+                                const char *host, uint32_t source,
+                                int64_t anchor_wall, int64_t anchor_boot_ns,
+                                int64_t epsilon)
+{
+    struct as_hello *h = &as_ag.hello;
+    int err;
+
+    if (batch_bytes < 1024 || batch_bytes > AS_FRAME_MAX || batch_ms < 0)
+        return -EINVAL;
+    as_ag.family = as_addr_parse(addr, 0, &as_ag.addr, &as_ag.addr_len);
+    if (as_ag.family < 0)
+        return as_ag.family;
+
+    /* a full frame always fits, several to be useful */
+    spool_bytes = (spool_bytes + 7) & ~(size_t)7;
+    if (spool_bytes < 4 * (sizeof(struct as_frame) + AS_FRAME_MAX))
+        spool_bytes = 4 * (sizeof(struct as_frame) + AS_FRAME_MAX);
+    err = as_spool_map(spool_path, spool_bytes);
+    if (err)
+        return err;
+
+    as_ag.batch_bytes = batch_bytes;
+    as_ag.batch_ns = (int64_t)batch_ms * 1000000;
+    as_ag.backoff_ns = 1000000000LL;
+
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, AS_MAGIC, sizeof(h->magic));
+    h->version = AS_VERSION;
+    h->source = source;
+    h->stream_id = as_ag.sp->stream_id;
+    if (host)
+        snprintf(h->host, sizeof(h->host), "%s", host);
+    else if (gethostname(h->host, sizeof(h->host) - 1) < 0)
+        snprintf(h->host, sizeof(h->host), "unknown");
+    h->anchor_wall = anchor_wall;
+    h->anchor_boot_ns = anchor_boot_ns;
+    h->epsilon = epsilon;
+    h->spool_bytes = spool_bytes;
+
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t n = read(fd, h->boot_id, sizeof(h->boot_id) - 1);
+        close(fd);
+        while (n > 0 && (h->boot_id[n - 1] == '\n' || h->boot_id[n - 1] == 0))
+            h->boot_id[--n] = '\0';
+    }
+    if (!h->boot_id[0])
+        snprintf(h->boot_id, sizeof(h->boot_id), "unknown");
+    return 0;
+}
+
+/*
+ * For producers without a deadline (replay): while connected, wait for
+ * the spool to drain below half instead of letting it drop frames.
+ */
+static inline void as_agent_throttle(void)
+{
+    if (!as_ag.sp)
+        return;
+    for (int waiting = 0;; waiting = 1) {
+        pthread_mutex_lock(&as_ag.lock);
+        as_poll_locked();
+        uint64_t used = as_ag.sp->tail - as_ag.sp->head;
+        int fd = as_ag.connecting ? -1 : as_ag.fd;
+        pthread_mutex_unlock(&as_ag.lock);
+
+        uint64_t limit = waiting ? as_ag.sp->cap / 2 : as_ag.sp->cap / 4 * 3;
+        if (fd < 0 || used < limit)
+            return;
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        poll(&p, 1, 10);
+    }
+}
+
+/*
+ * Cut the calling thread's batch, then for up to drain_ms send what is
+ * spooled, half-close so the collector seals it, and wait for the acks.
+ * Whatever is left stays in a file-backed spool for the next run.
+ */
+static inline void as_agent_close(int drain_ms)
+{
+    if (!as_ag.sp)
+        return;
+    as_cut();
+
+    int64_t end = as_now() + (int64_t)drain_ms * 1000000;
+    while (as_now() < end) {
+        pthread_mutex_lock(&as_ag.lock);
+        as_poll_locked();
+        int done = as_ag.sp->head == as_ag.sp->tail;
+        int fd = as_ag.connecting ? -1 : as_ag.fd;
+        if (fd >= 0 && !done && !as_ag.shut && !as_ag.send_end &&
+            as_ag.send_pos == as_ag.sp->tail) {
+            shutdown(fd, SHUT_WR);
+            as_ag.shut = 1;
+        }
+        pthread_mutex_unlock(&as_ag.lock);
+        if (done)
+            break;
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        poll(&p, fd >= 0, 10);
+    }
+
+    if (as_ag.fd >= 0)
+        close(as_ag.fd);
+    as_ag.fd = -1;
+    as_ag.dropped = as_ag.sp->dropped;
+    as_ag.unacked = as_ag.sp->tail - as_ag.sp->head;
+    if (as_ag.file_backed)
+        msync(as_ag.sp, as_ag.map_len, MS_SYNC);
+    munmap(as_ag.sp, as_ag.map_len);
+    as_ag.sp = NULL;
+}
+
+#endif /* ALERT_STREAM_H */
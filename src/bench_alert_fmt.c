@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alert_fmt.h"
+
+/*
+ * Microbenchmark for alert_fmt.h.
+ *
+ *   bench_alert_fmt [lines] [out_file]
+ *
+ * "log_alert" is the existing path: vsnprintf of the SETTIMEOFDAY format
+ * into a stack buffer and one write() per line. "fast" formats with
+ * af_settime() into a 16 KiB batch and writes once per batch, as the
+ * detector does now. The format-only rows leave the writes out. Both
+ * paths are checked to produce the same bytes first. Output goes to
+ * /dev/null unless out_file is given.
+ */
+
+#define DEFAULT_LINES (1000 * 1000)
+#define BATCH         (16 * 1024)
+
+static const char *const state_str[] = { "CURRENT", "FUTURE", "PAST" };
+
+struct sample {
+    uint64_t cnt;
+    int64_t new_wall, expected, diff, tz;
+    uint64_t ktime_ns;
+    int64_t boot_ns;
+    uint32_t pid;
+    int state;
+    char comm[16];
+};
+
+static int out_fd = -1;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* a settimeofday storm: mostly small drifts, some big jumps both ways */
+static void fill(struct sample *s, size_t n)
+{
+    unsigned seed = 1;
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned r = seed >> 8;
+        int64_t diff = r % 10 == 0 ? (int64_t)(r % 100000) - 50000 :
+                                     (int64_t)(r % 61) - 30;
+        s[i] = (struct sample){
+            .cnt = i + 1,
+            .expected = 1700000000 + (int64_t)i / 1000,
+            .tz = 0,
+            .ktime_ns = 1000000000000ULL + i * 100000ULL,
+            .pid = 100 + r % 4000,
+            .state = diff > 60 ? 1 : diff < -60 ? 2 : 0,
+        };
+        s[i].new_wall = s[i].expected + diff;
+        s[i].diff = diff;
+        s[i].boot_ns = (int64_t)s[i].ktime_ns + 1500;
+        /* a full 16-byte comm has no NUL, as from the kernel */
+        const char *comm = r & 1 ? "settime" : "ntpd-worker-long";
+        memcpy(s[i].comm, comm, strnlen(comm, sizeof(s[i].comm)));
+    }
+}
+
+/* perfbuffer_settimeofday.c before alert_fmt.h, as was */
+static void log_alert(const char *fmt, ...)
+{
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (len > 0)
+        (void)!write(out_fd, buf, len);
+}
+
+#define SETTIME_FMT \
+    "SETTIMEOFDAY cnt=%llu new=%ld expected=%ld diff=%ld state=%s tz=%ld ktime_ns=%llu boot_ns=%lld pid=%u comm=%.16s\n"
+
+#define SETTIME_ARGS(s) \
+    (unsigned long long)(s)->cnt, (long)(s)->new_wall, (long)(s)->expected, \
+    (long)(s)->diff, state_str[(s)->state], (long)(s)->tz, \
+    (unsigned long long)(s)->ktime_ns, (long long)(s)->boot_ns, \
+    (s)->pid, (s)->comm
+
+static char *fast_one(char *p, const struct sample *s, enum af_style style)
+{
+    struct af_settime a = {
+        .cnt = s->cnt, .new_wall = s->new_wall, .expected = s->expected,
+        .diff = s->diff, .state = state_str[s->state], .tz = s->tz,
+        .ktime_ns = s->ktime_ns, .boot_ns = s->boot_ns, .pid = s->pid,
+        .comm = s->comm,
+    };
+    return af_settime(p, &a, style);
+}
+
+static void run_log_alert(const struct sample *s, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        log_alert(SETTIME_FMT, SETTIME_ARGS(&s[i]));
+}
+
+static size_t run_fast(const struct sample *s, size_t n, enum af_style style)
+{
+    static char batch[BATCH];
+    size_t len = 0, total = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (BATCH - len < AF_LINE_MAX) {
+            (void)!write(out_fd, batch, len);
+            total += len;
+            len = 0;
+        }
+        len = fast_one(batch + len, &s[i], style) - batch;
+    }
+    (void)!write(out_fd, batch, len);
+    return total + len;
+}
+
+static volatile size_t sink;
+
+static void run_fmt_printf(const struct sample *s, size_t n)
+{
+    char buf[512];
+    size_t total = 0;
+    for (size_t i = 0; i < n; i++)
+        total += snprintf(buf, sizeof(buf), SETTIME_FMT, SETTIME_ARGS(&s[i]));
+    sink = total;
+}
+
+static void run_fmt_fast(const struct sample *s, size_t n, enum af_style style)
+{
+    static char batch[BATCH];
+    size_t len = 0, total = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (BATCH - len < AF_LINE_MAX) {
+            total += len;
+            len = 0;
+        }
+        len = fast_one(batch + len, &s[i], style) - batch;
+    }
+    sink = total + len + (unsigned char)batch[0];
+}
+
+/* the fast KV line must be the printf line, byte for byte */
+static int verify(const struct sample *s, size_t n)
+{
+    char a[512], b[AF_LINE_MAX];
+    for (size_t i = 0; i < n; i++) {
+        int la = snprintf(a, sizeof(a), SETTIME_FMT, SETTIME_ARGS(&s[i]));
+        size_t lb = fast_one(b, &s[i], AF_KV) - b;
+        if ((size_t)la != lb || memcmp(a, b, lb) != 0) {
+            fprintf(stderr, "mismatch at %zu:\n  %.*s  %.*s", i,
+                    la, a, (int)lb, b);
+            return -1;
+        }
+    }
+
+    /* edges of the integer conversion */
+    static const int64_t edge[] = {
+        0, 9, 10, 99, 100, 9999, 10000, 99999999, 100000000,
+        -1, -10, INT64_MAX, INT64_MIN, 1000000000000000000LL,
+    };
+    for (size_t i = 0; i < sizeof(edge) / sizeof(edge[0]); i++) {
+        char p[32], q[32];
+        int lp = snprintf(p, sizeof(p), "%lld", (long long)edge[i]);
+        size_t lq = af_i64(q, edge[i]) - q;
+        if ((size_t)lp != lq || memcmp(p, q, lq) != 0) {
+            fprintf(stderr, "af_i64(%s) = %.*s\n", p, (int)lq, q);
+            return -1;
+        }
+    }
+    char p[32], q[32];
+    int lp = snprintf(p, sizeof(p), "%llu", (unsigned long long)UINT64_MAX);
+    size_t lq = af_u64(q, UINT64_MAX) - q;
+    if ((size_t)lp != lq || memcmp(p, q, lq) != 0) {
+        fprintf(stderr, "af_u64(%s) = %.*s\n", p, (int)lq, q);
+        return -1;
+    }
+
+    /* a comm with a newline must not start a line of its own */
+    struct sample evil = s[0];
+    memcpy(evil.comm, "x\n#CHAIN \\\r", 12);
+    for (int st = AF_KV; st <= AF_JSON; st++) {
+        size_t le = fast_one(b, &evil, st) - b;
+        const char *nl = memchr(b, '\n', le);
+        if (nl != b + le - 1 || memchr(b, '\r', le)) {
+            fprintf(stderr, "comm escape (%s): %.*s", st == AF_KV ? "kv" : "json",
+                    (int)le, b);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void report(const char *name, long long ns, size_t n, long long base)
+{
+    printf("%-22s %8.1f ns/line %10.0f lines/s", name,
+           (double)ns / n, n * 1e9 / ns);
+    if (base)
+        printf("   x%.1f", (double)base / ns);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_LINES;
+    const char *out = argc > 2 ? argv[2] : "/dev/null";
+
+    if (n == 0) {
+        fprintf(stderr, "usage: %s [lines] [out_file]\n", argv[0]);
+        return 1;
+    }
+    out_fd = open(out, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (out_fd < 0) {
+        perror(out);
+        return 1;
+    }
+
+    struct sample *s = malloc(n * sizeof(*s));
+    if (!s) {
+        perror("malloc");
+        return 1;
+    }
+    fill(s, n);
+
+    if (verify(s, n) != 0)
+        return 1;
+    printf("lines=%zu out=%s (kv output identical to printf)\n", n, out);
+
+    long long t0 = now_ns();
+    run_fmt_printf(s, n);
+    long long fmt_printf = now_ns() - t0;
+
+    t0 = now_ns();
+    run_fmt_fast(s, n, AF_KV);
+    long long fmt_kv = now_ns() - t0;
+
+    t0 = now_ns();
+    run_fmt_fast(s, n, AF_JSON);
+    long long fmt_json = now_ns() - t0;
+
+    t0 = now_ns();
+    run_log_alert(s, n);
+    long long full_printf = now_ns() - t0;
+
+    t0 = now_ns();
+    size_t bytes_kv = run_fast(s, n, AF_KV);
+    long long full_kv = now_ns() - t0;
+
+    t0 = now_ns();
+    size_t bytes_json = run_fast(s, n, AF_JSON);
+    long long full_json = now_ns() - t0;
+
+    printf("format only:\n");
+    report("  snprintf", fmt_printf, n, 0);
+    report("  af_settime kv", fmt_kv, n, fmt_printf);
+    report("  af_settime json", fmt_json, n, fmt_printf);
+    printf("format + write:\n");
+    report("  log_alert", full_printf, n, 0);
+    report("  fast kv (batched)", full_kv, n, full_printf);
+    report("  fast json (batched)", full_json, n, full_printf);
+    printf("bytes kv=%zu json=%zu\n", bytes_kv, bytes_json);
+
+    free(s);
+    close(out_fd);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ts_classify.h"
+
+/*
+ * Microbenchmark for ts_classify.h.
+ *
+ *   bench_classify [files] [rounds]
+ *
+ * "per-check" is the existing path: check_file_time() per timestamp,
+ * each one doing its own clock_gettime(). The batch rows take the
+ * expected time once and run each kernel over the same arrays; their
+ * output is compared byte for byte with the per-check result.
+ */
+
+#define EPSILON 60
+#define DEFAULT_FILES  (4 * 1024 * 1024)
+#define DEFAULT_ROUNDS 5
+
+static time_t wall_anchor;
+static struct timespec boot_anchor;
+
+static time_t expected_wall_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return wall_anchor + (now.tv_sec - boot_anchor.tv_sec);
+}
+
+/* inotify.c, as is */
+static enum tsc_state check_file_time(time_t file_time)
+{
+    time_t expected = expected_wall_time();
+    time_t diff = file_time - expected;
+
+    if (diff > EPSILON)
+        return TSC_FUTURE;
+    if (diff < -EPSILON)
+        return TSC_PAST;
+    return TSC_NORMAL;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* mostly recent, ~1% future, ~10% old; never within 5s of the edges */
+static int64_t sample(unsigned *seed, int64_t expected)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    unsigned r = (*seed >> 8) % 1000;
+    int64_t jitter = (*seed >> 4) % 50;
+
+    if (r < 10)
+        return expected + EPSILON + 5 + jitter * 3600;
+    if (r < 110)
+        return expected - EPSILON - 5 - jitter * 86400;
+    return expected - jitter;
+}
+
+int main(int argc, char **argv)
+{
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_FILES;
+    int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+    size_t words = (n + 63) / 64;
+
+    int64_t *m = malloc(n * sizeof(*m));
+    int64_t *a = malloc(n * sizeof(*a));
+    int64_t *c = malloc(n * sizeof(*c));
+    uint8_t *ref = malloc(n);
+    uint8_t *state = malloc(n);
+    uint64_t *future = malloc(words * sizeof(*future));
+    uint64_t *past = malloc(words * sizeof(*past));
+    if (!m || !a || !c || !ref || !state || !future || !past) {
+        perror("malloc");
+        return 1;
+    }
+
+    wall_anchor = time(NULL);
+    clock_gettime(CLOCK_BOOTTIME, &boot_anchor);
+
+    unsigned seed = 12345;
+    int64_t expected = expected_wall_time();
+    for (size_t i = 0; i < n; i++) {
+        m[i] = sample(&seed, expected);
+        a[i] = sample(&seed, expected);
+        c[i] = sample(&seed, expected);
+    }
+
+    struct tsc_batch b = { m, a, c, n };
+    struct tsc_out o = { state, future, past };
+
+    printf("Files: %zu  Rounds: %d  Timestamps/file: 3\n", n, rounds);
+
+    long long best = -1;
+    for (int r = 0; r < rounds; r++) {
+        long long t0 = now_ns();
+        for (size_t i = 0; i < n; i++)
+            ref[i] = check_file_time(m[i]) |
+                     check_file_time(a[i]) << 2 |
+                     check_file_time(c[i]) << 4;
+        long long dt = now_ns() - t0;
+        if (best < 0 || dt < best)
+            best = dt;
+    }
+    double base = (double)best / n;
+    printf("%-10s %8.3f ns/file  %8.1f M files/s\n",
+           "per-check", base, n / (best / 1e9) / 1e6);
+
+    for (int impl = TSC_IMPL_AUTO; impl <= TSC_IMPL_AVX2; impl++) {
+        if (impl != TSC_IMPL_AUTO && tsc_resolve(impl) != (enum tsc_impl)impl) {
+            printf("%-10s (not supported on this CPU)\n", tsc_impl_names[impl]);
+            continue;
+        }
+
+        best = -1;
+        for (int r = 0; r < rounds; r++) {
+            long long t0 = now_ns();
+            if (impl == TSC_IMPL_AUTO)
+                tsc_classify(&b, expected_wall_time(), EPSILON, &o);
+            else
+                tsc_classify_with(impl, &b, expected_wall_time(), EPSILON, &o);
+            long long dt = now_ns() - t0;
+            if (best < 0 || dt < best)
+                best = dt;
+        }
+
+        size_t bad = 0;
+        for (size_t i = 0; i < n; i++) {
+            int fbit = (future[i / 64] >> (i % 64)) & 1;
+            int pbit = (past[i / 64] >> (i % 64)) & 1;
+            if (state[i] != ref[i] ||
+                fbit != ((ref[i] & TSC_ANY_FUTURE) != 0) ||
+                pbit != ((ref[i] & TSC_ANY_PAST) != 0))
+                bad++;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%s", tsc_impl_names[impl]);
+        if (impl == TSC_IMPL_AUTO)
+            snprintf(name, sizeof(name), "auto=%s",
+                     tsc_impl_names[tsc_resolve(TSC_IMPL_AUTO)]);
+
+        double per = (double)best / n;
+        printf("%-10s %8.3f ns/file  %8.1f M files/s  x%.1f  mismatches=%zu\n",
+               name, per, n / (best / 1e9) / 1e6,
+               base / per, bad);
+        if (bad)
+            return 1;
+    }
+
+    free(m); free(a); free(c);
+    free(ref); free(state); free(future); free(past);
+    return 0;
+}
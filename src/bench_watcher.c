@@ -0,0 +1,638 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/*
+ * Throughput / detection latency benchmark for the file watchers.
+ *
+ *   bench_watcher [-n files] [-t threads] [-s seconds] [-r ops_per_sec]
+ *                 [-f forge_pct] [-a read_pct] [-A] [-p pause_ms] [-D dir]
+ *                 [-l alert_log] [-m token]... -- <watcher> [args...]
+ *
+ * The watcher command is run as given, with these arguments replaced:
+ *
+ *   @FILES@   the N benchmark files (absolute paths), one argument each
+ *   @LOG@     the alert log the benchmark tails (-l, default DIR/alerts.log)
+ *   @DIR@     the directory holding the files
+ *
+ *   bench_watcher -- ./inotify -o @LOG@ @FILES@
+ *   bench_watcher -l /data/local/tmp/alerts.log -- ./call_inotify @FILES@ @DIR@/clock.txt
+ *   bench_watcher -- ./file_ts -w @DIR@ -o @LOG@
+ *
+ * M threads run a mix of appends, utimensat() forgeries (a distinct
+ * value far in the future or past each time) and reads against random
+ * files. Forgeries set the mtime only, which the kernel reports as
+ * IN_MODIFY, like a write; -A sets the atime as well, which makes it
+ * IN_ATTRIB (and adds the watcher's atime line, counted as unmatched). A file has at most one forgery outstanding and is not
+ * written while it has one, so every forgery is expected to produce
+ * exactly one alert line: a line with path=<file> that contains one of
+ * the -m tokens (default FILE_FUTURE, FILE_PAST, mtime_state=FUTURE,
+ * mtime_state=PAST). Latency is from just before the syscall to the
+ * moment the line is read back from the log (inotify on the log file,
+ * so it includes the watcher's write and one wakeup).
+ *
+ * -p stops the watcher with SIGSTOP for pause_ms in the middle of the
+ * run, which overflows its inotify queue under load; forgeries made
+ * while it is stopped are reported separately, together with the
+ * overflow/rescan lines the watcher logged.
+ *
+ * Watcher CPU is utime+stime from /proc/<pid>/stat over the load phase
+ * and the drain that follows it.
+ */
+
+#define DEFAULT_FILES    1000
+#define DEFAULT_THREADS  4
+#define DEFAULT_SECONDS  10
+#define DEFAULT_FORGE    5      /* % of ops */
+#define DEFAULT_READ     20
+#define WARMUP_MS        500
+#define DRAIN_MS         3000
+#define WRITE_SIZE       128
+#define MAX_TOKENS       16
+
+static int n_files = DEFAULT_FILES;
+static int n_threads = DEFAULT_THREADS;
+static int seconds = DEFAULT_SECONDS;
+static long rate;               /* ops/s per thread, 0 = unthrottled */
+static int forge_pct = DEFAULT_FORGE;
+static int read_pct = DEFAULT_READ;
+static long pause_ms;
+static int forge_atime;         /* -A */
+static char dir[PATH_MAX];
+static char log_path[PATH_MAX];
+static const char *tokens[MAX_TOKENS];
+static int n_tokens;
+
+static char **paths;
+/*
+ * per file, __atomic: forgery time while one is outstanding, FILE_WRITING
+ * during an append, 0 otherwise; the two exclude each other so an append
+ * can never bury a forged mtime before the watcher saw it
+ */
+#define FILE_WRITING (-1)
+static int64_t *pending_ns;
+static uint8_t *pending_paused; /* per file: forged while the watcher was stopped */
+
+static volatile int stop_load;
+static volatile int paused;
+static int64_t forge_seq;       /* __atomic */
+
+static struct {
+    uint64_t writes, reads, forges, forges_paused, errors;
+} op_total;                     /* __atomic adds */
+
+static long long mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+/* ===== files ===== */
+static int files_create(void)
+{
+    paths = calloc(n_files, sizeof(*paths));
+    pending_ns = calloc(n_files, sizeof(*pending_ns));
+    pending_paused = calloc(n_files, 1);
+    if (!paths || !pending_ns || !pending_paused)
+        return -ENOMEM;
+
+    for (int i = 0; i < n_files; i++) {
+        if (asprintf(&paths[i], "%s/f%d", dir, i) < 0)
+            return -ENOMEM;
+        int fd = open(paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return -errno;
+        (void)!write(fd, "x\n", 2);
+        close(fd);
+    }
+    return 0;
+}
+
+/* path=<dir>/f<idx> -> idx, or -1 */
+static int file_index(const char *p, size_t len)
+{
+    size_t dl = strlen(dir);
+    if (len <= dl + 2 || memcmp(p, dir, dl) != 0 || p[dl] != '/' ||
+        p[dl + 1] != 'f')
+        return -1;
+    long v = 0;
+    for (size_t i = dl + 2; i < len; i++) {
+        if (p[i] < '0' || p[i] > '9')
+            return -1;
+        v = v * 10 + (p[i] - '0');
+        if (v >= n_files)
+            return -1;
+    }
+    return (int)v;
+}
+
+/* ===== load threads ===== */
+struct worker {
+    pthread_t tid;
+    unsigned seed;
+};
+
+static unsigned rnd(unsigned *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+static void op_write(int i)
+{
+    static const char line[WRITE_SIZE] = "benchmark append line\n";
+
+    int64_t expect = 0;
+    if (!__atomic_compare_exchange_n(&pending_ns[i], &expect, FILE_WRITING,
+                                     0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return;                     /* forged and not reported yet */
+    int fd = open(paths[i], O_WRONLY | O_APPEND);
+    if (fd < 0 || write(fd, line, sizeof(line)) < 0)
+        __atomic_add_fetch(&op_total.errors, 1, __ATOMIC_RELAXED);
+    if (fd >= 0)
+        close(fd);
+    __atomic_store_n(&pending_ns[i], 0, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&op_total.writes, 1, __ATOMIC_RELAXED);
+}
+
+static void op_read(int i)
+{
+    char buf[256];
+    int fd = open(paths[i], O_RDONLY);
+    if (fd < 0 || read(fd, buf, sizeof(buf)) < 0)
+        __atomic_add_fetch(&op_total.errors, 1, __ATOMIC_RELAXED);
+    if (fd >= 0)
+        close(fd);
+    __atomic_add_fetch(&op_total.reads, 1, __ATOMIC_RELAXED);
+}
+
+static void op_forge(int i)
+{
+    int64_t expect = 0;
+    int64_t t = mono_ns();
+
+    /* one outstanding forgery per file, none during an append */
+    if (!__atomic_compare_exchange_n(&pending_ns[i], &expect, t, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return;
+    pending_paused[i] = paused;
+
+    /* distinct every time, so the watcher always sees a change */
+    int64_t seq = __atomic_add_fetch(&forge_seq, 1, __ATOMIC_RELAXED);
+    struct timespec ts[2] = {
+        { .tv_nsec = UTIME_OMIT },
+        { .tv_sec = time(NULL) + (seq & 1 ? 1 : -1) * (86400 + seq) },
+    };
+    if (forge_atime)
+        ts[0] = ts[1];
+    if (utimensat(AT_FDCWD, paths[i], ts, 0) != 0) {
+        __atomic_store_n(&pending_ns[i], 0, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&op_total.errors, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_add_fetch(&op_total.forges, 1, __ATOMIC_RELAXED);
+    if (pending_paused[i])
+        __atomic_add_fetch(&op_total.forges_paused, 1, __ATOMIC_RELAXED);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    long long next = mono_ns();
+
+    while (!stop_load) {
+        unsigned r = rnd(&w->seed);
+        int i = (int)(rnd(&w->seed) % n_files);
+        unsigned pct = r % 100;
+
+        if (pct < (unsigned)forge_pct)
+            op_forge(i);
+        else if (pct < (unsigned)(forge_pct + read_pct))
+            op_read(i);
+        else
+            op_write(i);
+
+        if (rate) {
+            next += 1000000000LL / rate;
+            long long d = next - mono_ns();
+            if (d > 0) {
+                struct timespec ts = { d / 1000000000LL, d % 1000000000LL };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ===== alert log tail ===== */
+struct lat {
+    int64_t *v;
+    size_t n, cap;
+};
+
+static struct lat lat_all, lat_paused;
+static uint64_t detected, detected_paused, unmatched, overflow_lines,
+                rescan_lines;
+
+static void lat_push(struct lat *l, int64_t v)
+{
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 4096;
+        int64_t *p = realloc(l->v, cap * sizeof(*p));
+        if (!p)
+            return;
+        l->v = p;
+        l->cap = cap;
+    }
+    l->v[l->n++] = v;
+}
+
+static void tail_line(const char *s, size_t len, long long now)
+{
+    char line[1024];
+    if (len >= sizeof(line))
+        len = sizeof(line) - 1;
+    memcpy(line, s, len);
+    line[len] = '\0';
+
+    if (strstr(line, "IN_Q_OVERFLOW"))
+        overflow_lines++;
+    if (strstr(line, "rescan done"))
+        rescan_lines++;
+
+    int hit = 0;
+    for (int k = 0; k < n_tokens && !hit; k++)
+        hit = strstr(line, tokens[k]) != NULL;
+    if (!hit)
+        return;
+
+    const char *p = strstr(line, "path=");
+    if (!p)
+        return;
+    p += 5;
+    size_t pl = strcspn(p, " \n");
+    int i = file_index(p, pl);
+    if (i < 0)
+        return;
+
+    int64_t t = __atomic_load_n(&pending_ns[i], __ATOMIC_ACQUIRE);
+    if (t <= 0 || !__atomic_compare_exchange_n(&pending_ns[i], &t, 0, 0,
+                                               __ATOMIC_ACQ_REL,
+                                               __ATOMIC_RELAXED)) {
+        unmatched++;                /* e.g. a rescan re-reporting it */
+        return;
+    }
+    detected++;
+    lat_push(&lat_all, now - t);
+    if (pending_paused[i]) {
+        detected_paused++;
+        lat_push(&lat_paused, now - t);
+    }
+}
+
+struct tail {
+    pthread_t tid;
+    int fd, ifd;
+    off_t off;
+    volatile int stop;
+    char buf[1 << 16];
+    size_t have;
+};
+
+static void tail_read(struct tail *t)
+{
+    ssize_t n;
+    while ((n = pread(t->fd, t->buf + t->have, sizeof(t->buf) - t->have,
+                      t->off)) > 0) {
+        long long now = mono_ns();
+        t->off += n;
+        t->have += n;
+
+        size_t start = 0;
+        for (size_t i = 0; i < t->have; i++) {
+            if (t->buf[i] != '\n')
+                continue;
+            tail_line(t->buf + start, i - start, now);
+            start = i + 1;
+        }
+        if (start == 0 && t->have == sizeof(t->buf))
+            start = t->have;        /* overlong line: drop it */
+        memmove(t->buf, t->buf + start, t->have - start);
+        t->have -= start;
+    }
+}
+
+static void *tail_main(void *arg)
+{
+    struct tail *t = arg;
+    char ev[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!t->stop) {
+        tail_read(t);
+        /* inotify for prompt wakeups; the timeout covers missed ones */
+        struct timespec ts = { 0, 10000000L };
+        fd_set rf;
+        FD_ZERO(&rf);
+        FD_SET(t->ifd, &rf);
+        if (pselect(t->ifd + 1, &rf, NULL, NULL, &ts, NULL) > 0)
+            while (read(t->ifd, ev, sizeof(ev)) > 0)
+                ;
+    }
+    tail_read(t);
+    return NULL;
+}
+
+/* ===== watcher process ===== */
+static pid_t watcher_start(int argc, char **argv)
+{
+    size_t n = 0;
+    char **av = calloc(argc + n_files + 1, sizeof(*av));
+    if (!av)
+        return -1;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "@FILES@") == 0) {
+            for (int f = 0; f < n_files; f++)
+                av[n++] = paths[f];
+            continue;
+        }
+        const char *rep = NULL, *at;
+        size_t tl = 0;
+        if ((at = strstr(argv[i], "@LOG@"))) {
+            rep = log_path;
+            tl = 5;
+        } else if ((at = strstr(argv[i], "@DIR@"))) {
+            rep = dir;
+            tl = 5;
+        }
+        if (!rep) {
+            av[n++] = argv[i];
+            continue;
+        }
+        if (asprintf(&av[n++], "%.*s%s%s", (int)(at - argv[i]), argv[i],
+                     rep, at + tl) < 0)
+            return -1;
+    }
+    av[n] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0)
+            dup2(devnull, STDOUT_FILENO);
+        execvp(av[0], av);
+        perror(av[0]);
+        _exit(127);
+    }
+    return pid;
+}
+
+/* utime + stime of pid in clock ticks, or -1 */
+static long long proc_cpu_ticks(pid_t pid)
+{
+    char p[64], buf[1024];
+    snprintf(p, sizeof(p), "/proc/%d/stat", (int)pid);
+    int fd = open(p, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+
+    /* fields after "(comm)": state is 3rd, utime 14th, stime 15th */
+    char *s = strrchr(buf, ')');
+    if (!s)
+        return -1;
+    unsigned long long ut, st;
+    if (sscanf(s + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+               &ut, &st) != 2)
+        return -1;
+    return (long long)(ut + st);
+}
+
+/* ===== report ===== */
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct_us(struct lat *l, double q)
+{
+    if (!l->n)
+        return 0;
+    size_t i = (size_t)(q * (l->n - 1) + 0.5);
+    return l->v[i] / 1000.0;
+}
+
+static void report_lat(const char *name, struct lat *l)
+{
+    qsort(l->v, l->n, sizeof(*l->v), cmp_i64);
+    printf("%s_p50_us=%.0f %s_p99_us=%.0f %s_max_us=%.0f",
+           name, pct_us(l, 0.50), name, pct_us(l, 0.99),
+           name, l->n ? l->v[l->n - 1] / 1000.0 : 0.0);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n files] [-t threads] [-s seconds] [-r ops_per_sec]\n"
+            "          [-f forge_pct] [-a read_pct] [-A] [-p pause_ms] [-D dir]\n"
+            "          [-l alert_log] [-m token]... -- <watcher> [args...]\n"
+            "  watcher args: @FILES@ @LOG@ @DIR@ are substituted\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    snprintf(dir, sizeof(dir), "/data/local/tmp/bench_watcher");
+    while ((opt = getopt(argc, argv, "n:t:s:r:f:a:Ap:D:l:m:")) != -1) {
+        switch (opt) {
+        case 'n': n_files = atoi(optarg); break;
+        case 't': n_threads = atoi(optarg); break;
+        case 's': seconds = atoi(optarg); break;
+        case 'r': rate = strtol(optarg, NULL, 10); break;
+        case 'f': forge_pct = atoi(optarg); break;
+        case 'a': read_pct = atoi(optarg); break;
+        case 'A': forge_atime = 1; break;
+        case 'p': pause_ms = strtol(optarg, NULL, 10); break;
+        case 'D': snprintf(dir, sizeof(dir), "%s", optarg); break;
+        case 'l': snprintf(log_path, sizeof(log_path), "%s", optarg); break;
+        case 'm':
+            if (n_tokens == MAX_TOKENS) {
+                fprintf(stderr, "at most %d -m tokens\n", MAX_TOKENS);
+                return 1;
+            }
+            tokens[n_tokens++] = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind == argc || n_files <= 0 || n_threads <= 0 || seconds <= 0 ||
+        forge_pct < 0 || read_pct < 0 || forge_pct + read_pct > 100) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (n_tokens == 0) {
+        tokens[n_tokens++] = "FILE_FUTURE";
+        tokens[n_tokens++] = "FILE_PAST";
+        tokens[n_tokens++] = "mtime_state=FUTURE";
+        tokens[n_tokens++] = "mtime_state=PAST";
+    }
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror(dir);
+        return 1;
+    }
+    char real[PATH_MAX];
+    if (!realpath(dir, real)) {
+        perror(dir);
+        return 1;
+    }
+    snprintf(dir, sizeof(dir), "%s", real);
+    if (!log_path[0] &&
+        snprintf(log_path, sizeof(log_path), "%.*s/alerts.log",
+                 PATH_MAX - 16, dir) < 0)
+        return 1;
+
+    int err = files_create();
+    if (err) {
+        fprintf(stderr, "create files in %s: %s\n", dir, strerror(-err));
+        return 1;
+    }
+
+    /* tail from the current end: earlier runs' lines are not ours */
+    struct tail *tl = calloc(1, sizeof(*tl));
+    if (!tl)
+        return 1;
+    tl->fd = open(log_path, O_RDONLY | O_CREAT, 0644);
+    tl->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (tl->fd < 0 || tl->ifd < 0 ||
+        inotify_add_watch(tl->ifd, log_path, IN_MODIFY) < 0) {
+        perror(log_path);
+        return 1;
+    }
+    struct stat st;
+    tl->off = fstat(tl->fd, &st) == 0 ? st.st_size : 0;
+
+    pid_t pid = watcher_start(argc - optind, argv + optind);
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    sleep_ms(WARMUP_MS);
+    if (waitpid(pid, NULL, WNOHANG) == pid) {
+        fprintf(stderr, "watcher exited during startup\n");
+        return 1;
+    }
+    pthread_create(&tl->tid, NULL, tail_main, tl);
+
+    long long cpu0 = proc_cpu_ticks(pid);
+    long long t0 = mono_ns();
+
+    struct worker *ws = calloc(n_threads, sizeof(*ws));
+    if (!ws)
+        return 1;
+    for (int i = 0; i < n_threads; i++) {
+        ws[i].seed = 0x9e3779b9u * (i + 1);
+        pthread_create(&ws[i].tid, NULL, worker_main, &ws[i]);
+    }
+
+    long load_ms = seconds * 1000L;
+    if (pause_ms > 0) {
+        long half = (load_ms - pause_ms) / 2;
+        sleep_ms(half > 0 ? half : 0);
+        kill(pid, SIGSTOP);
+        paused = 1;
+        sleep_ms(pause_ms);
+        paused = 0;
+        kill(pid, SIGCONT);
+        load_ms -= (half > 0 ? half : 0) + pause_ms;
+    }
+    sleep_ms(load_ms > 0 ? load_ms : 0);
+    stop_load = 1;
+    for (int i = 0; i < n_threads; i++)
+        pthread_join(ws[i].tid, NULL);
+    long long t_load = mono_ns() - t0;
+
+    /* drain: until every forgery is reported or DRAIN_MS passes */
+    long long drain0 = mono_ns();
+    for (;;) {
+        int left = 0;
+        for (int i = 0; i < n_files && !left; i++)
+            left = __atomic_load_n(&pending_ns[i], __ATOMIC_ACQUIRE) > 0;
+        if (!left || mono_ns() - drain0 > DRAIN_MS * 1000000LL)
+            break;
+        sleep_ms(10);
+    }
+    long long cpu1 = proc_cpu_ticks(pid);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    tl->stop = 1;
+    pthread_join(tl->tid, NULL);
+
+    uint64_t ops = op_total.writes + op_total.reads + op_total.forges;
+    uint64_t missed = op_total.forges - detected;
+    uint64_t missed_paused = op_total.forges_paused - detected_paused;
+    long hz = sysconf(_SC_CLK_TCK);
+    double cpu_ms = cpu0 >= 0 && cpu1 >= 0 ? (cpu1 - cpu0) * 1000.0 / hz : -1;
+
+    printf("files=%d threads=%d seconds=%.1f ops=%llu ops_per_sec=%.0f "
+           "writes=%llu reads=%llu forges=%llu errors=%llu\n",
+           n_files, n_threads, t_load / 1e9, (unsigned long long)ops,
+           ops * 1e9 / t_load,
+           (unsigned long long)op_total.writes,
+           (unsigned long long)op_total.reads,
+           (unsigned long long)op_total.forges,
+           (unsigned long long)op_total.errors);
+    printf("detected=%llu missed=%llu detect_frac=%.4f unmatched=%llu ",
+           (unsigned long long)detected, (unsigned long long)missed,
+           op_total.forges ? (double)detected / op_total.forges : 0.0,
+           (unsigned long long)unmatched);
+    report_lat("lat", &lat_all);
+    printf("\n");
+    printf("watcher_cpu_ms=%.0f cpu_ms_per_1k_ops=%.3f\n",
+           cpu_ms, ops && cpu_ms >= 0 ? cpu_ms * 1000.0 / ops : -1.0);
+    if (pause_ms > 0) {
+        printf("pause_ms=%ld forges_paused=%llu detected_paused=%llu "
+               "missed_paused=%llu overflow_lines=%llu rescan_lines=%llu ",
+               pause_ms,
+               (unsigned long long)op_total.forges_paused,
+               (unsigned long long)detected_paused,
+               (unsigned long long)missed_paused,
+               (unsigned long long)overflow_lines,
+               (unsigned long long)rescan_lines);
+        report_lat("paused_lat", &lat_paused);
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * bpf_pin.h - bpffs pinning shared by the settimeofday loaders.
+ *
+ * Layout: /sys/fs/bpf/tsdetect/<tool>/{<map>..., link}
+ *
+ * First start (no pinned link): maps get a pin path before load, so
+ * libbpf creates and pins them; the tracepoint link is pinned after
+ * attach. The program then keeps counting after the daemon exits (and
+ * perfbuffer_settimeofday keeps queueing events in its backlog ring).
+ *
+ * Restart (pinned link present): the loader skips open/load/attach and
+ * just bpf_obj_get()s the maps it polls (pin_reuse()).
+ *
+ * Pinning a tracepoint link needs kernel 5.15+; before that only the
+ * maps persist, and the program detaches when the loader exits.
+ */
+#ifndef BPF_PIN_H
+#define BPF_PIN_H
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if __has_include(<bpf/libbpf.h>)
+  #include <bpf/libbpf.h>
+#else
+  #include <libbpf.h>
+#endif
+
+#if __has_include(<bpf/bpf.h>)
+  #include <bpf/bpf.h>
+#else
+  #include <bpf.h>
+#endif
+
+#define PIN_ROOT "/sys/fs/bpf/tsdetect"
+
+/* must match the `anchor` map value on the BPF side */
+struct anchor_val {
+    __s64 trusted_wall;      /* trusted wall clock at trusted_boot_ns */
+    __s64 trusted_boot_ns;   /* CLOCK_BOOTTIME */
+    __u64 seen_cnt;          /* last syscall_cnt handled by userspace */
+};
+
+/* dir/name into path; a pin never goes to a truncated path */
+static inline int pin_path(char *path, size_t sz, const char *dir, const char *name)
+{
+    int n = snprintf(path, sz, "%s/%s", dir, name);
+    return n < 0 || (size_t)n >= sz ? -ENAMETOOLONG : 0;
+}
+
+static inline int pin_prepare_dir(char *dir, size_t sz, const char *tool)
+{
+    if (pin_path(dir, sz, PIN_ROOT, tool))
+        return -ENAMETOOLONG;
+    if (mkdir(PIN_ROOT, 0700) != 0 && errno != EEXIST)
+        return -errno;
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+        return -errno;
+    return 0;
+}
+
+/* before load: libbpf reuses a compatible pinned map or pins a new one */
+static inline int pin_set_map_paths(struct bpf_object *obj, const char *dir)
+{
+    struct bpf_map *map;
+    char path[PATH_MAX];
+
+    bpf_object__for_each_map(map, obj) {
+        if (bpf_map__is_internal(map))   /* .rodata/.bss stay private */
+            continue;
+        int err = pin_path(path, sizeof(path), dir, bpf_map__name(map));
+        if (!err)
+            err = bpf_map__set_pin_path(map, path);
+        if (err)
+            return err;
+    }
+    return 0;
+}
+
+static inline int pin_open_map(const char *dir, const char *name)
+{
+    char path[PATH_MAX];
+    if (pin_path(path, sizeof(path), dir, name))
+        return -ENAMETOOLONG;
+    return bpf_obj_get(path);
+}
+
+static inline int pin_link(struct bpf_link *link, const char *dir)
+{
+    char path[PATH_MAX];
+    if (pin_path(path, sizeof(path), dir, "link"))
+        return -ENAMETOOLONG;
+    return bpf_link__pin(link, path);
+}
+
+/* a pinned link means the program is still attached from a previous run */
+static inline int pin_link_alive(const char *dir)
+{
+    int fd = pin_open_map(dir, "link");
+    if (fd < 0)
+        return 0;
+    close(fd);
+    return 1;
+}
+
+/* detach for good: drop every pin (link first so the program stops) */
+static inline void pin_remove(const char *dir)
+{
+    char path[PATH_MAX];
+    DIR *d;
+    struct dirent *de;
+
+    if (pin_path(path, sizeof(path), dir, "link") == 0)
+        unlink(path);
+
+    d = opendir(dir);
+    if (d) {
+        while ((de = readdir(d)) != NULL) {
+            if (de->d_name[0] == '.')
+                continue;
+            if (pin_path(path, sizeof(path), dir, de->d_name) == 0)
+                unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+/* pin names already in a directory, so a failed load only undoes its own */
+#define PIN_LIST_MAX 32
+
+struct pin_list {
+    int n;
+    char name[PIN_LIST_MAX][NAME_MAX + 1];
+};
+
+static inline void pin_list_get(const char *dir, struct pin_list *l)
+{
+    DIR *d = opendir(dir);
+    struct dirent *de;
+
+    l->n = 0;
+    if (!d)
+        return;
+    while ((de = readdir(d)) != NULL && l->n < PIN_LIST_MAX) {
+        if (de->d_name[0] == '.')
+            continue;
+        snprintf(l->name[l->n++], sizeof(l->name[0]), "%s", de->d_name);
+    }
+    closedir(d);
+}
+
+/* drop the pins that are not in old (the dir too, once empty) */
+static inline void pin_remove_new(const char *dir, const struct pin_list *old)
+{
+    char path[PATH_MAX];
+    DIR *d = opendir(dir);
+    struct dirent *de;
+
+    if (!d)
+        return;
+    while ((de = readdir(d)) != NULL) {
+        int keep = de->d_name[0] == '.';
+        for (int i = 0; i < old->n && !keep; i++)
+            keep = strcmp(old->name[i], de->d_name) == 0;
+        if (!keep && pin_path(path, sizeof(path), dir, de->d_name) == 0)
+            unlink(path);
+    }
+    closedir(d);
+    rmdir(dir);
+}
+
+/* one pinned map the fast path opens instead of loading */
+struct pin_map {
+    const char *name;
+    int *fd;                 /* set, or -1 */
+    int optional;            /* older pins may not have it */
+};
+
+/* pinned link/maps stay alive in bpffs after these fds close */
+static inline void pin_close_maps(const struct pin_map *m, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (*m[i].fd >= 0)
+            close(*m[i].fd);
+        *m[i].fd = -1;
+    }
+}
+
+/*
+ * Fast path: the program is still attached from a previous run. Returns 1
+ * with the maps open; with a required one missing the pins are stale, so
+ * they are dropped, dir is made again and 0 is returned for a fresh load.
+ */
+static inline int pin_reuse(char *dir, size_t sz, const char *tool,
+                            const struct pin_map *m, size_t n)
+{
+    int ok = 1;
+
+    if (!pin_link_alive(dir))
+        return 0;
+    for (size_t i = 0; i < n; i++) {
+        *m[i].fd = pin_open_map(dir, m[i].name);
+        if (*m[i].fd < 0 && !m[i].optional)
+            ok = 0;
+    }
+    if (ok)
+        return 1;
+    fprintf(stderr, "stale pins in %s, reloading\n", dir);
+    pin_close_maps(m, n);
+    pin_remove(dir);
+    pin_prepare_dir(dir, sz, tool);
+    return 0;
+}
+
+#endif /* BPF_PIN_H */
@@ -0,0 +1,197 @@
+/*
+ * bpf_stats.h - what our BPF programs cost, measured by the kernel.
+ *
+ * With BPF_STATS_RUN_TIME on, the kernel adds up run_cnt and run_time_ns
+ * for every program (bpf_prog_info); sampling both on a timer gives the
+ * ns each invocation adds to the syscall it hooks and how often it runs.
+ * Stats stay on while the fd from bpf_enable_stats() is open. Kernels
+ * before 5.8 only have the kernel.bpf_stats_enabled sysctl: it is set
+ * and put back at close, but stays set if we die first.
+ *
+ * Accounting is two clock reads per run, so it is opt-in (-X), and the
+ * number it reports includes them.
+ */
+#ifndef BPF_STATS_H
+#define BPF_STATS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if __has_include(<bpf/bpf.h>)
+  #include <bpf/bpf.h>
+#else
+  #include <bpf.h>
+#endif
+
+#define BS_PROGS   8
+#define BS_SYSCTL  "/proc/sys/kernel/bpf_stats_enabled"
+
+struct bs_prog {
+    int fd;
+    __u32 id;
+    char name[32];
+    const char *attach;         /* "raw_syscalls", "syscall", "pinned" */
+    __u64 run_cnt, run_time_ns; /* at the last sample */
+    __s64 at_ns;
+};
+
+struct bpf_stats {
+    int on;
+    int stats_fd;               /* bpf_enable_stats(); -1 with the sysctl */
+    char sysctl_old;            /* '0'/'1' to put back, 0: untouched */
+    long interval_ms;           /* 0: off */
+    __s64 next_ns;
+    struct bs_prog prog[BS_PROGS];
+    int n;
+};
+
+/* one interval of one program */
+struct bs_sample {
+    const struct bs_prog *p;
+    __u64 runs, run_ns;         /* in the interval */
+    double avg_ns, per_sec;
+    __u64 total_runs, total_ns;
+};
+
+static inline __s64 bs_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (__s64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int bs_sysctl(char set, char *old)
+{
+    int fd = open(BS_SYSCTL, O_RDWR | O_CLOEXEC);
+    int err = 0;
+
+    if (fd < 0)
+        return -errno;
+    if (old && read(fd, old, 1) != 1)
+        err = -EIO;
+    else if (pwrite(fd, &set, 1, 0) != 1)
+        err = -errno;
+    close(fd);
+    return err;
+}
+
+static inline int bs_info(int fd, struct bpf_prog_info *info)
+{
+    __u32 len = sizeof(*info);
+    memset(info, 0, sizeof(*info));
+    return bpf_obj_get_info_by_fd(fd, info, &len) ? -errno : 0;
+}
+
+/* interval_ms <= 0 leaves stats off; the bs_* calls then do nothing */
+static inline int bs_open(struct bpf_stats *bs, long interval_ms)
+{
+    memset(bs, 0, sizeof(*bs));
+    bs->stats_fd = -1;
+    if (interval_ms <= 0)
+        return 0;
+
+    bs->stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+    if (bs->stats_fd < 0) {
+        char old = 0;
+        int err = bs_sysctl('1', &old);
+        if (err)
+            return err;
+        bs->sysctl_old = old;
+    }
+    bs->on = 1;
+    bs->interval_ms = interval_ms;
+    bs->next_ns = bs_now() + interval_ms * 1000000LL;
+    return 0;
+}
+
+/* takes ownership of prog_fd; counters start from where they are now */
+static inline int bs_add(struct bpf_stats *bs, int prog_fd, const char *name,
+                         const char *attach)
+{
+    struct bpf_prog_info info;
+
+    if (!bs->on || prog_fd < 0)
+        return prog_fd < 0 ? -EBADF : 0;
+    if (bs->n == BS_PROGS || bs_info(prog_fd, &info) != 0) {
+        close(prog_fd);
+        return -ENOSPC;
+    }
+    struct bs_prog *p = &bs->prog[bs->n++];
+    p->fd = prog_fd;
+    p->id = info.id;
+    snprintf(p->name, sizeof(p->name), "%s", name ? name : info.name);
+    p->attach = attach;
+    p->run_cnt = info.run_cnt;
+    p->run_time_ns = info.run_time_ns;
+    p->at_ns = bs_now();
+    return 0;
+}
+
+/* a program we did not load ourselves: through the link that holds it */
+static inline int bs_add_link(struct bpf_stats *bs, int link_fd, const char *attach)
+{
+    struct bpf_link_info li;
+    __u32 len = sizeof(li);
+
+    if (!bs->on)
+        return 0;
+    memset(&li, 0, sizeof(li));
+    if (bpf_obj_get_info_by_fd(link_fd, &li, &len) != 0)
+        return -errno;
+    int fd = bpf_prog_get_fd_by_id(li.prog_id);
+    if (fd < 0)
+        return -errno;
+    return bs_add(bs, fd, NULL, attach);
+}
+
+static inline int bs_sample(struct bpf_stats *bs, int i, struct bs_sample *s)
+{
+    struct bs_prog *p = &bs->prog[i];
+    struct bpf_prog_info info;
+    __s64 now = bs_now();
+
+    if (bs_info(p->fd, &info) != 0)
+        return -errno;
+    s->p = p;
+    s->runs = info.run_cnt - p->run_cnt;
+    s->run_ns = info.run_time_ns - p->run_time_ns;
+    s->avg_ns = s->runs ? (double)s->run_ns / s->runs : 0.0;
+    s->per_sec = now > p->at_ns ? s->runs * 1e9 / (now - p->at_ns) : 0.0;
+    s->total_runs = info.run_cnt;
+    s->total_ns = info.run_time_ns;
+    p->run_cnt = info.run_cnt;
+    p->run_time_ns = info.run_time_ns;
+    p->at_ns = now;
+    return 0;
+}
+
+/* due once per interval: 1, and the caller samples every program */
+static inline int bs_due(struct bpf_stats *bs)
+{
+    if (!bs->on || !bs->n)
+        return 0;
+    __s64 now = bs_now();
+    if (now < bs->next_ns)
+        return 0;
+    bs->next_ns = now + bs->interval_ms * 1000000LL;
+    return 1;
+}
+
+static inline void bs_close(struct bpf_stats *bs)
+{
+    for (int i = 0; i < bs->n; i++)
+        close(bs->prog[i].fd);
+    bs->n = 0;
+    if (bs->stats_fd >= 0)
+        close(bs->stats_fd);
+    else if (bs->sysctl_old)
+        bs_sysctl(bs->sysctl_old, NULL);
+    bs->stats_fd = -1;
+    bs->on = 0;
+}
+
+#endif /* BPF_STATS_H */
@@ -2,6 +2,7 @@
 #include <sys/types.h>
 #include <sys/inotify.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
 #include <time.h>
 #include <limits.h>
 #include <unistd.h>
@@ -9,17 +10,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <libgen.h>
 #include <fcntl.h>
+#include <stdarg.h>
+#include <signal.h>
+
+#include "trace.h"
+#include "tamper_index.h"
+#include "watch_table.h"
+#include "chain_log.h"
 
 #define EVENT_SIZE (sizeof(struct inotify_event))
 #define BUF_LEN    (2048 * (EVENT_SIZE + NAME_MAX))
-#define EPSILON    60   /* ±1 minute */
+#define EPSILON    60   /* ±1 minute, default of -e */
 
 /* =========================================================
  *  ALERT LOG FD
  * ========================================================= */
 static int alert_fd = -1;
+static long epsilon_sec = EPSILON;                              /* -e */
+static const char *alert_path = "/data/local/tmp/alerts.log";  /* -o */
+static struct chain_log chain;      /* chain_log.h */
+static long chain_records = CL_RECORDS;    /* -m, 0 = plain log */
+static long chain_sec = CL_SECONDS;        /* -M */
 
 /* =========================================================
  *  BOOTTIME anchor
@@ -55,9 +67,9 @@ check_file_time(time_t file_time)
     time_t expected = expected_wall_time();
     time_t diff = file_time - expected;
 
-    if (diff > EPSILON)
+    if (diff > epsilon_sec)
         return FILE_FUTURE;
-    if (diff < -EPSILON)
+    if (diff < -epsilon_sec)
         return FILE_PAST;
     return FILE_NORMAL;
 }
@@ -72,190 +84,417 @@ static const char *file_state_str(enum file_time_state s)
 }
 
 /* =========================================================
- *  SYSTEM TIME STATE (from time_changed.txt)
+ *  SYSTEM TIME STATE (tamper windows from time_changed.txt)
+ *
+ *  Only lines appended since the last call are read, once per inotify
+ *  read batch and once per rescan slice. Each settimeofday
+ *  line (probe "settimeofday: ..." or detector "SETTIMEOFDAY ...", or
+ *  its -J JSON form) feeds the tamper window index; lines without
+ *  boot_ns are placed at the time we read them. A settimeofday line
+ *  without new/expected is counted and warned about once: it opens no
+ *  window.
  * ========================================================= */
-static const char *read_time_state(const char *log_path)
+static struct tamper_index tamper;
+static off_t clock_log_off;
+static unsigned long long clock_unparsed;
+
+static int line_field(const char *line, const char *key, long long *out)
+{
+    const char *p = strstr(line, key);
+    if (!p)
+        return 0;
+    char *end;
+    *out = strtoll(p + strlen(key), &end, 10);
+    return end != p + strlen(key);
+}
+
+static void clock_feed(const char *log_path)
 {
-    static char state[16] = "UNKNOWN";
     char line[512];
+    struct stat st;
 
     FILE *fp = fopen(log_path, "r");
     if (!fp)
-        return state;
+        return;
+    if (fstat(fileno(fp), &st) == 0 && st.st_size < clock_log_off)
+        clock_log_off = 0;              /* truncated: start over */
+    if (fseeko(fp, clock_log_off, SEEK_SET) != 0) {
+        fclose(fp);
+        return;
+    }
 
     while (fgets(line, sizeof(line), fp)) {
-        if (strstr(line, "[FUTURE]"))
-            strcpy(state, "FUTURE");
-        else if (strstr(line, "[PAST]"))
-            strcpy(state, "PAST");
-        else if (strstr(line, "[CURRENT]"))
-            strcpy(state, "CURRENT");
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n')
+            break;                      /* being written: next time */
+        clock_log_off += len;
+
+        int json = strstr(line, "\"type\":\"SETTIMEOFDAY\"") != NULL;
+        if (!json && !strstr(line, "settimeofday:") &&
+            !strstr(line, "SETTIMEOFDAY "))
+            continue;
+
+        long long new_wall, expected, boot;
+        if (!line_field(line, json ? "\"new\":" : " new=", &new_wall) ||
+            !line_field(line, json ? "\"expected\":" : " expected=", &expected)) {
+            if (clock_unparsed++ == 0)
+                fprintf(stderr, "%s: settimeofday line without new/expected, "
+                        "no tamper window: %s", log_path, line);
+            continue;
+        }
+        if (!line_field(line, json ? "\"boot_ns\":" : " boot_ns=", &boot)) {
+            struct timespec now;
+            clock_gettime(CLOCK_BOOTTIME, &now);
+            boot = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+        }
+        tamper_clock_event(&tamper, boot, new_wall, expected);
     }
 
     fclose(fp);
-    return state;
 }
 
 /* =========================================================
  *  LOG HELPER (printf 대체)
+ *
+ *  One batch per inotify read, written with its #CHAIN commit.
  * ========================================================= */
+#define ALERT_BATCH (16 * 1024)
+#define ALERT_LINE  512
+
+static char alert_batch[ALERT_BATCH];
+static size_t alert_len;
+
+static void alert_flush(void)
+{
+    cl_write(&chain, alert_batch, alert_len);
+    alert_len = 0;
+}
+
 static void log_alert(const char *fmt, ...)
 {
     if (alert_fd < 0)
         return;
+    if (ALERT_BATCH - alert_len < ALERT_LINE)
+        alert_flush();
 
-    char buf[512];
+    char *buf = alert_batch + alert_len;
     va_list ap;
     va_start(ap, fmt);
-    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    int len = vsnprintf(buf, ALERT_LINE, fmt, ap);
     va_end(ap);
 
+    if (len >= ALERT_LINE) {
+        len = ALERT_LINE - 1;
+        buf[len - 1] = '\n';
+    }
     if (len > 0)
-        write(alert_fd, buf, len);
+        alert_len += len;
 }
 
 /* =========================================================
- *  MAIN
+ *  TRACE (-R): file changes for perfbuffer_settimeofday -P
  * ========================================================= */
-int main(int argc, char **argv)
+static int64_t ts_ns(struct timespec t)
 {
-    if (argc < 3) {
-        fprintf(stderr,
-            "usage: %s <target_file> <time_changed.txt>\n", argv[0]);
-        return 1;
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void record_change(const char *path, uint32_t mask,
+                          const struct wt_target *prev, const struct stat *cur)
+{
+    if (trace_fd < 0)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+
+    struct trace_file f = {
+        .dev      = cur->st_dev,
+        .ino      = cur->st_ino,
+        .mask     = mask,
+        .mtime_ns = ts_ns(cur->st_mtim),
+        .atime_ns = ts_ns(cur->st_atim),
+        .ctime_ns = ts_ns(cur->st_ctim),
+    };
+    /* same comparisons as the alerts below */
+    if (cur->st_mtime != prev->mtime)
+        f.changed |= TRACE_F_MTIME;
+    if (cur->st_atime != prev->atime)
+        f.changed |= TRACE_F_ATIME;
+
+    trace_append(TRACE_FILE, ts_ns(now), &f, sizeof(f),
+                 path, strlen(path) + 1);
+    trace_flush();      /* low rate: keep the trace current */
+}
+
+/* =========================================================
+ *  TARGET CHECK
+ * ========================================================= */
+static struct watch_table wt;
+
+/* the caller feeds the tamper index (clock_feed) once per batch first */
+static void check_target(uint32_t i, uint32_t mask)
+{
+    struct wt_target *t = &wt.t[i];
+    struct stat cur_st;
+    if (stat(t->path, &cur_st) != 0)
+        return;
+
+    /* replaced (delete + create, rename over, or lost in an overflow) */
+    if ((uint64_t)cur_st.st_ino != t->ino ||
+        (uint64_t)cur_st.st_dev != t->dev || t->wd < 0) {
+        log_alert("[System] File recreated | path=%s\n", t->path);
+        wt_watch_file(&wt, i);
     }
 
-    const char *target_path = argv[1];
-    const char *time_log    = argv[2];
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    int64_t now_ns = ts_ns(now);
+
+    const struct tamper_win *sys = tamper_at(&tamper, now_ns);
+
+    record_change(t->path, mask, t, &cur_st);
+
+    if (cur_st.st_mtime != t->mtime) {
+        enum file_time_state fs =
+            check_file_time(cur_st.st_mtime);
+        const struct tamper_win *w =
+            tamper_written_in(&tamper, cur_st.st_mtime, now_ns);
+        log_alert(
+            "[ALERT] mtime changed | system=%s sys_offset=%lld | %s | in_window=%d win_offset=%lld | path=%s\n",
+            tamper_state_str(&tamper, sys),
+            sys ? (long long)sys->offset : 0LL,
+            file_state_str(fs),
+            w != NULL, w ? (long long)w->offset : 0LL,
+            t->path
+        );
+    }
 
-    /* open alert log */
-    alert_fd = open("/data/local/tmp/alerts.log",
-                    O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (alert_fd < 0) {
-        perror("open alerts.log");
-        return 1;
+    if (cur_st.st_atime != t->atime) {
+        enum file_time_state fs =
+            check_file_time(cur_st.st_atime);
+        const struct tamper_win *w =
+            tamper_written_in(&tamper, cur_st.st_atime, now_ns);
+        log_alert(
+            "[ALERT] atime changed | system=%s sys_offset=%lld | %s | in_window=%d win_offset=%lld | path=%s\n",
+            tamper_state_str(&tamper, sys),
+            sys ? (long long)sys->offset : 0LL,
+            file_state_str(fs),
+            w != NULL, w ? (long long)w->offset : 0LL,
+            t->path
+        );
     }
 
-    char realpath_buf[PATH_MAX];
-    if (!realpath(target_path, realpath_buf)) {
-        perror("realpath");
+    wt_stat_into(t, &cur_st);
+}
+
+/* =========================================================
+ *  QUEUE OVERFLOW RECOVERY (wt_rescan_*, watch_table.h)
+ *
+ *  Sliced, most recently active first, between inotify reads; targets
+ *  that report an event meanwhile are fresh and skipped.
+ * ========================================================= */
+static struct wt_rescan rs;
+
+static volatile sig_atomic_t exiting;
+
+static void on_term(int sig)
+{
+    (void)sig;
+    exiting = 1;
+}
+
+static void rescan_check(uint32_t i, void *arg)
+{
+    (void)arg;
+    check_target(i, IN_Q_OVERFLOW);
+}
+
+static void rescan_step(const char *time_log)
+{
+    clock_feed(time_log);
+    if (wt_rescan_step(&wt, &rs, rescan_check, NULL))
+        log_alert("[System] rescan done | targets=%u duration_us=%lld max_us=%lld\n",
+                  rs.n, rs.last_us, rs.max_us);
+}
+
+/* =========================================================
+ *  MAIN
+ * ========================================================= */
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    int opt, bad = 0;
+
+    while ((opt = getopt(argc, argv, "e:R:o:m:M:")) != -1) {
+        switch (opt) {
+        case 'e': {
+            char *end;
+            epsilon_sec = strtol(optarg, &end, 10);
+            if (end == optarg || *end || epsilon_sec <= 0)
+                bad = 1;
+            break;
+        }
+        case 'R':
+            trace_path = optarg;
+            break;
+        case 'o':
+            alert_path = optarg;
+            break;
+        case 'm':   /* Merkle root every this many lines; 0 = no chain */
+            chain_records = strtol(optarg, NULL, 10);
+            if (chain_records < 0)
+                bad = 1;
+            break;
+        case 'M':   /* ... or with batches this many seconds old */
+            chain_sec = strtol(optarg, NULL, 10);
+            if (chain_sec <= 0)
+                bad = 1;
+            break;
+        default:
+            bad = 1;
+        }
+    }
+    if (bad || argc - optind < 2) {
+        fprintf(stderr,
+            "usage: %s [-e epsilon_sec] [-R trace] [-o alert_log] [-m root_lines] [-M root_sec]\n"
+            "          <target_file>... <time_changed.txt>\n", argv[0]);
         return 1;
     }
 
-    char *p1 = strdup(realpath_buf);
-    char *p2 = strdup(realpath_buf);
-    char *dir  = dirname(p1);
-    char *file = basename(p2);
+    const char *time_log = argv[argc - 1];
 
-    struct stat prev_st;
-    if (stat(realpath_buf, &prev_st) != 0) {
-        perror("stat");
+    /* open alert log */
+    alert_fd = open(alert_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (alert_fd < 0 ||
+        cl_open(&chain, alert_fd, alert_path, 0, chain_records, chain_sec) != 0) {
+        perror(alert_path);
         return 1;
     }
 
     init_anchor();
+    tamper_init(&tamper, epsilon_sec);
+
+    if (trace_path) {
+        int err = trace_create(trace_path, TRACE_SRC_FILE, wall_anchor,
+                               ts_ns(boot_anchor), epsilon_sec, 0);
+        if (err) {
+            fprintf(stderr, "open trace: %s\n", strerror(-err));
+            return 1;
+        }
+    }
 
     int fd = inotify_init1(IN_NONBLOCK);
     if (fd < 0) {
         perror("inotify_init");
         return 1;
     }
+    wt_init(&wt, fd);
 
-    int file_wd = inotify_add_watch(
-        fd,
-        realpath_buf,
-        IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE |
-        IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED
-    );
-
-    int dir_wd = inotify_add_watch(
-        fd,
-        dir,
-        IN_CREATE | IN_MOVED_TO
-    );
-
-    if (file_wd < 0 || dir_wd < 0) {
-        perror("inotify_add_watch");
-        return 1;
+    for (int i = optind; i < argc - 1; i++) {
+        int err = 0;
+        if (wt_add(&wt, argv[i], NULL, &err) == WT_NONE) {
+            fprintf(stderr, "%s: %s\n", argv[i], strerror(-err));
+            return 1;
+        }
     }
 
     /* 감시 시작 메시지는 stdout 유지 */
-    printf("[Watcher] Monitoring %s\n", realpath_buf);
+    printf("[Watcher] Monitoring %u files in %u directories\n",
+           wt.live, wt.dir_by_path.n);
+
+    /*
+     * SIGINT/SIGTERM stay blocked except inside epoll_pwait(), so a stop
+     * request is never lost between the exiting check and the wait; the
+     * exit path below then seals the chain and flushes the trace.
+     */
+    struct sigaction sa;
+    sigset_t block, waitmask;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_term;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigprocmask(SIG_BLOCK, &block, &waitmask);
+    sigdelset(&waitmask, SIGINT);
+    sigdelset(&waitmask, SIGTERM);
+
+    /* block until events arrive instead of sleep-polling */
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN };
+    if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll");
+        return 1;
+    }
 
-    char buf[BUF_LEN];
+    char buf[BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
 
-    while (1) {
+    while (!exiting) {
         int len = read(fd, buf, sizeof(buf));
         if (len < 0) {
-            if (errno == EAGAIN) {
-                usleep(100000);
+            if (errno == EAGAIN || errno == EINTR) {
+                if (wt_rescan_busy(&rs))
+                    rescan_step(time_log);
+                alert_flush();
+                cl_tick(&chain, cl_now());
+                /* a rescan in progress only yields to pending events */
+                if (epoll_pwait(ep, &ev, 1, wt_rescan_busy(&rs) ? 0 :
+                                cl_due_ms(&chain, cl_now()), &waitmask) < 0 &&
+                    errno != EINTR)
+                    break;
                 continue;
             }
             break;
         }
 
+        int64_t now = wt_mono_ns();
+        clock_feed(time_log);
+
         for (int i = 0; i < len; ) {
             struct inotify_event *e =
                 (struct inotify_event *)&buf[i];
+            i += EVENT_SIZE + e->len;
 
-            /* ----- directory: file recreated ----- */
-            if (e->wd == dir_wd && e->len > 0 &&
-                strcmp(e->name, file) == 0 &&
-                (e->mask & IN_MOVED_TO)) {
-
-                log_alert("[System] File recreated\n");
-
-                int new_wd = inotify_add_watch(
-                    fd,
-                    realpath_buf,
-                    IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE |
-                    IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED
-                );
-                if (new_wd >= 0)
-                    file_wd = new_wd;
-
-                stat(realpath_buf, &prev_st);
+            /* events were dropped: stat the stale targets again */
+            if (e->mask & IN_Q_OVERFLOW) {
+                if (wt_rescan_begin(&wt, &rs) != 0)
+                    log_alert("[System] IN_Q_OVERFLOW | rescan alloc failed\n");
+                else
+                    log_alert("[System] IN_Q_OVERFLOW | overflows=%llu rescan_targets=%u\n",
+                              rs.overflows, rs.n);
+                continue;
             }
 
-            /* ----- file events ----- */
-            else if (e->wd == file_wd &&
-                     (e->mask & (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE))) {
-
-                struct stat cur_st;
-                if (stat(realpath_buf, &cur_st) == 0) {
-
-                    const char *sys_state =
-                        read_time_state(time_log);
-
-                    if (cur_st.st_mtime != prev_st.st_mtime) {
-                        enum file_time_state fs =
-                            check_file_time(cur_st.st_mtime);
-                        log_alert(
-                            "[ALERT] mtime changed | system=%s | %s\n",
-                            sys_state, file_state_str(fs)
-                        );
-                    }
-
-                    if (cur_st.st_atime != prev_st.st_atime) {
-                        enum file_time_state fs =
-                            check_file_time(cur_st.st_atime);
-                        log_alert(
-                            "[ALERT] atime changed | system=%s | %s\n",
-                            sys_state, file_state_str(fs)
-                        );
-                    }
-
-                    prev_st = cur_st;
-                }
-            }
+            enum wt_kind kind;
+            uint32_t t = wt_dispatch(&wt, e, &kind);
+            if (t == WT_NONE)
+                continue;
 
-            i += EVENT_SIZE + e->len;
+            if (kind == WT_EV_GONE)
+                log_alert("[System] File removed | path=%s\n", wt.t[t].path);
+            else if (kind == WT_EV_CHANGED)
+                for (uint32_t j = t; j != WT_NONE; j = wt.t[j].alias)
+                    check_target(j, e->mask);   /* hard links share it */
+            else if (kind != WT_EV_NONE)
+                check_target(t, e->mask);
+            wt.t[t].fresh_gen = rs.gen;
+            wt.t[t].last_event_ns = now;
         }
+        if (wt_rescan_busy(&rs))
+            rescan_step(time_log);
     }
 
+    log_alert("[System] exit | overflows=%llu rescans=%llu rescanned=%llu rescan_total_us=%lld rescan_max_us=%lld clock_unparsed=%llu\n",
+              rs.overflows, rs.rescans, rs.rescanned, rs.total_us, rs.max_us, clock_unparsed);
+    close(ep);
+    wt_free(&wt);
     close(fd);
+    trace_close();
+    alert_flush();
+    cl_close(&chain);
     close(alert_fd);
-    free(p1);
-    free(p2);
+    wt_rescan_free(&rs);
     return 0;
 }
@@ -0,0 +1,479 @@
+/*
+ * chain_log.h - hash-chained, append-only alert log.
+ *
+ * Alert lines are written a batch at a time, and each batch is sealed in
+ * the same write() by a commit line:
+ *
+ *   d_i = SHA256(batch bytes)
+ *   c_i = SHA256(c_{i-1} || d_i)
+ *   #CHAIN seq=i lines=<n> bytes=<len> hash=<c_i hex>
+ *
+ * so one hash over the batch plus one 64-byte block per batch is all a
+ * writer pays. Every N lines, or T seconds with batches pending, the
+ * batch digests since the last one are committed as a Merkle root
+ * (RFC 6962 shape: leaf = SHA256(0x00 || d_i), node = SHA256(0x01 || l || r)):
+ *
+ *   #MERKLE first=<seq> count=<k> root=<hex>
+ *
+ * A writer starts each segment (process start, log reopened) with
+ *
+ *   #SEGMENT v=1 seq=<next seq> prev=<hex>
+ *
+ * where prev is the last chain value already in the file, or the chain
+ * the writer was on if the file is new, or zeros. In a JSON Lines log
+ * the same text is wrapped as {"type":"LOG","msg":"#CHAIN ..."}, the
+ * shape af_log_json() gives any other log line.
+ *
+ * The chain is not keyed: anyone who can rewrite the file can rewrite it
+ * consistently from the edit onwards. What it gives is that a root copied
+ * off the device (collector, syslog, a screenshot) pins everything before
+ * it, and that edits, deletions and foreign writes in the middle of a
+ * segment break it. log_verify checks a log with these same helpers.
+ */
+#ifndef CHAIN_LOG_H
+#define CHAIN_LOG_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sha256.h"
+
+#define CL_RECORDS   1024       /* -m: lines per Merkle root */
+#define CL_SECONDS   10         /* -M: or this old */
+#define CL_LINE_MAX  192        /* one commit line, either style */
+#define CL_TAIL      (64 * 1024)    /* a batch and its commit fit */
+#define CL_LEAVES_MAX (64 * 1024)   /* a root at least this often */
+
+#define CL_JSON_PRE  "{\"type\":\"LOG\",\"msg\":\""
+#define CL_JSON_POST "\"}"
+
+/* one commit line as written: wrapping, newline and NUL included */
+#define CL_LINE_BUF  (CL_LINE_MAX + sizeof(CL_JSON_PRE) + sizeof(CL_JSON_POST))
+
+struct chain_log {
+    pthread_mutex_t lock;
+    int fd;                     /* -1 or chaining off: plain write() */
+    int on;
+    int json;
+    long every_n;
+    long long every_ns;
+
+    uint8_t chain[SHA256_LEN];
+    uint64_t seq;               /* last batch written */
+
+    /* Merkle window: leaf hashes since the last root */
+    uint8_t (*leaf)[SHA256_LEN];
+    size_t n_leaf, cap_leaf;
+    uint64_t win_first;
+    long win_lines;
+    long long win_t0;
+
+    unsigned long long batches, lines, bytes, roots, segments;
+};
+
+static inline long long cl_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline char *cl_hex(char *p, const uint8_t h[SHA256_LEN])
+{
+    static const char dig[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_LEN; i++) {
+        *p++ = dig[h[i] >> 4];
+        *p++ = dig[h[i] & 15];
+    }
+    *p = '\0';
+    return p;
+}
+
+static inline int cl_unhex(const char *p, const char *end, uint8_t h[SHA256_LEN])
+{
+    if (end - p < 2 * SHA256_LEN)
+        return -EINVAL;
+    for (int i = 0; i < 2 * SHA256_LEN; i++) {
+        int c = p[i], v;
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else
+            return -EINVAL;
+        if (i & 1)
+            h[i / 2] |= v;
+        else
+            h[i / 2] = v << 4;
+    }
+    return 0;
+}
+
+/* ----- commit lines, shared with log_verify ----- */
+
+enum cl_kind { CL_DATA, CL_CHAIN, CL_MERKLE, CL_SEGMENT };
+
+/*
+ * What [p, end) (one line, no newline) is. *body is set past the
+ * "#CHAIN " etc. so the fields can be looked up.
+ */
+static inline enum cl_kind cl_classify(const char *p, const char *end,
+                                       const char **body)
+{
+    static const struct { const char *s; size_t n; enum cl_kind k; } tag[] = {
+        { "#CHAIN ",   7, CL_CHAIN },
+        { "#MERKLE ",  8, CL_MERKLE },
+        { "#SEGMENT ", 9, CL_SEGMENT },
+    };
+    size_t pre = sizeof(CL_JSON_PRE) - 1;
+
+    if (end - p > (long)pre && p[0] == '{' && memcmp(p, CL_JSON_PRE, pre) == 0)
+        p += pre;
+    if (p == end || *p != '#')
+        return CL_DATA;
+    for (size_t i = 0; i < sizeof(tag) / sizeof(tag[0]); i++) {
+        if ((size_t)(end - p) > tag[i].n && memcmp(p, tag[i].s, tag[i].n) == 0) {
+            *body = p + tag[i].n;
+            return tag[i].k;
+        }
+    }
+    return CL_DATA;
+}
+
+/* value of " key=" in a commit line body, or NULL */
+static inline const char *cl_field(const char *p, const char *end, const char *key)
+{
+    size_t k = strlen(key);
+    while (p < end) {
+        if ((size_t)(end - p) > k && memcmp(p, key, k) == 0 && p[k] == '=')
+            return p + k + 1;
+        const char *sp = memchr(p, ' ', end - p);
+        if (!sp)
+            break;
+        p = sp + 1;
+    }
+    return NULL;
+}
+
+static inline int cl_field_u64(const char *p, const char *end, const char *key,
+                               unsigned long long *v)
+{
+    const char *f = cl_field(p, end, key);
+    if (!f || f == end || *f < '0' || *f > '9')
+        return -EINVAL;
+    unsigned long long x = 0;
+    while (f < end && *f >= '0' && *f <= '9')
+        x = x * 10 + (*f++ - '0');
+    *v = x;
+    return 0;
+}
+
+static inline int cl_field_hash(const char *p, const char *end, const char *key,
+                                uint8_t h[SHA256_LEN])
+{
+    const char *f = cl_field(p, end, key);
+    return f ? cl_unhex(f, end, h) : -EINVAL;
+}
+
+static inline void cl_link(uint8_t chain[SHA256_LEN], const uint8_t d[SHA256_LEN])
+{
+    uint8_t in[2 * SHA256_LEN];
+    memcpy(in, chain, SHA256_LEN);
+    memcpy(in + SHA256_LEN, d, SHA256_LEN);
+    sha256(in, sizeof(in), chain);
+}
+
+static inline void cl_leaf(uint8_t out[SHA256_LEN], const uint8_t d[SHA256_LEN])
+{
+    uint8_t in[1 + SHA256_LEN] = { 0x00 };
+    memcpy(in + 1, d, SHA256_LEN);
+    sha256(in, sizeof(in), out);
+}
+
+/*
+ * Root over n leaf hashes, in place. Pairing bottom-up and carrying an
+ * odd last node up unchanged gives the RFC 6962 tree for any n.
+ */
+static inline void cl_root(uint8_t (*h)[SHA256_LEN], size_t n, uint8_t out[SHA256_LEN])
+{
+    uint8_t in[1 + 2 * SHA256_LEN] = { 0x01 };
+
+    while (n > 1) {
+        size_t m = 0;
+        for (size_t i = 0; i + 1 < n; i += 2) {
+            memcpy(in + 1, h[i], SHA256_LEN);
+            memcpy(in + 1 + SHA256_LEN, h[i + 1], SHA256_LEN);
+            sha256(in, sizeof(in), h[m++]);
+        }
+        if (n & 1)
+            memcpy(h[m++], h[n - 1], SHA256_LEN);
+        n = m;
+    }
+    memcpy(out, h[0], SHA256_LEN);
+}
+
+/* ----- writer ----- */
+
+/* "#TAG body\n", or its JSON wrapping, into [p, end) */
+static inline char *cl_line(const struct chain_log *cl, char *p, char *end,
+                            const char *text)
+{
+    size_t room = end - p;
+    int n = cl->json ? snprintf(p, room, CL_JSON_PRE "%s" CL_JSON_POST "\n", text)
+                     : snprintf(p, room, "%s\n", text);
+
+    if (n < 0)
+        return p;
+    return p + ((size_t)n < room ? (size_t)n : room - 1);
+}
+
+/* the pending window's root line; lock held */
+static inline char *cl_merkle(struct chain_log *cl, char *p, char *end)
+{
+    char text[CL_LINE_MAX], hex[2 * SHA256_LEN + 1];
+    uint8_t root[SHA256_LEN];
+    size_t n = cl->n_leaf;
+
+    if (n == 0)
+        return p;
+    cl_root(cl->leaf, n, root);
+    cl_hex(hex, root);
+    snprintf(text, sizeof(text), "#MERKLE first=%llu count=%zu root=%s",
+             (unsigned long long)cl->win_first, n, hex);
+    cl->n_leaf = 0;
+    cl->win_lines = 0;
+    cl->roots++;
+    return cl_line(cl, p, end, text);
+}
+
+/*
+ * Append [data, len) (whole lines) and its commit. The batch digest is
+ * taken before the lock; linking, the root and the write are under it,
+ * so the chain order is the file order with any number of writers.
+ */
+static inline int cl_write(struct chain_log *cl, const void *data, size_t len)
+{
+    if (len == 0 || cl->fd < 0)
+        return 0;
+    if (!cl->on)
+        return write(cl->fd, data, len) < 0 ? -errno : 0;
+
+    uint8_t d[SHA256_LEN];
+    long lines = 0;
+    for (const char *p = data, *end = p + len;
+         (p = memchr(p, '\n', end - p)) != NULL; p++)
+        lines++;
+    sha256(data, len, d);
+
+    char tail[2 * CL_LINE_BUF], text[CL_LINE_MAX], hex[2 * SHA256_LEN + 1];
+    int err = 0;
+
+    pthread_mutex_lock(&cl->lock);
+    cl_link(cl->chain, d);
+    cl->seq++;
+    cl_hex(hex, cl->chain);
+    snprintf(text, sizeof(text), "#CHAIN seq=%llu lines=%ld bytes=%zu hash=%s",
+             (unsigned long long)cl->seq, lines, len, hex);
+    char *p = cl_line(cl, tail, tail + sizeof(tail), text);
+
+    if (cl->n_leaf == 0) {
+        cl->win_first = cl->seq;
+        cl->win_t0 = cl_now();
+    }
+    cl_leaf(cl->leaf[cl->n_leaf++], d);
+    cl->win_lines += lines;
+    if (cl->win_lines >= cl->every_n || cl->n_leaf == cl->cap_leaf)
+        p = cl_merkle(cl, p, tail + sizeof(tail));
+
+    struct iovec iov[2] = {
+        { (void *)data, len },
+        { tail, (size_t)(p - tail) },
+    };
+    if (writev(cl->fd, iov, 2) < 0)
+        err = -errno;
+    cl->batches++;
+    cl->lines += lines;
+    cl->bytes += len;
+    pthread_mutex_unlock(&cl->lock);
+    return err;
+}
+
+/* commit the pending root if it is at least min_age_ns old */
+static inline void cl_seal_aged(struct chain_log *cl, long long now, long long min_age_ns)
+{
+    char buf[CL_LINE_BUF];
+
+    if (!cl->on || cl->fd < 0)
+        return;
+    pthread_mutex_lock(&cl->lock);
+    if (cl->n_leaf && (min_age_ns <= 0 || now - cl->win_t0 >= min_age_ns)) {
+        char *p = cl_merkle(cl, buf, buf + sizeof(buf));
+        (void)!write(cl->fd, buf, p - buf);
+    }
+    pthread_mutex_unlock(&cl->lock);
+}
+
+/* commit the pending root now (exit, before the log is reopened) */
+static inline void cl_seal(struct chain_log *cl)
+{
+    cl_seal_aged(cl, 0, 0);
+}
+
+/* the T-second bound; call from the main loop */
+static inline void cl_tick(struct chain_log *cl, long long now)
+{
+    cl_seal_aged(cl, now, cl->every_ns);
+}
+
+/* epoll timeout until cl_tick has work: -1 with nothing pending */
+static inline int cl_due_ms(const struct chain_log *cl, long long now)
+{
+    if (!cl->on || cl->n_leaf == 0)
+        return -1;
+    long long left = cl->win_t0 + cl->every_ns - now;
+    return left <= 0 ? 0 : (int)((left + 999999) / 1000000);
+}
+
+/*
+ * The last chain value and seq in the file at path, from its tail.
+ * Returns 0 with nothing found (new file, or a log from before chaining).
+ */
+static inline int cl_tail(const char *path, uint8_t chain[SHA256_LEN], uint64_t *seq)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    int found = 0;
+
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    off_t off = st.st_size > CL_TAIL ? st.st_size - CL_TAIL : 0;
+    char *buf = malloc(CL_TAIL);
+    ssize_t n = buf ? pread(fd, buf, CL_TAIL, off) : -1;
+    close(fd);
+
+    const char *p = buf, *end = buf + (n > 0 ? n : 0);
+    if (off > 0 && (p = memchr(p, '\n', end - p)) != NULL)
+        p++;                        /* first line is partial */
+    while (p && p < end) {
+        const char *nl = memchr(p, '\n', end - p), *body;
+        if (!nl)
+            break;
+        enum cl_kind k = cl_classify(p, nl, &body);
+        unsigned long long s;
+        if (k == CL_CHAIN && cl_field_hash(body, nl, "hash", chain) == 0 &&
+            cl_field_u64(body, nl, "seq", &s) == 0) {
+            *seq = s;
+            found = 1;
+        } else if (k == CL_SEGMENT && cl_field_hash(body, nl, "prev", chain) == 0 &&
+                   cl_field_u64(body, nl, "seq", &s) == 0) {
+            *seq = s - 1;
+            found = 1;
+        }
+        p = nl + 1;
+    }
+    free(buf);
+    return found;
+}
+
+/* the segment line for the log at path, now on cl->fd; lock held */
+static inline int cl_start(struct chain_log *cl, const char *path)
+{
+    char text[CL_LINE_MAX], hex[2 * SHA256_LEN + 1], buf[CL_LINE_BUF];
+
+    cl_tail(path, cl->chain, &cl->seq);
+    cl->n_leaf = 0;
+    cl->win_lines = 0;
+    cl_hex(hex, cl->chain);
+    snprintf(text, sizeof(text), "#SEGMENT v=1 seq=%llu prev=%s",
+             (unsigned long long)cl->seq + 1, hex);
+    char *p = cl_line(cl, buf, buf + sizeof(buf), text);
+    cl->segments++;
+    return write(cl->fd, buf, p - buf) < 0 ? -errno : 0;
+}
+
+/*
+ * Start a segment in the log at path (already open on cl->fd): link to
+ * its tail if it has one, else carry the chain we were on into it.
+ */
+static inline int cl_segment(struct chain_log *cl, const char *path)
+{
+    if (!cl->on || cl->fd < 0)
+        return 0;
+    pthread_mutex_lock(&cl->lock);
+    int err = cl_start(cl, path);
+    pthread_mutex_unlock(&cl->lock);
+    return err;
+}
+
+/*
+ * cfg_reopen_log() for a chained log: the pending root goes to the old
+ * file and the new one starts a segment, with no other thread's batch
+ * landing in between.
+ */
+static inline int cl_reopen(struct chain_log *cl, const char *path)
+{
+    char buf[CL_LINE_BUF];
+    int nfd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    if (nfd < 0)
+        return -errno;
+    pthread_mutex_lock(&cl->lock);
+    if (cl->on) {
+        char *p = cl_merkle(cl, buf, buf + sizeof(buf));
+        if (p != buf)
+            (void)!write(cl->fd, buf, p - buf);
+    }
+    int err = dup2(nfd, cl->fd) < 0 ? -errno : 0;
+    if (!err && cl->on)
+        err = cl_start(cl, path);
+    pthread_mutex_unlock(&cl->lock);
+    close(nfd);
+    return err;
+}
+
+/*
+ * every_n 0: chaining off, cl_write() is a plain write. A window never
+ * holds more batches than lines, so its leaves are allocated up front.
+ */
+static inline int cl_open(struct chain_log *cl, int fd, const char *path, int json,
+                          long every_n, long every_sec)
+{
+    memset(cl, 0, sizeof(*cl));
+    pthread_mutex_init(&cl->lock, NULL);
+    cl->fd = fd;
+    cl->json = json;
+    cl->on = every_n > 0;
+    cl->every_n = every_n;
+    cl->every_ns = (every_sec > 0 ? every_sec : CL_SECONDS) * 1000000000LL;
+    if (!cl->on)
+        return 0;
+    cl->cap_leaf = every_n < CL_LEAVES_MAX ? every_n : CL_LEAVES_MAX;
+    cl->leaf = malloc(cl->cap_leaf * SHA256_LEN);
+    if (!cl->leaf)
+        return -ENOMEM;
+    return cl_segment(cl, path);
+}
+
+static inline void cl_close(struct chain_log *cl)
+{
+    cl_seal(cl);
+    free(cl->leaf);
+    cl->leaf = NULL;
+    cl->cap_leaf = 0;
+    pthread_mutex_destroy(&cl->lock);
+}
+
+#endif /* CHAIN_LOG_H */
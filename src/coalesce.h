@@ -0,0 +1,228 @@
+/*
+ * coalesce.h - alert coalescing for settimeofday storms.
+ *
+ * Events are keyed by (pid, state). The first event of a key is emitted
+ * right away; the ones after it are folded into a pending summary
+ * (count, min/max diff, first/last time) that is emitted once per
+ * interval. Every emitted line, first or summary, costs one token from
+ * a per-key bucket, so a key can never exceed `rate` lines/sec after
+ * its `burst` is spent; without a token the summary keeps growing.
+ *
+ * The table is split into shards, each behind its own mutex, so
+ * consumer threads only contend when they hit the same shard.
+ */
+#ifndef COALESCE_H
+#define COALESCE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define COALESCE_SHARDS     16
+#define COALESCE_SLOTS      256     /* per shard, power of two */
+#define COALESCE_COMM_LEN   16
+
+struct coalesce_entry {
+    uint32_t pid;
+    int      state;
+    int      used;
+    char     comm[COALESCE_COMM_LEN];
+
+    /* pending (not yet emitted) events */
+    uint64_t count;
+    long     min_diff;
+    long     max_diff;
+    int64_t  first_ns;
+    int64_t  last_ns;
+    uint64_t last_cnt;
+
+    int64_t  seen_ns;       /* last event of any kind, for expiry */
+    int64_t  emit_ns;       /* last emitted line */
+    double   tokens;
+    int64_t  refill_ns;
+};
+
+/*
+ * first != NULL: emit that event record as-is (first event of a key);
+ * first == NULL: emit a summary of the e->count folded events.
+ */
+typedef void (*coalesce_emit_fn)(const struct coalesce_entry *e,
+                                 const void *first);
+
+struct coalesce_shard {
+    pthread_mutex_t lock;
+    struct coalesce_entry slot[COALESCE_SLOTS];
+};
+
+struct coalescer {
+    int64_t interval_ns;    /* summary period; 0 = pass-through */
+    double  rate;           /* tokens per second per key */
+    double  burst;          /* bucket size */
+    coalesce_emit_fn emit;
+    uint64_t suppressed;    /* events folded into summaries, total */
+    struct coalesce_shard shard[COALESCE_SHARDS];
+};
+
+static inline void coalesce_init(struct coalescer *c, int64_t interval_ns,
+                                 double rate, double burst,
+                                 coalesce_emit_fn emit)
+{
+    memset(c, 0, sizeof(*c));
+    c->interval_ns = interval_ns;
+    c->rate = rate;
+    c->burst = burst < 1 ? 1 : burst;
+    c->emit = emit;
+    for (int i = 0; i < COALESCE_SHARDS; i++)
+        pthread_mutex_init(&c->shard[i].lock, NULL);
+}
+
+static inline uint32_t coalesce_hash(uint32_t pid, int state)
+{
+    uint32_t h = pid * 0x9e3779b1u ^ (uint32_t)state * 0x85ebca6bu;
+    return h ^ (h >> 15);
+}
+
+static inline int coalesce_take_token(struct coalescer *c,
+                                      struct coalesce_entry *e, int64_t now)
+{
+    e->tokens += (double)(now - e->refill_ns) * c->rate / 1e9;
+    if (e->tokens > c->burst)
+        e->tokens = c->burst;
+    e->refill_ns = now;
+
+    if (e->tokens < 1.0)
+        return 0;
+    e->tokens -= 1.0;
+    return 1;
+}
+
+/* shard lock held */
+static inline void coalesce_flush_entry(struct coalescer *c,
+                                        struct coalesce_entry *e, int64_t now,
+                                        int force)
+{
+    if (e->count == 0)
+        return;
+    if (!force && !coalesce_take_token(c, e, now))
+        return;
+
+    c->emit(e, NULL);
+    e->count = 0;
+    e->emit_ns = now;
+}
+
+/*
+ * Find the slot for (pid, state). When the probe run is full the oldest
+ * entry is flushed and recycled, so a pid storm cannot grow the table.
+ */
+static inline struct coalesce_entry *
+coalesce_slot(struct coalescer *c, struct coalesce_shard *sh,
+              uint32_t h, uint32_t pid, int state, int64_t now)
+{
+    struct coalesce_entry *free_slot = NULL, *victim = NULL;
+
+    /* slots are recycled in place, so scan the whole run for a match */
+    for (uint32_t i = 0; i < 8; i++) {
+        struct coalesce_entry *e = &sh->slot[(h + i) & (COALESCE_SLOTS - 1)];
+        if (!e->used) {
+            if (!free_slot)
+                free_slot = e;
+            continue;
+        }
+        if (e->pid == pid && e->state == state)
+            return e;
+        if (!victim || e->seen_ns < victim->seen_ns)
+            victim = e;
+    }
+    if (free_slot)
+        return free_slot;
+
+    coalesce_flush_entry(c, victim, now, 1);
+    victim->used = 0;
+    return victim;
+}
+
+static inline void coalesce_event(struct coalescer *c, uint32_t pid,
+                                  const char *comm, int state, long diff,
+                                  uint64_t cnt, int64_t now, const void *rec)
+{
+    if (c->interval_ns == 0) {
+        struct coalesce_entry tmp = { .pid = pid, .state = state,
+                                      .last_cnt = cnt, .last_ns = now };
+        memcpy(tmp.comm, comm, COALESCE_COMM_LEN);
+        c->emit(&tmp, rec);
+        return;
+    }
+
+    uint32_t h = coalesce_hash(pid, state);
+    struct coalesce_shard *sh = &c->shard[h % COALESCE_SHARDS];
+
+    pthread_mutex_lock(&sh->lock);
+
+    struct coalesce_entry *e = coalesce_slot(c, sh, h / COALESCE_SHARDS,
+                                             pid, state, now);
+    if (!e->used) {
+        memset(e, 0, sizeof(*e));
+        e->used = 1;
+        e->pid = pid;
+        e->state = state;
+        e->tokens = c->burst;
+        e->refill_ns = now;
+        e->emit_ns = now - c->interval_ns;   /* new key: emit right away */
+    }
+    memcpy(e->comm, comm, COALESCE_COMM_LEN);
+    e->seen_ns = now;
+
+    /* quiet key (nothing pending, last line older than interval): emit */
+    if (e->count == 0 && now - e->emit_ns >= c->interval_ns &&
+        coalesce_take_token(c, e, now)) {
+        e->last_cnt = cnt;
+        e->last_ns = now;
+        c->emit(e, rec);
+        e->emit_ns = now;
+        pthread_mutex_unlock(&sh->lock);
+        return;
+    }
+
+    if (e->count == 0) {
+        e->min_diff = e->max_diff = diff;
+        e->first_ns = now;
+    } else {
+        if (diff < e->min_diff) e->min_diff = diff;
+        if (diff > e->max_diff) e->max_diff = diff;
+    }
+    e->count++;
+    e->last_ns = now;
+    e->last_cnt = cnt;
+    __atomic_add_fetch(&c->suppressed, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&sh->lock);
+}
+
+/*
+ * Periodic driver: emit due summaries and forget idle keys. force=1
+ * (shutdown) emits every pending summary regardless of tokens.
+ */
+static inline void coalesce_tick(struct coalescer *c, int64_t now, int force)
+{
+    if (c->interval_ns == 0)
+        return;
+
+    for (int s = 0; s < COALESCE_SHARDS; s++) {
+        struct coalesce_shard *sh = &c->shard[s];
+
+        pthread_mutex_lock(&sh->lock);
+        for (int i = 0; i < COALESCE_SLOTS; i++) {
+            struct coalesce_entry *e = &sh->slot[i];
+            if (!e->used)
+                continue;
+            if (force || now - e->emit_ns >= c->interval_ns)
+                coalesce_flush_entry(c, e, now, force);
+            if (e->count == 0 && now - e->seen_ns >= 4 * c->interval_ns)
+                e->used = 0;
+        }
+        pthread_mutex_unlock(&sh->lock);
+    }
+}
+
+#endif /* COALESCE_H */
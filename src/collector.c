@@ -0,0 +1,699 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "alert_stream.h"
+#include "alert_fmt.h"
+
+/*
+ * Alert collector. Detectors on many devices stream their classified
+ * events here (perfbuffer_settimeofday -A, see alert_stream.h) over TCP
+ * or Unix sockets instead of each keeping a local log to be copied off.
+ *
+ * Records are merged per host and boot by boot time into segments,
+ * which are trace files (trace.h):
+ *
+ *   <dir>/<host>/<boot_id[0:8]>-<first_boot_ns>[.n].trace
+ *
+ * A segment is sealed (sorted, written to a temp file, synced, linked
+ * into place) when it holds -s KiB or is -t seconds old, when one of
+ * its agents disconnects or has sent half its spool size since the
+ * last seal, and at exit. Agents get their frames acked
+ * only then, so an ack means the records are on disk. Segments of one
+ * host load back together through trace_load(), which merges them by
+ * time; -d does that and prints the alerts.
+ *
+ *   collector -l addr [-l addr...] [-o dir] [-s seg_kb] [-t seg_sec]
+ *   collector -d [-J] segment...
+ *
+ * addr: "unix:/path", "host:port" or a port.
+ */
+
+#define MAX_LISTEN      8
+#define DEFAULT_SEG_KB  4096
+#define DEFAULT_SEG_SEC 10
+
+static volatile sig_atomic_t exiting;
+
+static void on_sig(int sig)
+{
+    (void)sig;
+    exiting = 1;
+}
+
+/* =========================================================
+ *  STATE
+ * ========================================================= */
+struct seg_item {
+    int64_t boot_ns;
+    uint32_t stream;
+    uint32_t idx;               /* arrival order: keeps a stream's order */
+    uint32_t off;
+    uint32_t len;
+};
+
+/* one (host, boot): an open segment */
+struct host {
+    char name[AS_HOST_LEN];
+    char boot_id[AS_BOOT_ID_LEN];
+    struct trace_hdr hdr;
+    char *buf;
+    size_t len, cap;
+    struct seg_item *item;
+    size_t n, item_cap;
+    int64_t opened_ns;          /* first record of the open segment */
+    uint64_t segments, records;
+};
+
+/* one agent spool, across its connections */
+struct stream {
+    uint64_t id;
+    uint32_t host;
+    uint64_t last_seq;
+    uint64_t spool_bytes;       /* the agent's */
+    uint64_t unsealed;          /* bytes taken since its host's last seal */
+    struct conn *conn;
+    uint64_t frames, records, dups, lost;
+};
+
+#define CONN_NEW     UINT32_MAX         /* no hello yet */
+#define CONN_ORPHAN  (UINT32_MAX - 1)   /* its stream moved on */
+
+struct conn {
+    int fd;
+    int listener;
+    uint32_t stream;            /* index, CONN_NEW or CONN_ORPHAN */
+    size_t rx_len;
+    char rx[sizeof(struct as_frame) + AS_FRAME_MAX];
+};
+
+static const char *out_dir = "segments";
+static size_t seg_bytes = (size_t)DEFAULT_SEG_KB * 1024;
+static int64_t seg_ns = DEFAULT_SEG_SEC * 1000000000LL;
+static int epfd = -1;
+
+static struct host *hosts;
+static uint32_t n_hosts;
+static struct stream *streams;
+static uint32_t n_streams;
+static uint64_t total_segments, total_records;
+
+/* host and boot id name directories and files: keep them to [A-Za-z0-9._-] */
+static void sanitize(char *s, size_t size)
+{
+    s[size - 1] = '\0';
+    for (char *p = s; *p; p++)
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+              (*p >= '0' && *p <= '9') || *p == '.' || *p == '-' || *p == '_'))
+            *p = '_';
+    if (!s[0] || strcmp(s, ".") == 0 || strcmp(s, "..") == 0)
+        snprintf(s, size, "_");
+}
+
+/*
+ * out_dir/<host> into dir, with room left for the longest name seal()
+ * puts in it ("/<boot_id:8>-<boot_ns:19>.<k>.trace"). A host whose
+ * segments would land on a truncated path is refused at hello.
+ */
+#define SEG_NAME_MAX 48
+
+static int host_dir(char *dir, size_t size, const char *name)
+{
+    int n = snprintf(dir, size, "%s/%s", out_dir, name);
+    return n < 0 || (size_t)n + SEG_NAME_MAX >= size ? -ENAMETOOLONG : n;
+}
+
+static int host_find(const struct as_hello *h)
+{
+    for (uint32_t i = 0; i < n_hosts; i++)
+        if (strcmp(hosts[i].name, h->host) == 0 &&
+            strcmp(hosts[i].boot_id, h->boot_id) == 0)
+            return (int)i;
+
+    struct host *nh = realloc(hosts, (n_hosts + 1) * sizeof(*nh));
+    if (!nh)
+        return -ENOMEM;
+    hosts = nh;
+
+    struct host *x = &hosts[n_hosts];
+    memset(x, 0, sizeof(*x));
+    memcpy(x->name, h->host, sizeof(x->name));
+    memcpy(x->boot_id, h->boot_id, sizeof(x->boot_id));
+    memcpy(x->hdr.magic, TRACE_MAGIC, sizeof(x->hdr.magic));
+    x->hdr.version = TRACE_VERSION;
+    x->hdr.source = h->source;
+    x->hdr.anchor_wall = h->anchor_wall;
+    x->hdr.anchor_boot_ns = h->anchor_boot_ns;
+    x->hdr.epsilon = h->epsilon;
+    x->hdr.event_size = sizeof(struct as_alert);
+
+    char dir[PATH_MAX];
+    int err = host_dir(dir, sizeof(dir), x->name);
+    if (err < 0)
+        return err;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return -errno;
+    return (int)n_hosts++;
+}
+
+static int stream_find(uint64_t id)
+{
+    for (uint32_t i = 0; i < n_streams; i++)
+        if (streams[i].id == id)
+            return (int)i;
+
+    struct stream *ns = realloc(streams, (n_streams + 1) * sizeof(*ns));
+    if (!ns)
+        return -ENOMEM;
+    streams = ns;
+    streams[n_streams] = (struct stream){ .id = id, .host = UINT32_MAX };
+    return (int)n_streams++;
+}
+
+/* =========================================================
+ *  SEGMENTS
+ * ========================================================= */
+static int item_cmp(const void *pa, const void *pb)
+{
+    const struct seg_item *a = pa, *b = pb;
+    if (a->boot_ns != b->boot_ns)
+        return a->boot_ns < b->boot_ns ? -1 : 1;
+    if (a->stream != b->stream)
+        return a->stream < b->stream ? -1 : 1;
+    return a->idx < b->idx ? -1 : a->idx > b->idx;
+}
+
+static void send_ack(struct stream *st)
+{
+    struct as_ack a = { .seq = st->last_seq };
+    /* cumulative: one lost to a full socket is covered by the next */
+    if (st->conn)
+        (void)!send(st->conn->fd, &a, sizeof(a), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static int write_all(int fd, const char *p, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* sort the open segment of h, put it on disk, ack its streams */
+static int seal(uint32_t hi)
+{
+    struct host *h = &hosts[hi];
+    char dir[PATH_MAX], tmp[PATH_MAX], path[PATH_MAX];
+    int err = 0;
+
+    if (!h->n)
+        return 0;
+    qsort(h->item, h->n, sizeof(*h->item), item_cmp);
+
+    size_t out_len = sizeof(h->hdr) + h->len;
+    if (host_dir(dir, sizeof(dir), h->name) < 0 ||
+        snprintf(tmp, sizeof(tmp), "%s/.segment.tmp", dir) >= (int)sizeof(tmp))
+        return -ENAMETOOLONG;
+    char *out = malloc(out_len);
+    if (!out)
+        return -ENOMEM;
+    memcpy(out, &h->hdr, sizeof(h->hdr));
+    char *p = out + sizeof(h->hdr);
+    for (size_t i = 0; i < h->n; i++) {
+        memcpy(p, h->buf + h->item[i].off, h->item[i].len);
+        p += h->item[i].len;
+    }
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        err = -errno;
+    } else {
+        err = write_all(fd, out, out_len);
+        if (!err && fdatasync(fd) < 0)
+            err = -errno;
+        close(fd);
+    }
+    free(out);
+
+    /* link, not rename: never replace a segment from an earlier run */
+    for (unsigned k = 0; !err; k++) {
+        int n = snprintf(path, sizeof(path), "%s/%.8s-%019lld", dir,
+                         h->boot_id, (long long)h->item[0].boot_ns);
+        if (k)
+            snprintf(path + n, sizeof(path) - n, ".%u", k);
+        strncat(path, ".trace", sizeof(path) - strlen(path) - 1);
+        if (link(tmp, path) == 0)
+            break;
+        if (errno != EEXIST)
+            err = -errno;
+    }
+    unlink(tmp);
+    if (!err) {
+        int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0) {
+            fsync(dfd);
+            close(dfd);
+        }
+    }
+
+    if (err) {
+        /* keep it in memory and unacked; the next seal retries */
+        printf("SEGMENT host=%s error=%d records=%zu\n", h->name, err, h->n);
+        return err;
+    }
+
+    printf("SEGMENT host=%s path=%s records=%zu bytes=%zu first_boot_ns=%lld "
+           "last_boot_ns=%lld\n", h->name, path, h->n, out_len,
+           (long long)h->item[0].boot_ns,
+           (long long)h->item[h->n - 1].boot_ns);
+    h->segments++;
+    h->records += h->n;
+    total_segments++;
+    total_records += h->n;
+    h->len = 0;
+    h->n = 0;
+
+    for (uint32_t s = 0; s < n_streams; s++) {
+        if (streams[s].host == hi) {
+            streams[s].unsealed = 0;
+            send_ack(&streams[s]);
+        }
+    }
+    return 0;
+}
+
+static void seal_due(void)
+{
+    int64_t now = as_now();
+    for (uint32_t i = 0; i < n_hosts; i++)
+        if (hosts[i].n && now - hosts[i].opened_ns >= seg_ns)
+            seal(i);
+}
+
+static int seg_append(struct host *h, uint32_t stream, const char *recs,
+                      uint32_t len, uint32_t n)
+{
+    if (h->len + len > h->cap) {
+        size_t cap = h->cap ? h->cap : 1 << 20;
+        while (cap < h->len + len)
+            cap *= 2;
+        char *b = realloc(h->buf, cap);
+        if (!b)
+            return -ENOMEM;
+        h->buf = b;
+        h->cap = cap;
+    }
+    if (h->n + n > h->item_cap) {
+        size_t cap = h->item_cap ? h->item_cap : 8192;
+        while (cap < h->n + n)
+            cap *= 2;
+        struct seg_item *it = realloc(h->item, cap * sizeof(*it));
+        if (!it)
+            return -ENOMEM;
+        h->item = it;
+        h->item_cap = cap;
+    }
+
+    if (!h->n)
+        h->opened_ns = as_now();
+    memcpy(h->buf + h->len, recs, len);
+    for (uint32_t off = 0; off < len; ) {
+        const struct trace_rec *r = (const void *)(recs + off);
+        h->item[h->n] = (struct seg_item){
+            .boot_ns = r->boot_ns, .stream = stream, .idx = (uint32_t)h->n,
+            .off = (uint32_t)(h->len + off), .len = r->len,
+        };
+        h->n++;
+        off += r->len;
+    }
+    h->len += len;
+    return 0;
+}
+
+/* =========================================================
+ *  CONNECTIONS
+ * ========================================================= */
+static void conn_close(struct conn *c, int err)
+{
+    if (c->stream < n_streams) {
+        struct stream *st = &streams[c->stream];
+        /* a draining agent waits for this ack before it exits */
+        if (st->host != UINT32_MAX)
+            seal(st->host);
+        printf("BYE host=%s stream=%016llx frames=%llu records=%llu dups=%llu "
+               "lost_frames=%llu error=%d\n",
+               st->host != UINT32_MAX ? hosts[st->host].name : "-",
+               (unsigned long long)st->id, (unsigned long long)st->frames,
+               (unsigned long long)st->records, (unsigned long long)st->dups,
+               (unsigned long long)st->lost, err);
+        st->conn = NULL;
+    }
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c);
+}
+
+static int on_hello(struct conn *c, struct as_hello *h)
+{
+    if (memcmp(h->magic, AS_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != AS_VERSION)
+        return -EPROTO;
+    sanitize(h->host, sizeof(h->host));
+    sanitize(h->boot_id, sizeof(h->boot_id));
+
+    int hi = host_find(h);
+    if (hi < 0)
+        return hi;
+    int si = stream_find(h->stream_id);
+    if (si < 0)
+        return si;
+
+    struct stream *st = &streams[si];
+    /*
+     * The agent reconnected before we saw the old connection die. It may
+     * still have an event pending in this batch: only shut it down here,
+     * its next read closes it.
+     */
+    if (st->conn) {
+        st->conn->stream = CONN_ORPHAN;
+        shutdown(st->conn->fd, SHUT_RDWR);
+    }
+    /* a spool kept across a reboot: acks must not cover the old segment */
+    if (st->host != UINT32_MAX && st->host != (uint32_t)hi)
+        seal(st->host);
+    st->host = (uint32_t)hi;
+    st->spool_bytes = h->spool_bytes;
+    st->conn = c;
+    c->stream = (uint32_t)si;
+
+    printf("HELLO host=%s boot_id=%s stream=%016llx after_seq=%llu\n",
+           h->host, h->boot_id, (unsigned long long)st->id,
+           (unsigned long long)st->last_seq);
+    return 0;
+}
+
+static int on_frame(struct conn *c, const struct as_frame *f, const char *recs)
+{
+    struct stream *st = &streams[c->stream];
+
+    /* every record must be whole before any is taken */
+    uint32_t n = 0;
+    for (uint32_t off = 0; off < f->len; n++) {
+        const struct trace_rec *r = (const void *)(recs + off);
+        if (f->len - off < sizeof(*r) || r->len < sizeof(*r) ||
+            (r->len & 7) || r->len > f->len - off)
+            return -EPROTO;
+        off += r->len;
+    }
+    if (n != f->n)
+        return -EPROTO;
+
+    if (f->seq <= st->last_seq) {
+        st->dups++;
+        return 0;
+    }
+    int err = seg_append(&hosts[st->host], c->stream, recs, f->len, f->n);
+    if (err)
+        return err;
+    /* a gap: the agent's spool dropped frames for room */
+    if (st->last_seq)
+        st->lost += f->seq - st->last_seq - 1;
+    st->last_seq = f->seq;
+    st->frames++;
+    st->records += f->n;
+    st->unsealed += sizeof(*f) + f->len;
+
+    /* past half its spool the agent would soon drop frames for want of acks */
+    if (hosts[st->host].len >= seg_bytes || st->unsealed >= st->spool_bytes / 2)
+        seal(st->host);
+    return 0;
+}
+
+/* 0: more later, 1: peer closed, <0: error */
+static int conn_read(struct conn *c)
+{
+    if (c->stream == CONN_ORPHAN)
+        return -ECONNRESET;
+    ssize_t n = read(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len);
+    if (n == 0)
+        return 1;
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR ? 0 : -errno;
+    c->rx_len += n;
+
+    size_t off = 0;
+    if (c->stream == CONN_NEW) {
+        struct as_hello h;
+        if (c->rx_len < sizeof(h))
+            return 0;
+        memcpy(&h, c->rx, sizeof(h));
+        int err = on_hello(c, &h);
+        if (err)
+            return err;
+        off = sizeof(h);
+    }
+
+    while (c->rx_len - off >= sizeof(struct as_frame)) {
+        struct as_frame f;
+        memcpy(&f, c->rx + off, sizeof(f));
+        if (f.len > AS_FRAME_MAX || f.n == 0 || f.seq == 0)
+            return -EPROTO;
+        if (c->rx_len - off - sizeof(f) < f.len)
+            break;
+        int err = on_frame(c, &f, c->rx + off + sizeof(f));
+        if (err)
+            return err;
+        off += sizeof(f) + f.len;
+    }
+    memmove(c->rx, c->rx + off, c->rx_len - off);
+    c->rx_len -= off;
+    return 0;
+}
+
+static int conn_add(int fd, int listener)
+{
+    struct conn *c = malloc(listener ? offsetof(struct conn, rx) : sizeof(*c));
+    if (!c)
+        return -ENOMEM;
+    c->fd = fd;
+    c->listener = listener;
+    c->stream = CONN_NEW;
+    c->rx_len = 0;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        int err = -errno;
+        free(c);
+        return err;
+    }
+    return 0;
+}
+
+static int listen_on(const char *addr)
+{
+    struct sockaddr_storage ss;
+    socklen_t len;
+    int family = as_addr_parse(addr, 1, &ss, &len);
+    if (family < 0)
+        return family;
+
+    int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -errno;
+    if (family == AF_UNIX) {
+        unlink(((struct sockaddr_un *)&ss)->sun_path);
+    } else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(fd, (struct sockaddr *)&ss, len) < 0 || listen(fd, 128) < 0) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+    int err = conn_add(fd, 1);
+    if (err) {
+        close(fd);
+        return err;
+    }
+    printf("LISTEN addr=%s\n", addr);
+    return 0;
+}
+
+static void on_accept(int lfd)
+{
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        if (conn_add(fd, 0) < 0)
+            close(fd);
+    }
+}
+
+/* =========================================================
+ *  DUMP (-d)
+ * ========================================================= */
+static int dump(char *const *paths, int n, enum af_style style)
+{
+    struct trace_set ts;
+    static char out[64 * 1024];
+    size_t len = 0;
+
+    int err = trace_load(&ts, paths, n);
+    if (err) {
+        fprintf(stderr, "load: %s\n", strerror(-err));
+        return err;
+    }
+
+    for (size_t i = 0; i < ts.n_items; i++) {
+        size_t plen;
+        const void *pl = trace_payload(ts.item[i].rec, &plen);
+        struct as_alert r = { 0 };
+        const struct as_alert *a = &r;
+        if (ts.item[i].rec->type != TRACE_ALERT || plen < AS_ALERT_SIZE_NOCG)
+            continue;
+        memcpy(&r, pl, plen < sizeof(r) ? plen : sizeof(r));
+
+        struct af_settime s = {
+            .cnt      = a->cnt,
+            .new_wall = a->new_wall,
+            .expected = a->expected,
+            .diff     = a->diff,
+            .state    = a->state < 3 ? as_state_str[a->state] : "UNKNOWN",
+            .tz       = a->tz,
+            .ktime_ns = a->ktime_ns,
+            .boot_ns  = a->recv_boot_ns,
+            .pid      = a->pid,
+            .comm     = a->comm,
+            .cgroup   = a->cgroup_id,
+        };
+        if (sizeof(out) - len < AF_LINE_MAX) {
+            fwrite(out, 1, len, stdout);
+            len = 0;
+        }
+        len = af_settime(out + len, &s, style) - out;
+    }
+    fwrite(out, 1, len, stdout);
+    trace_unload(&ts);
+    return 0;
+}
+
+/* =========================================================
+ *  MAIN
+ * ========================================================= */
+int main(int argc, char **argv)
+{
+    const char *listen_addr[MAX_LISTEN];
+    int n_listen = 0, dump_mode = 0, opt;
+    enum af_style style = AF_KV;
+
+    while ((opt = getopt(argc, argv, "l:o:s:t:dJ")) != -1) {
+        switch (opt) {
+        case 'l':
+            if (n_listen < MAX_LISTEN)
+                listen_addr[n_listen++] = optarg;
+            break;
+        case 'o':
+            out_dir = optarg;
+            break;
+        case 's':
+            seg_bytes = strtoull(optarg, NULL, 10) * 1024;
+            break;
+        case 't':
+            seg_ns = strtoll(optarg, NULL, 10) * 1000000000LL;
+            break;
+        case 'd':
+            dump_mode = 1;
+            break;
+        case 'J':
+            style = AF_JSON;
+            break;
+        default:
+            goto usage;
+        }
+    }
+
+    if (dump_mode) {
+        if (optind == argc)
+            goto usage;
+        return dump(argv + optind, argc - optind, style) ? 1 : 0;
+    }
+    if (!n_listen || optind != argc || !seg_bytes || seg_ns <= 0)
+        goto usage;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    signal(SIGINT, on_sig);
+    signal(SIGTERM, on_sig);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (mkdir(out_dir, 0755) < 0 && errno != EEXIST) {
+        perror(out_dir);
+        return 1;
+    }
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+    for (int i = 0; i < n_listen; i++) {
+        int err = listen_on(listen_addr[i]);
+        if (err) {
+            fprintf(stderr, "listen %s: %s\n", listen_addr[i], strerror(-err));
+            return 1;
+        }
+    }
+
+    struct epoll_event evs[64];
+    while (!exiting) {
+        int n = epoll_wait(epfd, evs, 64, 1000);
+        for (int i = 0; i < n; i++) {
+            struct conn *c = evs[i].data.ptr;
+            if (c->listener) {
+                on_accept(c->fd);
+                continue;
+            }
+            int rc = conn_read(c);
+            if (rc)
+                conn_close(c, rc < 0 ? rc : 0);
+        }
+        seal_due();
+    }
+
+    for (uint32_t i = 0; i < n_hosts; i++)
+        seal(i);
+    for (uint32_t s = 0; s < n_streams; s++)
+        if (streams[s].conn)
+            conn_close(streams[s].conn, 0);
+    printf("EXIT hosts=%u streams=%u segments=%llu records=%llu\n",
+           n_hosts, n_streams, (unsigned long long)total_segments,
+           (unsigned long long)total_records);
+    return 0;
+
+usage:
+    fprintf(stderr,
+            "usage: %s -l addr [-l addr...] [-o dir] [-s seg_kb] [-t seg_sec]\n"
+            "       %s -d [-J] segment...\n"
+            "addr: unix:/path, host:port or port\n", argv[0], argv[0]);
+    return 1;
+}
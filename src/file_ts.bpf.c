@@ -0,0 +1,191 @@
+// file_ts.bpf.c - utimensat() timestamp writes under watched subtrees
+#include <linux/bpf.h>
+#include <linux/types.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
+
+#define TASK_COMM_LEN 16
+#define PATH_KEY_MAX  256   /* power of two: used as an index mask */
+
+/* syscalls/sys_enter_utimensat: common(8) + nr(8) + 4 args */
+struct utimensat_args {
+    __u64 _pad;
+    long  __syscall_nr;
+    long  dfd;
+    const char *filename;
+    const void *utimes;     /* struct timespec[2], NULL = now */
+    long  flags;
+};
+
+/*
+ * .rodata: emit_unresolved=1 sends relative/fd-based/non-canonical paths
+ * to userspace, which resolves them against the watch list; 0 drops
+ * them here as well.
+ */
+const volatile int emit_unresolved = 1;
+
+enum match {
+    MATCH_PREFIX     = 1,   /* under a watched subtree (LPM hit) */
+    MATCH_UNRESOLVED = 2,   /* cannot be decided from the string */
+};
+
+struct ts64 {
+    __s64 sec;
+    __s64 nsec;
+};
+
+/* MUST match the loader */
+struct file_event {
+    __u64 boot_ns;
+    __u32 pid;
+    __u32 uid;
+    __s32 dfd;
+    __u32 flags;
+    __u32 match;            /* enum match */
+    __u32 subtree;          /* watched entry id (MATCH_PREFIX) */
+    struct ts64 times[2];   /* atime, mtime as passed; UTIME_NOW if NULL */
+    char  comm[TASK_COMM_LEN];
+    char  path[PATH_KEY_MAX];
+};
+
+/*
+ * Watched subtrees, keyed by path components: userspace stores the
+ * canonical directory with a trailing '/', and the lookup key is the
+ * syscall's path with '/' appended, so "/var/log/" matches "/var/log"
+ * and "/var/log/x" but never "/var/logs".
+ */
+struct path_key {
+    __u32 prefixlen;        /* bits */
+    char  path[PATH_KEY_MAX];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LPM_TRIE);
+    __uint(max_entries, 1024);
+    __uint(map_flags, BPF_F_NO_PREALLOC);
+    __type(key, struct path_key);
+    __type(value, __u32);
+} watched SEC(".maps");
+
+/* key + event are too big for the 512-byte stack */
+struct scratch {
+    struct path_key key;
+    struct file_event ev;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct scratch);
+} scratch SEC(".maps");
+
+enum stat_idx {
+    STAT_SEEN,
+    STAT_DROPPED,
+    STAT_MATCHED,
+    STAT_UNRESOLVED,
+    STAT_MAX,
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, STAT_MAX);
+    __type(key, __u32);
+    __type(value, __u64);
+} stats SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERF_EVENT_ARRAY);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, sizeof(__u32));
+    __uint(max_entries, 0);
+} file_events SEC(".maps");
+
+static __always_inline void stat_inc(__u32 idx)
+{
+    __u64 *v = bpf_map_lookup_elem(&stats, &idx);
+    if (v)
+        (*v)++;
+}
+
+/* "/./" or "/../" (or any dot-name) may alias a watched path: let userspace decide */
+static __always_inline int has_dot_component(const char *p)
+{
+    for (int i = 0; i < PATH_KEY_MAX - 1; i++) {
+        if (p[i] == '\0')
+            return 0;
+        if (p[i] == '/' && p[i + 1] == '.')
+            return 1;
+    }
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_enter_utimensat")
+int handle_utimensat(struct utimensat_args *ctx)
+{
+    __u32 zero = 0;
+    struct scratch *s = bpf_map_lookup_elem(&scratch, &zero);
+    if (!s)
+        return 0;
+
+    stat_inc(STAT_SEEN);
+
+    struct file_event *ev = &s->ev;
+    long n = 0;
+
+    s->key.path[0] = '\0';
+    if (ctx->filename)
+        n = bpf_probe_read_user_str(s->key.path, sizeof(s->key.path),
+                                    ctx->filename);
+
+    ev->match = MATCH_UNRESOLVED;
+    ev->subtree = 0;
+
+    if (n > 1 && s->key.path[0] == '/' && !has_dot_component(s->key.path)) {
+        /* n counts the NUL: put the '/' there (a full buffer keeps n-1) */
+        if (n < PATH_KEY_MAX) {
+            s->key.path[(n - 1) & (PATH_KEY_MAX - 1)] = '/';
+            s->key.prefixlen = n * 8;
+        } else {
+            s->key.prefixlen = (PATH_KEY_MAX - 1) * 8;
+        }
+
+        __u32 *id = bpf_map_lookup_elem(&watched, &s->key);
+        if (!id) {
+            stat_inc(STAT_DROPPED);
+            return 0;
+        }
+        ev->match = MATCH_PREFIX;
+        ev->subtree = *id;
+        if (n < PATH_KEY_MAX)
+            s->key.path[(n - 1) & (PATH_KEY_MAX - 1)] = '\0';
+    } else if (!emit_unresolved) {
+        stat_inc(STAT_DROPPED);
+        return 0;
+    }
+
+    stat_inc(ev->match == MATCH_PREFIX ? STAT_MATCHED : STAT_UNRESOLVED);
+
+    ev->boot_ns = bpf_ktime_get_boot_ns();
+    ev->pid = bpf_get_current_pid_tgid() >> 32;
+    ev->uid = (__u32)bpf_get_current_uid_gid();
+    ev->dfd = (__s32)ctx->dfd;
+    ev->flags = (__u32)ctx->flags;
+    bpf_get_current_comm(ev->comm, sizeof(ev->comm));
+    bpf_probe_read_kernel(ev->path, sizeof(ev->path), s->key.path);
+
+    if (!ctx->utimes) {
+        ev->times[0].sec = ev->times[1].sec = 0;
+        ev->times[0].nsec = ev->times[1].nsec = (1L << 30) - 1;   /* UTIME_NOW */
+    } else if (bpf_probe_read_user(ev->times, sizeof(ev->times),
+                                   ctx->utimes) != 0) {
+        ev->times[0].sec = ev->times[1].sec = -1;                 /* unreadable */
+        ev->times[0].nsec = ev->times[1].nsec = -1;
+    }
+
+    bpf_perf_event_output(ctx, &file_events, BPF_F_CURRENT_CPU, ev, sizeof(*ev));
+    return 0;
+}
@@ -0,0 +1,461 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#include "file_ts.skel.h"
+#include "bpf_stats.h"
+
+/*
+ * utimensat() watcher for selected subtrees.
+ *
+ *   file_ts [-w dir]... [-s] [-e epsilon] [-o alert_log] [-X stats_sec]
+ *
+ * Each -w directory goes into the `watched` LPM trie, so timestamp writes
+ * elsewhere are dropped in the kernel and never reach the perf buffer.
+ * Paths the kernel side cannot decide from the string alone (relative,
+ * fd-based, "." components) are sent up marked unresolved and matched
+ * here after resolving them through /proc; -s drops them in the kernel
+ * instead. -X logs what the program costs per utimensat (bpf_stats.h).
+ */
+
+#define MAX_WATCH      1024     /* = watched max_entries */
+#define PATH_KEY_MAX   256
+#define TASK_COMM_LEN  16
+#define UTIME_NOW_NS   ((1L << 30) - 1)
+#define UTIME_OMIT_NS  ((1L << 30) - 2)
+
+static volatile sig_atomic_t exiting = 0;
+static int alert_fd = -1;
+static long epsilon_sec = 60;
+
+/* ===== MUST match BPF side ===== */
+enum match {
+    MATCH_PREFIX     = 1,
+    MATCH_UNRESOLVED = 2,
+};
+
+struct ts64 {
+    __s64 sec;
+    __s64 nsec;
+};
+
+struct file_event {
+    __u64 boot_ns;
+    __u32 pid;
+    __u32 uid;
+    __s32 dfd;
+    __u32 flags;
+    __u32 match;
+    __u32 subtree;
+    struct ts64 times[2];
+    char  comm[TASK_COMM_LEN];
+    char  path[PATH_KEY_MAX];
+};
+
+struct path_key {
+    __u32 prefixlen;
+    char  path[PATH_KEY_MAX];
+};
+
+enum stat_idx {
+    STAT_SEEN,
+    STAT_DROPPED,
+    STAT_MATCHED,
+    STAT_UNRESOLVED,
+    STAT_MAX,
+};
+
+/* ===== watched subtrees (canonical, with trailing '/') ===== */
+static char *watch[MAX_WATCH];
+static size_t watch_len[MAX_WATCH];
+static int n_watch;
+static unsigned long long user_dropped;
+
+/* ===== signal / libbpf log ===== */
+static void on_sig(int sig)
+{
+    (void)sig;
+    exiting = 1;
+}
+
+static int libbpf_print_fn(enum libbpf_print_level level,
+                           const char *fmt, va_list ap)
+{
+    (void)level;
+    return vfprintf(stderr, fmt, ap);
+}
+
+/* ===== logging ===== */
+static void log_alert(const char *fmt, ...)
+{
+    if (alert_fd < 0)
+        return;
+
+    char buf[1024];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (len > 0)
+        write(alert_fd, buf, len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1);
+}
+
+/* ===== trusted timeline (same rules as inotify.c) ===== */
+static time_t wall_anchor;
+static struct timespec boot_anchor;
+
+static void init_anchor(void)
+{
+    wall_anchor = time(NULL);
+    clock_gettime(CLOCK_BOOTTIME, &boot_anchor);
+}
+
+/* at the event's own boot time, not at receive time */
+static time_t expected_wall_at(__u64 boot_ns)
+{
+    return wall_anchor + ((__s64)(boot_ns / 1000000000ULL) - boot_anchor.tv_sec);
+}
+
+static const char *time_state(__s64 t, time_t expected)
+{
+    if (t - expected > epsilon_sec)
+        return "FUTURE";
+    if (t - expected < -epsilon_sec)
+        return "PAST";
+    return "CURRENT";
+}
+
+/* ===== watch list ===== */
+static int watch_add(int map_fd, const char *dir)
+{
+    char real[PATH_MAX];
+    struct path_key key;
+
+    if (n_watch == MAX_WATCH)
+        return -E2BIG;
+    if (!realpath(dir, real))
+        return -errno;
+
+    size_t len = strlen(real);
+    if (len > 1)
+        real[len++] = '/';      /* "/" stays "/" */
+    real[len] = '\0';
+    if (len >= PATH_KEY_MAX)
+        return -ENAMETOOLONG;
+
+    memset(&key, 0, sizeof(key));
+    key.prefixlen = len * 8;
+    memcpy(key.path, real, len);
+
+    __u32 id = n_watch;
+    if (bpf_map_update_elem(map_fd, &key, &id, BPF_ANY) != 0)
+        return -errno;
+
+    watch[n_watch] = strdup(real);
+    watch_len[n_watch] = len;
+    n_watch++;
+    return 0;
+}
+
+/* longest watched prefix of a canonical path + '/', or -1 */
+static int watch_match(const char *path)
+{
+    char buf[PATH_MAX + 1];
+    int best = -1;
+
+    snprintf(buf, sizeof(buf), "%s/", path);
+    for (int i = 0; i < n_watch; i++)
+        if (strncmp(buf, watch[i], watch_len[i]) == 0 &&
+            (best < 0 || watch_len[i] > watch_len[best]))
+            best = i;
+    return best;
+}
+
+/*
+ * Rebuild what the caller meant: base is its cwd (AT_FDCWD) or the dfd,
+ * both read from /proc while the task is (usually) still there.
+ */
+static int resolve_path(const struct file_event *e, char *out, size_t sz)
+{
+    char link[64], base[PATH_MAX], joined[PATH_MAX * 2];
+    ssize_t n;
+
+    if (e->path[0] == '/') {
+        snprintf(joined, sizeof(joined), "%.*s", PATH_KEY_MAX, e->path);
+    } else {
+        if (e->dfd == AT_FDCWD)
+            snprintf(link, sizeof(link), "/proc/%u/cwd", e->pid);
+        else
+            snprintf(link, sizeof(link), "/proc/%u/fd/%d", e->pid, e->dfd);
+        n = readlink(link, base, sizeof(base) - 1);
+        if (n < 0)
+            return -errno;
+        base[n] = '\0';
+
+        if (e->path[0] == '\0')     /* futimens(fd): the fd itself */
+            snprintf(joined, sizeof(joined), "%s", base);
+        else
+            snprintf(joined, sizeof(joined), "%s/%.*s", base,
+                     PATH_KEY_MAX, e->path);
+    }
+
+    if (!realpath(joined, out)) {
+        /* gone already: judge the lexical path */
+        snprintf(out, sz, "%s", joined);
+    }
+    return 0;
+}
+
+static void fmt_time(char *buf, size_t sz, const struct ts64 *t)
+{
+    if (t->nsec == UTIME_NOW_NS)
+        snprintf(buf, sz, "now");
+    else if (t->nsec == UTIME_OMIT_NS)
+        snprintf(buf, sz, "omit");
+    else if (t->sec == -1 && t->nsec == -1)
+        snprintf(buf, sz, "unreadable");
+    else
+        snprintf(buf, sz, "%lld", (long long)t->sec);
+}
+
+/* ===== perf callbacks ===== */
+static void handle_event(void *ctx, int cpu, void *data, unsigned int size)
+{
+    (void)ctx;
+    (void)cpu;
+
+    if (size < sizeof(struct file_event))
+        return;
+
+    const struct file_event *e = data;
+    char path[PATH_MAX];
+    int id = e->subtree;
+
+    if (e->match == MATCH_PREFIX) {
+        snprintf(path, sizeof(path), "%.*s", PATH_KEY_MAX, e->path);
+    } else {
+        if (resolve_path(e, path, sizeof(path)) != 0 ||
+            (id = watch_match(path)) < 0) {
+            user_dropped++;
+            return;
+        }
+    }
+
+    char at[24], mt[24];
+    fmt_time(at, sizeof(at), &e->times[0]);
+    fmt_time(mt, sizeof(mt), &e->times[1]);
+
+    time_t expected = expected_wall_at(e->boot_ns);
+    const char *mstate = (e->times[1].nsec == UTIME_NOW_NS ||
+                          e->times[1].nsec == UTIME_OMIT_NS ||
+                          e->times[1].sec == -1) ?
+                         "-" : time_state(e->times[1].sec, expected);
+
+    log_alert(
+        "UTIMENSAT path=%s atime=%s mtime=%s mtime_state=%s expected=%ld subtree=%s match=%s flags=%#x boot_ns=%llu pid=%u uid=%u comm=%.16s\n",
+        path, at, mt, mstate, (long)expected,
+        id >= 0 && id < n_watch ? watch[id] : "?",
+        e->match == MATCH_PREFIX ? "kernel" : "user",
+        e->flags,
+        (unsigned long long)e->boot_ns,
+        e->pid, e->uid, e->comm
+    );
+}
+
+static void handle_lost(void *ctx, int cpu, __u64 lost_cnt)
+{
+    (void)ctx;
+    log_alert("LOST_EVENTS cpu=%d lost=%llu\n",
+              cpu, (unsigned long long)lost_cnt);
+}
+
+/* ===== kernel-side filter counters (per-CPU) ===== */
+static void log_filter_stats(int fd)
+{
+    int ncpu = libbpf_num_possible_cpus();
+    unsigned long long sum[STAT_MAX] = {0};
+
+    if (ncpu <= 0)
+        return;
+    __u64 *vals = calloc(ncpu, sizeof(*vals));
+    if (!vals)
+        return;
+
+    for (__u32 k = 0; k < STAT_MAX; k++) {
+        if (bpf_map_lookup_elem(fd, &k, vals) != 0)
+            continue;
+        for (int c = 0; c < ncpu; c++)
+            sum[k] += vals[c];
+    }
+    free(vals);
+
+    log_alert("FILTER seen=%llu kernel_dropped=%llu matched=%llu unresolved=%llu user_dropped=%llu watched=%d\n",
+              sum[STAT_SEEN], sum[STAT_DROPPED], sum[STAT_MATCHED],
+              sum[STAT_UNRESOLVED], user_dropped, n_watch);
+}
+
+/* ===== BPF run-time stats (-X) ===== */
+static void log_bpf_stats(struct bpf_stats *bs)
+{
+    for (int i = 0; i < bs->n; i++) {
+        struct bs_sample s;
+        if (bs_sample(bs, i, &s) != 0)
+            continue;
+        log_alert("BPF_STATS prog=%s id=%u attach=%s runs=%llu avg_ns=%.1f runs_per_sec=%.1f total_runs=%llu total_ns=%llu\n",
+                  s.p->name, s.p->id, s.p->attach, (unsigned long long)s.runs,
+                  s.avg_ns, s.per_sec, (unsigned long long)s.total_runs,
+                  (unsigned long long)s.total_ns);
+    }
+}
+
+/* ===== main ===== */
+int main(int argc, char **argv)
+{
+    struct rlimit rlim = { RLIM_INFINITY, RLIM_INFINITY };
+    struct file_ts_bpf *skel = NULL;
+    struct perf_buffer *pb = NULL;
+    const char *alert_path = "/data/local/tmp/file_alerts.log";
+    const char *dirs[MAX_WATCH];
+    int n_dirs = 0, strict = 0;
+    long stats_sec = 0;
+    struct bpf_stats bstats;
+    int err, opt;
+
+    while ((opt = getopt(argc, argv, "w:se:o:X:")) != -1) {
+        switch (opt) {
+        case 'w':
+            if (n_dirs == MAX_WATCH) {
+                fprintf(stderr, "at most %d -w\n", MAX_WATCH);
+                return 1;
+            }
+            dirs[n_dirs++] = optarg;
+            break;
+        case 's':   /* drop unresolved paths in the kernel too */
+            strict = 1;
+            break;
+        case 'e':
+            epsilon_sec = strtol(optarg, NULL, 10);
+            break;
+        case 'o':
+            alert_path = optarg;
+            break;
+        case 'X':   /* BPF run-time stats every this many seconds */
+            stats_sec = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s -w dir [-w dir]... [-s] [-e epsilon_sec] [-o alert_log]\n"
+                    "          [-X stats_sec]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (n_dirs == 0) {
+        fprintf(stderr, "no -w subtree given\n");
+        return 1;
+    }
+
+    alert_fd = open(alert_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (alert_fd < 0) {
+        perror("open log");
+        return 1;
+    }
+
+    setrlimit(RLIMIT_MEMLOCK, &rlim);
+    libbpf_set_print(libbpf_print_fn);
+
+    signal(SIGINT, on_sig);
+    signal(SIGTERM, on_sig);
+
+    init_anchor();
+    bs_open(&bstats, 0);
+
+    skel = file_ts_bpf__open();
+    if (!skel) {
+        err = -errno;
+        goto out;
+    }
+    skel->rodata->emit_unresolved = !strict;
+
+    err = file_ts_bpf__load(skel);
+    if (err)
+        goto out;
+
+    /* fill the trie before attaching: no window where everything drops */
+    for (int i = 0; i < n_dirs; i++) {
+        err = watch_add(bpf_map__fd(skel->maps.watched), dirs[i]);
+        if (err) {
+            fprintf(stderr, "watch %s: %s\n", dirs[i], strerror(-err));
+            goto out;
+        }
+        log_alert("WATCH id=%d subtree=%s\n", i, watch[i]);
+    }
+
+    err = file_ts_bpf__attach(skel);
+    if (err)
+        goto out;
+
+    if (stats_sec > 0) {
+        struct bpf_program *prog = skel->progs.handle_utimensat;
+        err = bs_open(&bstats, stats_sec * 1000);
+        if (!err)
+            err = bs_add(&bstats, dup(bpf_program__fd(prog)),
+                         bpf_program__name(prog), "syscall");
+        if (err)
+            log_alert("BPF_STATS error=%d\n", err);
+    }
+
+    struct perf_buffer_opts pb_opts;
+    memset(&pb_opts, 0, sizeof(pb_opts));
+    pb_opts.sz = sizeof(pb_opts);
+
+    pb = perf_buffer__new(bpf_map__fd(skel->maps.file_events), 64,
+                          handle_event, handle_lost, NULL, &pb_opts);
+    err = libbpf_get_error(pb);
+    if (err) {
+        pb = NULL;
+        goto out;
+    }
+
+    log_alert("INIT trusted_wall=%ld trusted_boot=%ld strict=%d\n",
+              (long)wall_anchor, (long)boot_anchor.tv_sec, strict);
+
+    while (!exiting) {
+        err = perf_buffer__poll(pb, 100);
+        if (err < 0 && err != -EINTR) {
+            log_alert("poll error=%d\n", err);
+            break;
+        }
+        if (bs_due(&bstats))
+            log_bpf_stats(&bstats);
+    }
+    err = 0;
+    log_filter_stats(bpf_map__fd(skel->maps.stats));
+    log_bpf_stats(&bstats);
+
+out:
+    if (pb)
+        perf_buffer__free(pb);
+    bs_close(&bstats);
+    file_ts_bpf__destroy(skel);
+    for (int i = 0; i < n_watch; i++)
+        free(watch[i]);
+    if (alert_fd >= 0)
+        close(alert_fd);
+
+    return err ? 1 : 0;
+}
@@ -9,10 +9,14 @@
 // 라이선스 명시
 char LICENSE[] SEC("license") = "Dual BSD/GPL";
 
-// 시스템 콜 번호 (x86_64 기준)
-#define __NR_settimeofday 170
 #define SETTIMEOFDAY_IDX 0
 
+// 로더가 load 전에 채우는 .rodata 튜너블 (load 후에는 상수로 취급되어
+// verifier가 죽은 분기를 제거합니다)
+// - target_nr  : 감시할 syscall 번호 (기본값은 arm64 settimeofday 170,
+//                x86_64는 164, 로더가 __NR_settimeofday로 덮어씀)
+const volatile long target_nr = 170;
+
 // TASK_COMM_LEN 정의
 #define TASK_COMM_LEN 16
 
@@ -30,6 +34,13 @@ struct last_args_val {
     long tz_minuteswest;    // struct timezone*의 tz_minuteswest
 };
 
+// anchor 맵의 값 구조체 (bpf_pin.h와 동일해야 합니다)
+struct anchor_val {
+    __s64 trusted_wall;
+    __s64 trusted_boot_ns;
+    __u64 seen_cnt;
+};
+
 // ----------------------------------------------------
 // BPF 맵 정의 (.maps 섹션)
 // ----------------------------------------------------
@@ -50,6 +61,16 @@ struct {
     __type(value, struct last_args_val);
 } last_args SEC(".maps"); 
 
+// 3. 신뢰 기준점 저장 맵 (userspace 전용)
+// 맵을 bpffs에 pin 하면 데몬 재시작 후에도 trusted timeline과
+// 마지막으로 처리한 카운트를 이어받을 수 있습니다.
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, int);
+    __type(value, struct anchor_val);
+} anchor SEC(".maps");
+
 // ----------------------------------------------------
 // BPF 프로그램 정의 (tracepoint 섹션)
 // ----------------------------------------------------
@@ -57,7 +78,7 @@ struct {
 SEC("tracepoint/raw_syscalls/sys_enter")
 int handle_sys_enter(struct sys_enter_args *ctx)
 {
-    if (ctx->id != __NR_settimeofday) {
+    if (ctx->id != target_nr) {
         return 0;
     }
 
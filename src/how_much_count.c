@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 
 #if __has_include(<bpf/libbpf.h>)
@@ -22,14 +23,18 @@
   #include <bpf.h>
 #endif
 
+#include "how_much_count.skel.h"
+#include "bpf_pin.h"
+#include "startup_time.h"
+
 #define SETTIMEOFDAY_IDX 0
-#define EPSILON_SEC 60   /* ±1 minute tolerance */
 
 /* =========================================================
  *  GLOBALS
  * ========================================================= */
 static volatile sig_atomic_t exiting = 0;
 static int alert_fd = -1;
+static long epsilon_sec = 60;   /* ±1 minute tolerance */
 
 static void on_sig(int s) { (void)s; exiting = 1; }
 
@@ -66,6 +71,34 @@ static time_t expected_wall_from_trusted(struct timespec now_boot)
     return trusted_wall + delta;
 }
 
+/* the anchor map outlives the process when pinned (-p) */
+static void anchor_store(int fd, __u64 seen_cnt)
+{
+    struct anchor_val v = {
+        .trusted_wall = trusted_wall,
+        .trusted_boot_ns = (__s64)trusted_boot.tv_sec * 1000000000LL +
+                           trusted_boot.tv_nsec,
+        .seen_cnt = seen_cnt,
+    };
+    int key = 0;
+    (void)bpf_map_update_elem(fd, &key, &v, BPF_ANY);
+}
+
+static int anchor_restore(int fd, __u64 *seen_cnt)
+{
+    struct anchor_val v = {0};
+    int key = 0;
+
+    if (bpf_map_lookup_elem(fd, &key, &v) != 0 || v.trusted_boot_ns == 0)
+        return 0;
+
+    trusted_wall = (time_t)v.trusted_wall;
+    trusted_boot.tv_sec  = v.trusted_boot_ns / 1000000000LL;
+    trusted_boot.tv_nsec = v.trusted_boot_ns % 1000000000LL;
+    *seen_cnt = v.seen_cnt;
+    return 1;
+}
+
 static const char *classify(time_t new_wall,
                             time_t expected,
                             time_t *out_diff)
@@ -73,8 +106,8 @@ static const char *classify(time_t new_wall,
     time_t diff = new_wall - expected;
     if (out_diff) *out_diff = diff;
 
-    if (diff > EPSILON_SEC)  return "FUTURE";
-    if (diff < -EPSILON_SEC) return "PAST";
+    if (diff > epsilon_sec)  return "FUTURE";
+    if (diff < -epsilon_sec) return "PAST";
     return "CURRENT";
 }
 
@@ -101,19 +134,54 @@ static void log_alert(const char *fmt, ...)
  * ========================================================= */
 int main(int argc, char **argv)
 {
-    const char *obj_path = (argc > 1) ? argv[1] : "probe.bpf.o";
-
+    long long main_ns = boot_ns();
     struct rlimit r = { RLIM_INFINITY, RLIM_INFINITY };
-    struct bpf_object *obj = NULL;
-    struct bpf_program *prog = NULL;
-    struct bpf_link *link = NULL;
+    struct how_much_count_bpf *skel = NULL;
 
     int fd_cnt = -1;
     int fd_args = -1;
+    int fd_anchor = -1;
+    const struct pin_map pins[] = {
+        { "syscall_cnt", &fd_cnt, 0 },
+        { "last_args",   &fd_args, 0 },
+        { "anchor",      &fd_anchor, 0 },
+    };
 
     __u64 prev_cnt = 0;
     int key = SETTIMEOFDAY_IDX;
     int err = 0;
+    int opt;
+    int pin = 0, unpin = 0, reused = 0;
+    char pin_dir[PATH_MAX];
+
+    while ((opt = getopt(argc, argv, "e:pU")) != -1) {
+        switch (opt) {
+        case 'e': {
+            char *end;
+            epsilon_sec = strtol(optarg, &end, 10);
+            if (end == optarg || *end || epsilon_sec <= 0) {
+                fprintf(stderr, "-e must be a positive number of seconds\n");
+                return 1;
+            }
+            break;
+        }
+        case 'p':   /* keep maps + link in bpffs across restarts */
+            pin = 1;
+            break;
+        case 'U':   /* drop the pins (detaches) and exit */
+            unpin = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-e epsilon_sec] [-p | -U]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (unpin) {
+        snprintf(pin_dir, sizeof(pin_dir), "%s/how_much_count", PIN_ROOT);
+        pin_remove(pin_dir);
+        return 0;
+    }
 
     /* open alert log */
     alert_fd = open("/data/local/tmp/settime_alerts.log",
@@ -130,40 +198,63 @@ int main(int argc, char **argv)
 
     init_trusted();
 
-    obj = bpf_object__open_file(obj_path, NULL);
-    if (libbpf_get_error(obj)) {
-        err = -errno;
-        goto out;
+    if (pin) {
+        err = pin_prepare_dir(pin_dir, sizeof(pin_dir), "how_much_count");
+        if (err)
+            goto out;
+
+        reused = pin_reuse(pin_dir, sizeof(pin_dir), "how_much_count",
+                           pins, sizeof(pins) / sizeof(pins[0]));
     }
 
-    err = bpf_object__load(obj);
-    if (err)
-        goto out;
+    if (!reused) {
+        /* object is embedded in the binary via the generated skeleton */
+        skel = how_much_count_bpf__open();
+        if (!skel) {
+            err = -errno;
+            goto out;
+        }
 
-    prog = bpf_object__find_program_by_name(obj, "handle_sys_enter");
-    if (!prog) {
-        err = 1;
-        goto out;
-    }
+        skel->rodata->target_nr = __NR_settimeofday;
 
-    link = bpf_program__attach_tracepoint(
-        prog, "raw_syscalls", "sys_enter");
-    if (libbpf_get_error(link)) {
-        err = -errno;
-        link = NULL;
-        goto out;
-    }
+        if (pin) {
+            err = pin_set_map_paths(skel->obj, pin_dir);
+            if (err)
+                goto out;
+        }
 
-    fd_cnt  = bpf_object__find_map_fd_by_name(obj, "syscall_cnt");
-    fd_args = bpf_object__find_map_fd_by_name(obj, "last_args");
-    if (fd_cnt < 0 || fd_args < 0) {
-        err = 1;
-        goto out;
+        err = how_much_count_bpf__load(skel);
+        if (err)
+            goto out;
+
+        err = how_much_count_bpf__attach(skel);
+        if (err)
+            goto out;
+
+        if (pin) {
+            err = pin_link(skel->links.handle_sys_enter, pin_dir);
+            if (err)
+                goto out;
+        }
+
+        fd_cnt    = bpf_map__fd(skel->maps.syscall_cnt);
+        fd_args   = bpf_map__fd(skel->maps.last_args);
+        fd_anchor = bpf_map__fd(skel->maps.anchor);
     }
 
+    /* resume the timeline: time(NULL) may have been tampered while down */
+    int resumed = anchor_restore(fd_anchor, &prev_cnt);
+
+    long long attached_ns = boot_ns();
+    long long exec_ns = exec_boot_ns();
+
     log_alert("INIT trusted_wall=%ld trusted_boot=%ld\n",
               (long)trusted_wall,
               (long)trusted_boot.tv_sec);
+    log_alert("STARTUP exec_to_attach_us=%lld main_to_attach_us=%lld reused=%d resumed=%d seen_cnt=%llu\n",
+              exec_ns < 0 ? -1LL : (attached_ns - exec_ns) / 1000,
+              (attached_ns - main_ns) / 1000,
+              reused, resumed, (unsigned long long)prev_cnt);
 
     while (!exiting) {
         __u64 cnt = 0;
@@ -186,26 +277,30 @@ int main(int argc, char **argv)
             const char *cls = classify(new_wall, expected, &diff);
 
             log_alert(
-                "SETTIMEOFDAY cnt=%llu new=%ld expected=%ld diff=%ld state=%s tz=%ld\n",
+                "SETTIMEOFDAY cnt=%llu missed=%llu new=%ld expected=%ld diff=%ld state=%s tz=%ld boot_ns=%lld\n",
                 (unsigned long long)cnt,
+                (unsigned long long)(cnt > prev_cnt ? cnt - prev_cnt - 1 : 0),
                 (long)new_wall,
                 (long)expected,
                 (long)diff,
                 cls,
-                (long)a.tz_minuteswest
+                (long)a.tz_minuteswest,
+                (long long)now_boot.tv_sec * 1000000000LL + now_boot.tv_nsec
             );
 
             trusted_wall = expected;
             trusted_boot = now_boot;
             prev_cnt = cnt;
+            anchor_store(fd_anchor, prev_cnt);
         }
 
         usleep(150000);
     }
 
 out:
-    if (link) bpf_link__destroy(link);
-    if (obj)  bpf_object__close(obj);
+    if (reused)
+        pin_close_maps(pins, sizeof(pins) / sizeof(pins[0]));
+    how_much_count_bpf__destroy(skel);
     if (alert_fd >= 0) close(alert_fd);
     return err ? 1 : 0;
 }
@@ -11,10 +11,21 @@
 #include <errno.h>
 #include <libgen.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <stdarg.h>
+
+#include "ts_config.h"
+#include "watch_table.h"
+#include "timer_wheel.h"
+#include "chain_log.h"
 
 #define EVENT_SIZE (sizeof(struct inotify_event))
 #define BUF_LEN    (2048 * (EVENT_SIZE + NAME_MAX))
-#define EPSILON    60   /* ±1 minute */
+#define EPSILON    60   /* ±1 minute, default; -e / config epsilon */
+#define DEBOUNCE_MS 50  /* -d; 0 = stat on every event */
 /*
 
 m_time, a_time 변경 + write으로 기록
@@ -23,6 +34,11 @@ m_time, a_time 변경 + write으로 기록
  *  ALERT LOG FD
  * ========================================================= */
 static int alert_fd = -1;
+static char alert_path[PATH_MAX] = "/data/local/tmp/alerts.log";
+static struct chain_log chain;      /* chain_log.h: hash-chained batches */
+static long chain_records = CL_RECORDS;    /* -m, 0 = plain log */
+static long chain_sec = CL_SECONDS;        /* -M */
+static long epsilon_sec = EPSILON;
 
 /* =========================================================
  *  BOOTTIME anchor
@@ -58,9 +74,9 @@ check_file_time(time_t file_time)
     time_t expected = expected_wall_time();
     time_t diff = file_time - expected;
 
-    if (diff > EPSILON)
+    if (diff > epsilon_sec)
         return FILE_FUTURE;
-    if (diff < -EPSILON)
+    if (diff < -epsilon_sec)
         return FILE_PAST;
     return FILE_NORMAL;
 }
@@ -76,158 +92,567 @@ static const char *file_state_str(enum file_time_state s)
 
 /* =========================================================
  *  LOG HELPER
+ *
+ *  Lines collect in one batch per loop iteration, which goes out
+ *  with its #CHAIN commit in one write (chain_log.h).
  * ========================================================= */
+#define ALERT_BATCH (16 * 1024)
+#define ALERT_LINE  512
+
+static char alert_batch[ALERT_BATCH];
+static size_t alert_len;
+
+static void alert_flush(void)
+{
+    cl_write(&chain, alert_batch, alert_len);
+    alert_len = 0;
+}
+
 static void log_alert(const char *fmt, ...)
 {
     if (alert_fd < 0)
         return;
+    if (ALERT_BATCH - alert_len < ALERT_LINE)
+        alert_flush();
 
-    char buf[512];
+    char *buf = alert_batch + alert_len;
     va_list ap;
     va_start(ap, fmt);
-    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    int len = vsnprintf(buf, ALERT_LINE, fmt, ap);
     va_end(ap);
 
+    if (len >= ALERT_LINE) {    /* cut, but keep it a line */
+        len = ALERT_LINE - 1;
+        buf[len - 1] = '\n';
+    }
     if (len > 0)
-        write(alert_fd, buf, len);
+        alert_len += len;
 }
 
 /* =========================================================
- *  MAIN
+ *  TARGETS (watch_table.h)
+ *
+ *  Any number of files on the one inotify fd; parent directory
+ *  watches are shared and keep each target across delete/recreate
+ *  and rename-over.
  * ========================================================= */
-int main(int argc, char **argv)
+static struct watch_table wt;
+static int ifd = -1;
+static int cfg_wd = -1;
+static volatile sig_atomic_t exiting;
+
+/* per-target debounce deadlines, ids = wt rows (see DEBOUNCE) */
+static struct timer_wheel tw;
+static long debounce_ms = DEBOUNCE_MS;
+
+static long long mono_ns(void)
 {
-    if (argc < 2) {
-        fprintf(stderr, "usage: %s <target_file>\n", argv[0]);
-        return 1;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Compare the file against its last stat and log what moved. Called on
+ * events and by the overflow rescan (rescan=1), so both report alike.
+ */
+static void target_check(uint32_t i, int rescan)
+{
+    struct wt_target *t = &wt.t[i];
+    struct stat cur_st;
+
+    tw_cancel(&tw, i);      /* this stat covers any folded events */
+    if (stat(t->path, &cur_st) != 0)
+        return;
+
+    /* a different file under the name (replaced, or while events were lost) */
+    if ((uint64_t)cur_st.st_ino != t->ino ||
+        (uint64_t)cur_st.st_dev != t->dev || t->wd < 0) {
+        log_alert("[System] File recreated | path=%s%s\n",
+                  t->path, rescan ? " | rescan=1" : "");
+        int err = wt_watch_file(&wt, i);
+        if (err)
+            log_alert("[System] watch %s failed err=%d\n", t->path, err);
     }
 
-    const char *target_path = argv[1];
+    if (cur_st.st_mtime != t->mtime) {
+        enum file_time_state fs =
+            check_file_time(cur_st.st_mtime);
+        log_alert(
+            "[ALERT] mtime changed | %s | path=%s%s\n",
+            file_state_str(fs), t->path, rescan ? " | rescan=1" : ""
+        );
+    }
 
-    /* open alert log */
-    alert_fd = open("/data/local/tmp/alerts.log",
-                    O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (alert_fd < 0) {
-        perror("open alerts.log");
-        return 1;
+    if (cur_st.st_atime != t->atime) {
+        enum file_time_state fs =
+            check_file_time(cur_st.st_atime);
+        log_alert(
+            "[ALERT] atime changed | %s | path=%s%s\n",
+            file_state_str(fs), t->path, rescan ? " | rescan=1" : ""
+        );
     }
 
-    char realpath_buf[PATH_MAX];
-    if (!realpath(target_path, realpath_buf)) {
-        perror("realpath");
-        return 1;
+    wt_stat_into(t, &cur_st);
+}
+
+/* =========================================================
+ *  DEBOUNCE
+ *
+ *  A large write is a stream of IN_MODIFY on one inode. The first
+ *  event arms a deadline debounce_ms out in the timer wheel, later
+ *  ones fold into it, and the target is stat()ed once when it
+ *  expires. IN_ATTRIB (touch -d, utimensat) and appeared files are
+ *  checked right away. A timerfd armed at the wheel's next deadline
+ *  wakes the loop.
+ * ========================================================= */
+static int tfd = -1;
+static int64_t tfd_armed_ns = -1;
+
+static struct {
+    unsigned long long deferred;        /* deadlines armed */
+    unsigned long long folded;          /* events merged into one */
+    unsigned long long fired;           /* checks run at a deadline */
+    unsigned long long bypassed;        /* IN_ATTRIB checked at once */
+} ds;
+
+static void debounce_event(uint32_t i, uint32_t mask, long long now)
+{
+    if (debounce_ms == 0 || tw_reserve(&tw, wt.cap_t) != 0) {
+        target_check(i, 0);
+        return;
+    }
+    if (mask & IN_ATTRIB) {
+        ds.bypassed++;
+        target_check(i, 0);
+        return;
     }
+    if (tw_arm(&tw, i, now + debounce_ms * 1000000LL) > 0)
+        ds.deferred++;
+    else
+        ds.folded++;
+}
+
+static void debounce_fire(uint32_t i, void *ctx)
+{
+    (void)ctx;
+    ds.fired++;
+    target_check(i, 0);
+}
+
+/* run due deadlines, then point the timerfd at the next one */
+static void debounce_run(void)
+{
+    tw_advance(&tw, mono_ns(), debounce_fire, NULL);
+
+    int64_t next = tw_next_ns(&tw);
+    if (next == tfd_armed_ns)
+        return;
+    struct itimerspec its = { 0 };  /* all zero: disarm */
+    if (next >= 0) {
+        its.it_value.tv_sec = next / 1000000000LL;
+        its.it_value.tv_nsec = next % 1000000000LL;
+    }
+    if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == 0)
+        tfd_armed_ns = next;
+}
+
+/* =========================================================
+ *  QUEUE OVERFLOW RECOVERY (wt_rescan_*, watch_table.h)
+ *
+ *  Sliced, most recently active first; targets that report an event
+ *  meanwhile are fresh and skipped.
+ * ========================================================= */
+static struct wt_rescan rs;
+
+static void rescan_check(uint32_t i, void *arg)
+{
+    (void)arg;
+    target_check(i, 1);
+}
+
+static void rescan_begin(void)
+{
+    if (wt_rescan_begin(&wt, &rs) != 0) {
+        log_alert("[System] IN_Q_OVERFLOW | rescan alloc failed\n");
+        return;
+    }
+    log_alert("[System] IN_Q_OVERFLOW | overflows=%llu rescan_targets=%u\n",
+              rs.overflows, rs.n);
+}
 
-    char *p1 = strdup(realpath_buf);
-    char *p2 = strdup(realpath_buf);
-    char *dir  = dirname(p1);
-    char *file = basename(p2);
+static void rescan_step(void)
+{
+    if (wt_rescan_step(&wt, &rs, rescan_check, NULL))
+        log_alert("[System] rescan done | targets=%u duration_us=%lld max_us=%lld\n",
+                  rs.n, rs.last_us, rs.max_us);
+}
+
+static int target_add(const char *spec)
+{
+    int err;
+    uint32_t i = wt_add(&wt, spec, NULL, &err);
+    if (i == WT_NONE)
+        return err;
+    wt.t[i].fresh_gen = rs.gen;         /* just stat()ed */
+    return 0;
+}
+
+static void target_remove(const char *spec)
+{
+    uint32_t i = wt_find_spec(&wt, spec);
+    if (i == WT_NONE)
+        return;
+    wt_rescan_forget(&rs, i);
+    tw_cancel(&tw, i);
+    log_alert("[System] Stopped | path=%s\n", wt.t[i].path);
+    wt_remove(&wt, i);
+}
+
+/* =========================================================
+ *  CONFIG RELOAD (SIGHUP or the config file changing)
+ *
+ *  Only the difference is applied: targets that stay keep their
+ *  watches and last stat, so nothing is rescanned and nothing is
+ *  unwatched while the reload runs.
+ * ========================================================= */
+static const char *cfg_path;
+static const char *cfg_name;
+static struct ts_config cur_cfg = { .epsilon = -1 };
+static volatile sig_atomic_t reload_pending;
 
-    struct stat prev_st;
-    if (stat(realpath_buf, &prev_st) != 0) {
-        perror("stat");
+static void on_hup(int sig)
+{
+    (void)sig;
+    reload_pending = 1;
+}
+
+static void on_term(int sig)
+{
+    (void)sig;
+    exiting = 1;
+}
+
+/* specs that failed to add this reload, in config (sorted) order */
+struct reload_failed {
+    const char **spec;
+    size_t n;
+};
+
+static void reload_added(const char *spec, void *ctx)
+{
+    struct reload_failed *f = ctx;
+    int err = target_add(spec);
+    if (err) {
+        log_alert("[System] watch %s failed err=%d\n", spec, err);
+        f->spec[f->n++] = spec;
+    }
+}
+
+static void reload_removed(const char *spec, void *ctx)
+{
+    (void)ctx;
+    target_remove(spec);
+}
+
+static void reload(void)
+{
+    struct ts_config next = { .epsilon = -1 };
+
+    int err = cfg_load(cfg_path, &next);
+    if (err) {
+        log_alert("[System] config %s rejected err=%d, keeping previous\n",
+                  cfg_path, err);
+        return;
+    }
+
+    if (next.alert_log[0] && strcmp(next.alert_log, alert_path) != 0) {
+        alert_flush();      /* the old log keeps its own lines and root */
+        err = cl_reopen(&chain, next.alert_log);
+        if (err)
+            log_alert("[System] alert_log %s failed err=%d\n",
+                      next.alert_log, err);
+        else
+            snprintf(alert_path, sizeof(alert_path), "%s", next.alert_log);
+    }
+    if (next.epsilon >= 0)
+        epsilon_sec = next.epsilon;
+
+    /* no watch lines: keep the current list (argv or previous config) */
+    if (next.n_watch == 0) {
+        next.watch = cur_cfg.watch;
+        next.n_watch = cur_cfg.n_watch;
+        cur_cfg.watch = NULL;
+        cur_cfg.n_watch = 0;
+    }
+    struct reload_failed failed = {
+        .spec = malloc((next.n_watch ? next.n_watch : 1) * sizeof(char *)),
+    };
+    if (!failed.spec) {
+        log_alert("[System] config reload out of memory\n");
+        cfg_free(&next);
+        return;
+    }
+    cfg_watch_diff(&cur_cfg, &next, reload_added, reload_removed, &failed);
+
+    /* what failed to add is retried on the next reload */
+    size_t n = 0, k = 0;
+    for (size_t i = 0; i < next.n_watch; i++) {
+        if (k < failed.n && failed.spec[k] == next.watch[i]) {
+            k++;
+            free(next.watch[i]);
+        } else {
+            next.watch[n++] = next.watch[i];
+        }
+    }
+    next.n_watch = n;
+    free(failed.spec);
+
+    cfg_free(&cur_cfg);
+    cur_cfg = next;
+
+    log_alert("[System] config loaded epsilon=%ld targets=%u dirs=%u alert_log=%s\n",
+              epsilon_sec, wt.live, wt.dir_by_path.n, alert_path);
+}
+
+/* =========================================================
+ *  MAIN
+ * ========================================================= */
+int main(int argc, char **argv)
+{
+    int opt, bad = 0;
+
+    while ((opt = getopt(argc, argv, "C:d:e:o:m:M:")) != -1) {
+        switch (opt) {
+        case 'C':   /* config file, re-read on SIGHUP / change */
+            cfg_path = optarg;
+            break;
+        case 'd':   /* debounce window for write events, ms */
+            debounce_ms = strtol(optarg, NULL, 10);
+            if (debounce_ms < 0)
+                bad = 1;
+            break;
+        case 'e':
+            epsilon_sec = strtol(optarg, NULL, 10);
+            break;
+        case 'o':
+            snprintf(alert_path, sizeof(alert_path), "%s", optarg);
+            break;
+        case 'm':   /* Merkle root every this many lines; 0 = no chain */
+            chain_records = strtol(optarg, NULL, 10);
+            if (chain_records < 0)
+                bad = 1;
+            break;
+        case 'M':   /* ... or with batches this many seconds old */
+            chain_sec = strtol(optarg, NULL, 10);
+            if (chain_sec <= 0)
+                bad = 1;
+            break;
+        default:
+            bad = 1;
+        }
+    }
+    if (bad || (optind == argc && !cfg_path)) {
+        fprintf(stderr,
+                "usage: %s [-C config] [-d debounce_ms] [-e epsilon_sec] [-o alert_log]\n"
+                "          [-m root_lines] [-M root_sec] [target_file...]\n",
+                argv[0]);
         return 1;
     }
 
+    for (int i = optind; i < argc; i++)
+        if (cfg_watch_push(&cur_cfg, argv[i]) != 0)
+            return 1;
+    cfg_watch_sort(&cur_cfg);
+
     init_anchor();
 
-    int fd = inotify_init1(IN_NONBLOCK);
-    if (fd < 0) {
+    ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd < 0) {
         perror("inotify_init");
         return 1;
     }
+    wt_init(&wt, ifd);
+    tw_init(&tw, 1000000LL, mono_ns());     /* 1 ms ticks */
+
+    if (cfg_path) {
+        struct ts_config first = { .epsilon = -1 };
+        int err = cfg_load(cfg_path, &first);
+        if (err) {
+            fprintf(stderr, "config %s: %s\n", cfg_path, strerror(-err));
+            return 1;
+        }
+        if (first.alert_log[0])
+            snprintf(alert_path, sizeof(alert_path), "%s", first.alert_log);
+        cfg_free(&first);
+
+        cfg_wd = cfg_watch_add(ifd, cfg_path, &cfg_name);
+        if (cfg_wd < 0)
+            fprintf(stderr, "config watch: %s (SIGHUP only)\n",
+                    strerror(-cfg_wd));
+        wt.keep_wd = cfg_wd;    /* may share a target's directory */
+    }
 
-    int file_wd = inotify_add_watch(
-        fd,
-        realpath_buf,
-        IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE |
-        IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED
-    );
-
-    int dir_wd = inotify_add_watch(
-        fd,
-        dir,
-        IN_CREATE | IN_MOVED_TO
-    );
+    /* open alert log */
+    if (cfg_reopen_log(&alert_fd, alert_path) != 0) {
+        perror("open alerts.log");
+        return 1;
+    }
+    int err = cl_open(&chain, alert_fd, alert_path, 0, chain_records,
+                      chain_sec);
+    if (err) {
+        fprintf(stderr, "alerts.log chain: %s\n", strerror(-err));
+        return 1;
+    }
 
-    if (file_wd < 0 || dir_wd < 0) {
-        perror("inotify_add_watch");
+    for (size_t i = 0; i < cur_cfg.n_watch; i++) {
+        int err = target_add(cur_cfg.watch[i]);
+        if (err) {
+            fprintf(stderr, "%s: %s\n", cur_cfg.watch[i], strerror(-err));
+            return 1;
+        }
+    }
+    if (cfg_path)
+        reload();   /* config watches on top of argv ones */
+    printf("[Watcher] Monitoring %u files in %u directories\n",
+           wt.live, wt.dir_by_path.n);
+
+    /*
+     * Signals stay blocked except inside epoll_pwait(), so a SIGHUP can
+     * never slip in between the reload_pending check and the wait.
+     */
+    struct sigaction sa;
+    sigset_t block, waitmask;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_hup;
+    sigaction(SIGHUP, &sa, NULL);
+    sa.sa_handler = on_term;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigemptyset(&block);
+    sigaddset(&block, SIGHUP);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    sigprocmask(SIG_BLOCK, &block, &waitmask);
+    sigdelset(&waitmask, SIGHUP);
+    sigdelset(&waitmask, SIGINT);
+    sigdelset(&waitmask, SIGTERM);
+
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        perror("timerfd_create");
         return 1;
     }
 
-    printf("[Watcher] Monitoring %s\n", realpath_buf);
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev[2] = {
+        { .events = EPOLLIN, .data.fd = ifd },
+        { .events = EPOLLIN, .data.fd = tfd },
+    };
+    if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, ifd, &ev[0]) < 0 ||
+        epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev[1]) < 0) {
+        perror("epoll");
+        return 1;
+    }
 
-    char buf[BUF_LEN];
+    char buf[BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
 
-    while (1) {
-        int len = read(fd, buf, sizeof(buf));
-        if (len < 0) {
-            if (errno == EAGAIN) {
-                usleep(100000);
-                continue;
-            }
-            break;
+    while (!exiting) {
+        if (reload_pending) {
+            reload_pending = 0;
+            if (cfg_path)
+                reload();
         }
 
-        for (int i = 0; i < len; ) {
-            struct inotify_event *e =
-                (struct inotify_event *)&buf[i];
+        /* a rescan in progress only yields to pending events */
+        int n = epoll_pwait(ep, ev, 2,
+                            wt_rescan_busy(&rs) ? 0 : cl_due_ms(&chain, mono_ns()),
+                            &waitmask);
+        if (n < 0 && errno != EINTR)
+            break;
 
-            /* ----- directory: file recreated ----- */
-            if (e->wd == dir_wd && e->len > 0 &&
-                strcmp(e->name, file) == 0 &&
-                (e->mask & IN_MOVED_TO)) {
+        int inotify_ready = 0;
+        for (int k = 0; k < n; k++) {
+            if (ev[k].data.fd == ifd) {
+                inotify_ready = 1;
+            } else {
+                uint64_t ticks;     /* clear readiness; the wheel keeps time */
+                (void)!read(tfd, &ticks, sizeof(ticks));
+                tfd_armed_ns = -1;
+            }
+        }
 
-                log_alert("[System] File recreated\n");
+        int len;
+        while (inotify_ready && (len = read(ifd, buf, sizeof(buf))) > 0) {
+            long long now = mono_ns();
 
-                int new_wd = inotify_add_watch(
-                    fd,
-                    realpath_buf,
-                    IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE |
-                    IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED
-                );
-                if (new_wd >= 0)
-                    file_wd = new_wd;
+            for (int i = 0; i < len; ) {
+                struct inotify_event *e =
+                    (struct inotify_event *)&buf[i];
+                i += EVENT_SIZE + e->len;
 
-                stat(realpath_buf, &prev_st);
-            }
+                if (e->mask & IN_Q_OVERFLOW) {
+                    rescan_begin();
+                    continue;
+                }
 
-            /* ----- file events ----- */
-            else if (e->wd == file_wd &&
-                     (e->mask & (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE))) {
-
-                struct stat cur_st;
-                if (stat(realpath_buf, &cur_st) == 0) {
-
-                    if (cur_st.st_mtime != prev_st.st_mtime) {
-                        enum file_time_state fs =
-                            check_file_time(cur_st.st_mtime);
-                        log_alert(
-                            "[ALERT] mtime changed | %s\n",
-                            file_state_str(fs)
-                        );
-                    }
-
-                    if (cur_st.st_atime != prev_st.st_atime) {
-                        enum file_time_state fs =
-                            check_file_time(cur_st.st_atime);
-                        log_alert(
-                            "[ALERT] atime changed | %s\n",
-                            file_state_str(fs)
-                        );
-                    }
-
-                    prev_st = cur_st;
+                /* ----- config edited / replaced ----- */
+                if (cfg_path && cfg_event_hit(e, cfg_wd, cfg_name))
+                    reload_pending = 1;
+
+                enum wt_kind kind;
+                uint32_t t = wt_dispatch(&wt, e, &kind);
+                if (t == WT_NONE)
+                    continue;
+
+                switch (kind) {
+                case WT_EV_APPEARED:    /* created / renamed over */
+                    target_check(t, 0);
+                    break;
+                case WT_EV_CHANGED:     /* hard links share the watch */
+                    for (uint32_t j = t; j != WT_NONE; j = wt.t[j].alias)
+                        debounce_event(j, e->mask, now);
+                    break;
+                case WT_EV_GONE:
+                    tw_cancel(&tw, t);
+                    log_alert("[System] File removed | path=%s\n",
+                              wt.t[t].path);
+                    break;
+                default:
+                    break;
                 }
+                wt.t[t].fresh_gen = rs.gen;
+                wt.t[t].last_event_ns = now;
             }
-
-            i += EVENT_SIZE + e->len;
         }
+
+        debounce_run();
+        if (wt_rescan_busy(&rs))
+            rescan_step();
+        alert_flush();
+        cl_tick(&chain, mono_ns());
     }
 
-    close(fd);
+    /* writes still inside their window get their one check */
+    tw_advance(&tw, mono_ns() + debounce_ms * 1000000LL + 1000000LL,
+               debounce_fire, NULL);
+
+    log_alert("[System] exit | overflows=%llu rescans=%llu rescanned=%llu rescan_total_us=%lld rescan_max_us=%lld\n",
+              rs.overflows, rs.rescans, rs.rescanned, rs.total_us, rs.max_us);
+    log_alert("[System] debounce | window_ms=%ld deferred=%llu folded=%llu fired=%llu attrib_bypass=%llu\n",
+              debounce_ms, ds.deferred, ds.folded, ds.fired, ds.bypassed);
+    log_alert("[System] chain | batches=%llu lines=%llu roots=%llu segments=%llu\n",
+              chain.batches, chain.lines, chain.roots, chain.segments);
+
+    close(ep);
+    close(tfd);
+    tw_free(&tw);
+    wt_free(&wt);
+    close(ifd);
+    alert_flush();
+    cl_close(&chain);
     close(alert_fd);
-    free(p1);
-    free(p2);
+    wt_rescan_free(&rs);
+    cfg_free(&cur_cfg);
     return 0;
 }
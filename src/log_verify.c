@@ -0,0 +1,362 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "chain_log.h"
+
+/*
+ * Checker for hash-chained alert logs (chain_log.h).
+ *
+ *   log_verify [-s] [-r root_hex]... log [log...]
+ *
+ * Logs are read through a sliding mmap window, each batch hashed as it
+ * streams past, and checked as one chain in the order given, so a log
+ * and the one it was reopened into (config alert_log) check together.
+ * Every #CHAIN line must match the batch before it, every #MERKLE line
+ * the batches since the last one, and every #SEGMENT line must link to
+ * the chain before it in the same run. -r roots (copied off the device)
+ * must each be found as a checked #MERKLE root.
+ *
+ * Bytes before a file's first segment (a log from before chaining) and
+ * a batch cut short by a crash before the next segment or end of file
+ * are reported but not fatal; -s makes them so.
+ *
+ * One VERIFY line per file, a BROKEN line at the first mismatch; exit 1
+ * on any BROKEN or missing root.
+ */
+
+#define WINDOW   (64UL << 20)   /* mmap window */
+#define MAX_PIN  64
+
+static int strict;
+
+struct pin {
+    uint8_t root[SHA256_LEN];
+    int found;
+};
+static struct pin pin[MAX_PIN];
+static int n_pin;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* =========================================================
+ *  CHAIN STATE (carried from one file to the next)
+ * ========================================================= */
+struct verify {
+    int linked;                 /* seen a segment: chain is known */
+    uint8_t chain[SHA256_LEN];
+    uint64_t seq;
+
+    struct sha256 batch;        /* data since the last commit line */
+    unsigned long long batch_bytes;
+    off_t batch_off;
+
+    uint8_t (*leaf)[SHA256_LEN];
+    size_t n_leaf, cap_leaf;
+    uint64_t win_first;
+
+    uint8_t root[SHA256_LEN];
+    int have_root;
+
+    /* per file */
+    unsigned long long segments, batches, lines, roots, unrooted;
+    unsigned long long head_bytes, torn_bytes, torn;
+    int in_segment;
+};
+
+static void batch_reset(struct verify *v, off_t off)
+{
+    sha256_init(&v->batch);
+    v->batch_bytes = 0;
+    v->batch_off = off;
+}
+
+/* data with no #CHAIN after it: before a segment or cut short */
+static void batch_torn(struct verify *v, off_t off)
+{
+    if (!v->in_segment) {
+        v->head_bytes += v->batch_bytes;
+    } else if (v->batch_bytes) {
+        v->torn_bytes += v->batch_bytes;
+        v->torn++;
+    }
+    batch_reset(v, off);
+}
+
+static int leaf_push(struct verify *v, const uint8_t d[SHA256_LEN])
+{
+    if (v->n_leaf == v->cap_leaf) {
+        size_t nc = v->cap_leaf ? v->cap_leaf * 2 : 64;
+        void *p = realloc(v->leaf, nc * SHA256_LEN);
+        if (!p)
+            return -ENOMEM;
+        v->leaf = p;
+        v->cap_leaf = nc;
+    }
+    cl_leaf(v->leaf[v->n_leaf++], d);
+    return 0;
+}
+
+static const char *line_chain(struct verify *v, const char *b, const char *e)
+{
+    unsigned long long seq, lines, bytes;
+    uint8_t want[SHA256_LEN], d[SHA256_LEN];
+
+    if (cl_field_u64(b, e, "seq", &seq) || cl_field_u64(b, e, "lines", &lines) ||
+        cl_field_u64(b, e, "bytes", &bytes) || cl_field_hash(b, e, "hash", want))
+        return "parse";
+    if (seq != v->seq + 1)
+        return "seq";
+    if (bytes != v->batch_bytes)
+        return "length";
+
+    sha256_final(&v->batch, d);
+    cl_link(v->chain, d);
+    if (memcmp(v->chain, want, SHA256_LEN) != 0)
+        return "hash";
+    if (v->n_leaf == 0)
+        v->win_first = seq;
+    if (leaf_push(v, d) != 0)
+        return "out_of_memory";
+    v->seq = seq;
+    v->batches++;
+    v->lines += lines;
+    return NULL;
+}
+
+static const char *line_merkle(struct verify *v, const char *b, const char *e)
+{
+    unsigned long long first, count;
+    uint8_t want[SHA256_LEN];
+
+    if (cl_field_u64(b, e, "first", &first) || cl_field_u64(b, e, "count", &count) ||
+        cl_field_hash(b, e, "root", want))
+        return "parse";
+    if (count == 0 || count != v->n_leaf || first != v->win_first)
+        return "merkle_range";
+
+    cl_root(v->leaf, v->n_leaf, v->root);
+    v->n_leaf = 0;
+    if (memcmp(v->root, want, SHA256_LEN) != 0)
+        return "root";
+    v->have_root = 1;
+    v->roots++;
+    for (int i = 0; i < n_pin; i++)
+        if (memcmp(pin[i].root, v->root, SHA256_LEN) == 0)
+            pin[i].found = 1;
+    return NULL;
+}
+
+static const char *line_segment(struct verify *v, const char *b, const char *e)
+{
+    unsigned long long seq;
+    uint8_t prev[SHA256_LEN];
+
+    if (cl_field_u64(b, e, "seq", &seq) || cl_field_hash(b, e, "prev", prev) ||
+        seq == 0)
+        return "parse";
+    if (v->linked && (memcmp(prev, v->chain, SHA256_LEN) != 0 ||
+                      seq != v->seq + 1))
+        return "relink";
+
+    v->unrooted += v->n_leaf;   /* writer died before its root */
+    v->n_leaf = 0;
+    memcpy(v->chain, prev, SHA256_LEN);
+    v->seq = seq - 1;
+    v->linked = 1;
+    v->in_segment = 1;
+    v->segments++;
+    return NULL;
+}
+
+/* =========================================================
+ *  ONE FILE
+ * ========================================================= */
+static int verify_file(struct verify *v, const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    char hex[2 * SHA256_LEN + 1], root_hex[2 * SHA256_LEN + 1];
+
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("BROKEN file=%s offset=0 reason=open error=%d\n", path, errno);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    v->segments = v->batches = v->lines = v->roots = v->unrooted = 0;
+    v->head_bytes = v->torn_bytes = v->torn = 0;
+    v->in_segment = 0;
+    batch_reset(v, 0);
+
+    long long t0 = now_ns();
+    off_t size = st.st_size, woff, broken_at = -1;
+    const char *why = NULL;
+    long page = sysconf(_SC_PAGESIZE);
+
+    /*
+     * Each window starts at the page holding the first line not yet
+     * seen. Commit lines are found by their '#' (at a line start, or
+     * after the JSON prefix), so data between them is never split into
+     * lines; it goes to the batch hash as one update per run.
+     */
+    size_t pre = sizeof(CL_JSON_PRE) - 1;
+    off_t pos = 0;
+    while (pos < size && !why) {
+        woff = pos & ~(off_t)(page - 1);
+        off_t want = pos - woff + (off_t)WINDOW;
+        size_t wlen = size - woff < want ? size - woff : want;
+        char *map = mmap(NULL, wlen, PROT_READ, MAP_PRIVATE, fd, woff);
+        if (map == MAP_FAILED) {
+            why = "mmap";
+            broken_at = pos;
+            break;
+        }
+        madvise(map, wlen, MADV_SEQUENTIAL);
+
+        const char *base = map + (pos - woff), *end = map + wlen;
+        const char *p = base, *run = base, *cut = NULL;
+        int last = woff + (off_t)wlen == size;
+
+        while (p < end) {
+            const char *q = memchr(p, '#', end - p), *ls, *body;
+            if (!q)
+                break;
+            p = q + 1;
+            if (q == base || q[-1] == '\n')
+                ls = q;
+            else if (q - base >= (long)pre && memcmp(q - pre, CL_JSON_PRE, pre) == 0 &&
+                     (q - pre == base || q[-pre - 1] == '\n'))
+                ls = q - pre;
+            else
+                continue;
+
+            const char *nl = memchr(q, '\n', end - q);
+            if (!nl && !last && ls != base) {
+                cut = ls;           /* remap from this line */
+                break;
+            }
+            const char *after = nl ? nl + 1 : end;
+            if (!nl)
+                nl = end;           /* unterminated tail */
+
+            enum cl_kind k = cl_classify(ls, nl, &body);
+            if (k == CL_DATA)
+                continue;
+
+            sha256_update(&v->batch, run, ls - run);
+            v->batch_bytes += ls - run;
+            off_t at = woff + (ls - map), next = woff + (after - map);
+            if (!v->in_segment && k != CL_SEGMENT) {
+                /* no segment to check it against */
+                v->batch_bytes += after - ls;
+                batch_torn(v, next);
+            } else if (k == CL_CHAIN) {
+                why = line_chain(v, body, nl);
+                broken_at = v->batch_off;
+                batch_reset(v, next);
+            } else {
+                batch_torn(v, next);
+                why = k == CL_MERKLE ? line_merkle(v, body, nl) :
+                                       line_segment(v, body, nl);
+                broken_at = at;
+            }
+            if (why)
+                break;
+            p = run = after;
+        }
+        if (!cut && !last) {        /* remap from the last whole line */
+            const char *nl = memrchr(run, '\n', end - run);
+            cut = nl ? nl + 1 : run > base ? run : end;
+        }
+        if (!cut)
+            cut = end;
+        if (!why) {
+            sha256_update(&v->batch, run, cut - run);
+            v->batch_bytes += cut - run;
+        }
+        pos = woff + (cut - map);
+        munmap(map, wlen);
+    }
+    close(fd);
+    if (!why)
+        batch_torn(v, size);
+
+    double ms = (now_ns() - t0) / 1e6;
+    if (!why && strict && (v->head_bytes || v->torn_bytes)) {
+        why = v->head_bytes ? "unchained_head" : "torn_batch";
+        broken_at = 0;
+    }
+    if (why) {
+        printf("BROKEN file=%s offset=%lld seq=%llu reason=%s\n", path,
+               (long long)broken_at, (unsigned long long)v->seq + 1, why);
+        v->linked = 0;      /* the next file is checked on its own */
+    }
+
+    cl_hex(hex, v->chain);
+    cl_hex(root_hex, v->root);
+    printf("VERIFY file=%s bytes=%lld segments=%llu batches=%llu lines=%llu roots=%llu unrooted=%llu head_bytes=%llu torn=%llu torn_bytes=%llu last_hash=%s last_root=%s ms=%.1f mb_per_s=%.0f ok=%d\n",
+           path, (long long)size, v->segments, v->batches, v->lines,
+           v->roots, v->unrooted + v->n_leaf, v->head_bytes, v->torn,
+           v->torn_bytes, hex, v->have_root ? root_hex : "-", ms,
+           ms > 0 ? size / 1e3 / ms : 0.0, !why);
+    return why ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int opt, rc = 0;
+
+    while ((opt = getopt(argc, argv, "sr:")) != -1) {
+        switch (opt) {
+        case 's':
+            strict = 1;
+            break;
+        case 'r':   /* a root kept off the device */
+            if (n_pin == MAX_PIN ||
+                cl_unhex(optarg, optarg + strlen(optarg), pin[n_pin].root) != 0) {
+                fprintf(stderr, "-r: at most %d 64-digit hex roots\n", MAX_PIN);
+                return 1;
+            }
+            n_pin++;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind == argc)
+        goto usage;
+
+    struct verify v = { 0 };
+    for (int i = optind; i < argc; i++)
+        if (verify_file(&v, argv[i]) != 0)
+            rc = 1;
+
+    for (int i = 0; i < n_pin; i++) {
+        char hex[2 * SHA256_LEN + 1];
+        cl_hex(hex, pin[i].root);
+        printf("PINNED root=%s found=%d\n", hex, pin[i].found);
+        if (!pin[i].found)
+            rc = 1;
+    }
+    free(v.leaf);
+    return rc;
+
+usage:
+    fprintf(stderr, "usage: %s [-s] [-r root_hex]... log [log...]\n", argv[0]);
+    return 1;
+}
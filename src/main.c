@@ -7,7 +7,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 
 #if __has_include(<bpf/libbpf.h>)
   #include <bpf/libbpf.h>
@@ -21,10 +23,14 @@
   #include <bpf.h>
 #endif
 
+#include "probe.skel.h"
+#include "bpf_pin.h"
+#include "startup_time.h"
+
 #define SETTIMEOFDAY_IDX 0
-#define EPSILON_SEC 60   /* 1 minute tolerance */
 
 static volatile sig_atomic_t exiting = 0;
+static long epsilon_sec = 60;   /* 1 minute tolerance */
 static void on_sig(int s) { (void)s; exiting = 1; }
 
 static int libbpf_print_fn(enum libbpf_print_level level, const char *fmt, va_list ap) {
@@ -32,12 +38,78 @@ static int libbpf_print_fn(enum libbpf_print_level level, const char *fmt, va_li
     return vfprintf(stderr, fmt, ap);
 }
 
-/* must match BPF side */
+/* must match BPF side; seq is odd while the BPF side is writing */
 struct last_args_val {
     long tv_sec;
     long tz_minuteswest;
+    __u64 seq;
+};
+
+/*
+ * syscall_cnt and last_args are BPF_F_MMAPABLE arrays. Mapped read-only,
+ * the poll loop reads them with plain loads instead of two bpf() calls
+ * every 150ms: a read that saw seq odd or changed is retried, and the
+ * poll is skipped if none is consistent. The BPF side needs kernel 5.12+
+ * for its cmpxchg/fetch atomics (built with -mcpu=v3), which also covers
+ * mmapable arrays (5.5+). Only maps pinned by an older build without the
+ * flag fall back to bpf_map_lookup_elem (cnt == NULL).
+ */
+struct map_view {
+    const __u64 *cnt;
+    const struct last_args_val *args;
+    size_t len;
 };
 
+static void view_close(struct map_view *v) {
+    if (v->cnt) munmap((void *)v->cnt, v->len);
+    if (v->args) munmap((void *)v->args, v->len);
+    v->cnt = NULL;
+    v->args = NULL;
+}
+
+static int view_open(struct map_view *v, int fd_cnt, int fd_args) {
+    struct bpf_map_info info;
+    __u32 len = sizeof(info);
+    void *p;
+
+    memset(v, 0, sizeof(*v));
+    memset(&info, 0, sizeof(info));
+    if (bpf_obj_get_info_by_fd(fd_args, &info, &len) != 0)
+        return -errno;
+    if (!(info.map_flags & BPF_F_MMAPABLE) || info.value_size < sizeof(struct last_args_val))
+        return -EOPNOTSUPP;
+
+    v->len = sysconf(_SC_PAGESIZE);   /* one element each: the first page */
+    p = mmap(NULL, v->len, PROT_READ, MAP_SHARED, fd_args, 0);
+    if (p == MAP_FAILED)
+        return -errno;
+    v->args = p;
+    p = mmap(NULL, v->len, PROT_READ, MAP_SHARED, fd_cnt, 0);
+    if (p == MAP_FAILED) {
+        int err = -errno;
+        view_close(v);
+        return err;
+    }
+    v->cnt = p;
+    return 0;
+}
+
+/* -EAGAIN: no consistent read (a writer held seq odd throughout) */
+static int view_read(const struct map_view *v, __u64 *cnt, struct last_args_val *a) {
+    for (int tries = 0; tries < 1000; tries++) {
+        __u64 seq = __atomic_load_n(&v->args->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        *cnt = __atomic_load_n(v->cnt, __ATOMIC_RELAXED);
+        a->tv_sec = __atomic_load_n(&v->args->tv_sec, __ATOMIC_RELAXED);
+        a->tz_minuteswest = __atomic_load_n(&v->args->tz_minuteswest, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&v->args->seq, __ATOMIC_RELAXED) == seq)
+            return 0;
+    }
+    return -EAGAIN;
+}
+
 /* Trusted timeline (keep expected/untampered timeline) */
 static time_t trusted_wall = 0;           /* baseline wall at trusted_boot */
 static struct timespec trusted_boot = {0};
@@ -52,29 +124,84 @@ static time_t expected_wall_from_trusted(struct timespec now_boot) {
     return trusted_wall + delta;
 }
 
+/* the anchor map outlives the process when pinned (-p) */
+static void anchor_store(int fd, __u64 seen_cnt) {
+    struct anchor_val v = {
+        .trusted_wall = trusted_wall,
+        .trusted_boot_ns = (__s64)trusted_boot.tv_sec * 1000000000LL + trusted_boot.tv_nsec,
+        .seen_cnt = seen_cnt,
+    };
+    int key = 0;
+    (void)bpf_map_update_elem(fd, &key, &v, BPF_ANY);
+}
+
+static int anchor_restore(int fd, __u64 *seen_cnt) {
+    struct anchor_val v = {0};
+    int key = 0;
+    if (bpf_map_lookup_elem(fd, &key, &v) != 0 || v.trusted_boot_ns == 0)
+        return 0;
+    trusted_wall = (time_t)v.trusted_wall;
+    trusted_boot.tv_sec = v.trusted_boot_ns / 1000000000LL;
+    trusted_boot.tv_nsec = v.trusted_boot_ns % 1000000000LL;
+    *seen_cnt = v.seen_cnt;
+    return 1;
+}
+
 static const char *classify(time_t new_wall, time_t expected, time_t *out_diff) {
     time_t diff = new_wall - expected;
     if (out_diff) *out_diff = diff;
 
-    if (diff > EPSILON_SEC) return "FUTURE";
-    if (diff < -EPSILON_SEC) return "PAST";
+    if (diff > epsilon_sec) return "FUTURE";
+    if (diff < -epsilon_sec) return "PAST";
     return "CURRENT"; /* means aligned with expected timeline */
 }
 
 int main(int argc, char **argv) {
-    const char *obj_path = (argc > 1) ? argv[1] : "probe.bpf.o";
-
+    long long main_ns = boot_ns();
     struct rlimit r = { RLIM_INFINITY, RLIM_INFINITY };
-    struct bpf_object *obj = NULL;
-    struct bpf_program *prog = NULL;
-    struct bpf_link *link = NULL;
+    struct probe_bpf *skel = NULL;
 
     int fd_cnt = -1;
     int fd_args = -1;
+    int fd_anchor = -1;
+    const struct pin_map pins[] = {
+        { "syscall_cnt", &fd_cnt, 0 },
+        { "last_args",   &fd_args, 0 },
+        { "anchor",      &fd_anchor, 0 },
+    };
+    struct map_view view = {0};
 
     __u64 prev_cnt = 0;
     int key = SETTIMEOFDAY_IDX;
     int err = 0;
+    int opt;
+    int pin = 0, unpin = 0, reused = 0;
+    char pin_dir[PATH_MAX];
+
+    while ((opt = getopt(argc, argv, "e:pU")) != -1) {
+        switch (opt) {
+        case 'e': {
+            char *end;
+            epsilon_sec = strtol(optarg, &end, 10);
+            if (end == optarg || *end || epsilon_sec <= 0) {
+                fprintf(stderr, "-e must be a positive number of seconds\n");
+                return 1;
+            }
+            break;
+        }
+        case 'p': pin = 1; break;     /* keep maps + link in bpffs across restarts */
+        case 'U': unpin = 1; break;   /* drop the pins (detaches) and exit */
+        default:
+            fprintf(stderr, "usage: %s [-e epsilon_sec] [-p | -U]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (unpin) {
+        snprintf(pin_dir, sizeof(pin_dir), "%s/probe", PIN_ROOT);
+        pin_remove(pin_dir);
+        return 0;
+    }
 
     setrlimit(RLIMIT_MEMLOCK, &r);
     libbpf_set_print(libbpf_print_fn);
@@ -83,44 +210,81 @@ int main(int argc, char **argv) {
 
     init_trusted();
 
-    obj = bpf_object__open_file(obj_path, NULL);
-    if (libbpf_get_error(obj)) {
-        err = -errno;
-        fprintf(stderr, "open %s failed: %d\n", obj_path, err);
-        obj = NULL;
-        goto out;
-    }
+    if (pin) {
+        err = pin_prepare_dir(pin_dir, sizeof(pin_dir), "probe");
+        if (err) {
+            fprintf(stderr, "bpffs dir %s: %s\n", pin_dir, strerror(-err));
+            goto out;
+        }
 
-    err = bpf_object__load(obj);
-    if (err) {
-        fprintf(stderr, "load failed: %d (%s)\n", err, strerror(-err));
-        goto out;
+        reused = pin_reuse(pin_dir, sizeof(pin_dir), "probe",
+                           pins, sizeof(pins) / sizeof(pins[0]));
     }
 
-    prog = bpf_object__find_program_by_name(obj, "handle_sys_enter");
-    if (!prog) {
-        fprintf(stderr, "prog handle_sys_enter not found\n");
-        err = 1;
-        goto out;
-    }
+    if (!reused) {
+        /* object is embedded in the binary: no probe.bpf.o lookup at runtime */
+        skel = probe_bpf__open();
+        if (!skel) {
+            err = -errno;
+            fprintf(stderr, "open skeleton failed: %d\n", err);
+            goto out;
+        }
 
-    link = bpf_program__attach_tracepoint(prog, "raw_syscalls", "sys_enter");
-    if (libbpf_get_error(link)) {
-        err = -errno;
-        fprintf(stderr, "attach tracepoint failed: %d\n", err);
-        link = NULL;
-        goto out;
-    }
+        skel->rodata->target_nr = __NR_settimeofday;
 
-    fd_cnt  = bpf_object__find_map_fd_by_name(obj, "syscall_cnt");
-    fd_args = bpf_object__find_map_fd_by_name(obj, "last_args");
-    if (fd_cnt < 0 || fd_args < 0) {
-        fprintf(stderr, "map fds not found (syscall_cnt=%d last_args=%d)\n", fd_cnt, fd_args);
-        err = 1;
-        goto out;
+        if (pin) {
+            err = pin_set_map_paths(skel->obj, pin_dir);
+            if (err) {
+                fprintf(stderr, "set pin paths failed: %d\n", err);
+                goto out;
+            }
+        }
+
+        err = probe_bpf__load(skel);
+        if (err) {
+            fprintf(stderr, "load failed: %d (%s)\n", err, strerror(-err));
+            goto out;
+        }
+
+        err = probe_bpf__attach(skel);
+        if (err) {
+            fprintf(stderr, "attach tracepoint failed: %d\n", err);
+            goto out;
+        }
+
+        if (pin) {
+            err = pin_link(skel->links.handle_sys_enter, pin_dir);
+            if (err) {
+                fprintf(stderr, "pin link failed: %d\n", err);
+                goto out;
+            }
+        }
+
+        fd_cnt    = bpf_map__fd(skel->maps.syscall_cnt);
+        fd_args   = bpf_map__fd(skel->maps.last_args);
+        fd_anchor = bpf_map__fd(skel->maps.anchor);
     }
 
+    /*
+     * Pinned maps may carry the timeline of the previous run. Resuming it
+     * matters: time(NULL) may already have been tampered with while no one
+     * was watching. Calls made in between show up as cnt > prev_cnt below.
+     */
+    if (anchor_restore(fd_anchor, &prev_cnt))
+        printf("Resumed trusted timeline from %s (seen cnt=%llu)\n",
+               reused ? "pinned maps" : "reused maps", (unsigned long long)prev_cnt);
+
+    err = view_open(&view, fd_cnt, fd_args);
+    printf("Counters: %s\n", err ? "bpf_map_lookup_elem" : "mmap");
+    err = 0;
+
+    long long attached_ns = boot_ns();
+    long long exec_ns = exec_boot_ns();
+
     printf("Attached. Detecting settimeofday() time jumps. Ctrl+C to stop.\n");
+    printf("Startup: exec->attached=%lldus main->attached=%lldus\n",
+           exec_ns < 0 ? -1LL : (attached_ns - exec_ns) / 1000,
+           (attached_ns - main_ns) / 1000);
     printf("Initial trusted: wall=%ld boot=%ld\n", (long)trusted_wall, (long)trusted_boot.tv_sec);
 
     while (!exiting) {
@@ -128,11 +292,19 @@ int main(int argc, char **argv) {
         struct last_args_val a;
         memset(&a, 0, sizeof(a));
 
-        if (bpf_map_lookup_elem(fd_cnt, &key, &cnt) != 0) {
-            usleep(150 * 1000);
-            continue;
+        if (view.cnt) {
+            if (view_read(&view, &cnt, &a) != 0) {
+                fprintf(stderr, "counters: no consistent read, retrying\n");
+                usleep(150 * 1000);
+                continue;
+            }
+        } else {
+            if (bpf_map_lookup_elem(fd_cnt, &key, &cnt) != 0) {
+                usleep(150 * 1000);
+                continue;
+            }
+            (void)bpf_map_lookup_elem(fd_args, &key, &a);
         }
-        (void)bpf_map_lookup_elem(fd_args, &key, &a);
 
         if (cnt != prev_cnt) {
             struct timespec now_boot;
@@ -144,13 +316,15 @@ int main(int argc, char **argv) {
             time_t diff = 0;
             const char *cls = classify(new_wall, expected, &diff);
 
-            printf("settimeofday: cnt=%llu new=%ld expected=%ld diff=%ld => [%s] tz_minuteswest=%ld\n",
+            printf("settimeofday: cnt=%llu missed=%llu new=%ld expected=%ld diff=%ld => [%s] tz_minuteswest=%ld boot_ns=%lld\n",
                    (unsigned long long)cnt,
+                   (unsigned long long)(cnt > prev_cnt ? cnt - prev_cnt - 1 : 0),
                    (long)new_wall,
                    (long)expected,
                    (long)diff,
                    cls,
-                   (long)a.tz_minuteswest);
+                   (long)a.tz_minuteswest,
+                   (long long)now_boot.tv_sec * 1000000000LL + now_boot.tv_nsec);
 
             /*
              * IMPORTANT:
@@ -161,6 +335,7 @@ int main(int argc, char **argv) {
             trusted_boot = now_boot;
 
             prev_cnt = cnt;
+            anchor_store(fd_anchor, prev_cnt);
             fflush(stdout);
         }
 
@@ -168,7 +343,9 @@ int main(int argc, char **argv) {
     }
 
 out:
-    if (link) bpf_link__destroy(link);
-    if (obj) bpf_object__close(obj);
+    view_close(&view);
+    if (reused)
+        pin_close_maps(pins, sizeof(pins) / sizeof(pins[0]));
+    probe_bpf__destroy(skel);
     return err ? 1 : 0;
 }
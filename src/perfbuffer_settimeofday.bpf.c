@@ -12,13 +12,51 @@ struct sys_enter_args {
     unsigned long args[6];
 };
 
-#define __NR_settimeofday 170
+/* syscalls/sys_enter_settimeofday: same offsets, only one syscall */
+struct settimeofday_args {
+    __u64 _pad;
+    int __syscall_nr;
+    unsigned long tv;
+    unsigned long tz;
+};
+
+/*
+ * .rodata tunables, filled in by the loader before load. They are frozen
+ * afterwards, so the verifier sees them as known scalars.
+ */
+const volatile long target_nr = 170;     /* arm64 settimeofday; loader sets __NR_ */
+const volatile int filter_cgroup = 0;    /* -g: only cgroups in the map */
+
+/*
+ * .bss tunables: the map is mmap'd by the skeleton, so the loader can
+ * change them while attached (config reload) without a reload/re-attach.
+ */
+volatile long epsilon_sec;               /* shared with userspace classify */
+
+#define TASK_COMM_LEN 16
+#define STACK_DEPTH   32        /* frames kept per stack */
+#define STACK_NONE    (-2)      /* -ENOENT: not captured */
+#define NO_READER     (-2)      /* -ENOENT: no perf buffer on this CPU */
+#define BACKLOG_BYTES (256 * 1024)  /* ~3k events while the reader is down */
 
 struct event {
-    __u64 ktime_ns;
+    __u64 ktime_ns;             /* CLOCK_BOOTTIME at the syscall */
     __u64 cnt;
     long  tv_sec;
     long  tz_minuteswest;
+    __u32 pid;                  /* tgid of the caller */
+    __u32 uid;
+    char  comm[TASK_COMM_LEN];
+    __s32 kstack_id;            /* stacks map ids, or STACK_NONE / */
+    __s32 ustack_id;            /* the bpf_get_stackid error */
+    __u64 cgroup_id;            /* cgroup v2 id of the caller */
+};
+
+/* must match struct anchor_val in bpf_pin.h */
+struct anchor_val {
+    __s64 trusted_wall;
+    __s64 trusted_boot_ns;
+    __u64 seen_cnt;
 };
 
 /* ? ARRAY map: key/value 명시 (이건 맞는 수정) */
@@ -42,13 +80,155 @@ struct {
     __uint(max_entries, 0);
 } events SEC(".maps");
 
-SEC("tracepoint/raw_syscalls/sys_enter")
-int handle_sys_enter(struct sys_enter_args *ctx)
+/*
+ * Events emitted while no reader is attached. The kernel clears the
+ * perf buffer slots when the reader's map fd closes, so from then on
+ * bpf_perf_event_output() fails with -ENOENT and the event goes here.
+ * Pinned, the ring outlives the daemon; the next reader drains it before
+ * it polls. Only what overflows the ring is left to the cnt gap.
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, BACKLOG_BYTES);
+} backlog SEC(".maps");
+
+/*
+ * Written by userspace only. Pinned under bpffs it carries the trusted
+ * timeline and the last handled cnt across daemon restarts; the cnt gap
+ * against seen_cnt after the backlog is drained tells the restarted
+ * reader how many events were lost. The program reads the timeline to
+ * decide which events get a stack.
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct anchor_val);
+} anchor SEC(".maps");
+
+/*
+ * Caller stacks of the events outside epsilon, symbolized by userspace.
+ * Identical stacks share an id; entries are never deleted (userspace
+ * caches by id), so once a bucket is taken a different stack hashing
+ * to it comes back as -EEXIST instead of replacing it.
+ */
+struct {
+    __uint(type, BPF_MAP_TYPE_STACK_TRACE);
+    __uint(max_entries, 4096);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, STACK_DEPTH * sizeof(__u64));
+} stacks SEC(".maps");
+
+/*
+ * Overload control, written by userspace when its perf buffers pass a
+ * high watermark and cleared below a low one. While aggregate is set
+ * no event is emitted; each call only folds into the per-CPU agg.
+ * Both must match userspace.
+ */
+struct ctl_val {
+    __u32 aggregate;
+    __u32 _pad;
+};
+
+struct agg_val {
+    __u64 count;
+    __u64 future;               /* outside epsilon, against the anchor */
+    __u64 past;
+    __s64 min_sec;              /* requested tv_sec */
+    __s64 max_sec;
+    __u64 first_ns;             /* CLOCK_BOOTTIME */
+    __u64 last_ns;
+    __u64 last_cnt;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct ctl_val);
+} control SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct agg_val);
+} agg SEC(".maps");
+
+/*
+ * Container scope, filled by userspace (-G) before attach. Keyed by
+ * cgroup v2 id (the inode of the cgroup directory); a call matches only
+ * its own cgroup, not an ancestor's. With filter_cgroup set, a call from
+ * a cgroup not in the map is dropped before anything else: not counted,
+ * no user memory read, nothing emitted. epsilon_sec < 0 means the global
+ * one. Counters are per container and must match userspace.
+ */
+struct cg_val {
+    __s64 epsilon_sec;
+    __u64 count;
+    __u64 future;
+    __u64 past;
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 64);
+    __type(key, __u64);
+    __type(value, struct cg_val);
+} cgroups SEC(".maps");
+
+/*
+ * Same test as userspace classify(), against the anchor userspace last
+ * stored: whole seconds on both sides, unsigned division only. >0 is
+ * FUTURE, <0 PAST; no anchor yet means nothing is outside.
+ */
+static __always_inline int time_side(long tv_sec, __u64 boot_ns, long eps)
 {
-    if (ctx->id != __NR_settimeofday)
+    __u32 key = 0;
+    struct anchor_val *a = bpf_map_lookup_elem(&anchor, &key);
+
+    if (!a || a->trusted_boot_ns <= 0)
         return 0;
+    long expected = a->trusted_wall + (long)(boot_ns / 1000000000ULL) -
+                    (long)((__u64)a->trusted_boot_ns / 1000000000ULL);
+    long diff = tv_sec - expected;
+    return diff > eps ? 1 : diff < -eps ? -1 : 0;
+}
+
+static __always_inline void agg_add(const struct event *ev, int side)
+{
+    __u32 key = 0;
+    struct agg_val *a = bpf_map_lookup_elem(&agg, &key);
 
+    if (!a)
+        return;
+    if (!a->count) {
+        a->min_sec = a->max_sec = ev->tv_sec;
+        a->first_ns = ev->ktime_ns;
+    } else if (ev->tv_sec < a->min_sec) {
+        a->min_sec = ev->tv_sec;
+    } else if (ev->tv_sec > a->max_sec) {
+        a->max_sec = ev->tv_sec;
+    }
+    a->count++;
+    a->last_ns = ev->ktime_ns;
+    a->last_cnt = ev->cnt;
+    if (side > 0)
+        a->future++;
+    else if (side < 0)
+        a->past++;
+}
+
+static __always_inline int on_settimeofday(void *ctx, unsigned long tv,
+                                           unsigned long tz)
+{
     __u32 key = 0;
+    __u64 cg_id = bpf_get_current_cgroup_id();
+    struct cg_val *cg = bpf_map_lookup_elem(&cgroups, &cg_id);
+
+    if (filter_cgroup && !cg)
+        return 0;
+
     __u64 *cnt_ptr = bpf_map_lookup_elem(&syscall_cnt, &key);
     __u64 cnt = 0;
 
@@ -58,24 +238,72 @@ int handle_sys_enter(struct sys_enter_args *ctx)
     }
 
     struct event ev = {};
-    ev.ktime_ns = bpf_ktime_get_ns();
+    /* boot time, so userspace takes expected at the syscall, not at read */
+    ev.ktime_ns = bpf_ktime_get_boot_ns();
     ev.cnt = cnt;
-    if (ctx->args[0]) {
-        if (bpf_probe_read_user(&ev.tv_sec, sizeof(ev.tv_sec),
-                                (void *)ctx->args[0]) != 0)
+    ev.pid = bpf_get_current_pid_tgid() >> 32;
+    ev.uid = (__u32)bpf_get_current_uid_gid();
+    ev.cgroup_id = cg_id;
+    bpf_get_current_comm(ev.comm, sizeof(ev.comm));
+    if (tv) {
+        if (bpf_probe_read_user(&ev.tv_sec, sizeof(ev.tv_sec), (void *)tv) != 0)
             ev.tv_sec = -1;
     } else {
         ev.tv_sec = -1;
     }
 
-    if (ctx->args[1]) {
+    long eps = cg && cg->epsilon_sec >= 0 ? cg->epsilon_sec : epsilon_sec;
+    int side = time_side(ev.tv_sec, ev.ktime_ns, eps);
+    if (cg) {
+        __sync_fetch_and_add(&cg->count, 1);
+        if (side > 0)
+            __sync_fetch_and_add(&cg->future, 1);
+        else if (side < 0)
+            __sync_fetch_and_add(&cg->past, 1);
+    }
+    struct ctl_val *ctl = bpf_map_lookup_elem(&control, &key);
+    if (ctl && ctl->aggregate) {
+        agg_add(&ev, side);
+        return 0;
+    }
+
+    if (tz) {
         if (bpf_probe_read_user(&ev.tz_minuteswest, sizeof(ev.tz_minuteswest),
-                                (void *)ctx->args[1]) != 0)
+                                (void *)tz) != 0)
             ev.tz_minuteswest = -1;
     } else {
         ev.tz_minuteswest = 0;
     }
 
-    bpf_perf_event_output(ctx, &events, BPF_F_CURRENT_CPU, &ev, sizeof(ev));
+    if (side) {
+        ev.kstack_id = bpf_get_stackid(ctx, &stacks, 0);
+        ev.ustack_id = bpf_get_stackid(ctx, &stacks, BPF_F_USER_STACK);
+    } else {
+        ev.kstack_id = ev.ustack_id = STACK_NONE;
+    }
+
+    if (bpf_perf_event_output(ctx, &events, BPF_F_CURRENT_CPU, &ev,
+                              sizeof(ev)) == NO_READER)
+        bpf_ringbuf_output(&backlog, &ev, sizeof(ev), 0);
     return 0;
 }
+
+/*
+ * Two ways in; the loader autoloads one. raw_syscalls runs on every
+ * syscall of the system and drops all but target_nr; the per-syscall
+ * tracepoint (-s) runs only for settimeofday but needs
+ * CONFIG_FTRACE_SYSCALLS.
+ */
+SEC("tracepoint/raw_syscalls/sys_enter")
+int handle_sys_enter(struct sys_enter_args *ctx)
+{
+    if (ctx->id != target_nr)
+        return 0;
+    return on_settimeofday(ctx, ctx->args[0], ctx->args[1]);
+}
+
+SEC("tracepoint/syscalls/sys_enter_settimeofday")
+int handle_settimeofday(struct settimeofday_args *ctx)
+{
+    return on_settimeofday(ctx, ctx->tv, ctx->tz);
+}
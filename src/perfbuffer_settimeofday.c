@@ -2,21 +2,47 @@
 #include <errno.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <fcntl.h>
 
+#include <linux/perf_event.h>
 #include <bpf/libbpf.h>
 #include <bpf/bpf.h>
 
-#define EPSILON_SEC 60
+#include "perfbuffer_settimeofday.skel.h"
+#include "bpf_pin.h"
+#include "startup_time.h"
+#include "coalesce.h"
+#include "trace.h"
+#include "tamper_index.h"
+#include "ts_config.h"
+#include "alert_fmt.h"
+#include "alert_stream.h"
+#include "chain_log.h"
+#include "stack_sym.h"
+#include "bpf_stats.h"
 
 static volatile sig_atomic_t exiting = 0;
 static int alert_fd = -1;
+static enum af_style alert_style = AF_KV;   /* -J: JSON Lines */
+static int anchor_fd = -1;
+static __u64 seen_cnt;          /* __atomic max across consumers */
+static long epsilon_sec = 60;   /* mirrored into .bss; -C may change it */
+static int epsilon_set = 0;     /* -e given: overrides a trace's epsilon */
+
+#define MAX_CONSUMERS 64
+static __thread int consumer_id;   /* 0 in single-thread mode */
 
 /* ===== signal ===== */
 static void on_sig(int sig)
@@ -35,44 +61,493 @@ static int libbpf_print_fn(enum libbpf_print_level level,
 
 /* ===== MUST match BPF side ===== */
 struct event {
-    __u64 ktime_ns;
+    __u64 ktime_ns;             /* CLOCK_BOOTTIME at the syscall */
     __u64 cnt;
     long  tv_sec;
     long  tz_minuteswest;
+    __u32 pid;
+    __u32 uid;
+    char  comm[16];
+    __s32 kstack_id;            /* stacks map ids, or SS_NONE / */
+    __s32 ustack_id;            /* the bpf_get_stackid error */
+    __u64 cgroup_id;
+};
+
+struct ctl_val {
+    __u32 aggregate;
+    __u32 _pad;
+};
+
+struct agg_val {
+    __u64 count;
+    __u64 future;
+    __u64 past;
+    __s64 min_sec;
+    __s64 max_sec;
+    __u64 first_ns;
+    __u64 last_ns;
+    __u64 last_cnt;
+};
+
+struct cg_val {
+    __s64 epsilon_sec;          /* < 0: the global one */
+    __u64 count;
+    __u64 future;
+    __u64 past;
+};
+
+/* an event from a BPF object or trace that predates the stack ids */
+#define EVENT_SIZE_NOSTACK offsetof(struct event, kstack_id)
+/* ... or the cgroup id */
+#define EVENT_SIZE_NOCG    offsetof(struct event, cgroup_id)
+
+static int event_read(struct event *e, const void *data, size_t size)
+{
+    if (size >= sizeof(*e)) {
+        memcpy(e, data, sizeof(*e));
+        return 0;
+    }
+    if (size >= EVENT_SIZE_NOCG) {
+        memcpy(e, data, EVENT_SIZE_NOCG);
+        e->cgroup_id = 0;
+        return 0;
+    }
+    if (size < EVENT_SIZE_NOSTACK)
+        return -1;
+    memcpy(e, data, EVENT_SIZE_NOSTACK);
+    e->kstack_id = e->ustack_id = SS_NONE;
+    e->cgroup_id = 0;
+    return 0;
+}
+
+/* one classified event: binary log record and coalescer payload */
+struct alert_rec {
+    struct event ev;
+    __s64 recv_boot_ns;
+    __s64 expected;
+    __s64 diff;
+    __u32 state;
+    __u32 _pad;
 };
 
-/* ===== trusted timeline ===== */
-static time_t trusted_wall;
-static struct timespec trusted_boot;
+/* ===== trusted timeline (RCU-style publication) =====
+ *
+ * The anchor is immutable once published. Consumers load the current
+ * pointer with acquire semantics and never lock; a re-anchor allocates a
+ * new node and CASes it in. Replaced nodes are freed once every consumer
+ * has passed a quiescent point (between perf buffer batches) after the
+ * swap, so a reader can never see a node being freed or half-written.
+ */
+struct anchor {
+    time_t wall;                 /* trusted wall clock at boot */
+    struct timespec boot;        /* CLOCK_BOOTTIME */
+    struct anchor *retired_next;
+    __u64 retired_epoch;
+};
+
+static struct anchor *cur_anchor;            /* __atomic access only */
+static __u64 anchor_epoch = 1;
+static __u64 reader_epoch[MAX_CONSUMERS];    /* last quiescent epoch */
+static int n_readers = 1;
+static struct anchor *retired;
+static pthread_mutex_t retire_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct anchor *anchor_get(void)
+{
+    return __atomic_load_n(&cur_anchor, __ATOMIC_ACQUIRE);
+}
+
+/* caller holds no anchor pointer across this call */
+static void anchor_quiescent(void)
+{
+    __atomic_store_n(&reader_epoch[consumer_id],
+                     __atomic_load_n(&anchor_epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+}
+
+/* retire_lock held */
+static void anchor_reclaim(void)
+{
+    __u64 min = __atomic_load_n(&anchor_epoch, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n_readers; i++) {
+        __u64 r = __atomic_load_n(&reader_epoch[i], __ATOMIC_ACQUIRE);
+        if (r < min)
+            min = r;
+    }
+
+    struct anchor **pp = &retired;
+    while (*pp) {
+        struct anchor *a = *pp;
+        if (a->retired_epoch <= min) {
+            *pp = a->retired_next;
+            free(a);
+        } else {
+            pp = &a->retired_next;
+        }
+    }
+}
+
+/*
+ * Replace `old` by (wall, boot). Losing the race means another consumer
+ * re-anchored first from a newer event; that one wins.
+ */
+static int anchor_publish(const struct anchor *old, time_t wall,
+                          struct timespec boot)
+{
+    struct anchor *n = calloc(1, sizeof(*n));
+    if (!n)
+        return 0;
+    n->wall = wall;
+    n->boot = boot;
+
+    struct anchor *expect = (struct anchor *)old;
+    if (!__atomic_compare_exchange_n(&cur_anchor, &expect, n, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(n);
+        return 0;
+    }
+
+    if (old) {
+        pthread_mutex_lock(&retire_lock);
+        expect->retired_epoch =
+            __atomic_add_fetch(&anchor_epoch, 1, __ATOMIC_ACQ_REL);
+        expect->retired_next = retired;
+        retired = expect;
+        anchor_reclaim();
+        pthread_mutex_unlock(&retire_lock);
+    }
+    return 1;
+}
 
 static void init_trusted(void)
 {
-    trusted_wall = time(NULL);
-    clock_gettime(CLOCK_BOOTTIME, &trusted_boot);
+    struct timespec boot;
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    anchor_publish(anchor_get(), time(NULL), boot);
+}
+
+static time_t expected_wall(const struct anchor *a, struct timespec now_boot)
+{
+    time_t delta = now_boot.tv_sec - a->boot.tv_sec;
+    return a->wall + delta;
+}
+
+/* ===== bpffs anchor (survives restarts when pinned) ===== */
+static void anchor_store(void)
+{
+    const struct anchor *a = anchor_get();
+    struct anchor_val v = {
+        .trusted_wall = a->wall,
+        .trusted_boot_ns = (__s64)a->boot.tv_sec * 1000000000LL +
+                           a->boot.tv_nsec,
+        .seen_cnt = __atomic_load_n(&seen_cnt, __ATOMIC_RELAXED),
+    };
+    __u32 key = 0;
+
+    if (anchor_fd >= 0)
+        (void)bpf_map_update_elem(anchor_fd, &key, &v, BPF_ANY);
+}
+
+static int anchor_restore(void)
+{
+    struct anchor_val v = {0};
+    struct timespec boot;
+    __u32 key = 0;
+
+    if (bpf_map_lookup_elem(anchor_fd, &key, &v) != 0 ||
+        v.trusted_boot_ns == 0)
+        return 0;
+
+    boot.tv_sec  = v.trusted_boot_ns / 1000000000LL;
+    boot.tv_nsec = v.trusted_boot_ns % 1000000000LL;
+    anchor_publish(anchor_get(), (time_t)v.trusted_wall, boot);
+    seen_cnt = v.seen_cnt;
+    return 1;
 }
 
-static time_t expected_wall(struct timespec now_boot)
+static void seen_cnt_update(__u64 cnt)
 {
-    time_t delta = now_boot.tv_sec - trusted_boot.tv_sec;
-    return trusted_wall + delta;
+    __u64 cur = __atomic_load_n(&seen_cnt, __ATOMIC_RELAXED);
+    while (cnt > cur &&
+           !__atomic_compare_exchange_n(&seen_cnt, &cur, cnt, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
 }
 
-static const char *classify(time_t new_wall,
-                            time_t expected,
-                            time_t *out_diff)
+enum time_state {
+    TS_CURRENT,
+    TS_FUTURE,
+    TS_PAST,
+};
+
+static const char *const time_state_str[] = {
+    [TS_CURRENT] = "CURRENT",
+    [TS_FUTURE]  = "FUTURE",
+    [TS_PAST]    = "PAST",
+};
+
+static enum time_state classify(time_t new_wall,
+                                time_t expected,
+                                long eps,
+                                time_t *out_diff)
 {
     time_t diff = new_wall - expected;
     if (out_diff)
         *out_diff = diff;
 
-    if (diff > EPSILON_SEC)
-        return "FUTURE";
-    if (diff < -EPSILON_SEC)
-        return "PAST";
-    return "CURRENT";
+    if (diff > eps)
+        return TS_FUTURE;
+    if (diff < -eps)
+        return TS_PAST;
+    return TS_CURRENT;
+}
+
+/* ===== container scope (-G, -g) =====
+ *
+ * -G path[:epsilon] names a cgroup v2 directory; its id (the directory's
+ * inode, as bpf_get_current_cgroup_id() returns it) goes into the BPF
+ * cgroups map before attach, with its own epsilon. With -g the BPF side
+ * drops calls from every other cgroup before it counts or reads them,
+ * so event volume follows the watched containers, not the host. Calls
+ * from a nested cgroup match only if it is listed itself.
+ *
+ * The table is written once at startup; consumers only read it.
+ */
+#define CG_MAX       64         /* cgroups max_entries */
+
+struct container {
+    __u64 id;
+    long epsilon_sec;           /* < 0: -e / config */
+    char name[AF_NAME_MAX + 1];
+};
+
+static struct container containers[CG_MAX];
+static int n_containers;
+static int cg_only;                 /* -g */
+static int fd_cgroups = -1;
+
+/* cgroup v2 ids are the 8-byte file handle of the cgroup directory */
+static int cg_id(const char *path, __u64 *id)
+{
+    union {
+        struct file_handle fh;
+        char b[sizeof(struct file_handle) + sizeof(__u64)];
+    } h;
+    int mount_id;
+
+    h.fh.handle_bytes = sizeof(__u64);
+    if (name_to_handle_at(AT_FDCWD, path, &h.fh, &mount_id, 0) != 0)
+        return -errno;
+    if (h.fh.handle_bytes != sizeof(__u64))
+        return -EINVAL;
+    memcpy(id, h.fh.f_handle, sizeof(*id));
+    return 0;
+}
+
+static int cg_add(const char *arg)
+{
+    char path[PATH_MAX];
+    const char *colon = strrchr(arg, ':');
+    long eps = -1;
+    char *end;
+
+    if (n_containers == CG_MAX)
+        return -ENOSPC;
+    if (strlen(arg) >= sizeof(path))
+        return -ENAMETOOLONG;
+    snprintf(path, sizeof(path), "%s", arg);
+    if (colon) {
+        eps = strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end || eps < 0)
+            return -EINVAL;
+        path[colon - arg] = '\0';
+    }
+
+    struct container *c = &containers[n_containers];
+    int err = cg_id(path, &c->id);
+    if (err)
+        return err;
+    size_t len = strlen(path);
+    while (len > 1 && path[len - 1] == '/')
+        path[--len] = '\0';
+    const char *base = strrchr(path, '/');
+    snprintf(c->name, sizeof(c->name), "%s", base && base[1] ? base + 1 : path);
+    c->epsilon_sec = eps;
+    n_containers++;
+    return 0;
+}
+
+static const struct container *cg_find(__u64 id)
+{
+    for (int i = 0; i < n_containers; i++)
+        if (containers[i].id == id)
+            return &containers[i];
+    return NULL;
+}
+
+static long cg_epsilon(__u64 id)
+{
+    const struct container *c = id ? cg_find(id) : NULL;
+    if (c && c->epsilon_sec >= 0)
+        return c->epsilon_sec;
+    return __atomic_load_n(&epsilon_sec, __ATOMIC_RELAXED);
+}
+
+/* counters of a cgroup already in a pinned map are kept */
+static int cg_fill(int fd)
+{
+    for (int i = 0; i < n_containers; i++) {
+        struct cg_val v;
+        if (bpf_map_lookup_elem(fd, &containers[i].id, &v) != 0)
+            memset(&v, 0, sizeof(v));
+        v.epsilon_sec = containers[i].epsilon_sec;
+        if (bpf_map_update_elem(fd, &containers[i].id, &v, BPF_ANY) != 0)
+            return -errno;
+    }
+    return 0;
+}
+
+/* ===== end-to-end latency (-H) =====
+ *
+ * Every event is stamped on CLOCK_BOOTTIME, the clock the BPF side
+ * stamps it with, at each stage:
+ *
+ *   ring      syscall -> read from the perf buffer
+ *   classify  read -> classified
+ *   enqueue   classified -> binlog record + coalescer/formatter done
+ *   write     enqueued -> the batch holding its line was written
+ *   fsync     written -> fdatasync returned (-S)
+ *   e2e       syscall -> written, or synced with -S
+ *
+ * write/fsync/e2e count events that produced a line; coalesced ones end
+ * at enqueue. On replay, ring is taken from the trace and the rest is
+ * measured. Histograms are log-linear (4 buckets per power of two), one
+ * set per consumer; SIGUSR1 and exit write them to the -H file and the
+ * percentiles to the alert log.
+ */
+enum lat_stage {
+    LAT_RING,
+    LAT_CLASSIFY,
+    LAT_ENQUEUE,
+    LAT_WRITE,
+    LAT_FSYNC,
+    LAT_E2E,
+    LAT_MAX,
+};
+
+static const char *const lat_names[LAT_MAX] = {
+    "ring", "classify", "enqueue", "write", "fsync", "e2e",
+};
+
+#define LAT_BUCKETS 256
+
+static const char *lat_path;        /* -H; NULL = not measuring */
+static int alert_sync;              /* -S: fdatasync each alert batch */
+static volatile sig_atomic_t lat_dump_pending;
+static __u64 lat_hist[MAX_CONSUMERS][LAT_MAX][LAT_BUCKETS];
+static __thread __s64 lat_cur_emit; /* event being enqueued, 0 = none */
+
+static __s64 lat_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (__s64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* [0, 4) exact, then 4 buckets per power of two */
+static int lat_bucket(__s64 v)
+{
+    if (v < 4)
+        return v < 0 ? 0 : (int)v;
+    int msb = 63 - __builtin_clzll((unsigned long long)v);
+    return (msb - 1) * 4 + (int)((v >> (msb - 2)) & 3);
+}
+
+static __s64 lat_bucket_lo(int i)
+{
+    if (i < 4)
+        return i;
+    return (__s64)(4 + i % 4) << (i / 4 - 1);
+}
+
+static void lat_add(enum lat_stage st, __s64 ns)
+{
+    __atomic_fetch_add(&lat_hist[consumer_id][st][lat_bucket(ns)], 1,
+                       __ATOMIC_RELAXED);
+}
+
+static void on_usr1(int sig)
+{
+    (void)sig;
+    lat_dump_pending = 1;
+}
+
+/* ===== logging =====
+ *
+ * SETTIMEOFDAY lines are formatted by alert_fmt.h straight into a
+ * per-thread batch and written with one O_APPEND write per perf buffer
+ * batch (or when full). Everything else is rare and goes through
+ * log_alert(), which writes the thread's pending batch first so lines
+ * from one thread stay in order. Each write is a chain_log.h batch,
+ * sealed by its #CHAIN line (-m 0: plain log).
+ */
+#define ALERT_BATCH (16 * 1024)
+#define ALERT_LINES (ALERT_BATCH / 64)  /* shorter than any line */
+
+static __thread char alert_buf[ALERT_BATCH];
+static __thread size_t alert_len;
+static struct chain_log chain;
+static long chain_records = CL_RECORDS;    /* -m */
+static long chain_sec = CL_SECONDS;        /* -M */
+
+/* -H: per line in the batch, syscall and enqueue time */
+static __thread struct {
+    __s64 emit;                 /* 0: summary, no single syscall */
+    __s64 enq;
+} alert_ts[ALERT_LINES];
+static __thread int alert_n;
+
+static void alert_flush(void)
+{
+    if (alert_len == 0)
+        return;
+    if (alert_fd >= 0) {
+        cl_write(&chain, alert_buf, alert_len);
+        __s64 done = lat_path ? lat_now() : 0, synced = done;
+        if (alert_sync) {
+            fdatasync(alert_fd);
+            synced = lat_path ? lat_now() : 0;
+        }
+        for (int i = 0; lat_path && i < alert_n; i++) {
+            lat_add(LAT_WRITE, done - alert_ts[i].enq);
+            if (alert_sync)
+                lat_add(LAT_FSYNC, synced - done);
+            if (alert_ts[i].emit)
+                lat_add(LAT_E2E, synced - alert_ts[i].emit);
+        }
+    }
+    alert_len = 0;
+    alert_n = 0;
+}
+
+/* room for one line of either schema */
+static char *alert_reserve(void)
+{
+    if (ALERT_BATCH - alert_len < AF_LINE_MAX || alert_n == ALERT_LINES)
+        alert_flush();
+    return alert_buf + alert_len;
+}
+
+static void alert_commit(const char *end, __s64 emit)
+{
+    alert_len = end - alert_buf;
+    if (lat_path) {
+        alert_ts[alert_n].emit = emit;
+        alert_ts[alert_n].enq = lat_now();
+        alert_n++;
+    }
 }
 
-/* ===== logging ===== */
 static void log_alert(const char *fmt, ...)
 {
     if (alert_fd < 0)
@@ -85,43 +560,307 @@ static void log_alert(const char *fmt, ...)
     int len = vsnprintf(buf, sizeof(buf), fmt, ap);
     va_end(ap);
 
-    if (len > 0)
-        write(alert_fd, buf, len);
+    if (len <= 0)
+        return;
+    if (len >= (int)sizeof(buf))
+        len = sizeof(buf) - 1;
+    alert_flush();
+
+    if (alert_style == AF_JSON) {
+        char json[6 * sizeof(buf) + 32];
+        size_t n = len;
+        if (n && buf[n - 1] == '\n')
+            n--;
+        len = af_log_json(json, buf, n) - json;
+        cl_write(&chain, json, len);
+        return;
+    }
+    cl_write(&chain, buf, len);
 }
 
-/* ===== perf callbacks ===== */
-static void handle_event(void *ctx, int cpu, void *data, unsigned int size)
+/* ===== binary per-event log (-b) =====
+ *
+ * Every event is kept here even when the text log only carries the
+ * coalesced summary. Records are batched per consumer thread and
+ * written with one O_APPEND write per batch.
+ */
+#define BINLOG_BATCH 64
+
+static int binlog_fd = -1;
+static __thread struct alert_rec binlog_buf[BINLOG_BATCH];
+static __thread int binlog_n;
+
+static void binlog_flush(void)
 {
-    (void)ctx;
-    (void)cpu;
+    if (binlog_fd < 0 || binlog_n == 0)
+        return;
+    if (write(binlog_fd, binlog_buf, binlog_n * sizeof(binlog_buf[0])) < 0)
+        log_alert("binlog write error=%d\n", -errno);
+    binlog_n = 0;
+}
 
-    if (size < sizeof(struct event))
+static void binlog_append(const struct alert_rec *r)
+{
+    if (binlog_fd < 0)
         return;
+    binlog_buf[binlog_n++] = *r;
+    if (binlog_n == BINLOG_BATCH)
+        binlog_flush();
+}
 
-    const struct event *e = data;
+/* ===== alert stream to a collector (-A) =====
+ *
+ * Every event, like the binlog, batched per consumer thread into frames
+ * for the collector (alert_stream.h). The connection is driven from the
+ * main loop only; a frame cut on a consumer just lands in the spool.
+ */
+static const char *stream_addr;
+static const char *stream_spool;
+static const char *stream_host;
+static long stream_batch_kb = 32, stream_batch_ms = 200, stream_spool_kb = 4096;
 
-    struct timespec now_boot;
-    clock_gettime(CLOCK_BOOTTIME, &now_boot);
+static void stream_append(const struct alert_rec *r, __s64 ev_boot_ns)
+{
+    if (!as_ag.sp)
+        return;
+    struct as_alert a = {
+        .cnt          = r->ev.cnt,
+        .new_wall     = r->ev.tv_sec,
+        .expected     = r->expected,
+        .diff         = r->diff,
+        .tz           = r->ev.tz_minuteswest,
+        .ktime_ns     = r->ev.ktime_ns,
+        .recv_boot_ns = r->recv_boot_ns,
+        .pid          = r->ev.pid,
+        .uid          = r->ev.uid,
+        .state        = r->state,
+        .cgroup_id    = r->ev.cgroup_id,
+    };
+    memcpy(a.comm, r->ev.comm, sizeof(a.comm));
+    as_append(TRACE_ALERT, ev_boot_ns, &a, sizeof(a));
+}
 
-    time_t expected = expected_wall(now_boot);
+/* once the trusted anchor is known: it goes into the hello */
+static int stream_open(void)
+{
+    const struct anchor *an = anchor_get();
+    if (!stream_addr)
+        return 0;
+    int err = as_agent_open(stream_addr, stream_spool,
+                            (size_t)stream_spool_kb * 1024,
+                            (size_t)stream_batch_kb * 1024, (int)stream_batch_ms,
+                            stream_host, TRACE_SRC_CLOCK, an->wall,
+                            (__s64)an->boot.tv_sec * 1000000000LL + an->boot.tv_nsec,
+                            epsilon_sec);
+    if (err) {
+        log_alert("STREAM addr=%s error=%d\n", stream_addr, err);
+        return err;
+    }
+    log_alert("STREAM addr=%s host=%s stream=%016llx spooled_bytes=%llu\n",
+              stream_addr, as_ag.hello.host,
+              (unsigned long long)as_ag.sp->stream_id,
+              (unsigned long long)(as_ag.sp->tail - as_ag.sp->head));
+    return 0;
+}
+
+/* main thread, between polls */
+static void stream_poll(void)
+{
+    switch (as_agent_poll()) {
+    case AS_EV_UP:
+        log_alert("STREAM up addr=%s spooled_bytes=%llu\n", stream_addr,
+                  (unsigned long long)(as_ag.sp->tail - as_ag.sp->head));
+        break;
+    case AS_EV_DOWN:
+        log_alert("STREAM down addr=%s error=%d\n", stream_addr, as_ag.err);
+        break;
+    case AS_EV_NONE:
+        break;
+    }
+}
+
+static void stream_close(void)
+{
+    if (!as_ag.sp)
+        return;
+    as_agent_close(2000);
+    log_alert("STREAM frames=%llu records=%llu sent=%llu dropped=%llu "
+              "unacked_bytes=%llu connects=%llu\n",
+              (unsigned long long)as_ag.frames,
+              (unsigned long long)as_ag.records,
+              (unsigned long long)as_ag.sent,
+              (unsigned long long)as_ag.dropped,
+              (unsigned long long)as_ag.unacked,
+              (unsigned long long)as_ag.connects);
+}
+
+/* ===== coalesced alert output ===== */
+static struct coalescer coal;
+static struct stack_sym stacks = {  /* fd -1 in replay: ids, no frames */
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .fd = -1,
+};
+
+static void emit_alert(const struct coalesce_entry *ce, const void *first)
+{
+    if (alert_fd < 0)
+        return;
+
+    if (first) {
+        const struct alert_rec *r = first;
+        struct af_settime a = {
+            .cnt      = r->ev.cnt,
+            .new_wall = r->ev.tv_sec,
+            .expected = r->expected,
+            .diff     = r->diff,
+            .state    = time_state_str[r->state],
+            .tz       = r->ev.tz_minuteswest,
+            .ktime_ns = r->ev.ktime_ns,
+            .boot_ns  = r->recv_boot_ns,
+            .pid      = r->ev.pid,
+            .comm     = r->ev.comm,
+            .cgroup   = r->ev.cgroup_id,
+        };
+        const struct container *c = cg_find(r->ev.cgroup_id);
+        struct ss_text t;
+
+        if (c)
+            a.container = c->name;
+
+        /* only the first event of a key is symbolized: summaries have no stack */
+        ss_frames(&stacks, r->ev.pid, r->ev.comm, r->ev.kstack_id,
+                  r->ev.ustack_id, &t);
+        if (t.klen || t.ulen) {
+            a.ustack = t.u;
+            a.ustack_len = t.ulen;
+            a.kstack = t.k;
+            a.kstack_len = t.klen;
+        }
+        alert_commit(af_settime(alert_reserve(), &a, alert_style),
+                     lat_cur_emit);
+        return;
+    }
+
+    struct af_summary a = {
+        .pid      = ce->pid,
+        .comm     = ce->comm,
+        .state    = time_state_str[ce->state],
+        .count    = ce->count,
+        .min_diff = ce->min_diff,
+        .max_diff = ce->max_diff,
+        .first_ns = ce->first_ns,
+        .last_ns  = ce->last_ns,
+        .last_cnt = ce->last_cnt,
+    };
+    alert_commit(af_summary(alert_reserve(), &a, alert_style), 0);
+}
+
+/* ===== per-stage timing (replay only) ===== */
+enum stage {
+    STAGE_CLASSIFY,
+    STAGE_BINLOG,
+    STAGE_COALESCE,     /* includes formatting + write of emitted lines */
+    STAGE_ANCHOR,
+    STAGE_CORRELATE,    /* tamper window index update */
+    STAGE_FILE,
+    STAGE_MAX,
+};
+
+static const char *const stage_names[STAGE_MAX] = {
+    "classify", "binlog", "coalesce", "anchor", "correlate", "file",
+};
+
+static __u64 stage_ns[STAGE_MAX];
+
+static long long mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* charge the time since *lap to `st`; lap == NULL when not measuring */
+static void stage_lap(enum stage st, long long *lap)
+{
+    if (!lap)
+        return;
+    long long now = mono_ns();
+    stage_ns[st] += now - *lap;
+    *lap = now;
+}
+
+/* ===== event pipeline (live and replay) ===== */
+
+/*
+ * CLOCK_BOOTTIME of the syscall: the kernel stamp, unless it cannot be
+ * one (a v1 trace stamped CLOCK_MONOTONIC, or it lies after receipt).
+ */
+static __s64 event_boot_ns(const struct event *e, __s64 recv_ns, int boot_ktime)
+{
+    if (!boot_ktime || e->ktime_ns == 0 || (__s64)e->ktime_ns > recv_ns)
+        return recv_ns;
+    return (__s64)e->ktime_ns;
+}
+
+/*
+ * ev_boot_ns is when the clock was set and recv_ns when we read it;
+ * expected is taken at ev_boot_ns so time spent queued in the perf
+ * buffer or waiting for a consumer does not show up in diff.
+ */
+static void process_event(const struct event *e, __s64 ev_boot_ns,
+                          __s64 recv_ns, long long *lap)
+{
+    __s64 t_read = 0, t_emit = 0;
+    if (lat_path) {
+        t_read = lap ? lat_now() : recv_ns;
+        t_emit = t_read - (recv_ns - ev_boot_ns);
+        lat_add(LAT_RING, recv_ns - ev_boot_ns);
+    }
+
+    struct timespec ev_boot = {
+        .tv_sec  = ev_boot_ns / 1000000000LL,
+        .tv_nsec = ev_boot_ns % 1000000000LL,
+    };
+    const struct anchor *a = anchor_get();
+    time_t expected = expected_wall(a, ev_boot);
     time_t new_wall = (time_t)e->tv_sec;
 
     time_t diff;
     /* * classify 함수는 new_wall과 expected의 차이를 계산하여
-     * 오차 범위(EPSILON_SEC) 이내면 "CURRENT"를 반환합니다.
+     * 오차 범위(epsilon_sec) 이내면 TS_CURRENT를 반환합니다.
      */
-    const char *cls = classify(new_wall, expected, &diff);
-
-    log_alert(
-        "SETTIMEOFDAY cnt=%llu new=%ld expected=%ld diff=%ld state=%s tz=%ld ktime_ns=%llu\n",
-        (unsigned long long)e->cnt,
-        (long)new_wall,
-        (long)expected,
-        (long)diff,
-        cls,
-        (long)e->tz_minuteswest,
-        (unsigned long long)e->ktime_ns
-    );
+    enum time_state st = classify(new_wall, expected,
+                                  cg_epsilon(e->cgroup_id), &diff);
+    stage_lap(STAGE_CLASSIFY, lap);
+    __s64 t_class = lat_path ? lat_now() : 0;
+    if (lat_path)
+        lat_add(LAT_CLASSIFY, t_class - t_read);
+
+    /*
+     * Buffers are per CPU and may be drained by different consumers, so
+     * cnt arrives out of order; in-stream loss is reported by handle_lost.
+     */
+    seen_cnt_update(e->cnt);
+
+    struct alert_rec r = {
+        .ev = *e,
+        .recv_boot_ns = recv_ns,
+        .expected = expected,
+        .diff = diff,
+        .state = st,
+    };
+    binlog_append(&r);
+    stream_append(&r, ev_boot_ns);
+    stage_lap(STAGE_BINLOG, lap);
+
+    /* storms of identical (pid, state) events collapse into summaries */
+    lat_cur_emit = t_emit;
+    coalesce_event(&coal, e->pid, e->comm, st, (long)diff, e->cnt,
+                   r.recv_boot_ns, &r);
+    lat_cur_emit = 0;
+    stage_lap(STAGE_COALESCE, lap);
+    if (lat_path)
+        lat_add(LAT_ENQUEUE, lat_now() - t_class);
 
     /* * [수정된 로직] Drift 보정 (Re-anchoring)
      * * 상태가 "CURRENT" (정상 범위 내)라면, 이 시간 변경은 
@@ -129,11 +868,12 @@ static void handle_event(void *ctx, int cpu, void *data, unsigned int size)
      * * 이때 기준점(trusted_wall/boot)을 현재 시점으로 '갱신'해줘야
      * 그동안 누적된 Monotonic Clock의 오차(Drift)가 사라집니다.
      */
-    if (strcmp(cls, "CURRENT") == 0) {
+    if (st == TS_CURRENT) {
         // 정상적인 변경이라면, 새로운 시간을 신뢰할 수 있는 기준으로 삼음
-        trusted_wall = new_wall; 
-        trusted_boot = now_boot;
-        
+        // (다른 consumer가 먼저 갱신했다면 그쪽이 우선)
+        if (anchor_publish(a, new_wall, ev_boot))
+            anchor_store();
+
         // (선택) 디버깅용 로그: 앵커가 갱신되었음을 기록
         // log_alert("[INFO] Anchor re-synced to absorb drift.\n");
     } else {
@@ -144,34 +884,1049 @@ static void handle_event(void *ctx, int cpu, void *data, unsigned int size)
         // 변경 없음: 오차가 큰 비정상 변경 시에는 기준점을 바꾸지 않아야 
         // 사용자가 다시 원래대로 돌려놓을 때까지 계속 경고를 띄울 수 있음.
     }
+    stage_lap(STAGE_ANCHOR, lap);
+}
+
+/* ===== overload degradation (-O) =====
+ *
+ * Consumers sample how full the perf rings are every OV_EVERY events
+ * (head - tail of each mmap'd ring, no syscall); a lost-sample report
+ * counts as full. The main loop acts on the peak: above the high
+ * watermark it sets the control flag and the BPF side only keeps per-CPU
+ * aggregates; once below the low one, and at least OV_HOLD_MS later, the
+ * flag is cleared and the aggregates of the window are logged as one
+ * OVERLOAD_SUMMARY and reset. Calls that land between clearing the flag
+ * and the reset are counted in neither.
+ */
+#define OV_EVERY   256
+#define OV_HOLD_MS 1000
+
+static long ov_high = 75, ov_low = 25;     /* -O high,low (% of a ring) */
+static int fd_control = -1, fd_agg = -1;
+static struct perf_buffer *ov_pb;
+static int ov_peak;                 /* __atomic max since the last tick */
+static __u64 ov_lost;               /* __atomic */
+static __thread unsigned ov_n;
+static int ov_on;
+static __s64 ov_since;
+static int ov_on_fill;
+
+static int ov_fill(void)
+{
+    size_t n = perf_buffer__buffer_cnt(ov_pb);
+    int max = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        void *base;
+        size_t size;
+        if (perf_buffer__buffer(ov_pb, (int)i, &base, &size) != 0 || !size)
+            continue;
+        struct perf_event_mmap_page *h = base;
+        __u64 head = __atomic_load_n(&h->data_head, __ATOMIC_ACQUIRE);
+        __u64 tail = __atomic_load_n(&h->data_tail, __ATOMIC_RELAXED);
+        int pct = (int)((head - tail) * 100 / size);
+        if (pct > max)
+            max = pct;
+    }
+    return max;
+}
+
+/* consumer side, per event */
+static void ov_sample(void)
+{
+    if (!ov_pb || ++ov_n % OV_EVERY)
+        return;
+    int fill = ov_fill();
+    int cur = __atomic_load_n(&ov_peak, __ATOMIC_RELAXED);
+    while (fill > cur &&
+           !__atomic_compare_exchange_n(&ov_peak, &cur, fill, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static int ov_set(__u32 on)
+{
+    struct ctl_val v = { .aggregate = on };
+    __u32 key = 0;
+    return bpf_map_update_elem(fd_control, &key, &v, BPF_ANY);
+}
+
+static void ov_summary(__s64 now)
+{
+    int ncpu = libbpf_num_possible_cpus();
+    __u32 key = 0;
+
+    if (ncpu <= 0)
+        return;
+    struct agg_val *v = calloc(ncpu, sizeof(*v)), t = { 0 };
+    if (!v)
+        return;
+    if (bpf_map_lookup_elem(fd_agg, &key, v) == 0) {
+        for (int c = 0; c < ncpu; c++) {
+            if (!v[c].count)
+                continue;
+            if (!t.count || v[c].min_sec < t.min_sec)
+                t.min_sec = v[c].min_sec;
+            if (!t.count || v[c].max_sec > t.max_sec)
+                t.max_sec = v[c].max_sec;
+            if (!t.count || v[c].first_ns < t.first_ns)
+                t.first_ns = v[c].first_ns;
+            if (v[c].last_ns > t.last_ns)
+                t.last_ns = v[c].last_ns;
+            if (v[c].last_cnt > t.last_cnt)
+                t.last_cnt = v[c].last_cnt;
+            t.count += v[c].count;
+            t.future += v[c].future;
+            t.past += v[c].past;
+        }
+        memset(v, 0, ncpu * sizeof(*v));
+        (void)bpf_map_update_elem(fd_agg, &key, v, BPF_ANY);
+    }
+    free(v);
+
+    log_alert("OVERLOAD_SUMMARY start_boot_ns=%lld end_boot_ns=%lld fill_pct=%d "
+              "events=%llu future=%llu past=%llu min_new=%lld max_new=%lld "
+              "first_ktime_ns=%llu last_ktime_ns=%llu last_cnt=%llu\n",
+              (long long)ov_since, (long long)now, ov_on_fill,
+              (unsigned long long)t.count, (unsigned long long)t.future,
+              (unsigned long long)t.past, (long long)t.min_sec,
+              (long long)t.max_sec, (unsigned long long)t.first_ns,
+              (unsigned long long)t.last_ns, (unsigned long long)t.last_cnt);
+}
+
+/* main loop, every tick */
+static void ov_tick(__s64 now)
+{
+    if (!ov_pb)
+        return;
+    int fill = __atomic_exchange_n(&ov_peak, 0, __ATOMIC_RELAXED);
+    int cur = ov_fill();
+    if (cur > fill)
+        fill = cur;
+    if (__atomic_exchange_n(&ov_lost, 0, __ATOMIC_RELAXED))
+        fill = 100;
+
+    if (!ov_on && fill >= ov_high) {
+        if (ov_set(1) != 0)
+            return;
+        ov_on = 1;
+        ov_since = now;
+        ov_on_fill = fill;
+        log_alert("OVERLOAD on fill_pct=%d high=%ld low=%ld\n", fill,
+                  ov_high, ov_low);
+    } else if (ov_on && fill <= ov_low &&
+               now - ov_since >= OV_HOLD_MS * 1000000LL) {
+        if (ov_set(0) != 0)
+            return;
+        ov_on = 0;
+        ov_summary(now);
+    }
+}
+
+/* at exit: leave the (maybe pinned) program streaming */
+static void ov_close(__s64 now)
+{
+    if (ov_pb && ov_on && ov_set(0) == 0) {
+        ov_on = 0;
+        ov_summary(now);
+    }
+}
+
+static void ov_open(struct perf_buffer *pb, __s64 now)
+{
+    struct ctl_val v = { 0 };
+    __u32 key = 0;
+
+    ov_pb = pb;
+    /* left set by a pinned run that died degraded; start unknown (0) */
+    if (bpf_map_lookup_elem(fd_control, &key, &v) == 0 && v.aggregate) {
+        ov_on = 1;
+        ov_close(now);
+    }
+}
+
+/* ===== perf callbacks ===== */
+static void handle_event(void *ctx, int cpu, void *data, unsigned int size)
+{
+    (void)ctx;
+    (void)cpu;
+
+    struct event ev;
+    if (event_read(&ev, data, size) != 0)
+        return;
+
+    struct timespec now_boot;
+    clock_gettime(CLOCK_BOOTTIME, &now_boot);
+    __s64 recv_ns = (__s64)now_boot.tv_sec * 1000000000LL + now_boot.tv_nsec;
+
+    trace_append(TRACE_CLOCK, recv_ns, &ev, sizeof(ev), NULL, 0);
+    process_event(&ev, event_boot_ns(&ev, recv_ns, 1), recv_ns, NULL);
+    ov_sample();
 }
+
 static void handle_lost(void *ctx, int cpu, __u64 lost_cnt)
 {
     (void)ctx;
+    __atomic_add_fetch(&ov_lost, lost_cnt, __ATOMIC_RELAXED);
     log_alert("LOST_EVENTS cpu=%d lost=%llu\n",
               cpu, (unsigned long long)lost_cnt);
 }
 
+/* ===== down-time backlog =====
+ *
+ * With no reader holding the perf buffers the program writes to the
+ * pinned backlog ring instead. A restarted reader runs it through the
+ * normal path, oldest first, once before the perf buffer exists (so the
+ * cnt gap only counts what the ring dropped) and once after (events
+ * emitted in between).
+ */
+static struct ring_buffer *backlog_rb;
+static unsigned long long backlog_n;
+
+static int handle_backlog(void *ctx, void *data, size_t size)
+{
+    handle_event(ctx, -1, data, (unsigned int)size);
+    backlog_n++;
+    return 0;
+}
+
+static void backlog_open(int fd)
+{
+    if (fd < 0)
+        return;                 /* pinned before the backlog existed */
+    backlog_rb = ring_buffer__new(fd, handle_backlog, NULL, NULL);
+    if (libbpf_get_error(backlog_rb)) {
+        log_alert("BACKLOG error=%ld\n", libbpf_get_error(backlog_rb));
+        backlog_rb = NULL;
+        return;
+    }
+    ring_buffer__consume(backlog_rb);
+}
+
+static void backlog_close(void)
+{
+    if (!backlog_rb)
+        return;
+    ring_buffer__consume(backlog_rb);
+    ring_buffer__free(backlog_rb);
+    backlog_rb = NULL;
+    if (backlog_n)
+        log_alert("BACKLOG drained=%llu\n", backlog_n);
+}
+
+/* ===== sharded consumers =====
+ *
+ * Thread t owns the per-CPU buffers with idx % n == t and waits on them
+ * through its own epoll set, so no buffer is ever consumed twice and
+ * callbacks for one CPU stay ordered.
+ */
+struct consumer {
+    pthread_t tid;
+    int id;
+    int epfd;
+    int running;
+    struct perf_buffer *pb;
+};
+
+static void *consumer_main(void *arg)
+{
+    struct consumer *c = arg;
+    struct epoll_event evs[64];
+
+    consumer_id = c->id;
+
+    while (!exiting) {
+        int n = epoll_wait(c->epfd, evs, 64, 100);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            log_alert("consumer=%d epoll error=%d\n", c->id, -errno);
+            break;
+        }
+        for (int i = 0; i < n; i++)
+            perf_buffer__consume_buffer(c->pb, evs[i].data.u64);
+        binlog_flush();
+        as_tick();
+        alert_flush();
+        trace_flush();
+        anchor_quiescent();
+    }
+    binlog_flush();
+    as_cut();
+    alert_flush();
+    trace_flush();
+    return NULL;
+}
+
+static int consumers_start(struct consumer *cs, int n, struct perf_buffer *pb)
+{
+    size_t nbuf = perf_buffer__buffer_cnt(pb);
+
+    for (int t = 0; t < n; t++) {
+        cs[t].id = t;
+        cs[t].pb = pb;
+        cs[t].running = 0;
+        cs[t].epfd = -1;
+    }
+
+    for (int t = 0; t < n; t++) {
+        cs[t].epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (cs[t].epfd < 0)
+            return -errno;
+    }
+
+    for (size_t i = 0; i < nbuf; i++) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = i };
+        int fd = perf_buffer__buffer_fd(pb, i);
+        if (fd < 0)
+            continue;
+        if (epoll_ctl(cs[i % n].epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            return -errno;
+    }
+
+    for (int t = 0; t < n; t++) {
+        int err = pthread_create(&cs[t].tid, NULL, consumer_main, &cs[t]);
+        if (err)
+            return -err;
+        cs[t].running = 1;
+    }
+    return 0;
+}
+
+/* ===== replay (-P) =====
+ *
+ * Feeds recorded traces through the same pipeline with no BPF and no
+ * root. Receive times come from the records, so classification,
+ * re-anchoring and coalescing decide as they did live (for a single
+ * consumer). File records from a watcher trace are classified against
+ * the replayed trusted timeline and joined with the tamper windows the
+ * replayed clock events have built so far.
+ */
+static const char *const file_field_names[] = { "mtime", "atime", "ctime" };
+static struct tamper_index tamper;
+
+static void replay_file(const struct trace_file *f, size_t len,
+                        struct timespec now_boot, __s64 boot_ns)
+{
+    if (len < sizeof(*f))
+        return;
+
+    const struct anchor *a = anchor_get();
+    time_t expected = expected_wall(a, now_boot);
+    const struct tamper_win *sys = tamper_at(&tamper, boot_ns);
+    const __s64 v[3] = { f->mtime_ns, f->atime_ns, f->ctime_ns };
+    int plen = (int)strnlen(f->path, len - sizeof(*f));
+
+    for (int i = 0; i < 3; i++) {
+        if (!(f->changed & (1u << i)))
+            continue;
+        time_t diff;
+        time_t value = (time_t)(v[i] / 1000000000LL);
+        enum time_state st = classify(value, expected,
+                                      __atomic_load_n(&epsilon_sec, __ATOMIC_RELAXED),
+                                      &diff);
+        const struct tamper_win *w = tamper_written_in(&tamper, value, boot_ns);
+        log_alert(
+            "FILE path=%.*s field=%s value=%lld expected=%ld diff=%ld state=%s system=%s sys_offset=%lld in_window=%d win_offset=%lld\n",
+            plen, f->path,
+            file_field_names[i],
+            (long long)value,
+            (long)expected,
+            (long)diff,
+            time_state_str[st],
+            tamper_state_str(&tamper, sys),
+            sys ? (long long)sys->offset : 0LL,
+            w != NULL,
+            w ? (long long)w->offset : 0LL
+        );
+    }
+}
+
+static int replay(char *const *paths, int n, int realtime)
+{
+    struct trace_set ts;
+    int err = trace_load(&ts, paths, n);
+    if (err)
+        return err;
+
+    /* trusted timeline: the detector's, if a detector trace is present */
+    const struct trace_hdr *h = ts.hdr[0];
+    for (int f = ts.n_files - 1; f >= 0; f--) {
+        if (ts.hdr[f]->source != TRACE_SRC_CLOCK)
+            continue;
+        if (ts.hdr[f]->event_size != sizeof(struct event) &&
+            ts.hdr[f]->event_size != EVENT_SIZE_NOCG &&
+            ts.hdr[f]->event_size != EVENT_SIZE_NOSTACK) {
+            fprintf(stderr, "%s: recorded with a different struct event\n",
+                    paths[f]);
+            trace_unload(&ts);
+            return -EPROTO;
+        }
+        h = ts.hdr[f];
+    }
+
+    struct timespec boot = {
+        .tv_sec  = h->anchor_boot_ns / 1000000000LL,
+        .tv_nsec = h->anchor_boot_ns % 1000000000LL,
+    };
+    anchor_publish(anchor_get(), (time_t)h->anchor_wall, boot);
+    if (!epsilon_set)
+        epsilon_sec = h->epsilon;
+    tamper_init(&tamper, epsilon_sec);
+    if (stream_open()) {
+        trace_unload(&ts);
+        return -EINVAL;
+    }
+
+    log_alert("REPLAY_START traces=%d records=%zu trusted_wall=%lld epsilon=%ld realtime=%d\n",
+              ts.n_files, ts.n_items, (long long)h->anchor_wall,
+              epsilon_sec, realtime);
+
+    __u64 n_clock = 0, n_file = 0;
+    __s64 first = ts.n_items ? ts.item[0].boot_ns : 0;
+    __s64 tick = first, last = first;
+    long long t0 = mono_ns();
+
+    for (size_t i = 0; i < ts.n_items && !exiting; i++) {
+        const struct trace_item *it = &ts.item[i];
+        struct timespec now_boot = {
+            .tv_sec  = it->boot_ns / 1000000000LL,
+            .tv_nsec = it->boot_ns % 1000000000LL,
+        };
+        size_t len;
+        const void *p = trace_payload(it->rec, &len);
+
+        if (realtime) {
+            long long due = t0 + (it->boot_ns - first);
+            struct timespec ts_due = { due / 1000000000LL, due % 1000000000LL };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                   &ts_due, NULL) == EINTR && !exiting)
+                ;
+        }
+
+        long long lap = mono_ns();
+        switch (it->rec->type) {
+        case TRACE_CLOCK: {
+            struct event ev;
+            const struct event *e = &ev;
+            if (event_read(&ev, p, len) != 0)
+                break;
+            __s64 ev_ns = event_boot_ns(e, it->boot_ns,
+                    ts.hdr[it->file]->version >= TRACE_VERSION_BOOT_KTIME);
+            struct timespec ev_boot = {
+                .tv_sec  = ev_ns / 1000000000LL,
+                .tv_nsec = ev_ns % 1000000000LL,
+            };
+            /* process_event may re-anchor: take expected first */
+            time_t expected = expected_wall(anchor_get(), ev_boot);
+            process_event(e, ev_ns, it->boot_ns, &lap);
+            tamper_clock_event(&tamper, ev_ns, e->tv_sec, expected);
+            stage_lap(STAGE_CORRELATE, &lap);
+            n_clock++;
+            break;
+        }
+        case TRACE_FILE:
+            replay_file(p, len, now_boot, it->boot_ns);
+            stage_lap(STAGE_FILE, &lap);
+            n_file++;
+            break;
+        }
+
+        /* the live loops tick every 100ms; do the same on replayed time */
+        if (it->boot_ns - tick >= 100000000LL) {
+            coalesce_tick(&coal, it->boot_ns, 0);
+            as_tick();
+            stream_poll();
+            as_agent_throttle();    /* no deadline here: never drop */
+            cl_tick(&chain, cl_now());
+            tick = it->boot_ns;
+            stage_lap(STAGE_COALESCE, &lap);
+        }
+        anchor_quiescent();     /* nothing held between records */
+        last = it->boot_ns;
+    }
+
+    coalesce_tick(&coal, last, 1);
+    binlog_flush();
+    alert_flush();
+    double sec = (mono_ns() - t0) / 1e9;
+
+    char line[512];
+    int len = snprintf(line, sizeof(line),
+                       "REPLAY records=%llu clock=%llu file=%llu elapsed=%.3fs "
+                       "rate=%.0f events/s traced_span=%.3fs",
+                       (unsigned long long)(n_clock + n_file),
+                       (unsigned long long)n_clock,
+                       (unsigned long long)n_file, sec,
+                       sec > 0 ? (n_clock + n_file) / sec : 0.0,
+                       (last - first) / 1e9);
+    for (int st = 0; st < STAGE_MAX; st++) {
+        __u64 cnt = st == STAGE_FILE ? n_file : n_clock;
+        len += snprintf(line + len, sizeof(line) - len, " %s_ns=%.0f",
+                        stage_names[st], cnt ? (double)stage_ns[st] / cnt : 0.0);
+    }
+    fprintf(stderr, "%s\n", line);
+    log_alert("%s suppressed=%llu tamper_windows=%zu\n", line,
+              (unsigned long long)coal.suppressed, tamper.n);
+
+    tamper_free(&tamper);
+    trace_unload(&ts);
+    return 0;
+}
+
+/* ===== BPF run-time stats (-X) =====
+ *
+ * Every -X seconds one line per program with what the interval cost;
+ * the -H export carries the running totals.
+ */
+static struct bpf_stats bstats;
+
+static void bstats_log(void)
+{
+    for (int i = 0; i < bstats.n; i++) {
+        struct bs_sample s;
+        if (bs_sample(&bstats, i, &s) != 0)
+            continue;
+        log_alert("BPF_STATS prog=%s id=%u attach=%s runs=%llu avg_ns=%.1f "
+                  "runs_per_sec=%.1f total_runs=%llu total_ns=%llu\n",
+                  s.p->name, s.p->id, s.p->attach,
+                  (unsigned long long)s.runs, s.avg_ns, s.per_sec,
+                  (unsigned long long)s.total_runs,
+                  (unsigned long long)s.total_ns);
+    }
+}
+
+/* main thread, between polls */
+static void bstats_poll(void)
+{
+    if (bs_due(&bstats))
+        bstats_log();
+}
+
+/* ===== latency export (-H) =====
+ *
+ *   stage=ring lo_ns=1536 count=42
+ *   bpf_prog=handle_sys_enter attach=raw_syscalls runs=9 run_ns=612 avg_ns=68.0
+ *
+ * one line per non-empty bucket (lo_ns is its lower bound), then the
+ * BPF run-time totals with -X, written to a temp file and renamed over
+ * the -H path so readers never see half of it.
+ */
+static void lat_export(void)
+{
+    static __u64 h[LAT_MAX][LAT_BUCKETS];
+    char tmp[PATH_MAX];
+
+    memset(h, 0, sizeof(h));
+    for (int c = 0; c < MAX_CONSUMERS; c++)
+        for (int st = 0; st < LAT_MAX; st++)
+            for (int b = 0; b < LAT_BUCKETS; b++)
+                h[st][b] += __atomic_load_n(&lat_hist[c][st][b],
+                                            __ATOMIC_RELAXED);
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", lat_path);
+    FILE *fp = fopen(tmp, "we");
+    if (!fp) {
+        log_alert("LATENCY path=%s error=%d\n", lat_path, -errno);
+        return;
+    }
+
+    for (int st = 0; st < LAT_MAX; st++) {
+        __u64 n = 0, seen = 0;
+        __s64 p[3] = { 0, 0, 0 };
+        static const double q[3] = { 0.50, 0.99, 0.999 };
+        int k = 0;
+
+        for (int b = 0; b < LAT_BUCKETS; b++)
+            n += h[st][b];
+        for (int b = 0; b < LAT_BUCKETS; b++) {
+            if (!h[st][b])
+                continue;
+            fprintf(fp, "stage=%s lo_ns=%lld count=%llu\n", lat_names[st],
+                    (long long)lat_bucket_lo(b), (unsigned long long)h[st][b]);
+            seen += h[st][b];
+            /* report a bucket by its upper bound: never understated */
+            while (k < 3 && seen >= q[k] * n)
+                p[k++] = lat_bucket_lo(b + 1);
+        }
+        if (n)
+            log_alert("LATENCY stage=%s count=%llu p50_ns=%lld p99_ns=%lld "
+                      "p999_ns=%lld\n", lat_names[st], (unsigned long long)n,
+                      (long long)p[0], (long long)p[1], (long long)p[2]);
+    }
+
+    for (int i = 0; i < bstats.n; i++) {
+        struct bpf_prog_info info;
+        const struct bs_prog *bp = &bstats.prog[i];
+        if (bs_info(bp->fd, &info) != 0)
+            continue;
+        fprintf(fp, "bpf_prog=%s attach=%s runs=%llu run_ns=%llu avg_ns=%.1f\n",
+                bp->name, bp->attach, (unsigned long long)info.run_cnt,
+                (unsigned long long)info.run_time_ns,
+                info.run_cnt ? (double)info.run_time_ns / info.run_cnt : 0.0);
+    }
+
+    int bad = ferror(fp) | fclose(fp);
+    if (bad || rename(tmp, lat_path) < 0) {
+        log_alert("LATENCY path=%s error=%d\n", lat_path, -EIO);
+        unlink(tmp);
+    }
+}
+
+/* main thread, between polls */
+static void lat_poll(void)
+{
+    if (!lat_dump_pending || !lat_path)
+        return;
+    lat_dump_pending = 0;
+    lat_export();
+}
+
+/* ===== config reload (-C) =====
+ *
+ * epsilon and alert_log can change while attached: classify() reads
+ * epsilon atomically, the BPF copy lives in the mmap'd .bss, and the log
+ * fd is swapped in place with dup2(). Nothing is detached or re-opened,
+ * so no event falls between the old and the new config.
+ */
+static const char *cfg_path;
+static const char *cfg_name;
+static int cfg_ifd = -1, cfg_wd = -1;
+static char alert_path_cur[PATH_MAX];
+static volatile sig_atomic_t reload_pending;
+static struct perfbuffer_settimeofday_bpf *live_skel;  /* NULL when reused */
+
+static void on_hup(int sig)
+{
+    (void)sig;
+    reload_pending = 1;
+}
+
+static void config_apply(const struct ts_config *c)
+{
+    if (c->alert_log[0] && strcmp(c->alert_log, alert_path_cur) != 0) {
+        alert_flush();
+        int err = cl_reopen(&chain, c->alert_log);
+        if (err)
+            log_alert("CONFIG alert_log=%s error=%d\n", c->alert_log, err);
+        else
+            snprintf(alert_path_cur, sizeof(alert_path_cur), "%s",
+                     c->alert_log);
+    }
+
+    if (c->epsilon >= 0) {
+        __atomic_store_n(&epsilon_sec, c->epsilon, __ATOMIC_RELAXED);
+        if (live_skel)
+            live_skel->bss->epsilon_sec = c->epsilon;
+    }
+}
+
+/* main thread, between polls */
+static void config_poll(void)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+
+    while (cfg_ifd >= 0 && (len = read(cfg_ifd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < len; ) {
+            const struct inotify_event *e = (const void *)(buf + i);
+            if (cfg_event_hit(e, cfg_wd, cfg_name))
+                reload_pending = 1;
+            i += sizeof(*e) + e->len;
+        }
+    }
+
+    if (!reload_pending || !cfg_path)
+        return;
+    reload_pending = 0;
+
+    struct ts_config c = { .epsilon = -1 };
+    int err = cfg_load(cfg_path, &c);
+    if (err) {
+        log_alert("CONFIG path=%s error=%d kept=1\n", cfg_path, err);
+        return;
+    }
+    config_apply(&c);
+    log_alert("CONFIG path=%s epsilon=%ld alert_log=%s bpf=%d\n",
+              cfg_path, epsilon_sec, alert_path_cur, live_skel != NULL);
+    cfg_free(&c);
+}
+
+/* ===== BPF backend ===== */
+static int per_syscall;             /* -s: sys_enter_settimeofday only */
+
+static struct bpf_program *bpf_entry(struct perfbuffer_settimeofday_bpf *skel,
+                                     int syscall_tp)
+{
+    return syscall_tp ? skel->progs.handle_settimeofday
+                      : skel->progs.handle_sys_enter;
+}
+
+static int bpf_start(struct perfbuffer_settimeofday_bpf **out, const char *pin_dir)
+{
+    struct perfbuffer_settimeofday_bpf *skel;
+    int err;
+
+    /* open & load BPF (object embedded via the generated skeleton) */
+    *out = skel = perfbuffer_settimeofday_bpf__open();
+    if (!skel)
+        return -errno;
+
+    skel->rodata->target_nr = __NR_settimeofday;
+    skel->rodata->filter_cgroup = cg_only;
+    bpf_program__set_autoload(bpf_entry(skel, !per_syscall), false);
+
+    if (pin_dir) {
+        err = pin_set_map_paths(skel->obj, pin_dir);
+        if (err)
+            return err;
+    }
+
+    err = perfbuffer_settimeofday_bpf__load(skel);
+    if (err)
+        return err;
+    skel->bss->epsilon_sec = epsilon_sec;
+    live_skel = skel;
+    fd_cgroups = bpf_map__fd(skel->maps.cgroups);
+    err = cg_fill(fd_cgroups);    /* before attach: -g drops the rest */
+    if (err)
+        return err;
+
+    err = perfbuffer_settimeofday_bpf__attach(skel);
+    if (err)
+        return err;
+
+    if (pin_dir) {
+        err = pin_link(per_syscall ? skel->links.handle_settimeofday
+                                   : skel->links.handle_sys_enter, pin_dir);
+        /* tracepoint links pin from 5.15: keep BPF, lose persistence */
+        if (err)
+            log_alert("PIN_LINK error=%d persistent=0\n", err);
+    }
+    return 0;
+}
+
+/* the BPF side's per-container counters, at exit */
+static void cg_log(void)
+{
+    for (int i = 0; i < n_containers; i++) {
+        const struct container *c = &containers[i];
+        struct cg_val v;
+        if (bpf_map_lookup_elem(fd_cgroups, &c->id, &v) != 0)
+            continue;
+        log_alert("CGROUP id=%llu container=%s epsilon=%ld count=%llu future=%llu past=%llu\n",
+                  (unsigned long long)c->id, c->name,
+                  c->epsilon_sec >= 0 ? c->epsilon_sec : epsilon_sec,
+                  (unsigned long long)v.count, (unsigned long long)v.future,
+                  (unsigned long long)v.past);
+    }
+}
+
+/* ===== timerfd backend (-F, or when BPF will not load) =====
+ *
+ * A CLOCK_REALTIME timer armed with TFD_TIMER_CANCEL_ON_SET is cancelled
+ * by the kernel whenever the clock is set (settimeofday, clock_settime,
+ * adjtimex offset), and read() then fails with ECANCELED. Each wake
+ * becomes an event with the clock as it is now, which goes through the
+ * same classify/coalesce/log path as a BPF event; nothing runs in
+ * between, and no syscall pays for it. What is lost is who set it: pid,
+ * uid, comm and tz are not known (pid 0, comm "-"), and several sets
+ * between two wakes are one event, classified by where the clock ended.
+ * Resume from suspend also cancels; wall and boot time move together
+ * then, so it classifies CURRENT.
+ */
+static int tfd = -1;
+static __u64 tfd_wakes;
+
+/* abs. expiry far beyond KTIME_MAX: it only ever ends by cancellation */
+static int tfd_arm(void)
+{
+    struct itimerspec its = { .it_value = { .tv_sec = (time_t)1 << 40 } };
+    return timerfd_settime(tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                           &its, NULL);
+}
+
+static int tfd_open(void)
+{
+    tfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0)
+        return -errno;
+    if (tfd_arm() < 0) {
+        int err = -errno;
+        close(tfd);
+        tfd = -1;
+        return err;
+    }
+    return 0;
+}
+
+/* like perf_buffer__poll: events handled, or -errno */
+static int tfd_poll(int timeout_ms)
+{
+    struct pollfd pfd = { .fd = tfd, .events = POLLIN };
+    __u64 expired;
+
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n <= 0)
+        return n < 0 ? -errno : 0;
+    if (read(tfd, &expired, sizeof(expired)) < 0 && errno != ECANCELED)
+        return errno == EAGAIN ? 0 : -errno;
+
+    /* re-arm before sampling: a set from here on wakes us again */
+    if (tfd_arm() < 0)
+        return -errno;
+
+    struct timespec wall, boot;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    __s64 boot_ns = (__s64)boot.tv_sec * 1000000000LL + boot.tv_nsec;
+    struct event ev = {
+        .ktime_ns  = (__u64)boot_ns,
+        .cnt       = ++tfd_wakes,
+        .tv_sec    = wall.tv_sec,
+        .comm      = "-",
+        .kstack_id = SS_NONE,
+        .ustack_id = SS_NONE,
+    };
+
+    trace_append(TRACE_CLOCK, boot_ns, &ev, sizeof(ev), NULL, 0);
+    process_event(&ev, boot_ns, boot_ns, NULL);
+    return 1;
+}
+
 /* ===== main ===== */
 int main(int argc, char **argv)
 {
-    const char *obj_path = (argc > 1) ? argv[1] : "probe.bpf.o";
+    long long main_ns = boot_ns();
     struct rlimit rlim = { RLIM_INFINITY, RLIM_INFINITY };
 
-    struct bpf_object *obj = NULL;
-    struct bpf_program *prog;
-    struct bpf_link *link = NULL;
+    struct perfbuffer_settimeofday_bpf *skel = NULL;
     struct perf_buffer *pb = NULL;
 
     int err;
+    int opt;
+    int pin = 0, unpin = 0, reused = 0, use_tfd = 0;
+    int fd_events = -1, fd_cnt = -1, fd_stacks = -1, fd_backlog = -1;
+    const struct pin_map pins[] = {
+        { "events",      &fd_events, 0 },
+        { "syscall_cnt", &fd_cnt, 0 },
+        { "anchor",      &anchor_fd, 0 },
+        { "stacks",      &fd_stacks, 1 },
+        { "control",     &fd_control, 1 },
+        { "agg",         &fd_agg, 1 },
+        { "cgroups",     &fd_cgroups, 1 },
+        { "backlog",     &fd_backlog, 1 },
+    };
+    char pin_dir[PATH_MAX];
+    int n_consumers = 0;
+    struct consumer consumers[MAX_CONSUMERS];
+    long coalesce_ms = 1000;
+    double coalesce_rate = 1.0, coalesce_burst = 5.0;
+    const char *binlog_path = NULL;
+    long stats_sec = 0;
+    const char *alert_path = "/data/local/tmp/settime_alerts.log";
+    const char *record_path = NULL;
+    char *replay_paths[TRACE_MAX_FILES];
+    int n_replay = 0, realtime = 0;
+
+    while ((opt = getopt(argc, argv, "e:pUFsG:gt:c:r:B:b:o:JR:P:TC:H:SA:Q:N:k:w:q:m:M:O:X:")) != -1) {
+        switch (opt) {
+        case 'e': {
+            char *end;
+            epsilon_sec = strtol(optarg, &end, 10);
+            if (end == optarg || *end || epsilon_sec <= 0) {
+                fprintf(stderr, "-e must be a positive number of seconds\n");
+                return 1;
+            }
+            epsilon_set = 1;
+            break;
+        }
+        case 't':   /* N consumer threads, each owning a CPU subset */
+            n_consumers = atoi(optarg);
+            if (n_consumers < 0 || n_consumers > MAX_CONSUMERS) {
+                fprintf(stderr, "-t must be 0..%d\n", MAX_CONSUMERS);
+                return 1;
+            }
+            break;
+        case 'p':   /* keep maps + link in bpffs across restarts */
+            pin = 1;
+            break;
+        case 'U':   /* drop the pins (detaches) and exit */
+            unpin = 1;
+            break;
+        case 'F':   /* no BPF: timerfd clock-set wakeups only */
+            use_tfd = 1;
+            break;
+        case 'G':   /* a container's cgroup v2 dir [:its own epsilon] */
+            err = cg_add(optarg);
+            if (err) {
+                fprintf(stderr, "-G %s: %s\n", optarg, strerror(-err));
+                return 1;
+            }
+            break;
+        case 'g':   /* only the -G cgroups, dropped in the kernel */
+            cg_only = 1;
+            break;
+        case 's':   /* attach to sys_enter_settimeofday, not raw_syscalls */
+            per_syscall = 1;
+            break;
+        case 'X':   /* BPF run-time stats every this many seconds */
+            stats_sec = strtol(optarg, NULL, 10);
+            break;
+        case 'O': { /* ring fill % to aggregate at, and to stream again */
+            char *end;
+            ov_high = strtol(optarg, &end, 10);
+            ov_low = *end == ',' ? strtol(end + 1, NULL, 10) : ov_high / 3;
+            if (ov_high < 0 || ov_high > 100 || ov_low < 0 || ov_low > ov_high) {
+                fprintf(stderr, "-O high[,low]: 0 <= low <= high <= 100, 0 = off\n");
+                return 1;
+            }
+            break;
+        }
+        case 'c':   /* summary interval per (pid, state); 0 = every event */
+            coalesce_ms = strtol(optarg, NULL, 10);
+            break;
+        case 'r':   /* lines/sec per (pid, state) */
+            coalesce_rate = strtod(optarg, NULL);
+            break;
+        case 'B':
+            coalesce_burst = strtod(optarg, NULL);
+            break;
+        case 'b':   /* binary per-event log */
+            binlog_path = optarg;
+            break;
+        case 'o':   /* alert log */
+            alert_path = optarg;
+            break;
+        case 'J':   /* alert log as JSON Lines */
+            alert_style = AF_JSON;
+            break;
+        case 'R':   /* record raw events to a trace */
+            record_path = optarg;
+            break;
+        case 'P':   /* replay a trace (repeat to merge several) */
+            if (n_replay == TRACE_MAX_FILES) {
+                fprintf(stderr, "at most %d traces\n", TRACE_MAX_FILES);
+                return 1;
+            }
+            replay_paths[n_replay++] = optarg;
+            break;
+        case 'T':   /* replay at recorded speed */
+            realtime = 1;
+            break;
+        case 'C':   /* config file, re-read on SIGHUP / change */
+            cfg_path = optarg;
+            break;
+        case 'H':   /* per-stage latency histograms, SIGUSR1 + exit */
+            lat_path = optarg;
+            break;
+        case 'S':   /* fdatasync the alert log after each batch */
+            alert_sync = 1;
+            break;
+        case 'm':   /* Merkle root every this many lines; 0 = no chain */
+            chain_records = strtol(optarg, NULL, 10);
+            break;
+        case 'M':   /* ... or with batches this many seconds old */
+            chain_sec = strtol(optarg, NULL, 10);
+            break;
+        case 'A':   /* stream every event to a collector */
+            stream_addr = optarg;
+            break;
+        case 'Q':   /* spool file: unacked frames survive a restart */
+            stream_spool = optarg;
+            break;
+        case 'N':   /* host name sent to the collector */
+            stream_host = optarg;
+            break;
+        case 'k':   /* cut a frame at this many KiB ... */
+            stream_batch_kb = atol(optarg);
+            break;
+        case 'w':   /* ... or when its oldest record is this old */
+            stream_batch_ms = atol(optarg);
+            break;
+        case 'q':   /* spool size; the oldest frames go when it is full */
+            stream_spool_kb = atol(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-e epsilon_sec] [-p | -U | -F] [-s] [-t threads]\n"
+                    "          [-G cgroup_dir[:epsilon_sec]]... [-g]\n"
+                    "          [-c coalesce_ms] [-r rate] [-B burst] [-b binlog]\n"
+                    "          [-o alert_log] [-J] [-S] [-m root_lines] [-M root_sec]\n"
+                    "          [-O high[,low]] [-X stats_sec] [-R trace] [-C config]\n"
+                    "          [-H latency_file] [stream]\n"
+                    "       %s -P trace [-P trace...] [-T] [-o alert_log] [-J] [-S]\n"
+                    "          [-m root_lines] [-M root_sec] [-b binlog]\n"
+                    "          [-H latency_file] [stream]\n"
+                    "stream: -A addr [-Q spool_file] [-N host] [-k batch_kb]\n"
+                    "        [-w batch_ms] [-q spool_kb]\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if (unpin) {
+        snprintf(pin_dir, sizeof(pin_dir), "%s/perfbuffer_settimeofday",
+                 PIN_ROOT);
+        pin_remove(pin_dir);
+        return 0;
+    }
+
+    /* config values override the command line */
+    if (cfg_path) {
+        struct ts_config c = { .epsilon = -1 };
+        err = cfg_load(cfg_path, &c);
+        if (err) {
+            fprintf(stderr, "config %s: %s\n", cfg_path, strerror(-err));
+            return 1;
+        }
+        if (c.alert_log[0])
+            alert_path = strdupa(c.alert_log);
+        if (c.epsilon >= 0) {
+            epsilon_sec = c.epsilon;
+            epsilon_set = 1;
+        }
+        cfg_free(&c);
+    }
 
     /* open log */
-    alert_fd = open("/data/local/tmp/settime_alerts.log",
-                    O_WRONLY | O_CREAT | O_APPEND, 0644);
+    alert_fd = open(alert_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
     if (alert_fd < 0) {
         perror("open log");
         return 1;
     }
+    snprintf(alert_path_cur, sizeof(alert_path_cur), "%s", alert_path);
+    err = cl_open(&chain, alert_fd, alert_path, alert_style == AF_JSON,
+                  chain_records, chain_sec);
+    if (err) {
+        fprintf(stderr, "alert log chain: %s\n", strerror(-err));
+        return 1;
+    }
+
+    if (binlog_path) {
+        binlog_fd = open(binlog_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (binlog_fd < 0) {
+            perror("open binlog");
+            return 1;
+        }
+    }
+
+    coalesce_init(&coal, (int64_t)coalesce_ms * 1000000, coalesce_rate,
+                  coalesce_burst, emit_alert);
+
+    if (lat_path) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_usr1;
+        sigaction(SIGUSR1, &sa, NULL);
+    }
+
+    if (n_replay) {
+        signal(SIGINT, on_sig);
+        signal(SIGTERM, on_sig);
+        err = replay(replay_paths, n_replay, realtime);
+        goto out;
+    }
 
     setrlimit(RLIMIT_MEMLOCK, &rlim);
     libbpf_set_print(libbpf_print_fn);
@@ -181,75 +1936,258 @@ int main(int argc, char **argv)
 
     init_trusted();
     log_alert("INIT trusted_wall=%ld trusted_boot=%ld\n",
-              (long)trusted_wall, (long)trusted_boot.tv_sec);
+              (long)anchor_get()->wall, (long)anchor_get()->boot.tv_sec);
 
-    /* open & load BPF */
-    obj = bpf_object__open_file(obj_path, NULL);
-    err = libbpf_get_error(obj);
-    if (err) {
-        obj = NULL;
-        goto out;
+    if (pin && !use_tfd) {
+        err = pin_prepare_dir(pin_dir, sizeof(pin_dir),
+                              "perfbuffer_settimeofday");
+        if (err)
+            goto out;
+
+        reused = pin_reuse(pin_dir, sizeof(pin_dir), "perfbuffer_settimeofday",
+                           pins, sizeof(pins) / sizeof(pins[0]));
     }
 
-    err = bpf_object__load(obj);
+    if (!reused && !use_tfd) {
+        struct pin_list had;
+
+        if (pin)
+            pin_list_get(pin_dir, &had);
+        err = bpf_start(&skel, pin ? pin_dir : NULL);
+        if (err) {
+            /* no BTF, no BPF, too old a kernel: still catch clock sets */
+            log_alert("FALLBACK backend=timerfd reason=bpf error=%d\n", err);
+            perfbuffer_settimeofday_bpf__destroy(skel);
+            skel = NULL;
+            live_skel = NULL;
+            fd_cgroups = -1;
+            if (pin)    /* an earlier run's counters and backlog stay */
+                pin_remove_new(pin_dir, &had);
+            use_tfd = 1;
+        } else {
+            fd_events = bpf_map__fd(skel->maps.events);
+            fd_cnt    = bpf_map__fd(skel->maps.syscall_cnt);
+            anchor_fd = bpf_map__fd(skel->maps.anchor);
+            fd_stacks = bpf_map__fd(skel->maps.stacks);
+            fd_control = bpf_map__fd(skel->maps.control);
+            fd_agg    = bpf_map__fd(skel->maps.agg);
+            fd_backlog = bpf_map__fd(skel->maps.backlog);
+        }
+    }
+    if (reused && fd_cgroups >= 0) {
+        /* -g stays as the pinned program was loaded */
+        err = cg_fill(fd_cgroups);
+        if (err)
+            goto out;
+    }
+    for (int i = 0; i < n_containers && !use_tfd; i++)
+        log_alert("CONTAINER id=%llu name=%s epsilon=%ld only=%d kernel=%d\n",
+                  (unsigned long long)containers[i].id, containers[i].name,
+                  containers[i].epsilon_sec, cg_only && !reused,
+                  fd_cgroups >= 0);
+    if (!use_tfd && stats_sec > 0) {
+        err = bs_open(&bstats, stats_sec * 1000);
+        if (!err && reused) {
+            int link_fd = pin_open_map(pin_dir, "link");
+            err = bs_add_link(&bstats, link_fd, "pinned");
+            if (link_fd >= 0)
+                close(link_fd);
+        } else if (!err) {
+            struct bpf_program *prog = bpf_entry(skel, per_syscall);
+            err = bs_add(&bstats, dup(bpf_program__fd(prog)),
+                         bpf_program__name(prog),
+                         per_syscall ? "syscall" : "raw_syscalls");
+        }
+        if (err)
+            log_alert("BPF_STATS error=%d\n", err);
+    }
+    if (use_tfd) {
+        err = tfd_open();
+        if (err) {
+            log_alert("FALLBACK backend=timerfd error=%d\n", err);
+            goto out;
+        }
+        log_alert("BACKEND timerfd attribution=0\n");
+    }
+    err = ss_open(&stacks, fd_stacks);
     if (err)
         goto out;
 
-    prog = bpf_object__find_program_by_name(obj, "handle_sys_enter");
-    if (!prog) {
-        err = -ENOENT;
-        goto out;
-    }
+    /*
+     * Resume the trusted timeline of the previous run: time(NULL) may
+     * already be tampered. What was emitted while we were down is in the
+     * backlog, drained once the log, stream and trace are open.
+     */
+    int resumed = anchor_restore();
+    if (resumed)
+        log_alert("RESUME trusted_wall=%ld trusted_boot=%ld seen_cnt=%llu\n",
+                  (long)anchor_get()->wall, (long)anchor_get()->boot.tv_sec,
+                  (unsigned long long)seen_cnt);
+    else
+        anchor_store();         /* BPF tests events against it for stacks */
 
-    link = bpf_program__attach_tracepoint(
-        prog, "raw_syscalls", "sys_enter");
-    err = libbpf_get_error(link);
-    if (err) {
-        link = NULL;
+    err = stream_open();
+    if (err)
         goto out;
+
+    if (record_path) {
+        const struct anchor *a = anchor_get();
+        err = trace_create(record_path, TRACE_SRC_CLOCK, a->wall,
+                           (__s64)a->boot.tv_sec * 1000000000LL + a->boot.tv_nsec,
+                           epsilon_sec, sizeof(struct event));
+        if (err) {
+            fprintf(stderr, "open trace: %s\n", strerror(-err));
+            goto out;
+        }
     }
 
-    /* perf events map */
-    int fd_events = bpf_object__find_map_fd_by_name(obj, "events");
-    if (fd_events < 0) {
-        err = -ENOENT;
-        goto out;
+    if (!use_tfd)
+        backlog_open(fd_backlog);
+    if (resumed) {
+        __u32 key = 0;
+        __u64 cnt = 0;
+
+        /* what neither a perf buffer nor the backlog held */
+        if (bpf_map_lookup_elem(fd_cnt, &key, &cnt) == 0 && cnt > seen_cnt) {
+            log_alert("GAP missed=%llu after_cnt=%llu while_down=1\n",
+                      (unsigned long long)(cnt - seen_cnt),
+                      (unsigned long long)seen_cnt);
+            seen_cnt = cnt;
+        }
+        anchor_store();
     }
 
     /* perf buffer */
-    struct perf_buffer_opts pb_opts;
-    memset(&pb_opts, 0, sizeof(pb_opts));
-    pb_opts.sz = sizeof(pb_opts);
-
-    pb = perf_buffer__new(fd_events, 256,
-                          handle_event, handle_lost,
-                          NULL, &pb_opts);
-    err = libbpf_get_error(pb);
-    if (err) {
-        pb = NULL;
-        goto out;
+    if (!use_tfd) {
+        struct perf_buffer_opts pb_opts;
+        memset(&pb_opts, 0, sizeof(pb_opts));
+        pb_opts.sz = sizeof(pb_opts);
+
+        pb = perf_buffer__new(fd_events, 256,
+                              handle_event, handle_lost,
+                              NULL, &pb_opts);
+        err = libbpf_get_error(pb);
+        if (err) {
+            pb = NULL;
+            goto out;
+        }
+        if (ov_high > 0 && fd_control >= 0 && fd_agg >= 0)
+            ov_open(pb, boot_ns());
     }
+    backlog_close();
 
-    /* event loop */
-    while (!exiting) {
-        err = perf_buffer__poll(pb, 100);
-        if (err < 0 && err != -EINTR) {
-            log_alert("poll error=%d\n", err);
-            break;
+    if (cfg_path) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_hup;
+        sigaction(SIGHUP, &sa, NULL);
+
+        cfg_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (cfg_ifd >= 0)
+            cfg_wd = cfg_watch_add(cfg_ifd, cfg_path, &cfg_name);
+        if (cfg_wd < 0)
+            log_alert("CONFIG path=%s watch_error=%d sighup_only=1\n",
+                      cfg_path, cfg_ifd < 0 ? -errno : cfg_wd);
+        if (reused)
+            log_alert("CONFIG bpf=0 reason=reused_pin\n");
+    }
+
+    long long attached_ns = boot_ns();
+    long long exec_ns = exec_boot_ns();
+    log_alert("STARTUP exec_to_attach_us=%lld main_to_attach_us=%lld reused=%d backend=%s\n",
+              exec_ns < 0 ? -1LL : (attached_ns - exec_ns) / 1000,
+              (attached_ns - main_ns) / 1000, reused, use_tfd ? "timerfd" : "bpf");
+
+    if (n_consumers > 1 && pb) {
+        n_readers = n_consumers;
+        err = consumers_start(consumers, n_consumers, pb);
+        if (err) {
+            log_alert("consumers start error=%d\n", err);
+            exiting = 1;
+        }
+        while (!exiting) {
+            usleep(100000);
+            coalesce_tick(&coal, boot_ns(), 0);
+            ov_tick(boot_ns());
+            bstats_poll();
+            alert_flush();
+            cl_tick(&chain, cl_now());
+            stream_poll();
+            config_poll();
+            lat_poll();
+        }
+        for (int t = 0; t < n_consumers; t++) {
+            if (consumers[t].running)
+                pthread_join(consumers[t].tid, NULL);
+            if (consumers[t].epfd >= 0)
+                close(consumers[t].epfd);
+        }
+        if (err)
+            goto out;
+    } else {
+        /* event loop */
+        while (!exiting) {
+            err = pb ? perf_buffer__poll(pb, 100) : tfd_poll(100);
+            if (err < 0 && err != -EINTR) {
+                log_alert("poll error=%d\n", err);
+                break;
+            }
+            coalesce_tick(&coal, boot_ns(), 0);
+            ov_tick(boot_ns());
+            bstats_poll();
+            binlog_flush();
+            as_tick();
+            stream_poll();
+            alert_flush();
+            cl_tick(&chain, cl_now());
+            trace_flush();
+            anchor_quiescent();
+            config_poll();
+            lat_poll();
         }
     }
 
     err = 0;
+    anchor_store();
+    coalesce_tick(&coal, boot_ns(), 1);
+    log_alert("COALESCE suppressed=%llu\n",
+              (unsigned long long)coal.suppressed);
 
 out:
+    backlog_close();
+    ov_close(boot_ns());
+    if (bstats.n)
+        bstats_log();
     if (pb)
         perf_buffer__free(pb);
-    if (link)
-        bpf_link__destroy(link);
-    if (obj)
-        bpf_object__close(obj);
-    if (alert_fd >= 0)
+    cg_log();
+    if (reused)
+        pin_close_maps(pins, sizeof(pins) / sizeof(pins[0]));
+    perfbuffer_settimeofday_bpf__destroy(skel);
+    trace_close();
+    stream_close();
+    if (cfg_ifd >= 0)
+        close(cfg_ifd);
+    if (tfd >= 0)
+        close(tfd);
+    binlog_flush();
+    if (binlog_fd >= 0)
+        close(binlog_fd);
+    alert_flush();
+    if (lat_path && alert_fd >= 0)
+        lat_export();
+    bs_close(&bstats);
+    if (stacks.fd >= 0 && alert_fd >= 0)
+        log_alert("STACKS symbolized=%llu cached=%llu maps_read=%llu objects=%llu unresolved=%llu errors=%llu\n",
+                  stacks.misses, stacks.hits, stacks.maps_read, stacks.objects,
+                  stacks.unresolved, stacks.errors);
+    ss_close(&stacks);
+    if (alert_fd >= 0) {
+        log_alert("CHAIN batches=%llu lines=%llu roots=%llu segments=%llu\n",
+                  chain.batches, chain.lines, chain.roots, chain.segments);
+        cl_close(&chain);
         close(alert_fd);
+    }
 
     return err ? 1 : 0;
 }
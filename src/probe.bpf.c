@@ -9,10 +9,14 @@
 // ̼ 
 char LICENSE[] SEC("license") = "Dual BSD/GPL";
 
-// ý  ȣ (x86_64 )
-#define __NR_settimeofday 170
 #define SETTIMEOFDAY_IDX 0
 
+// δ load  ä .rodata Ʃʺ (load Ŀ  ޵Ǿ
+// verifier  б⸦ մϴ)
+// - target_nr  :  syscall ȣ (⺻ arm64 settimeofday 170,
+//                x86_64 164, δ __NR_settimeofday )
+const volatile long target_nr = 170;
+
 // TASK_COMM_LEN 
 #define TASK_COMM_LEN 16
 
@@ -25,9 +29,20 @@ struct sys_enter_args {
 };
 
 //   ü (main.c ؾ մϴ)
+// seq   ȦԴϴ. userspace mmap   дٰ seq
+// Ȧ̰ų ٲ ٽ нϴ (seqlock).    16Ʈ
+//   ڿ Ӵϴ.
 struct last_args_val {
     long tv_sec;            // struct timeval* tv_sec
     long tz_minuteswest;    // struct timezone* tz_minuteswest
+    __u64 seq;
+};
+
+// anchor   ü (bpf_pin.h ؾ մϴ)
+struct anchor_val {
+    __s64 trusted_wall;
+    __s64 trusted_boot_ns;
+    __u64 seen_cnt;
 };
 
 // ----------------------------------------------------
@@ -35,8 +50,10 @@ struct last_args_val {
 // ----------------------------------------------------
 
 // 1. syscall Ƚ   (Ű: int, : u64)
+// 1, 2  BPF_F_MMAPABLE: userspace mmap ؼ bpf() ȣ  нϴ.
 struct {
     __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(map_flags, BPF_F_MMAPABLE);
     __uint(max_entries, 1);
     __type(key, int);
     __type(value, __u64);
@@ -45,11 +62,22 @@ struct {
 // 2.     (Ű: int, : struct last_args_val)
 struct {
     __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(map_flags, BPF_F_MMAPABLE);
     __uint(max_entries, 1);
     __type(key, int);
     __type(value, struct last_args_val);
 } last_args SEC(".maps"); 
 
+// 3. ŷ    (userspace )
+//  bpffs pin ϸ   Ŀ trusted timeline
+//  ó īƮ ̾  ֽϴ.
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, int);
+    __type(value, struct anchor_val);
+} anchor SEC(".maps");
+
 // ----------------------------------------------------
 // BPF α׷  (tracepoint )
 // ----------------------------------------------------
@@ -57,27 +85,26 @@ struct {
 SEC("tracepoint/raw_syscalls/sys_enter")
 int handle_sys_enter(struct sys_enter_args *ctx)
 {
-    if (ctx->id != __NR_settimeofday) {
+    if (ctx->id != target_nr) {
         return 0;
     }
 
     int key = SETTIMEOFDAY_IDX;
     __u64 *cnt_ptr;
+    struct last_args_val *args;
     struct last_args_val new_args = {0};
 
-    // 1. Ƚ īƮ 
+    // ARRAY  Ҵ ׻  verifier  NULL ˻簡 ʿմϴ.
     cnt_ptr = bpf_map_lookup_elem(&syscall_cnt, &key);
-    if (cnt_ptr) {
-        __sync_fetch_and_add(cnt_ptr, 1);
-    } else {
-        //  ʱȭ   (ARRAY ʿ  ߻ )
-        __u64 one = 1;
-        bpf_map_update_elem(&syscall_cnt, &key, &one, BPF_ANY);
+    args = bpf_map_lookup_elem(&last_args, &key);
+    if (!cnt_ptr || !args) {
+        return 0;
     }
-    
-    // 2.   Ʈ
+
+    // 1.  б
     // sys_settimeofday(const struct timeval *tv, const struct timezone *tz)
-    
+    //  ޸𸮴   ۿ ̸ о  ª մϴ.
+
     //  0: tv  (struct timeval *)
     if (ctx->args[0]) {
         // struct timeval { __kernel_time_t tv_sec; ... }
@@ -97,9 +124,27 @@ int handle_sys_enter(struct sys_enter_args *ctx)
             new_args.tz_minuteswest = -1; // б 
         }
     }
-    
-    //    ʿ Ʈ
-    bpf_map_update_elem(&last_args, &key, &new_args, BPF_ANY);
+
+    // 2. Ƚ ڸ     (seqlock)
+    // ¦ seq cmpxchg Ȧ ٲ   , ڸ  
+    //   fetch-add ٽ ¦ ϴ.    
+    // ޸ 踮 arm64    ̿ Դϴ
+    // (cmpxchg/fetch  : Ŀ 5.12+, clang -mcpu=v3).
+    // ٸ CPU  ̸ ڴ ǳʶٰ Ƚ ϴ. ׷ д
+    //   ȣ   ڸ  ʽϴ.
+    __u64 seq = *(volatile __u64 *)&args->seq;
+    if (!(seq & 1) && __sync_val_compare_and_swap(&args->seq, seq, seq + 1) == seq) {
+        __sync_fetch_and_add(cnt_ptr, 1);
+        args->tv_sec = new_args.tv_sec;
+        args->tz_minuteswest = new_args.tz_minuteswest;
+        //     seq seq + 1 ״Դϴ. ȯ 
+        // non-fetch(  )   ϵ ʽϴ.
+        if (__sync_fetch_and_add(&args->seq, 1) != seq + 1) {
+            return 1;
+        }
+    } else {
+        __sync_fetch_and_add(cnt_ptr, 1);
+    }
 
     return 0;
 }
\ No newline at end of file
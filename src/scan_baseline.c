@@ -0,0 +1,832 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <dirent.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+
+#include "ts_index.h"
+#include "ts_classify.h"
+
+/*
+ * Baseline scanner: the watchers only see changes made after they start,
+ * so this walks whole trees once (or every -i seconds) and lists files
+ * whose timestamps are already in the future or look forged.
+ *
+ * With -I the timestamps seen are kept in a persistent index (ts_index.h).
+ * The next pass starts from the indexed directories instead of the roots
+ * and only walks into new subtrees of those whose mtime/ctime moved; every
+ * entry is still statx()ed and compared with its stored values, so
+ * timestamps set back in place (utimensat() leaves the directory alone)
+ * are flagged, and keep being reported on later passes. -F forces a full
+ * walk.
+ *
+ *   scan_baseline [-j threads] [-i interval_sec] [-e epsilon] [-x]
+ *                 [-o out] [-I index_base [-F]] <root>...
+ */
+
+#define EPSILON      60        /* ±1 minute, same as the watchers */
+#define DENTS_BUF    (64 * 1024)
+#define OUT_BUF      (64 * 1024)
+#define MAX_WORKERS  256
+#define REVISIT_CHUNK 64
+#define STAT_BATCH   256       /* entries classified together */
+
+/* =========================================================
+ *  BOOTTIME anchor (same rules as inotify.c)
+ * ========================================================= */
+static time_t wall_anchor;
+static struct timespec boot_anchor;
+static long epsilon = EPSILON;
+
+static void init_anchor(void)
+{
+    wall_anchor = time(NULL);
+    clock_gettime(CLOCK_BOOTTIME, &boot_anchor);
+}
+
+static time_t expected_wall_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return wall_anchor + (now.tv_sec - boot_anchor.tv_sec);
+}
+
+/* =========================================================
+ *  ANOMALY RULES
+ * ========================================================= */
+enum anomaly {
+    AN_FUTURE_MTIME       = 1 << 0,   /* check_file_time == FILE_FUTURE */
+    AN_FUTURE_ATIME       = 1 << 1,
+    AN_FUTURE_CTIME       = 1 << 2,
+    AN_FUTURE_BTIME       = 1 << 3,
+    AN_MTIME_AFTER_CTIME  = 1 << 4,   /* ctime is bumped by every utimensat */
+    AN_MTIME_BEFORE_BIRTH = 1 << 5,   /* backdated mtime (or cp -p / tar) */
+    AN_CTIME_BEFORE_BIRTH = 1 << 6,   /* impossible without clock tamper */
+    AN_ATIME_BEFORE_BIRTH = 1 << 7,
+    AN_WHOLE_SECONDS      = 1 << 8,   /* touch -d style: ns zeroed */
+    AN_MTIME_ROLLBACK     = 1 << 9,   /* older than the indexed value (-I) */
+    AN_CTIME_ROLLBACK     = 1 << 10,  /* only a clock set can do this */
+    AN_ATIME_ROLLBACK     = 1 << 11,
+};
+
+static const char *const anomaly_names[] = {
+    "future_mtime", "future_atime", "future_ctime", "future_btime",
+    "mtime_after_ctime", "mtime_before_birth", "ctime_before_birth",
+    "atime_before_birth", "whole_seconds",
+    "mtime_rollback", "ctime_rollback", "atime_rollback",
+};
+
+/*
+ * FILE_PAST relative to "now" is meaningless for files that existed
+ * before the scan, so only the FILE_FUTURE half of check_file_time is
+ * applied; the history checks cover backdating instead.
+ *
+ * The mtime/atime/ctime future checks are the ts_classify.h rule: a
+ * directory's entries go through tsc_classify() in batches and
+ * future_bits() reads its state bytes. check_other() is the rest.
+ */
+static unsigned future_bits(uint8_t s)
+{
+    return (TSC_MTIME(s) == TSC_FUTURE ? AN_FUTURE_MTIME : 0) |
+           (TSC_ATIME(s) == TSC_FUTURE ? AN_FUTURE_ATIME : 0) |
+           (TSC_CTIME(s) == TSC_FUTURE ? AN_FUTURE_CTIME : 0);
+}
+
+static unsigned check_other(const struct statx *sx, time_t expected)
+{
+    unsigned a = 0;
+    int has_btime = (sx->stx_mask & STATX_BTIME) && sx->stx_btime.tv_sec;
+
+    if (has_btime && sx->stx_btime.tv_sec > expected + epsilon)
+        a |= AN_FUTURE_BTIME;
+
+    if (sx->stx_mtime.tv_sec > sx->stx_ctime.tv_sec + epsilon)
+        a |= AN_MTIME_AFTER_CTIME;
+
+    if (has_btime) {
+        if (sx->stx_mtime.tv_sec + epsilon < sx->stx_btime.tv_sec)
+            a |= AN_MTIME_BEFORE_BIRTH;
+        if (sx->stx_ctime.tv_sec + epsilon < sx->stx_btime.tv_sec)
+            a |= AN_CTIME_BEFORE_BIRTH;
+        if (sx->stx_atime.tv_sec + epsilon < sx->stx_btime.tv_sec)
+            a |= AN_ATIME_BEFORE_BIRTH;
+    }
+
+    /* only meaningful where the fs keeps ns (ctime has them) */
+    if (sx->stx_ctime.tv_nsec != 0 &&
+        sx->stx_mtime.tv_nsec == 0 && sx->stx_atime.tv_nsec == 0)
+        a |= AN_WHOLE_SECONDS;
+
+    return a;
+}
+
+/* one inode outside a batch (revisited directories) */
+static unsigned check_times(const struct statx *sx, time_t expected)
+{
+    int64_t lo = expected - epsilon, hi = expected + epsilon;
+    uint8_t s = tsc_code(sx->stx_mtime.tv_sec, lo, hi) |
+                tsc_code(sx->stx_atime.tv_sec, lo, hi) << 2 |
+                tsc_code(sx->stx_ctime.tv_sec, lo, hi) << 4;
+
+    return future_bits(s) | check_other(sx, expected);
+}
+
+/* whole_seconds alone is too weak to report */
+static int is_reportable(unsigned a)
+{
+    return (a & ~AN_WHOLE_SECONDS) != 0;
+}
+
+/* =========================================================
+ *  WORK-STEALING DEQUES
+ *
+ *  Each worker pushes the directories it discovers onto the bottom of
+ *  its own deque and pops from there (depth first, warm dcache); idle
+ *  workers steal from the top of a victim's deque (oldest, usually the
+ *  biggest subtrees). `pending` counts directories queued or in flight;
+ *  the walk is finished when it drops to zero.
+ * ========================================================= */
+struct deque {
+    pthread_mutex_t lock;
+    char **job;
+    size_t head, tail, cap;     /* live jobs are [head, tail) */
+};
+
+/* statx results of one getdents chunk, names point into dents */
+struct stat_batch {
+    const char *name[STAT_BATCH];
+    struct statx sx[STAT_BATCH];
+    int64_t mtime[STAT_BATCH], atime[STAT_BATCH], ctime[STAT_BATCH];
+    uint8_t state[STAT_BATCH];
+    size_t n;
+};
+
+struct worker {
+    pthread_t tid;
+    int id;
+    struct deque dq;
+    char *dents;
+    struct stat_batch *batch;
+    char out[OUT_BUF];
+    size_t out_len;
+    unsigned long long inodes, dirs, flagged;
+    unsigned long long revisited, skipped;
+};
+
+static struct worker *workers;
+static int n_workers = 0;
+static long pending;
+static int one_fs = 0;
+static dev_t root_dev;
+static FILE *out_fp;
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t exiting = 0;
+
+static void on_sig(int s) { (void)s; exiting = 1; }
+
+static void dq_push(struct deque *d, char *path)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        size_t live = d->tail - d->head;
+        if (d->head <= d->cap / 2) {
+            d->cap = d->cap ? d->cap * 2 : 256;
+            d->job = realloc(d->job, d->cap * sizeof(*d->job));
+        }
+        memmove(d->job, d->job + d->head, live * sizeof(*d->job));
+        d->head = 0;
+        d->tail = live;
+    }
+    d->job[d->tail++] = path;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static char *dq_pop_bottom(struct deque *d)
+{
+    char *p = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head)
+        p = d->job[--d->tail];
+    pthread_mutex_unlock(&d->lock);
+    return p;
+}
+
+static char *dq_steal_top(struct deque *d)
+{
+    char *p = NULL;
+    if (pthread_mutex_trylock(&d->lock) != 0)
+        return NULL;
+    if (d->tail > d->head)
+        p = d->job[d->head++];
+    pthread_mutex_unlock(&d->lock);
+    return p;
+}
+
+static void submit_dir(struct worker *w, char *path)
+{
+    __atomic_add_fetch(&pending, 1, __ATOMIC_RELAXED);
+    dq_push(&w->dq, path);
+}
+
+/* =========================================================
+ *  OUTPUT
+ * ========================================================= */
+static void out_flush(struct worker *w)
+{
+    if (w->out_len == 0)
+        return;
+    pthread_mutex_lock(&out_lock);
+    fwrite(w->out, 1, w->out_len, out_fp);
+    pthread_mutex_unlock(&out_lock);
+    w->out_len = 0;
+}
+
+static void report(struct worker *w, const char *dir, const char *name,
+                   const struct statx *sx, unsigned a)
+{
+    char line[PATH_MAX + 512];
+    int n = snprintf(line, sizeof(line), "%s/%s\treasons=", dir, name);
+
+    int first = 1;
+    for (unsigned i = 0; i < sizeof(anomaly_names) / sizeof(anomaly_names[0]); i++) {
+        if (!(a & (1u << i)))
+            continue;
+        n += snprintf(line + n, sizeof(line) - n, "%s%s",
+                      first ? "" : ",", anomaly_names[i]);
+        first = 0;
+    }
+    n += snprintf(line + n, sizeof(line) - n,
+                  " mtime=%lld atime=%lld ctime=%lld btime=%lld\n",
+                  (long long)sx->stx_mtime.tv_sec,
+                  (long long)sx->stx_atime.tv_sec,
+                  (long long)sx->stx_ctime.tv_sec,
+                  (sx->stx_mask & STATX_BTIME) ?
+                      (long long)sx->stx_btime.tv_sec : -1LL);
+    if (n >= (int)sizeof(line))
+        n = sizeof(line) - 1;
+
+    if (w->out_len + n > sizeof(w->out))
+        out_flush(w);
+    memcpy(w->out + w->out_len, line, n);
+    w->out_len += n;
+    w->flagged++;
+}
+
+/* "/a/b" -> report(dir="/a", name="b"); the root is stored as "" */
+static void report_path(struct worker *w, const char *path,
+                        const struct statx *sx, unsigned a)
+{
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+    size_t dlen = slash ? (size_t)(slash - path) : 0;
+
+    if (dlen >= sizeof(dir))
+        dlen = sizeof(dir) - 1;
+    memcpy(dir, path, dlen);
+    dir[dlen] = '\0';
+    report(w, dir, slash ? slash + 1 : path, sx, a);
+}
+
+/* =========================================================
+ *  PERSISTENT INDEX (-I)
+ *
+ *  Every inode seen is recorded by (dev, ino) with its ns timestamps;
+ *  directories also keep their path. An incremental pass starts from the
+ *  list of indexed directories (not from the roots). Each one is read
+ *  and its entries statx()ed against the index: utimensat() on a file
+ *  moves neither mtime nor ctime of its directory, so a directory that
+ *  did not change still has to be looked at. What an unchanged one saves
+ *  is the subdirectory statx (those are on the list themselves).
+ *  Subdirectories already on the list are left to their own revisit;
+ *  new or moved ones are walked in full. Rollbacks stick to the entry
+ *  and are reported again by every later pass.
+ * ========================================================= */
+static const char *index_base;
+static int force_full = 0;
+static struct tsidx idx;
+static int use_idx;
+static int incremental;         /* this pass starts from the revisit list */
+static uint32_t cur_gen;
+static uint64_t *revisit;       /* slot numbers */
+static size_t n_revisit, revisit_cap, revisit_pos;
+
+#define STATX_WANT (STATX_TYPE | STATX_INO | STATX_SIZE | \
+                    STATX_ATIME | STATX_MTIME | STATX_CTIME | STATX_BTIME)
+
+static int64_t stx_ns(const struct statx_timestamp *t)
+{
+    return (int64_t)t->tv_sec * 1000000000LL + t->tv_nsec;
+}
+
+/* compare with the previous pass, then store; *changed: dir needs a read */
+static unsigned index_note(struct tsidx_entry *e, const struct statx *sx,
+                           int *changed)
+{
+    int64_t m = stx_ns(&sx->stx_mtime);
+    int64_t a = stx_ns(&sx->stx_atime);
+    int64_t c = stx_ns(&sx->stx_ctime);
+    int64_t eps = (int64_t)epsilon * 1000000000LL;
+    unsigned r = 0;
+
+    if (e->gen != 0) {
+        if (m + eps < e->mtime_ns) r |= AN_MTIME_ROLLBACK;
+        if (c + eps < e->ctime_ns) r |= AN_CTIME_ROLLBACK;
+        if (a + eps < e->atime_ns) r |= AN_ATIME_ROLLBACK;
+    }
+    e->anomaly |= r;
+    r = e->anomaly;
+    *changed = e->gen == 0 || m != e->mtime_ns || c != e->ctime_ns;
+
+    e->mtime_ns = m;
+    e->atime_ns = a;
+    e->ctime_ns = c;
+    e->btime_ns = (sx->stx_mask & STATX_BTIME) ? stx_ns(&sx->stx_btime) : 0;
+    e->size = sx->stx_size;
+    e->gen = cur_gen;
+    return r;
+}
+
+/*
+ * Entry found while reading a directory. dirpath != NULL for a
+ * subdirectory we could descend into; *descend is cleared when that
+ * directory is on the revisit list under the same path.
+ */
+static unsigned index_visit(const struct statx *sx, const char *dirpath,
+                            int *descend)
+{
+    uint64_t dev = makedev(sx->stx_dev_major, sx->stx_dev_minor);
+    struct tsidx_entry *e = tsidx_lookup(&idx, dev, sx->stx_ino);
+    int changed;
+
+    if (!e && !(e = tsidx_insert(&idx, dev, sx->stx_ino)))
+        return 0;               /* table full: counted, still walked */
+    if (!dirpath)
+        return index_note(e, sx, &changed);
+
+    const char *old = tsidx_path(&idx, e->path_off);
+    int same = old && strcmp(old, dirpath) == 0 && !(e->flags & TSIDX_F_GONE);
+
+    if (incremental && same && (e->flags & TSIDX_F_QUEUED)) {
+        *descend = 0;
+        return 0;
+    }
+    if (!same)
+        e->path_off = tsidx_add_path(&idx, dirpath);
+    e->flags = TSIDX_F_DIR;
+    return index_note(e, sx, &changed);
+}
+
+static void index_begin_pass(void)
+{
+    struct tsidx_hdr *h = idx.hdr;
+
+    incremental = !force_full && h->full_gen != 0;
+    cur_gen = ++h->gen;
+    n_revisit = revisit_pos = 0;
+
+    for (uint64_t i = 0; i < h->capacity; i++) {
+        struct tsidx_entry *e = &idx.ent[i];
+        if (e->key == 0)
+            continue;
+        e->flags &= ~TSIDX_F_QUEUED;
+        if (!incremental || (e->flags & (TSIDX_F_DIR | TSIDX_F_GONE)) != TSIDX_F_DIR ||
+            !tsidx_path(&idx, e->path_off))
+            continue;
+        if (n_revisit == revisit_cap) {
+            revisit_cap = revisit_cap ? revisit_cap * 2 : 4096;
+            revisit = realloc(revisit, revisit_cap * sizeof(*revisit));
+            if (!revisit) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        revisit[n_revisit++] = i;
+        e->flags |= TSIDX_F_QUEUED;
+    }
+    __atomic_add_fetch(&pending, n_revisit, __ATOMIC_RELAXED);
+}
+
+/* tombstone directories nobody saw; returns how many */
+static unsigned long long index_end_pass(void)
+{
+    struct tsidx_hdr *h = idx.hdr;
+    unsigned long long gone = 0;
+
+    for (uint64_t i = 0; i < h->capacity; i++) {
+        struct tsidx_entry *e = &idx.ent[i];
+        if (e->key == 0)
+            continue;
+        e->flags &= ~TSIDX_F_QUEUED;
+        if ((e->flags & (TSIDX_F_DIR | TSIDX_F_GONE)) == TSIDX_F_DIR &&
+            e->gen != cur_gen && tsidx_path(&idx, e->path_off)) {
+            e->flags |= TSIDX_F_GONE;
+            gone++;
+        }
+    }
+
+    /*
+     * Anything not recorded this pass (table or path area full, or an
+     * interrupted walk) would be skipped forever by incremental passes,
+     * so the next one has to be full; tsidx_open() regrows first.
+     */
+    if (exiting || h->dropped || h->path_used > h->path_cap)
+        h->full_gen = 0;
+    else if (!incremental)
+        h->full_gen = cur_gen;
+
+    tsidx_checkpoint(&idx, expected_wall_time());
+    return gone;
+}
+
+static void scan_dir(struct worker *w, const char *path, int unchanged);
+
+static void revisit_dir(struct worker *w, struct tsidx_entry *e)
+{
+    const char *p = tsidx_path(&idx, e->path_off);
+    struct statx sx;
+    int changed = 1;
+
+    if (!p || statx(AT_FDCWD, p[0] ? p : "/",
+                    AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                    STATX_WANT, &sx) != 0 ||
+        !S_ISDIR(sx.stx_mode))
+        return;                 /* gone: tombstoned at the end of the pass */
+    w->inodes++;
+
+    unsigned a = check_times(&sx, expected_wall_time());
+    if (makedev(sx.stx_dev_major, sx.stx_dev_minor) == e->dev &&
+        sx.stx_ino == e->ino)
+        a |= index_note(e, &sx, &changed);
+    else
+        a |= index_visit(&sx, p, &changed);   /* another dir at this path */
+
+    if (is_reportable(a))
+        report_path(w, p, &sx, a);
+
+    if (!changed) {
+        w->skipped++;
+        scan_dir(w, p, 1);
+        return;
+    }
+    w->revisited++;
+    char *copy = strdup(p);
+    if (copy)
+        submit_dir(w, copy);
+}
+
+/* take a chunk of the revisit list; 0 when it is used up */
+static int revisit_next(struct worker *w)
+{
+    size_t i = __atomic_fetch_add(&revisit_pos, REVISIT_CHUNK, __ATOMIC_RELAXED);
+    if (i >= n_revisit)
+        return 0;
+
+    size_t end = i + REVISIT_CHUNK < n_revisit ? i + REVISIT_CHUNK : n_revisit;
+    for (size_t j = i; j < end && !exiting; j++)
+        revisit_dir(w, &idx.ent[revisit[j]]);
+    __atomic_sub_fetch(&pending, end - i, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/* =========================================================
+ *  DIRECTORY SCAN (getdents64 + statx)
+ * ========================================================= */
+struct linux_dirent64 {
+    unsigned long long d_ino;
+    long long          d_off;
+    unsigned short     d_reclen;
+    unsigned char      d_type;
+    char               d_name[];
+};
+
+/*
+ * Classify and report a batch of one directory's entries: the three
+ * future checks for the whole batch in one tsc_classify() call, then
+ * the per-entry rules, the index and the descent.
+ */
+static void flush_batch(struct worker *w, const char *path, size_t plen,
+                        time_t expected)
+{
+    struct stat_batch *b = w->batch;
+    struct tsc_batch in = {
+        .mtime = b->mtime, .atime = b->atime, .ctime = b->ctime, .n = b->n,
+    };
+    struct tsc_out out = { .state = b->state };
+
+    if (!b->n)
+        return;
+    tsc_classify(&in, expected, epsilon, &out);
+
+    for (size_t i = 0; i < b->n; i++) {
+        const struct statx *sx = &b->sx[i];
+        const char *name = b->name[i];
+        char *child = NULL;
+
+        if (S_ISDIR(sx->stx_mode) &&
+            !(one_fs &&
+              makedev(sx->stx_dev_major, sx->stx_dev_minor) != root_dev)) {
+            size_t nlen = strlen(name);
+            child = malloc(plen + 1 + nlen + 1);
+            if (child) {
+                memcpy(child, path, plen);
+                child[plen] = '/';
+                memcpy(child + plen + 1, name, nlen + 1);
+            }
+        }
+
+        int descend = 1;
+        unsigned a = future_bits(b->state[i]) | check_other(sx, expected);
+        if (use_idx)
+            a |= index_visit(sx, child, &descend);
+        if (is_reportable(a))
+            report(w, path, name, sx, a);
+
+        if (child && descend)
+            submit_dir(w, child);
+        else
+            free(child);
+    }
+    b->n = 0;
+}
+
+/*
+ * Read one directory. unchanged: an indexed directory whose mtime/ctime
+ * did not move, so its subdirectories are all on the revisit list and
+ * only the other entries need a statx.
+ */
+static void scan_dir(struct worker *w, const char *path, int unchanged)
+{
+    int dfd = open(path[0] ? path : "/",
+                   O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dfd < 0)
+        return;
+
+    struct stat_batch *b = w->batch;
+    size_t plen = strlen(path);
+    time_t expected = expected_wall_time();   /* once per directory */
+    w->dirs++;
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, dfd, w->dents, DENTS_BUF);
+        if (n <= 0)
+            break;
+
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64 *de = (struct linux_dirent64 *)(w->dents + off);
+            off += de->d_reclen;
+
+            const char *name = de->d_name;
+            if (name[0] == '.' &&
+                (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            if (unchanged && de->d_type == DT_DIR)
+                continue;
+
+            struct statx *sx = &b->sx[b->n];
+            if (statx(dfd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                      STATX_WANT, sx) != 0)
+                continue;
+            w->inodes++;
+
+            b->name[b->n] = name;
+            b->mtime[b->n] = sx->stx_mtime.tv_sec;
+            b->atime[b->n] = sx->stx_atime.tv_sec;
+            b->ctime[b->n] = sx->stx_ctime.tv_sec;
+            if (++b->n == STAT_BATCH)
+                flush_batch(w, path, plen, expected);
+        }
+        /* names live in dents: done before the next getdents */
+        flush_batch(w, path, plen, expected);
+    }
+    close(dfd);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    unsigned seed = (unsigned)w->id * 2654435761u + 1;
+    int idle = 0;
+
+    while (!exiting) {
+        char *path = dq_pop_bottom(&w->dq);
+
+        if (!path && revisit_next(w)) {
+            idle = 0;
+            continue;
+        }
+
+        for (int tries = 0; !path && tries < 2 * n_workers; tries++) {
+            seed = seed * 1103515245u + 12345u;
+            int v = (seed >> 16) % n_workers;
+            if (v != w->id)
+                path = dq_steal_top(&workers[v].dq);
+        }
+
+        if (!path) {
+            if (__atomic_load_n(&pending, __ATOMIC_ACQUIRE) == 0)
+                break;
+            if (++idle < 64) {
+                sched_yield();
+            } else {
+                struct timespec ts = { 0, 200000 };
+                nanosleep(&ts, NULL);
+            }
+            continue;
+        }
+
+        idle = 0;
+        scan_dir(w, path, 0);
+        free(path);
+        __atomic_sub_fetch(&pending, 1, __ATOMIC_RELEASE);
+    }
+
+    out_flush(w);
+    return NULL;
+}
+
+/* =========================================================
+ *  ONE PASS
+ * ========================================================= */
+static int scan_pass(char **roots, int n_roots)
+{
+    struct timespec t0, t1;
+    unsigned long long inodes = 0, dirs = 0, flagged = 0;
+    unsigned long long revisited = 0, skipped = 0, gone = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (int i = 0; i < n_workers; i++) {
+        workers[i].inodes = workers[i].dirs = workers[i].flagged = 0;
+        workers[i].revisited = workers[i].skipped = 0;
+        workers[i].out_len = 0;
+    }
+
+    use_idx = 0;
+    if (index_base) {
+        int err = tsidx_open(&idx, index_base, 0);
+        if (err) {
+            fprintf(stderr, "[Index] %s: %s\n", index_base, strerror(-err));
+            return -1;
+        }
+        if (idx.hdr->checkpoint_wall &&
+            expected_wall_time() + epsilon < idx.hdr->checkpoint_wall)
+            fprintf(stderr, "[Index] clock is %llds behind the last checkpoint\n",
+                    (long long)(idx.hdr->checkpoint_wall - expected_wall_time()));
+        use_idx = 1;
+        index_begin_pass();
+    }
+
+    for (int i = 0; i < n_roots; i++) {
+        char real[PATH_MAX];
+        struct stat st;
+        if (!realpath(roots[i], real) || stat(real, &st) != 0) {
+            perror(roots[i]);
+            continue;
+        }
+        root_dev = st.st_dev;   /* -x: compared against the last root */
+        /* "/" would otherwise yield "//name" */
+        char *root = strdup(strcmp(real, "/") ? real : "");
+        if (!root)
+            continue;
+
+        if (use_idx) {
+            struct statx sx;
+            int descend = 1;
+            if (statx(AT_FDCWD, real, AT_STATX_DONT_SYNC, STATX_WANT, &sx) == 0)
+                index_visit(&sx, root, &descend);
+            if (!descend) {         /* already on the revisit list */
+                free(root);
+                continue;
+            }
+        }
+        submit_dir(&workers[i % n_workers], root);
+    }
+
+    for (int i = 0; i < n_workers; i++) {
+        if (pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]) != 0) {
+            perror("pthread_create");
+            return -1;
+        }
+    }
+    for (int i = 0; i < n_workers; i++) {
+        pthread_join(workers[i].tid, NULL);
+        inodes += workers[i].inodes;
+        dirs += workers[i].dirs;
+        flagged += workers[i].flagged;
+        revisited += workers[i].revisited;
+        skipped += workers[i].skipped;
+    }
+    fflush(out_fp);
+
+    if (use_idx)
+        gone = index_end_pass();
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    fprintf(stderr,
+            "[Scan] threads=%d dirs=%llu inodes=%llu flagged=%llu "
+            "elapsed=%.3fs rate=%.0f inodes/min\n",
+            n_workers, dirs, inodes, flagged, sec,
+            sec > 0 ? inodes / sec * 60.0 : 0.0);
+    if (use_idx) {
+        fprintf(stderr,
+                "[Index] mode=%s gen=%u revisited=%llu unchanged=%llu gone=%llu "
+                "entries=%llu dropped=%llu\n",
+                incremental ? "incremental" : "full", cur_gen,
+                revisited, skipped, gone,
+                (unsigned long long)idx.hdr->count,
+                (unsigned long long)idx.hdr->dropped);
+        tsidx_close(&idx);
+    }
+    return 0;
+}
+
+/* =========================================================
+ *  MAIN
+ * ========================================================= */
+int main(int argc, char **argv)
+{
+    int interval = 0;
+    const char *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:i:e:xo:I:F")) != -1) {
+        switch (opt) {
+        case 'j': n_workers = atoi(optarg); break;
+        case 'i': interval = atoi(optarg); break;
+        case 'e': epsilon = strtol(optarg, NULL, 10); break;
+        case 'x': one_fs = 1; break;
+        case 'o': out_path = optarg; break;
+        case 'I': index_base = optarg; break;
+        case 'F': force_full = 1; break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind >= argc)
+        goto usage;
+
+    if (n_workers <= 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_workers = ncpu > 0 ? (int)ncpu * 2 : 4;   /* statx blocks on I/O */
+    }
+    if (n_workers > MAX_WORKERS)
+        n_workers = MAX_WORKERS;
+
+    out_fp = stdout;
+    if (out_path) {
+        out_fp = fopen(out_path, "a");
+        if (!out_fp) {
+            perror("open output");
+            return 1;
+        }
+    }
+
+    workers = calloc(n_workers, sizeof(*workers));
+    if (!workers)
+        return 1;
+    for (int i = 0; i < n_workers; i++) {
+        workers[i].id = i;
+        pthread_mutex_init(&workers[i].dq.lock, NULL);
+        workers[i].dents = malloc(DENTS_BUF);
+        workers[i].batch = malloc(sizeof(*workers[i].batch));
+        if (!workers[i].dents || !workers[i].batch)
+            return 1;
+        workers[i].batch->n = 0;
+    }
+
+    signal(SIGINT, on_sig);
+    signal(SIGTERM, on_sig);
+
+    init_anchor();
+
+    do {
+        if (scan_pass(argv + optind, argc - optind) != 0)
+            return 1;
+        for (int s = 0; s < interval && !exiting; s++)
+            sleep(1);
+    } while (interval > 0 && !exiting);
+
+    if (out_fp != stdout)
+        fclose(out_fp);
+    return 0;
+
+usage:
+    fprintf(stderr,
+            "usage: %s [-j threads] [-i interval_sec] [-e epsilon] [-x] "
+            "[-o out] [-I index_base [-F]] <root>...\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,224 @@
+/*
+ * sha256.h - SHA-256 (FIPS 180-4), no dependencies.
+ *
+ * The devices this runs on do not all ship a crypto library, and the
+ * log chain only needs the one hash. Whole blocks of the input are
+ * compressed straight from the caller's buffer (an mmap'd log too);
+ * only a partial block is copied.
+ *
+ * x86-64 uses the SHA extensions when CPUID has them (target attribute,
+ * no -m flags needed); everything else uses the portable rounds.
+ */
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+  #include <cpuid.h>
+  #include <immintrin.h>
+  #define SHA256_X86 1
+#endif
+
+#define SHA256_LEN 32
+
+struct sha256 {
+    uint32_t h[8];
+    uint64_t len;               /* bytes so far */
+    uint8_t  buf[64];
+    size_t   n;                 /* bytes in buf */
+};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define SHA256_ROR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline void sha256_blocks_c(uint32_t h[8], const uint8_t *p, size_t nblk)
+{
+    while (nblk--) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+                   (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = SHA256_ROR(w[i - 15], 7) ^ SHA256_ROR(w[i - 15], 18) ^
+                          (w[i - 15] >> 3);
+            uint32_t s1 = SHA256_ROR(w[i - 2], 17) ^ SHA256_ROR(w[i - 2], 19) ^
+                          (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t S1 = SHA256_ROR(e, 6) ^ SHA256_ROR(e, 11) ^ SHA256_ROR(e, 25);
+            uint32_t t1 = k + S1 + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+            uint32_t S0 = SHA256_ROR(a, 2) ^ SHA256_ROR(a, 13) ^ SHA256_ROR(a, 22);
+            uint32_t t2 = S0 + ((a & b) ^ (a & c) ^ (b & c));
+            k = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+        p += 64;
+    }
+}
+
+#ifdef SHA256_X86
+/*
+ * The state lives as ABEF / CDGH for sha256rnds2; each round pair takes
+ * four schedule words plus constants, and the next four words come from
+ * msg1/msg2 over the last sixteen.
+ */
+__attribute__((target("sha,sse4.1")))
+static inline void sha256_blocks_ni(uint32_t h[8], const uint8_t *p, size_t nblk)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL);
+    __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xb1);
+    __m128i s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1b);
+    __m128i s0 = _mm_alignr_epi8(t, s1, 8);         /* ABEF */
+    s1 = _mm_blend_epi16(s1, t, 0xf0);              /* CDGH */
+
+    while (nblk--) {
+        __m128i abef = s0, cdgh = s1, m[4];
+
+        for (int i = 0; i < 4; i++)
+            m[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)(p + 16 * i)), bswap);
+        for (int g = 0; g < 16; g++) {
+            if (g >= 4) {
+                __m128i x = _mm_sha256msg1_epu32(m[g & 3], m[(g + 1) & 3]);
+                x = _mm_add_epi32(x, _mm_alignr_epi8(m[(g + 3) & 3],
+                                                     m[(g + 2) & 3], 4));
+                m[g & 3] = _mm_sha256msg2_epu32(x, m[(g + 3) & 3]);
+            }
+            __m128i k = _mm_add_epi32(m[g & 3],
+                _mm_loadu_si128((const __m128i *)&sha256_k[4 * g]));
+            s1 = _mm_sha256rnds2_epu32(s1, s0, k);
+            s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(k, 0x0e));
+        }
+        s0 = _mm_add_epi32(s0, abef);
+        s1 = _mm_add_epi32(s1, cdgh);
+        p += 64;
+    }
+
+    t = _mm_shuffle_epi32(s0, 0x1b);                /* FEBA */
+    s1 = _mm_shuffle_epi32(s1, 0xb1);               /* DCHG */
+    _mm_storeu_si128((__m128i *)&h[0], _mm_blend_epi16(t, s1, 0xf0));
+    _mm_storeu_si128((__m128i *)&h[4], _mm_alignr_epi8(s1, t, 8));
+}
+
+static inline int sha256_have_ni(void)
+{
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1) || !(c & bit_SSSE3))
+        return 0;
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+        return 0;
+    return (b >> 29) & 1;       /* SHA */
+}
+#endif /* SHA256_X86 */
+
+static inline void sha256_blocks(uint32_t h[8], const uint8_t *p, size_t nblk)
+{
+#ifdef SHA256_X86
+    static int ni = -1;         /* racing first calls agree on the value */
+    if (ni < 0)
+        ni = sha256_have_ni();
+    if (ni) {
+        sha256_blocks_ni(h, p, nblk);
+        return;
+    }
+#endif
+    sha256_blocks_c(h, p, nblk);
+}
+
+static inline void sha256_init(struct sha256 *s)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(s->h, iv, sizeof(iv));
+    s->len = 0;
+    s->n = 0;
+}
+
+static inline void sha256_update(struct sha256 *s, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    s->len += len;
+    if (s->n) {
+        size_t k = 64 - s->n < len ? 64 - s->n : len;
+        memcpy(s->buf + s->n, p, k);
+        s->n += k;
+        p += k;
+        len -= k;
+        if (s->n < 64)
+            return;
+        sha256_blocks(s->h, s->buf, 1);
+        s->n = 0;
+    }
+    if (len >= 64) {
+        sha256_blocks(s->h, p, len / 64);
+        p += len & ~(size_t)63;
+        len &= 63;
+    }
+    memcpy(s->buf, p, len);
+    s->n = len;
+}
+
+static inline void sha256_final(struct sha256 *s, uint8_t out[SHA256_LEN])
+{
+    uint64_t bits = s->len * 8;
+
+    s->buf[s->n++] = 0x80;
+    if (s->n > 56) {
+        memset(s->buf + s->n, 0, 64 - s->n);
+        sha256_blocks(s->h, s->buf, 1);
+        s->n = 0;
+    }
+    memset(s->buf + s->n, 0, 56 - s->n);
+    for (int i = 0; i < 8; i++)
+        s->buf[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_blocks(s->h, s->buf, 1);
+
+    for (int i = 0; i < 8; i++) {
+        out[4 * i]     = (uint8_t)(s->h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(s->h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(s->h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)s->h[i];
+    }
+}
+
+static inline void sha256(const void *data, size_t len, uint8_t out[SHA256_LEN])
+{
+    struct sha256 s;
+    sha256_init(&s);
+    sha256_update(&s, data, len);
+    sha256_final(&s, out);
+}
+
+#endif /* SHA256_H */
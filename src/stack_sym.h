@@ -0,0 +1,705 @@
+/*
+ * stack_sym.h - symbolize the caller stacks the BPF side captures.
+ *
+ * Only events outside epsilon carry stack ids, so this runs at alert
+ * rate, not event rate, and every table is filled on first use:
+ *
+ *   stack    (pid, comm, kernel id, user id) -> formatted frames; a
+ *            caller that keeps setting the clock costs one lookup here
+ *   process  pid -> its executable mappings (/proc/pid/maps)
+ *   object   build-id, or dev:inode without one -> ELF symbols, shared
+ *            by every process mapping the same file
+ *   kernel   /proc/kallsyms, read once
+ *
+ * Frames are "sym+0xoff", "file+0xoff" (file offset, no symbol) or the
+ * bare address, ';'-separated, innermost first. A negative id is the
+ * bpf_get_stackid error and is written as such. A process that exits
+ * before its alert is written (date(1) does at once) only gets bare
+ * user addresses.
+ *
+ * A pid reused by another program shows up with another comm, which is
+ * part of the key, so it does not hit a dead process's entries.
+ *
+ * One mutex around it all: consumer threads rarely get here.
+ */
+#ifndef STACK_SYM_H
+#define STACK_SYM_H
+
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#if __has_include(<bpf/bpf.h>)
+  #include <bpf/bpf.h>
+#else
+  #include <bpf.h>
+#endif
+
+#define SS_DEPTH     32         /* STACK_DEPTH on the BPF side */
+#define SS_NONE      (-2)       /* STACK_NONE: no stack captured */
+#define SS_TEXT_MAX  384        /* formatted frames of one stack */
+#define SS_STACKS    256
+#define SS_PROCS     16
+#define SS_OBJS      128
+#define SS_SEGS      8
+#define SS_NAME_MAX  96         /* symbol chars kept per frame */
+#define SS_ID_MAX    32         /* build-id bytes */
+
+struct ss_sym {
+    uint64_t addr;
+    uint64_t size;
+    const char *name;
+};
+
+struct ss_obj {
+    uint8_t id[SS_ID_MAX];
+    size_t id_len;              /* 0: no build-id, keyed by dev:inode */
+    dev_t dev;
+    ino_t ino;
+    char name[64];              /* basename, for frames with no symbol */
+
+    const uint8_t *elf;         /* whole file, mapped read-only */
+    size_t elf_len;
+    struct {
+        uint64_t off, vaddr, len;
+    } seg[SS_SEGS];             /* PT_LOAD: file offset -> vaddr */
+    int n_seg;
+
+    struct ss_sym *sym;         /* by addr; loaded on first lookup */
+    size_t n_sym;
+    int sym_loaded;
+};
+
+struct ss_map {
+    uint64_t start, end, pgoff;
+    dev_t dev;
+    ino_t ino;
+    char *path;
+    struct ss_obj *obj;
+    int tried;                  /* obj looked up (NULL: not an ELF) */
+};
+
+struct ss_proc {
+    uint32_t pid;               /* 0: free */
+    char comm[16];
+    struct ss_map *map;         /* executable mappings, by address */
+    size_t n_map;
+};
+
+struct ss_stack {
+    uint32_t pid;
+    int32_t kid, uid;
+    char comm[16];
+    int used;
+    uint16_t klen, ulen;
+    char k[SS_TEXT_MAX];
+    char u[SS_TEXT_MAX];
+};
+
+/* what ss_frames hands back: copies, so the cache can move on */
+struct ss_text {
+    char k[SS_TEXT_MAX];
+    char u[SS_TEXT_MAX];
+    size_t klen, ulen;
+};
+
+struct stack_sym {
+    pthread_mutex_t lock;
+    int fd;                     /* stacks map; -1: off */
+
+    struct ss_stack *stack;
+    struct ss_proc proc[SS_PROCS];
+    unsigned proc_next;
+    struct ss_obj *obj[SS_OBJS];
+    int n_obj;
+
+    struct ss_sym *ksym;
+    size_t n_ksym;
+    char *kpool;
+    int k_tried;
+
+    /* stats */
+    unsigned long long hits, misses, maps_read, objects, unresolved, errors;
+};
+
+/* =========================================================
+ *  ELF OBJECTS
+ * ========================================================= */
+static int ss_elf_ok(const uint8_t *p, size_t len)
+{
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *)p;
+
+    return len >= sizeof(*eh) && memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 &&
+           eh->e_ident[EI_CLASS] == ELFCLASS64 &&
+           eh->e_phentsize == sizeof(Elf64_Phdr) &&
+           eh->e_phoff <= len &&
+           (len - eh->e_phoff) / sizeof(Elf64_Phdr) >= eh->e_phnum;
+}
+
+/* NT_GNU_BUILD_ID from the PT_NOTE segments; 0 if there is none */
+static size_t ss_build_id(const uint8_t *p, size_t len, uint8_t id[SS_ID_MAX])
+{
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *)p;
+    const Elf64_Phdr *ph = (const Elf64_Phdr *)(p + eh->e_phoff);
+
+    for (int i = 0; i < eh->e_phnum; i++) {
+        if (ph[i].p_type != PT_NOTE || ph[i].p_offset > len ||
+            ph[i].p_filesz > len - ph[i].p_offset)
+            continue;
+        const uint8_t *n = p + ph[i].p_offset, *end = n + ph[i].p_filesz;
+        while (end - n >= (long)sizeof(Elf64_Nhdr)) {
+            const Elf64_Nhdr *nh = (const Elf64_Nhdr *)n;
+            size_t name = (nh->n_namesz + 3) & ~3u, desc = (nh->n_descsz + 3) & ~3u;
+            const uint8_t *d = n + sizeof(*nh) + name;
+            if (name > (size_t)(end - n) || desc > (size_t)(end - d))
+                break;
+            if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4 &&
+                memcmp(n + sizeof(*nh), "GNU", 4) == 0 && nh->n_descsz &&
+                nh->n_descsz <= SS_ID_MAX) {
+                memcpy(id, d, nh->n_descsz);
+                return nh->n_descsz;
+            }
+            n = d + desc;
+        }
+    }
+    return 0;
+}
+
+static int ss_sym_cmp(const void *a, const void *b)
+{
+    const struct ss_sym *x = a, *y = b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+/* function symbols of .symtab, or .dynsym when stripped */
+static void ss_obj_syms(struct ss_obj *o)
+{
+    const uint8_t *p = o->elf;
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr *)p;
+    const Elf64_Shdr *sh, *tab = NULL, *str;
+
+    o->sym_loaded = 1;
+    if (eh->e_shentsize != sizeof(Elf64_Shdr) || eh->e_shoff > o->elf_len ||
+        (o->elf_len - eh->e_shoff) / sizeof(Elf64_Shdr) < eh->e_shnum)
+        return;
+    sh = (const Elf64_Shdr *)(p + eh->e_shoff);
+    for (int i = 0; i < eh->e_shnum; i++) {
+        if (sh[i].sh_type == SHT_SYMTAB)
+            tab = &sh[i];
+        else if (sh[i].sh_type == SHT_DYNSYM && !tab)
+            tab = &sh[i];
+    }
+    if (!tab || tab->sh_link >= eh->e_shnum || tab->sh_offset > o->elf_len ||
+        tab->sh_size > o->elf_len - tab->sh_offset)
+        return;
+    str = &sh[tab->sh_link];
+    if (str->sh_offset > o->elf_len || str->sh_size > o->elf_len - str->sh_offset)
+        return;
+
+    const Elf64_Sym *s = (const Elf64_Sym *)(p + tab->sh_offset);
+    const char *names = (const char *)p + str->sh_offset;
+    size_t n = tab->sh_size / sizeof(*s);
+
+    o->sym = malloc(n * sizeof(*o->sym) + 1);
+    if (!o->sym)
+        return;
+    for (size_t i = 0; i < n; i++) {
+        int type = ELF64_ST_TYPE(s[i].st_info);
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) ||
+            s[i].st_shndx == SHN_UNDEF || !s[i].st_value ||
+            s[i].st_name >= str->sh_size ||
+            !memchr(names + s[i].st_name, 0, str->sh_size - s[i].st_name))
+            continue;
+        o->sym[o->n_sym++] = (struct ss_sym){
+            s[i].st_value, s[i].st_size, names + s[i].st_name,
+        };
+    }
+    qsort(o->sym, o->n_sym, sizeof(*o->sym), ss_sym_cmp);
+}
+
+/* last symbol at or below addr that still covers it (size 0: any) */
+static const struct ss_sym *ss_sym_find(const struct ss_sym *s, size_t n,
+                                        uint64_t addr)
+{
+    size_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (s[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo)
+        return NULL;
+    s += lo - 1;
+    return !s->size || addr < s->addr + s->size ? s : NULL;
+}
+
+static struct ss_obj *ss_obj_get(struct stack_sym *ss, const struct ss_map *m,
+                                 uint32_t pid)
+{
+    char path[64];
+    struct stat st;
+    uint8_t id[SS_ID_MAX];
+
+    for (int i = 0; i < ss->n_obj; i++)
+        if (ss->obj[i]->dev == m->dev && ss->obj[i]->ino == m->ino)
+            return ss->obj[i];
+
+    /* map_files still opens a file replaced or deleted since the mmap */
+    snprintf(path, sizeof(path), "/proc/%u/map_files/%" PRIx64 "-%" PRIx64,
+             pid, m->start, m->end);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        fd = open(m->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void *elf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (elf == MAP_FAILED)
+        return NULL;
+    if (!ss_elf_ok(elf, st.st_size))
+        goto drop;
+
+    /* same build-id under another path (bind mounts, APEX) */
+    size_t id_len = ss_build_id(elf, st.st_size, id);
+    for (int i = 0; id_len && i < ss->n_obj; i++)
+        if (ss->obj[i]->id_len == id_len && memcmp(ss->obj[i]->id, id, id_len) == 0) {
+            munmap(elf, st.st_size);
+            return ss->obj[i];
+        }
+    if (ss->n_obj == SS_OBJS)
+        goto drop;
+
+    struct ss_obj *o = calloc(1, sizeof(*o));
+    if (!o)
+        goto drop;
+    memcpy(o->id, id, id_len);
+    o->id_len = id_len;
+    o->dev = m->dev;
+    o->ino = m->ino;
+    const char *base = strrchr(m->path, '/');
+    snprintf(o->name, sizeof(o->name), "%s", base ? base + 1 : m->path);
+    o->elf = elf;
+    o->elf_len = st.st_size;
+
+    const Elf64_Ehdr *eh = elf;
+    const Elf64_Phdr *ph = (const Elf64_Phdr *)(o->elf + eh->e_phoff);
+    for (int i = 0; i < eh->e_phnum && o->n_seg < SS_SEGS; i++)
+        if (ph[i].p_type == PT_LOAD) {
+            o->seg[o->n_seg].off = ph[i].p_offset;
+            o->seg[o->n_seg].vaddr = ph[i].p_vaddr;
+            o->seg[o->n_seg].len = ph[i].p_filesz;
+            o->n_seg++;
+        }
+    ss->obj[ss->n_obj++] = o;
+    ss->objects++;
+    return o;
+
+drop:
+    munmap(elf, st.st_size);
+    return NULL;
+}
+
+/* =========================================================
+ *  PROCESSES
+ * ========================================================= */
+static void ss_proc_free(struct ss_proc *pr)
+{
+    for (size_t i = 0; i < pr->n_map; i++)
+        free(pr->map[i].path);
+    free(pr->map);
+    memset(pr, 0, sizeof(*pr));
+}
+
+/* the executable file mappings of pid into pr; /proc lists them by address */
+static struct ss_proc *ss_proc_load(struct stack_sym *ss, struct ss_proc *pr,
+                                    uint32_t pid, const char comm[16])
+{
+    char path[32], *line = NULL;
+    size_t cap = 0, n_cap = 0;
+
+    ss_proc_free(pr);
+    snprintf(path, sizeof(path), "/proc/%u/maps", pid);
+    FILE *f = fopen(path, "re");
+    if (!f)
+        return NULL;
+    ss->maps_read++;
+
+    while (getline(&line, &cap, f) > 0) {
+        uint64_t start, end, pgoff, ino;
+        unsigned maj, min;
+        char perm[5];
+        int off = 0;
+
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %4s %" SCNx64 " %x:%x %" SCNu64 " %n",
+                   &start, &end, perm, &pgoff, &maj, &min, &ino, &off) < 7 ||
+            perm[2] != 'x' || line[off] != '/')
+            continue;
+        line[strcspn(line, "\n")] = 0;
+        if (pr->n_map == n_cap) {
+            size_t nc = n_cap ? n_cap * 2 : 32;
+            struct ss_map *m = realloc(pr->map, nc * sizeof(*m));
+            if (!m)
+                break;
+            pr->map = m;
+            n_cap = nc;
+        }
+        char *p = strdup(line + off);
+        if (!p)
+            break;
+        pr->map[pr->n_map++] = (struct ss_map){
+            .start = start, .end = end, .pgoff = pgoff,
+            .dev = makedev(maj, min), .ino = (ino_t)ino, .path = p,
+        };
+    }
+    free(line);
+    fclose(f);
+    pr->pid = pid;
+    memcpy(pr->comm, comm, sizeof(pr->comm));
+    return pr;
+}
+
+static struct ss_proc *ss_proc_get(struct stack_sym *ss, uint32_t pid,
+                                   const char comm[16], int *fresh)
+{
+    for (int i = 0; i < SS_PROCS; i++)
+        if (ss->proc[i].pid == pid &&
+            memcmp(ss->proc[i].comm, comm, sizeof(ss->proc[i].comm)) == 0) {
+            *fresh = 0;
+            return &ss->proc[i];
+        }
+    *fresh = 1;
+    return ss_proc_load(ss, &ss->proc[ss->proc_next++ % SS_PROCS], pid, comm);
+}
+
+static struct ss_map *ss_map_find(struct ss_proc *pr, uint64_t ip)
+{
+    size_t lo = 0, hi = pr->n_map;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ip < pr->map[mid].start)
+            hi = mid;
+        else if (ip >= pr->map[mid].end)
+            lo = mid + 1;
+        else
+            return &pr->map[mid];
+    }
+    return NULL;
+}
+
+/* =========================================================
+ *  KERNEL
+ * ========================================================= */
+static void ss_kallsyms(struct stack_sym *ss)
+{
+    FILE *f = fopen("/proc/kallsyms", "re");
+    char *line = NULL;
+    size_t cap = 0, n_cap = 0, pool_len = 0, pool_cap = 0;
+    int nonzero = 0;
+
+    ss->k_tried = 1;
+    if (!f)
+        return;
+    while (getline(&line, &cap, f) > 0) {
+        char *end, type, *name;
+        uint64_t addr = strtoull(line, &end, 16);
+
+        if (end == line || end[0] != ' ' || !end[1] || end[2] != ' ')
+            continue;
+        type = end[1];
+        if (type != 't' && type != 'T' && type != 'w' && type != 'W')
+            continue;
+        name = end + 3;
+        name[strcspn(name, " \t\n")] = 0;   /* drop "[module]" */
+        nonzero |= addr != 0;
+
+        size_t len = strlen(name) + 1;
+        if (ss->n_ksym == n_cap) {
+            size_t nc = n_cap ? n_cap * 2 : 4096;
+            struct ss_sym *s = realloc(ss->ksym, nc * sizeof(*s));
+            if (!s)
+                break;
+            ss->ksym = s;
+            n_cap = nc;
+        }
+        if (pool_len + len > pool_cap) {
+            size_t nc = pool_cap ? pool_cap * 2 : 1 << 16;
+            char *p = realloc(ss->kpool, nc);
+            if (!p)
+                break;
+            ss->kpool = p;
+            pool_cap = nc;
+        }
+        memcpy(ss->kpool + pool_len, name, len);
+        /* pool offset for now: the pool still moves */
+        ss->ksym[ss->n_ksym++] = (struct ss_sym){ addr, 0, (const char *)(uintptr_t)pool_len };
+        pool_len += len;
+    }
+    free(line);
+    fclose(f);
+
+    if (!nonzero) {             /* kptr_restrict: addresses read as 0 */
+        ss->n_ksym = 0;
+        return;
+    }
+    for (size_t i = 0; i < ss->n_ksym; i++)
+        ss->ksym[i].name = ss->kpool + (uintptr_t)ss->ksym[i].name;
+    qsort(ss->ksym, ss->n_ksym, sizeof(*ss->ksym), ss_sym_cmp);
+}
+
+/* =========================================================
+ *  FRAMES
+ * ========================================================= */
+
+/* one frame after the others; 0 once the text is full */
+static int ss_put(char *t, uint16_t *len, const char *name, uint64_t off,
+                  int has_name)
+{
+    char f[SS_NAME_MAX + 24];
+    int n;
+
+    if (has_name) {
+        n = 0;
+        for (; n < SS_NAME_MAX && name[n]; n++) {
+            unsigned char c = (unsigned char)name[n];
+            /* one token in either log style */
+            f[n] = c <= ' ' || c >= 0x7f || c == '"' || c == '\\' || c == ';' ?
+                   '?' : (char)c;
+        }
+        n += snprintf(f + n, sizeof(f) - n, "+0x%" PRIx64, off);
+    } else {
+        n = snprintf(f, sizeof(f), "0x%" PRIx64, off);
+    }
+
+    size_t sep = *len != 0;
+    if (*len + sep + n > SS_TEXT_MAX - 4) {
+        memcpy(t + *len, ";...", 4);
+        *len += 4;
+        return 0;
+    }
+    if (sep)
+        t[(*len)++] = ';';
+    memcpy(t + *len, f, n);
+    *len += n;
+    return 1;
+}
+
+static void ss_err(char *t, uint16_t *len, int32_t id)
+{
+    *len = (uint16_t)snprintf(t, SS_TEXT_MAX, "%d", id);
+}
+
+static int ss_ips(struct stack_sym *ss, int32_t id, uint64_t ips[SS_DEPTH])
+{
+    uint32_t key = (uint32_t)id;
+
+    if (bpf_map_lookup_elem(ss->fd, &key, ips) != 0) {
+        ss->errors++;
+        return -1;
+    }
+    return 0;
+}
+
+static void ss_kernel(struct stack_sym *ss, struct ss_stack *e)
+{
+    uint64_t ips[SS_DEPTH];
+
+    if (e->kid < 0) {
+        ss_err(e->k, &e->klen, e->kid);
+        return;
+    }
+    if (ss_ips(ss, e->kid, ips) != 0) {
+        ss_err(e->k, &e->klen, -ENOENT);
+        return;
+    }
+    if (!ss->k_tried)
+        ss_kallsyms(ss);
+    for (int i = 0; i < SS_DEPTH && ips[i]; i++) {
+        const struct ss_sym *s = ss_sym_find(ss->ksym, ss->n_ksym, ips[i]);
+        if (!(s ? ss_put(e->k, &e->klen, s->name, ips[i] - s->addr, 1) :
+                  ss_put(e->k, &e->klen, NULL, ips[i], 0)))
+            break;
+    }
+}
+
+/* the frames of e->uid in pr; how many addresses were outside its maps */
+static int ss_user_frames(struct stack_sym *ss, struct ss_stack *e,
+                          struct ss_proc *pr, const uint64_t ips[SS_DEPTH])
+{
+    int unmapped = 0;
+
+    e->ulen = 0;
+    for (int i = 0; i < SS_DEPTH && ips[i]; i++) {
+        /* a return address: look up the call, which is before it */
+        uint64_t ip = ips[i], at = i ? ip - 1 : ip;
+        struct ss_map *m = pr ? ss_map_find(pr, at) : NULL;
+        int more;
+
+        if (!m) {
+            unmapped++;
+            more = ss_put(e->u, &e->ulen, NULL, ip, 0);
+        } else {
+            if (!m->tried) {
+                m->obj = ss_obj_get(ss, m, pr->pid);
+                m->tried = 1;
+            }
+            struct ss_obj *o = m->obj;
+            uint64_t foff = at - m->start + m->pgoff;
+            uint64_t off = ip - m->start + m->pgoff;
+            const struct ss_sym *s = NULL;
+
+            if (o) {
+                if (!o->sym_loaded)
+                    ss_obj_syms(o);
+                for (int k = 0; k < o->n_seg; k++)
+                    if (foff - o->seg[k].off < o->seg[k].len) {
+                        uint64_t va = foff - o->seg[k].off + o->seg[k].vaddr;
+                        s = ss_sym_find(o->sym, o->n_sym, va);
+                        if (s)
+                            off = va + (ip - at) - s->addr;
+                        break;
+                    }
+            }
+            if (s) {
+                more = ss_put(e->u, &e->ulen, s->name, off, 1);
+            } else {
+                const char *base = strrchr(m->path, '/');
+                more = ss_put(e->u, &e->ulen, o ? o->name : base ? base + 1 : m->path,
+                              off, 1);
+            }
+        }
+        if (!more)
+            break;
+    }
+    return unmapped;
+}
+
+static void ss_user(struct stack_sym *ss, struct ss_stack *e)
+{
+    uint64_t ips[SS_DEPTH];
+    int fresh;
+
+    if (e->uid < 0) {
+        ss_err(e->u, &e->ulen, e->uid);
+        return;
+    }
+    if (ss_ips(ss, e->uid, ips) != 0) {
+        ss_err(e->u, &e->ulen, -ENOENT);
+        return;
+    }
+    struct ss_proc *pr = ss_proc_get(ss, e->pid, e->comm, &fresh);
+    int unmapped = ss_user_frames(ss, e, pr, ips);
+
+    /* mapped since we read its maps (dlopen): read them again, once */
+    if (unmapped && pr && !fresh) {
+        pr = ss_proc_load(ss, pr, e->pid, e->comm);
+        unmapped = ss_user_frames(ss, e, pr, ips);
+    }
+    if (unmapped)
+        ss->unresolved++;
+}
+
+static uint32_t ss_hash(uint32_t pid, int32_t kid, int32_t uid)
+{
+    uint64_t h = ((uint64_t)pid << 32 | (uint32_t)kid) * 0x9e3779b97f4a7c15ULL;
+    h ^= (uint32_t)uid * 0xc2b2ae3d27d4eb4fULL;
+    return (uint32_t)(h >> 32);
+}
+
+/*
+ * Frames of one alert into out. Both texts are empty when nothing was
+ * captured (kid and uid SS_NONE) or stacks are off.
+ */
+static void ss_frames(struct stack_sym *ss, uint32_t pid, const char comm[16],
+                      int32_t kid, int32_t uid, struct ss_text *out)
+{
+    out->klen = out->ulen = 0;
+    if (ss->fd < 0 || (kid == SS_NONE && uid == SS_NONE))
+        return;
+
+    pthread_mutex_lock(&ss->lock);
+    uint32_t h = ss_hash(pid, kid, uid);
+    struct ss_stack *e = NULL, *slot = NULL;
+    for (int i = 0; i < 8; i++) {   /* short probe, then take the home slot */
+        struct ss_stack *c = &ss->stack[(h + i) % SS_STACKS];
+        if (!c->used) {
+            slot = c;
+            break;
+        }
+        if (c->pid == pid && c->kid == kid && c->uid == uid &&
+            memcmp(c->comm, comm, sizeof(c->comm)) == 0) {
+            e = c;
+            break;
+        }
+    }
+    if (e) {
+        ss->hits++;
+    } else {
+        e = slot ? slot : &ss->stack[h % SS_STACKS];
+        ss->misses++;
+        e->used = 1;
+        e->pid = pid;
+        e->kid = kid;
+        e->uid = uid;
+        memcpy(e->comm, comm, sizeof(e->comm));
+        e->klen = e->ulen = 0;
+        ss_kernel(ss, e);
+        ss_user(ss, e);
+    }
+    memcpy(out->k, e->k, e->klen);
+    memcpy(out->u, e->u, e->ulen);
+    out->klen = e->klen;
+    out->ulen = e->ulen;
+    pthread_mutex_unlock(&ss->lock);
+}
+
+/* map_fd < 0: stacks off (replay, or a pinned program without them) */
+static int ss_open(struct stack_sym *ss, int map_fd)
+{
+    memset(ss, 0, sizeof(*ss));
+    pthread_mutex_init(&ss->lock, NULL);
+    ss->fd = -1;
+    if (map_fd < 0)
+        return 0;
+    ss->stack = calloc(SS_STACKS, sizeof(*ss->stack));
+    if (!ss->stack)
+        return -ENOMEM;
+    ss->fd = map_fd;
+    return 0;
+}
+
+static void ss_close(struct stack_sym *ss)
+{
+    for (int i = 0; i < SS_PROCS; i++)
+        ss_proc_free(&ss->proc[i]);
+    for (int i = 0; i < ss->n_obj; i++) {
+        munmap((void *)ss->obj[i]->elf, ss->obj[i]->elf_len);
+        free(ss->obj[i]->sym);
+        free(ss->obj[i]);
+    }
+    free(ss->ksym);
+    free(ss->kpool);
+    free(ss->stack);
+    pthread_mutex_destroy(&ss->lock);
+    ss->n_obj = 0;
+    ss->fd = -1;
+}
+
+#endif /* STACK_SYM_H */
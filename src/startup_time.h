@@ -0,0 +1,46 @@
+/*
+ * startup_time.h - startup latency (exec -> attached) of the BPF loaders.
+ *
+ * The exec side comes from the starttime field of /proc/self/stat (clock
+ * ticks since boot), the main() side from CLOCK_BOOTTIME so both are on
+ * the same clock.
+ */
+#ifndef STARTUP_TIME_H
+#define STARTUP_TIME_H
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline long long exec_boot_ns(void)
+{
+    char buf[1024];
+    FILE *fp = fopen("/proc/self/stat", "r");
+    if (!fp)
+        return -1;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    /* comm may contain spaces: skip past the last ')' (field 2) */
+    char *p = strrchr(buf, ')');
+    if (!p)
+        return -1;
+
+    unsigned long long start_ticks = 0;
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                      "%*u %*u %*d %*d %*d %*d %*d %*d %llu", &start_ticks) != 1)
+        return -1;
+
+    return (long long)start_ticks * 1000000000LL / sysconf(_SC_CLK_TCK);
+}
+
+static inline long long boot_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#endif /* STARTUP_TIME_H */
@@ -0,0 +1,276 @@
+/*
+ * tamper_index.h - interval index of clock tamper windows.
+ *
+ * A tamper window is a stretch of CLOCK_BOOTTIME during which the wall
+ * clock differed from the trusted timeline by more than epsilon. It is
+ * opened by a settimeofday that lands outside epsilon and closed by the
+ * next one (back inside epsilon, or to another offset, which opens the
+ * next window). While a window is open the system showed
+ *
+ *   shown(b) = shown_start + (b - start_ns)        (seconds)
+ *
+ * so it has two ranges worth querying:
+ *
+ *   tamper_at(b)          was the clock off at boot time b?
+ *                         windows are disjoint in boot time: binary search
+ *   tamper_written_in(v)  could wall value v (a file timestamp) have been
+ *                         produced inside a window? shown ranges overlap,
+ *                         so this is a stabbing query on an interval tree
+ *
+ * tamper_at is O(log n); tamper_written_in is O(log^2 n) (+k for
+ * overlapping hits). Clock events must be fed in boot-time order.
+ *
+ * The wall-ordered side is a set of static levels (level k holds 0 or
+ * 2^k windows, each a sorted array read as an implicit BST with max_end
+ * per node). A new window merges the full levels below the first empty
+ * one, like a binary counter, so a storm of settimeofday calls with a
+ * new offset each costs O(log n) amortized per window instead of a full
+ * rebuild. Closing a window only lowers its end; the stale max_end above
+ * it is still an upper bound, so nothing is rebuilt.
+ */
+#ifndef TAMPER_INDEX_H
+#define TAMPER_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAMPER_OPEN INT64_MAX   /* end_ns of a window still in progress */
+#define TAMPER_LEVELS 32
+
+struct tamper_win {
+    int64_t start_ns;           /* CLOCK_BOOTTIME of the settimeofday */
+    int64_t end_ns;             /* next settimeofday, or TAMPER_OPEN */
+    int64_t shown_start;        /* wall clock set at start_ns (sec) */
+    int64_t offset;             /* shown - trusted (sec) */
+};
+
+struct tamper_level {
+    uint32_t *by_wall;          /* win indices sorted by shown_start */
+    int64_t *max_end;           /* per by_wall node: max shown end in subtree */
+    size_t n;                   /* 0 or 1 << level */
+};
+
+struct tamper_index {
+    long epsilon;
+    uint64_t clock_events;      /* 0: nothing known about the clock yet */
+    struct tamper_win *win;     /* boot-time order */
+    size_t n, cap;
+    struct tamper_level lv[TAMPER_LEVELS];
+    uint32_t *merge_tmp;
+    size_t merge_cap;
+};
+
+static inline void tamper_init(struct tamper_index *ix, long epsilon)
+{
+    memset(ix, 0, sizeof(*ix));
+    ix->epsilon = epsilon;
+}
+
+static inline void tamper_free(struct tamper_index *ix)
+{
+    free(ix->win);
+    for (int k = 0; k < TAMPER_LEVELS; k++) {
+        free(ix->lv[k].by_wall);
+        free(ix->lv[k].max_end);
+    }
+    free(ix->merge_tmp);
+    memset(ix, 0, sizeof(*ix));
+}
+
+/* last second the window showed; open windows are unbounded in the tree */
+static inline int64_t tamper_shown_end(const struct tamper_win *w, int64_t now_ns)
+{
+    int64_t end = w->end_ns;
+    if (end == TAMPER_OPEN) {
+        if (now_ns == TAMPER_OPEN)
+            return INT64_MAX;
+        end = now_ns;
+    }
+    return w->shown_start + (end - w->start_ns + 999999999) / 1000000000;
+}
+
+static inline int64_t tamper_build(struct tamper_index *ix, struct tamper_level *l,
+                                   size_t lo, size_t hi)
+{
+    if (lo >= hi)
+        return INT64_MIN;
+    size_t mid = lo + (hi - lo) / 2;
+    int64_t m = tamper_shown_end(&ix->win[l->by_wall[mid]], TAMPER_OPEN);
+    int64_t a = tamper_build(ix, l, lo, mid);
+    int64_t b = tamper_build(ix, l, mid + 1, hi);
+    if (a > m) m = a;
+    if (b > m) m = b;
+    l->max_end[mid] = m;
+    return m;
+}
+
+/* merge sorted runs a and b (by shown_start) into out */
+static inline void tamper_merge(const struct tamper_index *ix,
+                                const uint32_t *a, size_t na,
+                                const uint32_t *b, size_t nb, uint32_t *out)
+{
+    size_t i = 0, j = 0, o = 0;
+    while (i < na && j < nb)
+        out[o++] = ix->win[b[j]].shown_start < ix->win[a[i]].shown_start ?
+                   b[j++] : a[i++];
+    while (i < na)
+        out[o++] = a[i++];
+    while (j < nb)
+        out[o++] = b[j++];
+}
+
+/* add window w to the wall-ordered levels */
+static inline int tamper_insert(struct tamper_index *ix, uint32_t w)
+{
+    int k = 0;
+    while (k < TAMPER_LEVELS && ix->lv[k].n)
+        k++;
+    if (k == TAMPER_LEVELS)
+        return -1;
+
+    size_t size = (size_t)1 << k;
+    struct tamper_level *dst = &ix->lv[k];
+    if (!dst->by_wall) {
+        dst->by_wall = malloc(size * sizeof(*dst->by_wall));
+        dst->max_end = malloc(size * sizeof(*dst->max_end));
+        if (!dst->by_wall || !dst->max_end)
+            return -1;
+    }
+    if (ix->merge_cap < size) {
+        uint32_t *t = realloc(ix->merge_tmp, size * sizeof(*t));
+        if (!t)
+            return -1;
+        ix->merge_tmp = t;
+        ix->merge_cap = size;
+    }
+
+    /* k merges ping-pong between the buffers and must end in dst */
+    uint32_t *cur = (k & 1) ? ix->merge_tmp : dst->by_wall;
+    uint32_t *other = (k & 1) ? dst->by_wall : ix->merge_tmp;
+    size_t n = 1;
+    cur[0] = w;
+    for (int j = 0; j < k; j++) {
+        tamper_merge(ix, cur, n, ix->lv[j].by_wall, ix->lv[j].n, other);
+        n += ix->lv[j].n;
+        ix->lv[j].n = 0;
+        uint32_t *t = cur;
+        cur = other;
+        other = t;
+    }
+
+    dst->n = n;
+    tamper_build(ix, dst, 0, n);
+    return 0;
+}
+
+static inline int tamper_grow(struct tamper_index *ix)
+{
+    size_t cap = ix->cap ? ix->cap * 2 : 64;
+    struct tamper_win *w = realloc(ix->win, cap * sizeof(*w));
+    if (!w)
+        return -1;
+    ix->win = w;
+    ix->cap = cap;
+    return 0;
+}
+
+/*
+ * One settimeofday: the clock was set to new_wall when the trusted
+ * timeline said expected (both seconds), at boot time boot_ns.
+ */
+static inline void tamper_clock_event(struct tamper_index *ix, int64_t boot_ns,
+                                      int64_t new_wall, int64_t expected)
+{
+    int64_t diff = new_wall - expected;
+
+    ix->clock_events++;
+
+    if (ix->n && ix->win[ix->n - 1].end_ns == TAMPER_OPEN) {
+        struct tamper_win *last = &ix->win[ix->n - 1];
+        /* same offset again (e.g. a retry): the window just continues */
+        if (diff - last->offset <= ix->epsilon &&
+            last->offset - diff <= ix->epsilon)
+            return;
+        last->end_ns = boot_ns > last->start_ns ? boot_ns : last->start_ns;
+    }
+
+    if (diff > ix->epsilon || diff < -ix->epsilon) {
+        if (ix->n == ix->cap && tamper_grow(ix) != 0)
+            return;
+        ix->win[ix->n] = (struct tamper_win){
+            .start_ns = boot_ns,
+            .end_ns = TAMPER_OPEN,
+            .shown_start = new_wall,
+            .offset = diff,
+        };
+        /* not in the wall levels (no memory): tamper_at still sees it */
+        (void)tamper_insert(ix, (uint32_t)ix->n);
+        ix->n++;
+    }
+}
+
+/* window the clock was in at boot_ns, or NULL (clock was trusted) */
+static inline const struct tamper_win *tamper_at(const struct tamper_index *ix,
+                                                 int64_t boot_ns)
+{
+    size_t lo = 0, hi = ix->n;      /* first window starting after boot_ns */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ix->win[mid].start_ns <= boot_ns)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return NULL;
+    const struct tamper_win *w = &ix->win[lo - 1];
+    return boot_ns < w->end_ns ? w : NULL;
+}
+
+static inline void tamper_stab(const struct tamper_index *ix,
+                               const struct tamper_level *l, size_t lo, size_t hi,
+                               int64_t v, int64_t now_ns,
+                               const struct tamper_win **best)
+{
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (l->max_end[mid] < v)
+            return;
+        tamper_stab(ix, l, lo, mid, v, now_ns, best);
+
+        const struct tamper_win *w = &ix->win[l->by_wall[mid]];
+        if (w->shown_start > v)
+            return;                 /* everything to the right starts later */
+        if (v <= tamper_shown_end(w, now_ns) &&
+            (!*best || w->start_ns > (*best)->start_ns))
+            *best = w;
+        lo = mid + 1;
+    }
+}
+
+/*
+ * Latest window whose shown wall range contains v (seconds), or NULL.
+ * now_ns bounds windows that are still open.
+ */
+static inline const struct tamper_win *
+tamper_written_in(const struct tamper_index *ix, int64_t v, int64_t now_ns)
+{
+    const struct tamper_win *best = NULL;
+    for (int k = 0; k < TAMPER_LEVELS; k++)
+        if (ix->lv[k].n)
+            tamper_stab(ix, &ix->lv[k], 0, ix->lv[k].n, v, now_ns, &best);
+    return best;
+}
+
+static inline const char *tamper_state_str(const struct tamper_index *ix,
+                                           const struct tamper_win *w)
+{
+    if (!ix->clock_events)
+        return "UNKNOWN";
+    if (!w)
+        return "CURRENT";
+    return w->offset > 0 ? "FUTURE" : "PAST";
+}
+
+#endif /* TAMPER_INDEX_H */
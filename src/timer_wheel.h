@@ -0,0 +1,231 @@
+/*
+ * timer_wheel.h - hierarchical timing wheel of per-id deadlines.
+ *
+ * TW_LEVELS wheels of 64 slots each; level L spans 64^(L+1) ticks. A
+ * deadline goes into the lowest level whose span covers it, and a slot
+ * of level L is poured down ("cascaded") into the levels below when the
+ * level L-1 wheel wraps around to it. Arming, cancelling and expiring
+ * are O(1) whatever the number of pending deadlines; each deadline is
+ * cascaded at most TW_LEVELS-1 times.
+ *
+ * Timers are identified by a caller-chosen id (a table row), at most one
+ * pending deadline per id, linked through arrays indexed by id, so a
+ * timer costs no allocation once tw_reserve() covered its id.
+ *
+ * tw_next_ns() is a lower bound on the next expiry (the start of the
+ * next non-empty slot), which is what a timerfd gets armed with: waking
+ * early only cascades.
+ *
+ * Single-threaded: call from the watcher loop only.
+ */
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TW_BITS     6
+#define TW_SLOTS    (1u << TW_BITS)
+#define TW_MASK     (TW_SLOTS - 1)
+#define TW_LEVELS   4               /* 2^24 ticks: ~4.6 h at 1 ms */
+#define TW_NONE     UINT32_MAX
+#define TW_IDLE     UINT16_MAX      /* where[]: not armed */
+
+struct timer_wheel {
+    int64_t  tick_ns;
+    int64_t  base_ns;               /* time of tick 0 */
+    uint64_t cur;                   /* last tick processed */
+    uint32_t head[TW_LEVELS][TW_SLOTS];
+    uint32_t *next, *prev;          /* per id */
+    uint64_t *expires;              /* per id, in ticks */
+    uint16_t *where;                /* per id: level * TW_SLOTS + slot */
+    uint32_t cap;
+    uint32_t pending;
+};
+
+typedef void (*tw_expire_fn)(uint32_t id, void *ctx);
+
+static void tw_init(struct timer_wheel *w, int64_t tick_ns, int64_t now_ns)
+{
+    memset(w, 0, sizeof(*w));
+    w->tick_ns = tick_ns;
+    w->base_ns = now_ns;
+    memset(w->head, 0xff, sizeof(w->head));
+}
+
+static void tw_free(struct timer_wheel *w)
+{
+    free(w->next);
+    free(w->prev);
+    free(w->expires);
+    free(w->where);
+    memset(w, 0, sizeof(*w));
+}
+
+/* make ids [0, n) usable */
+static int tw_reserve(struct timer_wheel *w, uint32_t n)
+{
+    if (n <= w->cap)
+        return 0;
+    uint32_t cap = w->cap ? w->cap : 64;
+    while (cap < n)
+        cap *= 2;
+
+    uint32_t *nx = realloc(w->next, cap * sizeof(*nx));
+    if (nx)
+        w->next = nx;
+    uint32_t *pv = realloc(w->prev, cap * sizeof(*pv));
+    if (pv)
+        w->prev = pv;
+    uint64_t *ex = realloc(w->expires, cap * sizeof(*ex));
+    if (ex)
+        w->expires = ex;
+    uint16_t *wh = realloc(w->where, cap * sizeof(*wh));
+    if (wh)
+        w->where = wh;
+    if (!nx || !pv || !ex || !wh)
+        return -1;
+
+    for (uint32_t i = w->cap; i < cap; i++)
+        w->where[i] = TW_IDLE;
+    w->cap = cap;
+    return 0;
+}
+
+static int tw_armed(const struct timer_wheel *w, uint32_t id)
+{
+    return id < w->cap && w->where[id] != TW_IDLE;
+}
+
+/* link id by its expires[] relative to cur (expires >= cur) */
+static void tw_link(struct timer_wheel *w, uint32_t id)
+{
+    uint64_t e = w->expires[id];
+    uint64_t delta = e - w->cur;
+    int l = 0;
+
+    while (l < TW_LEVELS - 1 && delta >= (uint64_t)1 << (TW_BITS * (l + 1)))
+        l++;
+    if (delta >= (uint64_t)1 << (TW_BITS * TW_LEVELS)) {
+        e = w->cur + ((uint64_t)1 << (TW_BITS * TW_LEVELS)) - 1;
+        w->expires[id] = e;         /* clamp: fires early, never late */
+    }
+
+    uint32_t s = (e >> (TW_BITS * l)) & TW_MASK;
+    uint32_t *h = &w->head[l][s];
+    w->where[id] = (uint16_t)(l * TW_SLOTS + s);
+    w->prev[id] = TW_NONE;
+    w->next[id] = *h;
+    if (*h != TW_NONE)
+        w->prev[*h] = id;
+    *h = id;
+}
+
+static void tw_cancel(struct timer_wheel *w, uint32_t id)
+{
+    if (!tw_armed(w, id))
+        return;
+    uint16_t at = w->where[id];
+    uint32_t *h = &w->head[at / TW_SLOTS][at % TW_SLOTS];
+
+    if (w->prev[id] != TW_NONE)
+        w->next[w->prev[id]] = w->next[id];
+    else
+        *h = w->next[id];
+    if (w->next[id] != TW_NONE)
+        w->prev[w->next[id]] = w->prev[id];
+    w->where[id] = TW_IDLE;
+    w->pending--;
+}
+
+/*
+ * Arm id to expire at at_ns unless it already is: a pending deadline is
+ * kept, so later events fold into the first one's window.
+ * Returns 1 if armed now, 0 if already pending, -1 if id is not reserved.
+ */
+static int tw_arm(struct timer_wheel *w, uint32_t id, int64_t at_ns)
+{
+    if (id >= w->cap)
+        return -1;
+    if (w->where[id] != TW_IDLE)
+        return 0;
+
+    int64_t t = (at_ns - w->base_ns + w->tick_ns - 1) / w->tick_ns;
+    /* cur's slot was already expired: the earliest is the next tick */
+    w->expires[id] = t > (int64_t)w->cur ? (uint64_t)t : w->cur + 1;
+    tw_link(w, id);
+    w->pending++;
+    return 1;
+}
+
+/* move every deadline of head[l][s] down to where it now belongs */
+static void tw_cascade(struct timer_wheel *w, int l, uint32_t s)
+{
+    uint32_t id = w->head[l][s];
+    w->head[l][s] = TW_NONE;
+    while (id != TW_NONE) {
+        uint32_t nx = w->next[id];
+        tw_link(w, id);
+        id = nx;
+    }
+}
+
+/* expire every deadline up to now_ns, in tick order */
+static void tw_advance(struct timer_wheel *w, int64_t now_ns,
+                       tw_expire_fn fn, void *ctx)
+{
+    if (now_ns < w->base_ns)
+        return;
+    uint64_t target = (uint64_t)((now_ns - w->base_ns) / w->tick_ns);
+
+    while (w->cur < target) {
+        if (!w->pending) {
+            w->cur = target;        /* idle: nothing to walk through */
+            break;
+        }
+        w->cur++;
+
+        /* highest level first, so poured deadlines reach level 0 now */
+        int top = 0;
+        while (top < TW_LEVELS - 1 &&
+               (w->cur & (((uint64_t)1 << (TW_BITS * (top + 1))) - 1)) == 0)
+            top++;
+        for (int l = top; l >= 1; l--)
+            tw_cascade(w, l, (w->cur >> (TW_BITS * l)) & TW_MASK);
+
+        uint32_t s = w->cur & TW_MASK;
+        uint32_t id;
+        while ((id = w->head[0][s]) != TW_NONE) {
+            tw_cancel(w, id);       /* unlink first: fn may re-arm it */
+            fn(id, ctx);
+        }
+    }
+}
+
+/* lower bound of the next expiry, or -1 if nothing is pending */
+static int64_t tw_next_ns(const struct timer_wheel *w)
+{
+    if (!w->pending)
+        return -1;
+
+    uint64_t best = UINT64_MAX;
+    for (int l = 0; l < TW_LEVELS; l++) {
+        int sh = TW_BITS * l;
+        uint64_t c = w->cur >> sh;
+        /*
+         * level 0: the exact tick; above: when the slot is cascaded,
+         * which may come before a later level-0 deadline
+         */
+        for (uint32_t k = 1; k <= TW_SLOTS; k++) {
+            if (w->head[l][(c + k) & TW_MASK] == TW_NONE)
+                continue;
+            if (((c + k) << sh) < best)
+                best = (c + k) << sh;
+            break;
+        }
+    }
+    return w->base_ns + (int64_t)best * w->tick_ns;
+}
+
+#endif /* TIMER_WHEEL_H */
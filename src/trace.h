@@ -0,0 +1,285 @@
+/*
+ * trace.h - record/replay trace files.
+ *
+ * A trace is a header followed by variable-length records:
+ *
+ *   TRACE_CLOCK  raw `struct event` as delivered by the perf buffer
+ *   TRACE_FILE   one file change seen by a watcher (struct trace_file)
+ *   TRACE_ALERT  one classified event (struct as_alert), as streamed to
+ *                and stored by the collector
+ *
+ * Every record carries the CLOCK_BOOTTIME at which userspace received
+ * it, which is all the pipeline needs to run again later. The header
+ * keeps the trusted anchor the recorder started from, so a replay
+ * classifies against the same timeline.
+ *
+ * Writers batch records per thread and flush with one O_APPEND write,
+ * so records from different threads never interleave mid-record but
+ * can be out of order; the reader sorts by boot time (stable), which
+ * also merges several traces (detector + watchers) into one stream.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_MAGIC     "TSTRACE1"
+#define TRACE_VERSION   2
+/* from v2 on, struct event ktime_ns is CLOCK_BOOTTIME (was CLOCK_MONOTONIC) */
+#define TRACE_VERSION_BOOT_KTIME 2
+#define TRACE_BATCH     (16 * 1024)
+
+enum trace_source {
+    TRACE_SRC_CLOCK = 1,        /* settimeofday detector */
+    TRACE_SRC_FILE  = 2,        /* inotify watcher */
+};
+
+enum trace_type {
+    TRACE_CLOCK = 1,
+    TRACE_FILE  = 2,
+    TRACE_ALERT = 3,            /* classified event (alert_stream.h) */
+};
+
+struct trace_hdr {
+    char    magic[8];
+    uint32_t version;
+    uint32_t source;            /* enum trace_source */
+    int64_t anchor_wall;        /* trusted wall clock at anchor_boot_ns */
+    int64_t anchor_boot_ns;
+    int64_t epsilon;
+    uint32_t event_size;        /* sizeof(struct event) of the recorder;
+                                   replay also takes the sizes before the
+                                   cgroup id and the stack ids */
+    uint32_t _pad;
+};
+
+struct trace_rec {
+    uint16_t type;              /* enum trace_type */
+    uint16_t len;               /* whole record, multiple of 8 */
+    uint32_t _pad;
+    int64_t boot_ns;            /* received at (CLOCK_BOOTTIME) */
+    /* payload follows */
+};
+
+/* TRACE_FILE payload */
+#define TRACE_F_MTIME   0x1     /* mtime differs from the previous stat */
+#define TRACE_F_ATIME   0x2
+#define TRACE_F_CTIME   0x4
+
+struct trace_file {
+    uint64_t dev;
+    uint64_t ino;
+    uint32_t mask;              /* inotify mask */
+    uint32_t changed;           /* TRACE_F_* */
+    int64_t mtime_ns;
+    int64_t atime_ns;
+    int64_t ctime_ns;
+    char    path[];             /* NUL-terminated */
+};
+
+/* ===== writer ===== */
+static int trace_fd = -1;
+static __thread char trace_buf[TRACE_BATCH];
+static __thread size_t trace_len;
+
+static inline int trace_create(const char *path, uint32_t source, int64_t anchor_wall,
+                               int64_t anchor_boot_ns, int64_t epsilon,
+                               uint32_t event_size)
+{
+    struct trace_hdr h = {
+        .version = TRACE_VERSION,
+        .source = source,
+        .anchor_wall = anchor_wall,
+        .anchor_boot_ns = anchor_boot_ns,
+        .epsilon = epsilon,
+        .event_size = event_size,
+    };
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                    0644);
+    if (trace_fd < 0)
+        return -errno;
+    if (write(trace_fd, &h, sizeof(h)) != (ssize_t)sizeof(h)) {
+        close(trace_fd);
+        trace_fd = -1;
+        return -EIO;
+    }
+    return 0;
+}
+
+static inline void trace_flush(void)
+{
+    if (trace_fd < 0 || trace_len == 0)
+        return;
+    if (write(trace_fd, trace_buf, trace_len) < 0)
+        fprintf(stderr, "trace write error=%d\n", -errno);
+    trace_len = 0;
+}
+
+static inline void trace_append(uint16_t type, int64_t boot_ns,
+                                const void *a, size_t alen,
+                                const void *b, size_t blen)
+{
+    if (trace_fd < 0)
+        return;
+
+    size_t len = (sizeof(struct trace_rec) + alen + blen + 7) & ~(size_t)7;
+    if (len > TRACE_BATCH || len > UINT16_MAX)
+        return;
+    if (trace_len + len > TRACE_BATCH)
+        trace_flush();
+
+    struct trace_rec *r = (struct trace_rec *)(trace_buf + trace_len);
+    memset(r, 0, len);
+    r->type = type;
+    r->len = (uint16_t)len;
+    r->boot_ns = boot_ns;
+    memcpy(r + 1, a, alen);
+    if (blen)
+        memcpy((char *)(r + 1) + alen, b, blen);
+    trace_len += len;
+}
+
+static inline void trace_close(void)
+{
+    trace_flush();
+    if (trace_fd >= 0)
+        close(trace_fd);
+    trace_fd = -1;
+}
+
+/* ===== reader ===== */
+#define TRACE_MAX_FILES 1024    /* a collector host directory is many segments */
+
+struct trace_item {
+    int64_t boot_ns;
+    uint32_t file;              /* index into trace_set.hdr[] */
+    uint32_t seq;               /* tie-break: keeps file order stable */
+    const struct trace_rec *rec;
+};
+
+struct trace_set {
+    int n_files;
+    const struct trace_hdr *hdr[TRACE_MAX_FILES];
+    void *map[TRACE_MAX_FILES];
+    size_t map_len[TRACE_MAX_FILES];
+    struct trace_item *item;
+    size_t n_items;
+};
+
+static inline int trace_item_cmp(const void *pa, const void *pb)
+{
+    const struct trace_item *a = pa, *b = pb;
+    if (a->boot_ns != b->boot_ns)
+        return a->boot_ns < b->boot_ns ? -1 : 1;
+    if (a->file != b->file)
+        return a->file < b->file ? -1 : 1;
+    return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+static inline int trace_map_one(struct trace_set *ts, const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct trace_hdr)) {
+        close(fd);
+        return -EINVAL;
+    }
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -errno;
+
+    const struct trace_hdr *h = p;
+    if (memcmp(h->magic, TRACE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version < 1 || h->version > TRACE_VERSION) {
+        munmap(p, st.st_size);
+        return -EINVAL;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+    int f = ts->n_files++;
+    ts->hdr[f] = h;
+    ts->map[f] = p;
+    ts->map_len[f] = st.st_size;
+    return f;
+}
+
+static inline void trace_unload(struct trace_set *ts)
+{
+    for (int f = 0; f < ts->n_files; f++)
+        munmap(ts->map[f], ts->map_len[f]);
+    free(ts->item);
+    memset(ts, 0, sizeof(*ts));
+}
+
+/*
+ * Map every trace and build one stream sorted by receive time. A
+ * truncated tail (recorder killed mid-write) ends that file early.
+ */
+static inline int trace_load(struct trace_set *ts, char *const *paths, int n)
+{
+    size_t cap = 0;
+
+    memset(ts, 0, sizeof(*ts));
+    if (n > TRACE_MAX_FILES)
+        return -E2BIG;
+
+    for (int i = 0; i < n; i++) {
+        int f = trace_map_one(ts, paths[i]);
+        if (f < 0) {
+            fprintf(stderr, "trace %s: %s\n", paths[i], strerror(-f));
+            trace_unload(ts);
+            return f;
+        }
+
+        const char *base = ts->map[f];
+        size_t off = sizeof(struct trace_hdr), end = ts->map_len[f];
+        uint32_t seq = 0;
+
+        while (off + sizeof(struct trace_rec) <= end) {
+            const struct trace_rec *r = (const struct trace_rec *)(base + off);
+            if (r->len < sizeof(*r) || (r->len & 7) || off + r->len > end) {
+                fprintf(stderr, "trace %s: bad record at %zu, stopping\n",
+                        paths[i], off);
+                break;
+            }
+            if (ts->n_items == cap) {
+                cap = cap ? cap * 2 : 65536;
+                struct trace_item *it = realloc(ts->item, cap * sizeof(*it));
+                if (!it) {
+                    trace_unload(ts);
+                    return -ENOMEM;
+                }
+                ts->item = it;
+            }
+            ts->item[ts->n_items++] = (struct trace_item){
+                .boot_ns = r->boot_ns, .file = f, .seq = seq++, .rec = r,
+            };
+            off += r->len;
+        }
+    }
+
+    qsort(ts->item, ts->n_items, sizeof(*ts->item), trace_item_cmp);
+    return 0;
+}
+
+static inline const void *trace_payload(const struct trace_rec *r, size_t *len)
+{
+    *len = r->len - sizeof(*r);
+    return r + 1;
+}
+
+#endif /* TRACE_H */
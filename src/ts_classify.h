@@ -0,0 +1,270 @@
+/*
+ * ts_classify.h - batch timestamp classification.
+ *
+ * Same rule as check_file_time() in inotify.c, applied to whole arrays:
+ *
+ *   t > expected + epsilon  -> FUTURE
+ *   t < expected - epsilon  -> PAST
+ *   otherwise               -> NORMAL
+ *
+ * Input is structure-of-arrays (one vector per timestamp kind) and the
+ * expected wall time is taken once per batch by the caller, not once
+ * per timestamp. Output per file is one packed state byte
+ *
+ *   bits 1:0 mtime, 3:2 atime, 5:4 ctime   (enum tsc_state each)
+ *
+ * plus optional bitmasks, one bit per file in 64-bit words: `future`
+ * (any of the three is FUTURE) and `past` (any is PAST).
+ *
+ * scan_baseline classifies each directory's statx results with it,
+ * a getdents chunk at a time.
+ *
+ * x86-64 picks AVX2 or SSE4.2 at run time (target attributes, so no
+ * -m flags are needed); everything else uses the scalar loop.
+ */
+#ifndef TS_CLASSIFY_H
+#define TS_CLASSIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+  #include <immintrin.h>
+  #define TSC_X86 1
+#endif
+
+enum tsc_state {
+    TSC_NORMAL = 0,
+    TSC_PAST   = 1,
+    TSC_FUTURE = 2,
+};
+
+#define TSC_MTIME(s)     ((s) & 3)
+#define TSC_ATIME(s)     (((s) >> 2) & 3)
+#define TSC_CTIME(s)     (((s) >> 4) & 3)
+#define TSC_ANY_FUTURE   0x2a
+#define TSC_ANY_PAST     0x15
+
+struct tsc_batch {
+    const int64_t *mtime;       /* seconds, n entries each */
+    const int64_t *atime;
+    const int64_t *ctime;
+    size_t n;
+};
+
+struct tsc_out {
+    uint8_t  *state;            /* n bytes */
+    uint64_t *future;           /* (n + 63) / 64 words, or NULL */
+    uint64_t *past;             /* (n + 63) / 64 words, or NULL */
+};
+
+enum tsc_impl {
+    TSC_IMPL_AUTO,
+    TSC_IMPL_SCALAR,
+    TSC_IMPL_SSE42,
+    TSC_IMPL_AVX2,
+};
+
+static const char *const tsc_impl_names[] = {
+    "auto", "scalar", "sse4.2", "avx2",
+};
+
+static inline uint8_t tsc_code(int64_t t, int64_t lo, int64_t hi)
+{
+    return (uint8_t)((t > hi) << 1 | (t < lo));
+}
+
+static inline uint8_t tsc_one(const struct tsc_batch *b, size_t i,
+                              int64_t lo, int64_t hi)
+{
+    return tsc_code(b->mtime[i], lo, hi) |
+           tsc_code(b->atime[i], lo, hi) << 2 |
+           tsc_code(b->ctime[i], lo, hi) << 4;
+}
+
+/* files [i, end) of the block starting at base, one at a time */
+static inline void tsc_tail(const struct tsc_batch *b, size_t base, size_t i,
+                            size_t end, int64_t lo, int64_t hi,
+                            uint8_t *state, uint64_t *fm, uint64_t *pm)
+{
+    for (; i < end; i++) {
+        uint8_t s = tsc_one(b, i, lo, hi);
+        state[i] = s;
+        *fm |= (uint64_t)((s & TSC_ANY_FUTURE) != 0) << (i - base);
+        *pm |= (uint64_t)((s & TSC_ANY_PAST) != 0) << (i - base);
+    }
+}
+
+static inline void tsc_store_masks(const struct tsc_out *o, size_t base,
+                                   uint64_t fm, uint64_t pm)
+{
+    if (o->future)
+        o->future[base / 64] = fm;
+    if (o->past)
+        o->past[base / 64] = pm;
+}
+
+static inline void tsc_kernel_scalar(const struct tsc_batch *b, int64_t lo,
+                                     int64_t hi, const struct tsc_out *o)
+{
+    for (size_t base = 0; base < b->n; base += 64) {
+        size_t end = base + 64 < b->n ? base + 64 : b->n;
+        uint64_t fm = 0, pm = 0;
+        tsc_tail(b, base, base, end, lo, hi, o->state, &fm, &pm);
+        tsc_store_masks(o, base, fm, pm);
+    }
+}
+
+#ifdef TSC_X86
+/*
+ * Per timestamp kind: fut = t > hi, past = lo > t (all-ones lanes).
+ * The 2-bit codes are merged into the low byte of each 64-bit lane,
+ * then one byte per lane is gathered with a shuffle.
+ */
+__attribute__((target("sse4.2")))
+static inline void tsc_kernel_sse42(const struct tsc_batch *b, int64_t lo,
+                                    int64_t hi, const struct tsc_out *o)
+{
+    const __m128i vlo = _mm_set1_epi64x(lo), vhi = _mm_set1_epi64x(hi);
+    const __m128i b0 = _mm_set1_epi64x(1), b1 = _mm_set1_epi64x(2);
+
+    for (size_t base = 0; base < b->n; base += 64) {
+        size_t end = base + 64 < b->n ? base + 64 : b->n;
+        uint64_t fm = 0, pm = 0;
+        size_t i = base;
+
+        for (; i + 2 <= end; i += 2) {
+            __m128i m = _mm_loadu_si128((const __m128i *)(b->mtime + i));
+            __m128i a = _mm_loadu_si128((const __m128i *)(b->atime + i));
+            __m128i c = _mm_loadu_si128((const __m128i *)(b->ctime + i));
+
+            __m128i fm_ = _mm_cmpgt_epi64(m, vhi), pm_ = _mm_cmpgt_epi64(vlo, m);
+            __m128i fa_ = _mm_cmpgt_epi64(a, vhi), pa_ = _mm_cmpgt_epi64(vlo, a);
+            __m128i fc_ = _mm_cmpgt_epi64(c, vhi), pc_ = _mm_cmpgt_epi64(vlo, c);
+
+            __m128i code =
+                _mm_or_si128(
+                    _mm_or_si128(_mm_and_si128(fm_, b1), _mm_and_si128(pm_, b0)),
+                    _mm_or_si128(
+                        _mm_slli_epi64(_mm_or_si128(_mm_and_si128(fa_, b1),
+                                                    _mm_and_si128(pa_, b0)), 2),
+                        _mm_slli_epi64(_mm_or_si128(_mm_and_si128(fc_, b1),
+                                                    _mm_and_si128(pc_, b0)), 4)));
+            o->state[i]     = (uint8_t)_mm_extract_epi8(code, 0);
+            o->state[i + 1] = (uint8_t)_mm_extract_epi8(code, 8);
+
+            __m128i fany = _mm_or_si128(_mm_or_si128(fm_, fa_), fc_);
+            __m128i pany = _mm_or_si128(_mm_or_si128(pm_, pa_), pc_);
+            fm |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(fany)) << (i - base);
+            pm |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(pany)) << (i - base);
+        }
+        tsc_tail(b, base, i, end, lo, hi, o->state, &fm, &pm);
+        tsc_store_masks(o, base, fm, pm);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void tsc_kernel_avx2(const struct tsc_batch *b, int64_t lo,
+                                   int64_t hi, const struct tsc_out *o)
+{
+    const __m256i vlo = _mm256_set1_epi64x(lo), vhi = _mm256_set1_epi64x(hi);
+    const __m256i b0 = _mm256_set1_epi64x(1), b1 = _mm256_set1_epi64x(2);
+    /* byte 0 of each lane -> bytes 0,1 of each 128-bit half */
+    const __m256i gather = _mm256_setr_epi8(
+        0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    for (size_t base = 0; base < b->n; base += 64) {
+        size_t end = base + 64 < b->n ? base + 64 : b->n;
+        uint64_t fm = 0, pm = 0;
+        size_t i = base;
+
+        for (; i + 4 <= end; i += 4) {
+            __m256i m = _mm256_loadu_si256((const __m256i *)(b->mtime + i));
+            __m256i a = _mm256_loadu_si256((const __m256i *)(b->atime + i));
+            __m256i c = _mm256_loadu_si256((const __m256i *)(b->ctime + i));
+
+            __m256i fm_ = _mm256_cmpgt_epi64(m, vhi), pm_ = _mm256_cmpgt_epi64(vlo, m);
+            __m256i fa_ = _mm256_cmpgt_epi64(a, vhi), pa_ = _mm256_cmpgt_epi64(vlo, a);
+            __m256i fc_ = _mm256_cmpgt_epi64(c, vhi), pc_ = _mm256_cmpgt_epi64(vlo, c);
+
+            __m256i code =
+                _mm256_or_si256(
+                    _mm256_or_si256(_mm256_and_si256(fm_, b1), _mm256_and_si256(pm_, b0)),
+                    _mm256_or_si256(
+                        _mm256_slli_epi64(_mm256_or_si256(_mm256_and_si256(fa_, b1),
+                                                          _mm256_and_si256(pa_, b0)), 2),
+                        _mm256_slli_epi64(_mm256_or_si256(_mm256_and_si256(fc_, b1),
+                                                          _mm256_and_si256(pc_, b0)), 4)));
+            code = _mm256_shuffle_epi8(code, gather);
+            uint32_t packed =
+                ((uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(code)) & 0xffff) |
+                ((uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(code, 1)) << 16);
+            memcpy(o->state + i, &packed, 4);
+
+            __m256i fany = _mm256_or_si256(_mm256_or_si256(fm_, fa_), fc_);
+            __m256i pany = _mm256_or_si256(_mm256_or_si256(pm_, pa_), pc_);
+            fm |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(fany)) << (i - base);
+            pm |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(pany)) << (i - base);
+        }
+        tsc_tail(b, base, i, end, lo, hi, o->state, &fm, &pm);
+        tsc_store_masks(o, base, fm, pm);
+    }
+}
+#endif /* TSC_X86 */
+
+typedef void (*tsc_kernel_fn)(const struct tsc_batch *b, int64_t lo,
+                              int64_t hi, const struct tsc_out *o);
+
+/* best available implementation; an unsupported request falls back */
+static inline enum tsc_impl tsc_resolve(enum tsc_impl want)
+{
+#ifdef TSC_X86
+    __builtin_cpu_init();
+    int avx2 = __builtin_cpu_supports("avx2");
+    int sse42 = __builtin_cpu_supports("sse4.2");
+
+    if (want == TSC_IMPL_AUTO)
+        return avx2 ? TSC_IMPL_AVX2 : sse42 ? TSC_IMPL_SSE42 : TSC_IMPL_SCALAR;
+    if (want == TSC_IMPL_AVX2 && !avx2)
+        want = TSC_IMPL_SSE42;
+    if (want == TSC_IMPL_SSE42 && !sse42)
+        want = TSC_IMPL_SCALAR;
+    return want;
+#else
+    (void)want;
+    return TSC_IMPL_SCALAR;
+#endif
+}
+
+static inline tsc_kernel_fn tsc_kernel(enum tsc_impl impl)
+{
+    switch (tsc_resolve(impl)) {
+#ifdef TSC_X86
+    case TSC_IMPL_AVX2:  return tsc_kernel_avx2;
+    case TSC_IMPL_SSE42: return tsc_kernel_sse42;
+#endif
+    default:             return tsc_kernel_scalar;
+    }
+}
+
+static inline void tsc_classify_with(enum tsc_impl impl,
+                                     const struct tsc_batch *b,
+                                     int64_t expected, long epsilon,
+                                     const struct tsc_out *o)
+{
+    tsc_kernel(impl)(b, expected - epsilon, expected + epsilon, o);
+}
+
+static inline void tsc_classify(const struct tsc_batch *b, int64_t expected,
+                                long epsilon, const struct tsc_out *o)
+{
+    static tsc_kernel_fn k;
+
+    if (!k)
+        k = tsc_kernel(TSC_IMPL_AUTO);
+    k(b, expected - epsilon, expected + epsilon, o);
+}
+
+#endif /* TS_CLASSIFY_H */
@@ -0,0 +1,233 @@
+/*
+ * ts_config.h - detector config file, re-read while running.
+ *
+ *   # comment
+ *   epsilon   = 60
+ *   alert_log = /data/local/tmp/alerts.log
+ *   watch     = /data/local/tmp/test.txt     (repeatable)
+ *
+ * Keys a tool does not use are ignored; keys that are absent leave the
+ * command line value alone. A file that fails to parse is rejected as a
+ * whole, so a half-written edit never replaces a working config.
+ *
+ * Reloads are triggered by SIGHUP or by an inotify watch on the config's
+ * directory (editors usually write a temp file and rename it over, which
+ * a watch on the file itself would lose).
+ */
+#ifndef TS_CONFIG_H
+#define TS_CONFIG_H
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#define CFG_MAX_WATCH 65536
+
+struct ts_config {
+    long   epsilon;             /* -1: not set */
+    char   alert_log[PATH_MAX]; /* "": not set */
+    char **watch;               /* sorted, unique */
+    size_t n_watch;
+};
+
+static inline void cfg_free(struct ts_config *c)
+{
+    for (size_t i = 0; i < c->n_watch; i++)
+        free(c->watch[i]);
+    free(c->watch);
+    c->watch = NULL;
+    c->n_watch = 0;
+}
+
+static inline int cfg_strcmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static inline int cfg_watch_push(struct ts_config *c, const char *path)
+{
+    if (c->n_watch == CFG_MAX_WATCH)
+        return -E2BIG;
+    /* capacity: next power of two, at least 16 */
+    if (c->n_watch >= 16 && (c->n_watch & (c->n_watch - 1)) == 0) {
+        char **w = realloc(c->watch, c->n_watch * 2 * sizeof(*w));
+        if (!w)
+            return -ENOMEM;
+        c->watch = w;
+    } else if (!c->watch) {
+        if (!(c->watch = malloc(16 * sizeof(*c->watch))))
+            return -ENOMEM;
+    }
+    if (!(c->watch[c->n_watch] = strdup(path)))
+        return -ENOMEM;
+    c->n_watch++;
+    return 0;
+}
+
+/* sorted + unique: reloads diff two lists in one merge pass */
+static inline void cfg_watch_sort(struct ts_config *c)
+{
+    size_t n = 0;
+
+    if (c->n_watch)
+        qsort(c->watch, c->n_watch, sizeof(*c->watch), cfg_strcmp);
+    for (size_t i = 0; i < c->n_watch; i++) {
+        if (n && strcmp(c->watch[n - 1], c->watch[i]) == 0)
+            free(c->watch[i]);
+        else
+            c->watch[n++] = c->watch[i];
+    }
+    c->n_watch = n;
+}
+
+static inline char *cfg_trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1]))
+        *--e = '\0';
+    return s;
+}
+
+/* parse `path` into *out (replaced only on success) */
+static inline int cfg_load(const char *path, struct ts_config *out)
+{
+    struct ts_config c = { .epsilon = -1 };
+    char line[PATH_MAX + 64];
+    int lineno = 0, err = 0;
+
+    FILE *fp = fopen(path, "re");
+    if (!fp)
+        return -errno;
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        char *s = cfg_trim(line);
+        if (*s == '\0')
+            continue;
+
+        char *eq = strchr(s, '=');
+        if (!eq) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, lineno);
+            err = -EINVAL;
+            break;
+        }
+        *eq = '\0';
+        char *key = cfg_trim(s), *val = cfg_trim(eq + 1);
+
+        if (strcmp(key, "epsilon") == 0) {
+            char *end;
+            c.epsilon = strtol(val, &end, 10);
+            if (*val == '\0' || *end != '\0' || c.epsilon < 0) {
+                fprintf(stderr, "%s:%d: bad epsilon '%s'\n", path, lineno, val);
+                err = -EINVAL;
+                break;
+            }
+        } else if (strcmp(key, "alert_log") == 0) {
+            snprintf(c.alert_log, sizeof(c.alert_log), "%s", val);
+        } else if (strcmp(key, "watch") == 0) {
+            err = cfg_watch_push(&c, val);
+            if (err) {
+                fprintf(stderr, "%s:%d: watch %s: %s\n",
+                        path, lineno, val, strerror(-err));
+                break;
+            }
+        }
+        /* unknown keys: another tool's */
+    }
+    fclose(fp);
+
+    if (err) {
+        cfg_free(&c);
+        return err;
+    }
+
+    cfg_watch_sort(&c);
+    cfg_free(out);
+    *out = c;
+    return 0;
+}
+
+/* call added()/removed() for every watch that differs between old and new */
+static inline void cfg_watch_diff(const struct ts_config *old,
+                                  const struct ts_config *new,
+                                  void (*added)(const char *path, void *ctx),
+                                  void (*removed)(const char *path, void *ctx),
+                                  void *ctx)
+{
+    size_t i = 0, j = 0;
+
+    while (i < old->n_watch || j < new->n_watch) {
+        int d = i == old->n_watch ? 1 :
+                j == new->n_watch ? -1 :
+                strcmp(old->watch[i], new->watch[j]);
+        if (d < 0) {
+            removed(old->watch[i++], ctx);
+        } else if (d > 0) {
+            added(new->watch[j++], ctx);
+        } else {
+            i++;
+            j++;
+        }
+    }
+}
+
+/*
+ * Watch the directory holding the config on an existing inotify fd.
+ * *name receives the basename to compare event names against.
+ */
+static inline int cfg_watch_add(int ifd, const char *path, const char **name)
+{
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+        *name = path;
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s",
+                 slash == path ? 1 : (int)(slash - path), path);
+        *name = slash + 1;
+    }
+
+    /* MASK_ADD: the same directory may also be watched for targets */
+    int wd = inotify_add_watch(ifd, dir,
+                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_MASK_ADD);
+    return wd < 0 ? -errno : wd;
+}
+
+static inline int cfg_event_hit(const struct inotify_event *e, int wd,
+                                const char *name)
+{
+    return e->wd == wd && e->len > 0 && strcmp(e->name, name) == 0;
+}
+
+/*
+ * Point *fd at a new log file without closing it in between: writers on
+ * other threads land in the old or the new file, never in a closed fd.
+ */
+static inline int cfg_reopen_log(int *fd, const char *path)
+{
+    int nfd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (nfd < 0)
+        return -errno;
+    if (*fd < 0) {
+        *fd = nfd;
+        return 0;
+    }
+    int err = dup2(nfd, *fd) < 0 ? -errno : 0;
+    close(nfd);
+    return err;
+}
+
+#endif /* TS_CONFIG_H */
@@ -0,0 +1,362 @@
+/*
+ * ts_index.h - persistent, mmap'd timestamp index for scan_baseline.
+ *
+ *   <base>.idx    header + open-addressing table keyed by (dev, ino)
+ *   <base>.paths  append-only NUL-terminated path strings
+ *
+ * Both files are MAP_SHARED, so the table is "loaded" by mapping it and
+ * a checkpoint is just msync(). Workers look up and claim slots without
+ * locks (a CAS on the key word); the table and path area are sized at
+ * open time and never grow during a pass. When full, inserts fail and
+ * are counted; the next open grows and rehashes.
+ */
+#ifndef TS_INDEX_H
+#define TS_INDEX_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TSIDX_MAGIC      0x3158444953545354ULL   /* "TSTSIDX1" */
+#define TSIDX_VERSION    2
+#define TSIDX_MIN_CAP    (1ULL << 16)
+#define TSIDX_MIN_PATHS  (16ULL << 20)
+#define TSIDX_NO_PATH    UINT64_MAX
+
+#define TSIDX_F_DIR      0x1
+#define TSIDX_F_GONE     0x2     /* directory vanished: tombstone */
+#define TSIDX_F_QUEUED   0x4     /* on the current pass's revisit list */
+
+struct tsidx_hdr {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t capacity;          /* slots, power of two */
+    uint64_t count;             /* claimed slots */
+    uint64_t dropped;           /* inserts refused this pass (table full) */
+    uint32_t gen;               /* bumped at every pass */
+    uint32_t full_gen;          /* gen of the last full (non-incremental) pass */
+    int64_t  checkpoint_wall;   /* trusted wall time of the last checkpoint */
+    uint64_t path_used;
+    uint64_t path_cap;
+};
+
+struct tsidx_entry {
+    uint64_t key;               /* 0 = empty; written first (CAS) */
+    uint64_t dev;
+    uint64_t ino;
+    int64_t  mtime_ns;
+    int64_t  atime_ns;
+    int64_t  ctime_ns;
+    int64_t  btime_ns;          /* 0 when the fs has no btime */
+    uint64_t size;
+    uint64_t path_off;          /* into <base>.paths or TSIDX_NO_PATH */
+    uint32_t gen;               /* last pass that saw this entry */
+    uint32_t flags;
+    uint32_t anomaly;           /* rollbacks seen so far, re-reported */
+    uint32_t _pad;
+};
+
+struct tsidx {
+    int fd;
+    int pfd;
+    struct tsidx_hdr *hdr;
+    struct tsidx_entry *ent;
+    size_t map_len;
+    char *paths;
+};
+
+static uint64_t tsidx_key(uint64_t dev, uint64_t ino)
+{
+    uint64_t h = ino * 0x9e3779b97f4a7c15ULL ^ dev * 0xc2b2ae3d27d4eb4fULL;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 29;
+    return h | 1;               /* never 0 */
+}
+
+static struct tsidx_entry *tsidx_lookup(struct tsidx *x, uint64_t dev,
+                                        uint64_t ino)
+{
+    uint64_t key = tsidx_key(dev, ino);
+    uint64_t mask = x->hdr->capacity - 1;
+
+    for (uint64_t i = key & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        struct tsidx_entry *e = &x->ent[i];
+        uint64_t k = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+        if (k == 0)
+            return NULL;
+        if (k == key && e->dev == dev && e->ino == ino)
+            return e;
+    }
+    return NULL;
+}
+
+/* claim a slot for (dev, ino); NULL when the load limit is reached */
+static struct tsidx_entry *tsidx_insert(struct tsidx *x, uint64_t dev,
+                                        uint64_t ino)
+{
+    uint64_t key = tsidx_key(dev, ino);
+    uint64_t mask = x->hdr->capacity - 1;
+
+    if (__atomic_load_n(&x->hdr->count, __ATOMIC_RELAXED) >
+        x->hdr->capacity / 10 * 8) {
+        __atomic_add_fetch(&x->hdr->dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    for (uint64_t i = key & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        struct tsidx_entry *e = &x->ent[i];
+        uint64_t zero = 0;
+        if (__atomic_compare_exchange_n(&e->key, &zero, key, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            e->dev = dev;
+            e->ino = ino;
+            e->path_off = TSIDX_NO_PATH;
+            __atomic_add_fetch(&x->hdr->count, 1, __ATOMIC_RELAXED);
+            return e;
+        }
+        if (zero == key && e->dev == dev && e->ino == ino)
+            return e;
+    }
+    return NULL;
+}
+
+static uint64_t tsidx_add_path(struct tsidx *x, const char *path)
+{
+    size_t len = strlen(path) + 1;
+    uint64_t off = __atomic_fetch_add(&x->hdr->path_used, len,
+                                      __ATOMIC_RELAXED);
+    if (off + len > x->hdr->path_cap)
+        return TSIDX_NO_PATH;
+    memcpy(x->paths + off, path, len);
+    return off;
+}
+
+static const char *tsidx_path(const struct tsidx *x, uint64_t off)
+{
+    if (off == TSIDX_NO_PATH || off >= x->hdr->path_cap)
+        return NULL;
+    return x->paths + off;
+}
+
+static void tsidx_close(struct tsidx *x);
+
+static int tsidx_map(struct tsidx *x, int fd, uint64_t capacity, int init)
+{
+    size_t len = sizeof(struct tsidx_hdr) + capacity * sizeof(struct tsidx_entry);
+
+    if (init && ftruncate(fd, len) != 0)
+        return -errno;
+
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        return -errno;
+
+    x->fd = fd;
+    x->map_len = len;
+    x->hdr = p;
+    x->ent = (struct tsidx_entry *)(x->hdr + 1);
+
+    if (init) {
+        memset(x->hdr, 0, sizeof(*x->hdr));
+        x->hdr->magic = TSIDX_MAGIC;
+        x->hdr->version = TSIDX_VERSION;
+        x->hdr->entry_size = sizeof(struct tsidx_entry);
+        x->hdr->capacity = capacity;
+    }
+    return 0;
+}
+
+static int tsidx_map_paths(struct tsidx *x, const char *base, uint64_t cap)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.paths", base);
+
+    x->pfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (x->pfd < 0)
+        return -errno;
+    if (ftruncate(x->pfd, cap) != 0)
+        return -errno;
+    x->paths = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_SHARED, x->pfd, 0);
+    if (x->paths == MAP_FAILED)
+        return -errno;
+    x->hdr->path_cap = cap;
+    return 0;
+}
+
+/*
+ * Rehash `old` into a fresh table of `capacity` slots, dropping
+ * tombstones and file entries a later full pass no longer saw. Paths
+ * are compacted into a new path file the same way.
+ */
+static int tsidx_rebuild(struct tsidx *x, const char *base, uint64_t capacity,
+                         uint64_t path_cap)
+{
+    char tmp[4096], dst[4096], pbase[4096], ptmp[4096], pdst[4096];
+    struct tsidx old = *x;
+    struct tsidx nx = { .fd = -1, .pfd = -1 };
+    int fd, err;
+
+    snprintf(dst, sizeof(dst), "%s.idx", base);
+    snprintf(tmp, sizeof(tmp), "%s.idx.tmp", base);
+    snprintf(pdst, sizeof(pdst), "%s.paths", base);
+    snprintf(pbase, sizeof(pbase), "%s.tmp", base);
+    snprintf(ptmp, sizeof(ptmp), "%s.tmp.paths", base);
+
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return -errno;
+    err = tsidx_map(&nx, fd, capacity, 1);
+    if (err)
+        goto fail;
+    nx.hdr->gen = old.hdr->gen;
+    nx.hdr->full_gen = old.hdr->full_gen;
+    nx.hdr->checkpoint_wall = old.hdr->checkpoint_wall;
+
+    unlink(ptmp);
+    err = tsidx_map_paths(&nx, pbase, path_cap);
+    if (err)
+        goto fail;
+
+    for (uint64_t i = 0; i < old.hdr->capacity; i++) {
+        struct tsidx_entry *o = &old.ent[i];
+        if (o->key == 0 || (o->flags & TSIDX_F_GONE))
+            continue;
+        if (o->gen < old.hdr->full_gen)
+            continue;
+        struct tsidx_entry *n = tsidx_insert(&nx, o->dev, o->ino);
+        if (!n)
+            break;
+        uint64_t key = n->key;
+        *n = *o;
+        n->key = key;
+        n->path_off = TSIDX_NO_PATH;
+        const char *p = tsidx_path(&old, o->path_off);
+        if (p)
+            n->path_off = tsidx_add_path(&nx, p);
+    }
+
+    if (rename(tmp, dst) != 0 || rename(ptmp, pdst) != 0) {
+        err = -errno;
+        goto fail;
+    }
+
+    tsidx_close(&old);
+    *x = nx;
+    return 0;
+
+fail:
+    if (nx.paths && nx.paths != MAP_FAILED)
+        munmap(nx.paths, path_cap);
+    if (nx.pfd >= 0)
+        close(nx.pfd);
+    if (nx.hdr)
+        munmap(nx.hdr, nx.map_len);
+    close(fd);
+    unlink(tmp);
+    unlink(ptmp);
+    return err;
+}
+
+/*
+ * Open (or create) <base>.idx / <base>.paths with room for at least
+ * `expect` entries. An index with the wrong magic or layout is rebuilt
+ * from scratch.
+ */
+static int tsidx_open(struct tsidx *x, const char *base, uint64_t expect)
+{
+    char path[4096];
+    struct stat st;
+    int fd, err;
+
+    memset(x, 0, sizeof(*x));
+    x->fd = x->pfd = -1;
+
+    snprintf(path, sizeof(path), "%s.idx", base);
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return -errno;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -errno;
+    }
+
+    uint64_t want = TSIDX_MIN_CAP;
+    while (want < expect * 2)
+        want <<= 1;
+
+    if ((size_t)st.st_size < sizeof(struct tsidx_hdr)) {
+        err = tsidx_map(x, fd, want, 1);
+        if (!err)
+            err = tsidx_map_paths(x, base, TSIDX_MIN_PATHS);
+        return err;
+    }
+
+    struct tsidx_hdr h;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+        h.magic != TSIDX_MAGIC || h.version != TSIDX_VERSION ||
+        h.entry_size != sizeof(struct tsidx_entry) ||
+        (size_t)st.st_size < sizeof(h) + h.capacity * sizeof(struct tsidx_entry)) {
+        fprintf(stderr, "[Index] %s: unusable, starting over\n", path);
+        err = tsidx_map(x, fd, want, 1);
+        if (!err)
+            err = tsidx_map_paths(x, base, TSIDX_MIN_PATHS);
+        return err;
+    }
+
+    err = tsidx_map(x, fd, h.capacity, 0);
+    if (!err)
+        err = tsidx_map_paths(x, base, h.path_cap ? h.path_cap : TSIDX_MIN_PATHS);
+    if (err)
+        return err;
+
+    /* grow between passes, never during one */
+    uint64_t need = x->hdr->count > expect ? x->hdr->count : expect;
+    uint64_t pcap = x->hdr->path_cap;
+    while (pcap < x->hdr->path_used * 2)
+        pcap <<= 1;
+    if (x->hdr->capacity < need * 2 || x->hdr->dropped ||
+        pcap != x->hdr->path_cap) {
+        while (want < need * 2)
+            want <<= 1;
+        if (want < x->hdr->capacity)
+            want = x->hdr->capacity;
+        if (x->hdr->dropped)
+            want <<= 1;
+        err = tsidx_rebuild(x, base, want, pcap);
+        if (err)
+            return err;
+    }
+    x->hdr->dropped = 0;
+    return 0;
+}
+
+static void tsidx_checkpoint(struct tsidx *x, int64_t trusted_wall)
+{
+    x->hdr->checkpoint_wall = trusted_wall;
+    msync(x->paths, x->hdr->path_cap, MS_SYNC);
+    msync(x->hdr, x->map_len, MS_SYNC);
+}
+
+static void tsidx_close(struct tsidx *x)
+{
+    if (x->paths && x->hdr)
+        munmap(x->paths, x->hdr->path_cap);
+    if (x->hdr)
+        munmap(x->hdr, x->map_len);
+    if (x->fd >= 0)
+        close(x->fd);
+    if (x->pfd >= 0)
+        close(x->pfd);
+    memset(x, 0, sizeof(*x));
+    x->fd = x->pfd = -1;
+}
+
+#endif /* TS_INDEX_H */
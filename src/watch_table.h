@@ -0,0 +1,684 @@
+/*
+ * watch_table.h - many watched files on one inotify fd.
+ *
+ * Each target is one fixed-size row (paths live on the heap) plus:
+ *
+ *   by_wd     wd -> target (file watch) or directory (parent watch)
+ *   by_name   (directory, basename) -> target
+ *   dir_by_path
+ *             parent directories, shared by every target inside them
+ *   by_spec   configured name -> target, for reloads
+ *
+ * all open-addressed hash tables of row indices, so any event resolves
+ * to its target in O(1) whatever the number of targets. Parent watches
+ * are what keep a target alive across replacement: IN_CREATE /
+ * IN_MOVED_TO of its name re-attach it, IN_DELETE / IN_MOVED_FROM drop
+ * the file watch (after a rename it would follow the inode elsewhere).
+ *
+ * inotify has one wd per inode and fd, so targets that are hard links of
+ * one file share it: by_wd holds the first, the others hang off its
+ * `alias` chain and get its events too.
+ *
+ * IN_Q_OVERFLOW recovery (wt_rescan_*) is shared by both watchers.
+ *
+ * Single-threaded: call from the watcher loop only.
+ */
+#ifndef WATCH_TABLE_H
+#define WATCH_TABLE_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define WT_FILE_MASK (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE | \
+                      IN_DELETE_SELF | IN_MOVE_SELF)
+/* MASK_ADD: a directory watch may be shared with other users of the fd */
+#define WT_DIR_MASK  (IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | \
+                      IN_MASK_ADD)
+
+#define WT_NONE      UINT32_MAX
+#define WT_DIR_BIT   0x80000000u    /* by_wd value is a directory */
+
+struct wt_target {
+    char    *spec;              /* as configured; NULL: free row */
+    char    *path;              /* realpath */
+    uint32_t name_off;          /* basename = path + name_off */
+    uint32_t dir;
+    int      wd;                /* file watch, -1 while missing */
+    uint32_t alias;             /* next target sharing wd, or WT_NONE */
+    uint32_t fresh_gen;         /* for the overflow rescan */
+    int64_t  last_event_ns;
+    uint64_t dev, ino;
+    int64_t  mtime, atime;      /* last seen (sec) */
+};
+
+struct wt_dir {
+    char    *path;              /* NULL: free row */
+    int      wd;
+    uint32_t refs;
+};
+
+/* open addressing, linear probing, backward-shift delete; 0 = empty */
+struct wt_itab {
+    uint32_t *slot;             /* row index + 1 */
+    uint32_t mask;
+    uint32_t n;
+};
+
+struct watch_table {
+    int ifd;
+    int keep_wd;                /* never removed (e.g. the config's dir) */
+    struct wt_target *t;
+    uint32_t n_t, cap_t, live;
+    uint32_t *free_t;
+    uint32_t n_free;
+    struct wt_dir *d;
+    uint32_t n_d, cap_d;
+    struct wt_itab by_wd, by_name, dir_by_path, by_spec;
+};
+
+/* ===== hashing ===== */
+static inline uint32_t wt_hash_str(uint32_t h, const char *s)
+{
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h ^ (h >> 16);
+}
+
+static inline uint32_t wt_hash_int(uint32_t x)
+{
+    x *= 0x9e3779b1u;
+    return x ^ (x >> 16);
+}
+
+static inline uint32_t wt_hash_name(uint32_t dir, const char *name)
+{
+    return wt_hash_str(2166136261u ^ wt_hash_int(dir), name);
+}
+
+static inline const char *wt_name(const struct watch_table *w, uint32_t i)
+{
+    return w->t[i].path + w->t[i].name_off;
+}
+
+enum wt_tab { WT_TAB_WD, WT_TAB_NAME, WT_TAB_DIR, WT_TAB_SPEC };
+
+/* hash of the row a slot points at, per table */
+static inline uint32_t wt_row_hash(const struct watch_table *w, enum wt_tab tab,
+                                   uint32_t v)
+{
+    switch (tab) {
+    case WT_TAB_WD:
+        return wt_hash_int((uint32_t)((v & WT_DIR_BIT) ?
+                                      w->d[v & ~WT_DIR_BIT].wd : w->t[v].wd));
+    case WT_TAB_NAME:
+        return wt_hash_name(w->t[v].dir, wt_name(w, v));
+    case WT_TAB_DIR:
+        return wt_hash_str(2166136261u, w->d[v].path);
+    default:
+        return wt_hash_str(2166136261u, w->t[v].spec);
+    }
+}
+
+static inline struct wt_itab *wt_tab(struct watch_table *w, enum wt_tab tab)
+{
+    switch (tab) {
+    case WT_TAB_WD:   return &w->by_wd;
+    case WT_TAB_NAME: return &w->by_name;
+    case WT_TAB_DIR:  return &w->dir_by_path;
+    default:          return &w->by_spec;
+    }
+}
+
+static int wt_itab_put(struct watch_table *w, enum wt_tab tab, uint32_t v);
+
+static inline int wt_itab_grow(struct watch_table *w, enum wt_tab tab)
+{
+    struct wt_itab *it = wt_tab(w, tab), old = *it;
+    uint32_t cap = old.slot ? (old.mask + 1) * 2 : 64;
+
+    it->slot = calloc(cap, sizeof(*it->slot));
+    if (!it->slot) {
+        *it = old;
+        return -ENOMEM;
+    }
+    it->mask = cap - 1;
+    it->n = 0;
+    for (uint32_t i = 0; old.slot && i <= old.mask; i++)
+        if (old.slot[i])
+            wt_itab_put(w, tab, old.slot[i] - 1);
+    free(old.slot);
+    return 0;
+}
+
+static inline int wt_itab_put(struct watch_table *w, enum wt_tab tab, uint32_t v)
+{
+    struct wt_itab *it = wt_tab(w, tab);
+
+    if (!it->slot || (it->n + 1) * 4 > (it->mask + 1) * 3) {   /* <= 75% */
+        int err = wt_itab_grow(w, tab);
+        if (err)
+            return err;
+    }
+    uint32_t i = wt_row_hash(w, tab, v) & it->mask;
+    while (it->slot[i])
+        i = (i + 1) & it->mask;
+    it->slot[i] = v + 1;
+    it->n++;
+    return 0;
+}
+
+static inline void wt_itab_del(struct watch_table *w, enum wt_tab tab, uint32_t v)
+{
+    struct wt_itab *it = wt_tab(w, tab);
+    if (!it->slot)
+        return;
+
+    uint32_t i = wt_row_hash(w, tab, v) & it->mask;
+    while (it->slot[i] && it->slot[i] != v + 1)
+        i = (i + 1) & it->mask;
+    if (!it->slot[i])
+        return;
+
+    /* shift back later entries of the run that hash at or before i */
+    for (uint32_t j = (i + 1) & it->mask; it->slot[j]; j = (j + 1) & it->mask) {
+        uint32_t home = wt_row_hash(w, tab, it->slot[j] - 1) & it->mask;
+        if (((j - home) & it->mask) >= ((j - i) & it->mask)) {
+            it->slot[i] = it->slot[j];
+            i = j;
+        }
+    }
+    it->slot[i] = 0;
+    it->n--;
+}
+
+/* ===== lookups ===== */
+static inline uint32_t wt_find_wd(const struct watch_table *w, int wd)
+{
+    const struct wt_itab *it = &w->by_wd;
+    if (!it->slot || wd < 0)
+        return WT_NONE;
+    for (uint32_t i = wt_hash_int((uint32_t)wd) & it->mask; it->slot[i];
+         i = (i + 1) & it->mask) {
+        uint32_t v = it->slot[i] - 1;
+        int vwd = (v & WT_DIR_BIT) ? w->d[v & ~WT_DIR_BIT].wd : w->t[v].wd;
+        if (vwd == wd)
+            return v;
+    }
+    return WT_NONE;
+}
+
+static inline uint32_t wt_find_name(const struct watch_table *w, uint32_t dir,
+                                    const char *name)
+{
+    const struct wt_itab *it = &w->by_name;
+    if (!it->slot)
+        return WT_NONE;
+    for (uint32_t i = wt_hash_name(dir, name) & it->mask; it->slot[i];
+         i = (i + 1) & it->mask) {
+        uint32_t v = it->slot[i] - 1;
+        if (w->t[v].dir == dir && strcmp(wt_name(w, v), name) == 0)
+            return v;
+    }
+    return WT_NONE;
+}
+
+static inline uint32_t wt_find_dir(const struct watch_table *w, const char *path)
+{
+    const struct wt_itab *it = &w->dir_by_path;
+    if (!it->slot)
+        return WT_NONE;
+    for (uint32_t i = wt_hash_str(2166136261u, path) & it->mask; it->slot[i];
+         i = (i + 1) & it->mask) {
+        uint32_t v = it->slot[i] - 1;
+        if (strcmp(w->d[v].path, path) == 0)
+            return v;
+    }
+    return WT_NONE;
+}
+
+static inline uint32_t wt_find_spec(const struct watch_table *w, const char *spec)
+{
+    const struct wt_itab *it = &w->by_spec;
+    if (!it->slot)
+        return WT_NONE;
+    for (uint32_t i = wt_hash_str(2166136261u, spec) & it->mask; it->slot[i];
+         i = (i + 1) & it->mask) {
+        uint32_t v = it->slot[i] - 1;
+        if (strcmp(w->t[v].spec, spec) == 0)
+            return v;
+    }
+    return WT_NONE;
+}
+
+/* ===== file watch of one target ===== */
+static inline void wt_stat_into(struct wt_target *t, const struct stat *st)
+{
+    t->dev = st->st_dev;
+    t->ino = st->st_ino;
+    t->mtime = st->st_mtime;
+    t->atime = st->st_atime;
+}
+
+/*
+ * Take row i off its wd. The next target on the alias chain takes over
+ * by_wd; returns 1 when nobody else uses the wd.
+ */
+static inline int wt_detach_wd(struct watch_table *w, uint32_t i)
+{
+    struct wt_target *t = &w->t[i];
+    uint32_t owner = wt_find_wd(w, t->wd);
+    uint32_t next = t->alias;
+
+    t->alias = WT_NONE;
+    if (owner == i) {
+        wt_itab_del(w, WT_TAB_WD, i);
+        if (next == WT_NONE)
+            return 1;
+        wt_itab_put(w, WT_TAB_WD, next);   /* a slot was just freed */
+        return 0;
+    }
+    for (uint32_t p = owner; p != WT_NONE && !(p & WT_DIR_BIT);
+         p = w->t[p].alias)
+        if (w->t[p].alias == i) {
+            w->t[p].alias = next;
+            break;
+        }
+    return 0;
+}
+
+static inline void wt_unwatch_file(struct watch_table *w, uint32_t i)
+{
+    struct wt_target *t = &w->t[i];
+    if (t->wd < 0)
+        return;
+    if (wt_detach_wd(w, i))
+        inotify_rm_watch(w->ifd, t->wd);
+    t->wd = -1;
+}
+
+/*
+ * (Re)attach the file watch after the file appeared under its name.
+ * The previous row state is left alone so the caller can compare.
+ */
+static inline int wt_watch_file(struct watch_table *w, uint32_t i)
+{
+    struct wt_target *t = &w->t[i];
+    int wd = inotify_add_watch(w->ifd, t->path, WT_FILE_MASK);
+    if (wd < 0)
+        return -errno;
+    if (wd == t->wd)
+        return 0;
+
+    uint32_t other = wt_find_wd(w, wd);
+    if (other != WT_NONE && (other & WT_DIR_BIT))
+        return -EEXIST;             /* a watched directory, not a file */
+    if (t->wd >= 0)
+        wt_detach_wd(w, i);
+    t->wd = wd;
+    if (other != WT_NONE) {
+        /* same inode as another target (hard link): share its watch */
+        t->alias = w->t[other].alias;
+        w->t[other].alias = i;
+        return 0;
+    }
+    return wt_itab_put(w, WT_TAB_WD, i);
+}
+
+/* ===== directories ===== */
+static inline uint32_t wt_dir_get(struct watch_table *w, const char *path, int *err)
+{
+    uint32_t di = wt_find_dir(w, path);
+    if (di != WT_NONE) {
+        w->d[di].refs++;
+        return di;
+    }
+
+    for (di = 0; di < w->n_d && w->d[di].path; di++)
+        ;
+    if (di == w->n_d) {
+        if (w->n_d == w->cap_d) {
+            uint32_t cap = w->cap_d ? w->cap_d * 2 : 16;
+            struct wt_dir *d = realloc(w->d, cap * sizeof(*d));
+            if (!d) {
+                *err = -ENOMEM;
+                return WT_NONE;
+            }
+            w->d = d;
+            w->cap_d = cap;
+        }
+        w->n_d++;
+    }
+
+    int wd = inotify_add_watch(w->ifd, path, WT_DIR_MASK);
+    if (wd < 0) {
+        *err = -errno;
+        if (di == w->n_d - 1)
+            w->n_d--;
+        return WT_NONE;
+    }
+    w->d[di] = (struct wt_dir){ .path = strdup(path), .wd = wd, .refs = 1 };
+    if (!w->d[di].path ||
+        wt_itab_put(w, WT_TAB_DIR, di) != 0 ||
+        wt_itab_put(w, WT_TAB_WD, di | WT_DIR_BIT) != 0) {
+        *err = -ENOMEM;
+        return WT_NONE;
+    }
+    return di;
+}
+
+static inline void wt_dir_put(struct watch_table *w, uint32_t di)
+{
+    struct wt_dir *d = &w->d[di];
+    if (--d->refs)
+        return;
+    wt_itab_del(w, WT_TAB_WD, di | WT_DIR_BIT);
+    wt_itab_del(w, WT_TAB_DIR, di);
+    if (d->wd != w->keep_wd)
+        inotify_rm_watch(w->ifd, d->wd);
+    free(d->path);
+    d->path = NULL;
+}
+
+/* ===== targets ===== */
+static inline void wt_init(struct watch_table *w, int ifd)
+{
+    memset(w, 0, sizeof(*w));
+    w->ifd = ifd;
+    w->keep_wd = -1;
+}
+
+/*
+ * Add a target. The file must exist; its stat becomes the baseline
+ * (*st, if given). Returns the row or WT_NONE with *err set.
+ */
+static inline uint32_t wt_add(struct watch_table *w, const char *spec,
+                              struct stat *st_out, int *err)
+{
+    char real[PATH_MAX], dir[PATH_MAX];
+    struct stat st;
+    uint32_t i;
+
+    if (!realpath(spec, real) || stat(real, &st) != 0) {
+        *err = -errno;
+        return WT_NONE;
+    }
+    const char *slash = strrchr(real, '/');
+    snprintf(dir, sizeof(dir), "%.*s",
+             slash == real ? 1 : (int)(slash - real), real);
+
+    if (w->n_free) {
+        i = w->free_t[--w->n_free];
+    } else {
+        if (w->n_t == w->cap_t) {
+            uint32_t cap = w->cap_t ? w->cap_t * 2 : 64;
+            struct wt_target *t = realloc(w->t, cap * sizeof(*t));
+            uint32_t *f = realloc(w->free_t, cap * sizeof(*f));
+            if (t)
+                w->t = t;
+            if (f)
+                w->free_t = f;
+            if (!t || !f) {
+                *err = -ENOMEM;
+                return WT_NONE;
+            }
+            w->cap_t = cap;
+        }
+        i = w->n_t++;
+    }
+
+    struct wt_target *t = &w->t[i];
+    memset(t, 0, sizeof(*t));
+    t->wd = -1;
+    t->alias = WT_NONE;
+    t->path = strdup(real);
+    t->spec = strdup(spec);
+    t->name_off = (uint32_t)(slash + 1 - real);
+    if (!t->path || !t->spec) {
+        *err = -ENOMEM;
+        goto fail;
+    }
+    t->dir = wt_dir_get(w, dir, err);
+    if (t->dir == WT_NONE)
+        goto fail;
+    if (wt_find_name(w, t->dir, wt_name(w, i)) != WT_NONE ||
+        wt_find_spec(w, spec) != WT_NONE) {
+        *err = -EEXIST;             /* same file under another spec */
+        wt_dir_put(w, t->dir);
+        goto fail;
+    }
+    *err = wt_watch_file(w, i);
+    if (*err == 0)
+        *err = wt_itab_put(w, WT_TAB_NAME, i);
+    if (*err == 0 && (*err = wt_itab_put(w, WT_TAB_SPEC, i)) != 0)
+        wt_itab_del(w, WT_TAB_NAME, i);
+    if (*err) {
+        wt_unwatch_file(w, i);
+        wt_dir_put(w, t->dir);
+        goto fail;
+    }
+
+    wt_stat_into(t, &st);
+    if (st_out)
+        *st_out = st;
+    w->live++;
+    return i;
+
+fail:
+    free(t->path);
+    free(t->spec);
+    t->spec = t->path = NULL;
+    w->free_t[w->n_free++] = i;
+    return WT_NONE;
+}
+
+static inline void wt_remove(struct watch_table *w, uint32_t i)
+{
+    struct wt_target *t = &w->t[i];
+    if (!t->spec)
+        return;
+    wt_unwatch_file(w, i);
+    wt_itab_del(w, WT_TAB_NAME, i);
+    wt_itab_del(w, WT_TAB_SPEC, i);
+    wt_dir_put(w, t->dir);
+    free(t->path);
+    free(t->spec);
+    t->spec = t->path = NULL;
+    w->free_t[w->n_free++] = i;
+    w->live--;
+}
+
+static inline void wt_free(struct watch_table *w)
+{
+    for (uint32_t i = 0; i < w->n_t; i++)
+        wt_remove(w, i);
+    free(w->t);
+    free(w->free_t);
+    free(w->d);
+    free(w->by_wd.slot);
+    free(w->by_name.slot);
+    free(w->dir_by_path.slot);
+    free(w->by_spec.slot);
+    memset(w, 0, sizeof(*w));
+}
+
+/* ===== dispatch ===== */
+enum wt_kind {
+    WT_EV_NONE,
+    WT_EV_CHANGED,      /* attribute/content event on the file */
+    WT_EV_APPEARED,     /* created or renamed into place */
+    WT_EV_GONE,         /* deleted or renamed away */
+};
+
+/*
+ * Map one event to (target, kind) in O(1). Watch bookkeeping that does
+ * not depend on the caller (IN_IGNORED, unwatching a vanished name) is
+ * done here; re-attaching an appeared file is left to the caller so it
+ * can compare against the previous row state first. WT_EV_CHANGED is
+ * for every target on the returned row's alias chain.
+ */
+static inline uint32_t wt_dispatch(struct watch_table *w,
+                                   const struct inotify_event *e,
+                                   enum wt_kind *kind)
+{
+    *kind = WT_EV_NONE;
+
+    uint32_t v = wt_find_wd(w, e->wd);
+    if (v == WT_NONE)
+        return WT_NONE;
+
+    if (v & WT_DIR_BIT) {
+        if (e->len == 0)
+            return WT_NONE;
+        uint32_t i = wt_find_name(w, v & ~WT_DIR_BIT, e->name);
+        if (i == WT_NONE)
+            return WT_NONE;
+        if (e->mask & (IN_CREATE | IN_MOVED_TO)) {
+            *kind = WT_EV_APPEARED;
+        } else if (e->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            wt_unwatch_file(w, i);
+            *kind = WT_EV_GONE;
+        }
+        return i;
+    }
+
+    if (e->mask & IN_IGNORED) {
+        /* kernel dropped the watch (inode gone); forget the wd */
+        wt_itab_del(w, WT_TAB_WD, v);
+        for (uint32_t j = v, next; j != WT_NONE; j = next) {
+            next = w->t[j].alias;
+            w->t[j].wd = -1;
+            w->t[j].alias = WT_NONE;
+        }
+        return WT_NONE;
+    }
+    if (e->mask & (IN_ATTRIB | IN_MODIFY | IN_CLOSE_WRITE)) {
+        *kind = WT_EV_CHANGED;
+        return v;
+    }
+    return WT_NONE;
+}
+
+/* ===== queue overflow rescan =====
+ *
+ * IN_Q_OVERFLOW says events were dropped, not which. Every target that
+ * has not produced an event since the overflow is stat()ed again, most
+ * recently active first (the burst that overflowed the queue most
+ * likely hit those), in slices of WT_RESCAN_SLICE targets or
+ * WT_RESCAN_BUDGET_NS so live events keep being read in between. The
+ * caller marks a target fresh (fresh_gen = gen) and stamps
+ * last_event_ns on CLOCK_MONOTONIC for every event; fresh targets are
+ * skipped.
+ */
+#define WT_RESCAN_SLICE      256
+#define WT_RESCAN_BUDGET_NS  2000000LL
+
+struct wt_rescan_ent {
+    int64_t last_event_ns;
+    uint32_t row;               /* WT_NONE once removed */
+};
+
+struct wt_rescan {
+    struct wt_rescan_ent *q;
+    uint32_t n, pos;
+    uint32_t gen;               /* bumped per IN_Q_OVERFLOW */
+    int64_t start_ns;
+    unsigned long long overflows;
+    unsigned long long rescans;         /* completed */
+    unsigned long long rescanned;       /* targets stat()ed by rescans */
+    long long last_us, max_us, total_us;
+};
+
+static inline int64_t wt_mono_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int wt_rescan_busy(const struct wt_rescan *r)
+{
+    return r->pos < r->n;
+}
+
+static inline int wt_rescan_cmp(const void *a, const void *b)
+{
+    const struct wt_rescan_ent *x = a, *y = b;
+    return (x->last_event_ns < y->last_event_ns) -
+           (x->last_event_ns > y->last_event_ns);
+}
+
+/* on IN_Q_OVERFLOW; -ENOMEM leaves no rescan queued */
+static inline int wt_rescan_begin(struct watch_table *w, struct wt_rescan *r)
+{
+    r->overflows++;
+    r->gen++;
+
+    /* an overflow during a rescan restarts it: its stats were lost too */
+    if (!wt_rescan_busy(r))
+        r->start_ns = wt_mono_ns();
+
+    struct wt_rescan_ent *q = realloc(r->q, (w->n_t ? w->n_t : 1) * sizeof(*q));
+    r->n = r->pos = 0;
+    if (!q)
+        return -ENOMEM;
+    r->q = q;
+    for (uint32_t i = 0; i < w->n_t; i++)
+        if (w->t[i].spec)
+            q[r->n++] = (struct wt_rescan_ent){ w->t[i].last_event_ns, i };
+    qsort(q, r->n, sizeof(*q), wt_rescan_cmp);
+    return 0;
+}
+
+/*
+ * One slice, while wt_rescan_busy(): check(row) for each target still
+ * stale. Returns 1 when this slice finished the rescan (r->n targets;
+ * last_us and friends are then set).
+ */
+static inline int wt_rescan_step(struct watch_table *w, struct wt_rescan *r,
+                                 void (*check)(uint32_t row, void *arg),
+                                 void *arg)
+{
+    int64_t t0 = wt_mono_ns();
+
+    for (int done = 0; wt_rescan_busy(r) && done < WT_RESCAN_SLICE; done++) {
+        uint32_t i = r->q[r->pos++].row;
+        if (i == WT_NONE || w->t[i].fresh_gen == r->gen)
+            continue;
+        check(i, arg);
+        w->t[i].fresh_gen = r->gen;
+        r->rescanned++;
+        if (wt_mono_ns() - t0 >= WT_RESCAN_BUDGET_NS)
+            break;
+    }
+    if (wt_rescan_busy(r))
+        return 0;
+
+    r->rescans++;
+    r->last_us = (wt_mono_ns() - r->start_ns) / 1000;
+    r->total_us += r->last_us;
+    if (r->last_us > r->max_us)
+        r->max_us = r->last_us;
+    return 1;
+}
+
+/* a row removed while queued (rows get reused) */
+static inline void wt_rescan_forget(struct wt_rescan *r, uint32_t row)
+{
+    for (uint32_t i = r->pos; i < r->n; i++)
+        if (r->q[i].row == row)
+            r->q[i].row = WT_NONE;
+}
+
+static inline void wt_rescan_free(struct wt_rescan *r)
+{
+    free(r->q);
+    memset(r, 0, sizeof(*r));
+}
+
+#endif /* WATCH_TABLE_H */
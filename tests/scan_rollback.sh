@@ -0,0 +1,30 @@
+#!/bin/sh
+# scan_baseline -I: a timestamp set back in place (utimensat, directory
+# untouched) is flagged by the next incremental pass and by the ones
+# after it, and files flagged before stay in the output.
+#
+#   tests/scan_rollback.sh ./scan_baseline
+set -u
+bin=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+mkdir -p "$dir/sb/a" "$dir/sb/b"
+for f in f1 f2 f3; do echo x > "$dir/sb/a/$f"; done
+echo x > "$dir/sb/b/fut"
+touch -d 2040-01-01 "$dir/sb/b/fut"
+
+fail() { echo "FAIL: $*"; exit 1; }
+
+"$bin" -I "$dir/idx" "$dir/sb" > "$dir/out0" 2> /dev/null || fail "first pass"
+grep -q "/b/fut" "$dir/out0" || fail "future file not flagged"
+
+touch -d 2002-01-01 "$dir/sb/a/f3"
+for pass in 1 2; do
+    "$bin" -I "$dir/idx" "$dir/sb" > "$dir/out$pass" 2> "$dir/err$pass" ||
+        fail "pass $pass"
+    grep -q "mode=incremental" "$dir/err$pass" || fail "pass $pass not incremental"
+    grep "/a/f3" "$dir/out$pass" | grep -q "mtime_rollback" ||
+        fail "pass $pass: rollback of a/f3 not reported"
+    grep -q "/b/fut" "$dir/out$pass" || fail "pass $pass: b/fut dropped"
+done
+echo "PASS scan_rollback"
@@ -0,0 +1,37 @@
+#!/bin/sh
+# call_inotify: two targets that are hard links of one file share an
+# inotify watch. A change through either name is reported for both,
+# and neither is taken for a recreated file.
+#
+#   tests/watch_hardlink.sh ./call_inotify
+set -u
+bin=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+mkdir "$dir/w"
+echo x > "$dir/w/a"
+ln "$dir/w/a" "$dir/w/b"
+: > "$dir/tl.txt"
+
+fail() { echo "FAIL: $*"; exit 1; }
+
+"$bin" -o "$dir/o.log" "$dir/w/a" "$dir/w/b" "$dir/tl.txt" > /dev/null 2> "$dir/err" &
+pid=$!
+sleep 0.5
+kill -0 $pid 2> /dev/null || fail "watcher did not start: $(cat "$dir/err")"
+
+touch -d 2001-01-01 "$dir/w/a"
+sleep 0.3
+touch -d 2002-01-01 "$dir/w/b"
+sleep 0.3
+echo y >> "$dir/w/a"
+sleep 0.3
+kill -TERM $pid
+wait $pid
+
+grep -q "File recreated" "$dir/o.log" && fail "hard link taken for a recreated file"
+for f in a b; do
+    n=$(grep -c "mtime changed.*path=$dir/w/$f\$" "$dir/o.log")
+    [ "$n" -ge 3 ] || fail "$f: $n mtime alerts, want 3"
+done
+echo "PASS watch_hardlink"
@@ -10,20 +10,51 @@ if is_plat("android") then
     set_toolchains("@ndk", { sdkver = "23" })
 end
 
--- 1) BPF  (clang, no skeleton)
-target("probe.bpf")
-  set_kind("object")
-  set_plat("linux")
-  add_rules("platform.linux.bpf", { skeleton = false })
-    add_packages("libbpf")
-  add_files("src/probe.bpf.c")
-  -- ?? ɺ  
-  add_cflags("-fvisibility=default")
--- 2) Android  
-target("probe")
+-- 1) BPF + δ  (clang, skeleton )
+--    platform.linux.bpf Ģ <name>.bpf.c  ϰ <name>.skel.h 
+--    ϹǷ .bpf.o   Ʈ ̳ʸ ˴ϴ.
+for _, name in ipairs({"probe", "how_much_count", "perfbuffer_settimeofday", "file_ts"}) do
+    target(name)
+        set_kind("binary")
+        add_rules("platform.linux.bpf")
+        add_packages("libbpf", "linux-tools")
+        add_syslinks("pthread")
+        if name == "probe" then
+            -- seqlock  cmpxchg/fetch   BPF ISA v3, Ŀ 5.12+  ʿմϴ
+            add_files("src/probe.bpf.c", { cflags = "-mcpu=v3" })
+            add_files("src/main.c")
+        else
+            add_files("src/" .. name .. ".bpf.c")
+            add_files("src/" .. name .. ".c")
+        end
+end
+
+-- 2) BPF  userspace 
+target("scan_baseline")
+    set_kind("binary")
+    add_syslinks("pthread")
+    add_files("src/scan_baseline.c")
+
+target("bench_classify")
+    set_kind("binary")
+    add_files("src/bench_classify.c")
+
+target("bench_alert_fmt")
+    set_kind("binary")
+    add_files("src/bench_alert_fmt.c")
+
+target("bench_watcher")
+    set_kind("binary")
+    add_syslinks("pthread")
+    add_files("src/bench_watcher.c")
+
+target("collector")
+    set_kind("binary")
+    add_syslinks("pthread")
+    add_files("src/collector.c")
+
+target("log_verify")
     set_kind("binary")
-    add_deps("probe.bpf")
-    add_packages("libbpf", "linux-tools")
-    add_files("src/main.c")
+    add_files("src/log_verify.c")
 
 set_languages("gnu11")